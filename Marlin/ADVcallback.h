@@ -26,74 +26,11 @@
 namespace adv
 {
 
-namespace internal {
-    template<typename I>
-    void copy_data(const I& i, void* o)
-    {
-        auto p = reinterpret_cast<const char*>(&i);
-        copy(p, p + sizeof(I), reinterpret_cast<char*>(o));
-    }
-}
-
-template<typename R, typename...A>
-struct Callable
-{
-    virtual void clone(void* dest) const = 0;
-    virtual R operator()(A&&...args) const = 0;
-    virtual ~Callable() = default;
-};
-
-template<typename R, typename...A>
-struct CallableFunction: public Callable<R, A...>
-{
-    using FP = R(*)(A...);
-    using Super = Callable<R, A...>;
-    using Self = CallableFunction<R, A...>;
-
-    explicit CallableFunction(FP f): function_{f} {}
-    void clone(void* dest) const override { internal::copy_data(function_, dest); }
-
-    R operator()(A&&...args) const override { if(is_void<R>::value) function_(forward<A>(args)...);
-        else return function_(forward<A>(args)...); }
-
-private:
-    FP function_;
-};
-
-template<typename O, typename R, typename...A>
-struct CallableMethod: public Callable<R, A...>
-{
-    using MP = R(O::*)(A...); // Pointer to member function type
-    using Super = Callable<R, A...>;
-    using Self = CallableMethod<O, R, A...>;
-
-    CallableMethod(O& o, MP m): f_{o, m} {}
-    void clone(void* dest) const override { internal::copy_data(f_, dest); }
-
-    R operator()(A&&...args) const override { if(is_void<R>::value) (f_.object_.*f_.method_)(forward<A>(args)...);
-        else return (f_.object_.*f_.method_)(forward<A>(args)...); }
-
-private:
-    struct fields { O& object_; MP method_; } f_{};
-};
-
-template<typename O, typename R, typename...A>
-struct CallableConstMethod: public Callable<R, A...>
-{
-    using MP = R(O::*)(A...) const; // Pointer to member function type
-    using Super = Callable<R, A...>;
-    using Self = CallableMethod<O, R, A...>;
-
-    CallableConstMethod(const O& o, MP m): f_{o, m} {}
-    void clone(void* dest) const override { internal::copy_data(f_, dest); }
-
-    R operator()(A&&...args) const override { if(is_void<R>::value) (f_.object_.*f_.method_)(forward<A>(args)...);
-        else return (f_.object_.*f_.method_)(forward<A>(args)...); }
-
-private:
-    struct fields { const O& object_; MP method_; } f_{};
-};
-
+//! Callback without virtual functions and without dynamic allocation.
+//! It is made of the object, the function or member function and a thunk: a plain function
+//! that knows their real types and makes the call. Copying a Callback copies these few bytes
+//! and calling it is one indirect call, without a vtable.
+//! Only member functions of objects and functions are supported, not lambdas with captures.
 template<typename>
 struct Callback;
 
@@ -108,56 +45,70 @@ struct Callback<R(*)(A...)>
     explicit Callback(nullptr_t) noexcept {}
 
     // From a function
-    explicit Callback(FP f): isNull_{false} { place<CallableFunction<R, A...>>(f); }
+    explicit Callback(FP f): thunk_{f ? &call_function : nullptr} { target_.function_ = f; }
 
     // From a member function and object reference
     template <typename O>
-    Callback(O& o, R(O::*m)(A...)): isNull_{false}  { place<CallableMethod<O, R, A...>>(o, m); }
+    Callback(O& o, R(O::*m)(A...)) { bind<O>(&o, m); }
 
     // From a member function and object pointer
     template <typename O>
-    Callback(O* o, R(O::*m)(A...)): isNull_{false}  { place<CallableMethod<O, R, A...>>(*o, m); }
+    Callback(O* o, R(O::*m)(A...)) { bind<O>(o, m); }
 
     // From a const member function and object reference
     template <typename O>
-    Callback(const O& o, R(O::*m)(A...)): isNull_{false}  { place<CallableConstMethod<O, R, A...>>(o, m); }
+    Callback(const O& o, R(O::*m)(A...) const) { bind<const O>(&o, m); }
 
     // From a const member function and object pointer
     template <typename O>
-    Callback(const O* o, R(O::*m)(A...)): isNull_{false}  { place<CallableConstMethod<O, R, A...>>(*o, m); }
+    Callback(const O* o, R(O::*m)(A...) const) { bind<const O>(o, m); }
 
-    // Captured lambda specialization
+    // From a lambda without capture
     template<typename L>
-    explicit Callback(const L& l): isNull_{false}  { place<CallableFunction<R, A...>>(l); }
+    explicit Callback(const L& l): Callback{static_cast<FP>(l)} {}
 
-    // From another Callback
-    Callback(const Self& cb): isNull_{cb.isNull_}  { copy_buffer(cb.buffer_); }
-
-    // Assignment
-    Callback& operator=(const Self& cb) { if(&cb != this) { isNull_ = cb.isNull_;  copy_buffer(cb.buffer_); } return *this; };
-    Callback& operator=(nullptr_t) { isNull_ = true; return *this; }
+    // Copy and assignment are the ones of the fields
+    Callback(const Self&) = default;
+    Callback& operator=(const Self&) = default;
+    Callback& operator=(nullptr_t) { thunk_ = nullptr; return *this; }
 
     // Call
-    R operator()(A&&... args)
-        { if(is_void<R>::value) { if(!isNull_) (*callable())(forward<A>(args)...); }
-          else { return !isNull_ ? (*callable())(forward<A>(args)...) : R(); } }
+    R operator()(A... args) const { return thunk_ ? thunk_(*this, forward<A>(args)...) : R(); }
 
     // Boolean
-    explicit operator bool() const noexcept { return !isNull_; }
+    explicit operator bool() const noexcept { return thunk_ != nullptr; }
 
 private:
-    void copy_buffer(const char* from) { copy(from, from + BUFFER_SIZE, buffer_); }
-    Callable<R, A...>* callable() { return reinterpret_cast<Callable<R, A...>*>(buffer_); }
+    struct Generic;
+    using MP = R(Generic::*)(A...);
+    using Thunk = R(*)(const Self&, A...);
+    static_assert(sizeof(MP) <= 2 * sizeof(void*), "A pointer to member function is expected to be 2 words");
+
+    template<typename O, typename M>
+    void bind(O* o, M m)
+    {
+        static_assert(sizeof(M) == sizeof(MP), "Unsupported member function pointer");
+        object_ = const_cast<void*>(static_cast<const void*>(o));
+        target_.method_ = reinterpret_cast<MP>(m);
+        thunk_ = m ? &call_method<O, M> : nullptr;
+    }
 
-    template<typename T, typename... Args> void place(Args&&... args)
-    { static_assert(sizeof(T) <= BUFFER_SIZE, "Buffer is too small"); new(buffer_) T(forward<Args>(args)...); }
+    static R call_function(const Self& self, A... args)
+        { return self.target_.function_(forward<A>(args)...); }
+
+    template<typename O, typename M>
+    static R call_method(const Self& self, A... args)
+        { return (static_cast<O*>(self.object_)->*reinterpret_cast<M>(self.target_.method_))(forward<A>(args)...); }
 
 private:
-    static const size_t BUFFER_SIZE = 8;
-    char buffer_[BUFFER_SIZE] = {};
-    bool isNull_ = true;
+    void* object_ = nullptr;
+    union Target { FP function_; MP method_; } target_{};
+    Thunk thunk_ = nullptr;
 };
 
+// Object, member function (2 words) and thunk: 8 bytes on the ATmega, one less than the previous implementation
+static_assert(sizeof(Callback<void(*)()>) == 4 * sizeof(void*), "Callback is larger than its fields");
+
 }
 
 #endif // ADV_CALLBACKS_H
@@ -0,0 +1,83 @@
+/**
+ * ADVdispatch - Dispatch of events through tables of thunks
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ADV_DISPATCH_H
+#define ADV_DISPATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace adv {
+
+//! The type itself, to name a member of the type of an object: &TypeOf<decltype(object)>::member
+template<typename T>
+using TypeOf = T;
+
+//! Event dispatch through a table indexed by the event. Each entry is a thunk: a plain function
+//! that calls a member function of an object known at compile time. The tables are constexpr and
+//! can be placed in flash (PROGMEM), there is no switch and no virtual function.
+//! Nothing here depends on the rest of the firmware so it can be tested on the host.
+template<typename E, typename V>
+struct Dispatch
+{
+    using Thunk = void (*)(V);
+
+    //! An entry of the table: an event and the function called with the value of the event
+    struct Entry
+    {
+        E event;
+        Thunk thunk;
+    };
+
+    //! Thunk calling handle(value) on an object
+    template<typename H, H& object>
+    static void handle(V value) { object.handle(value); }
+
+    //! Thunk calling a member function without parameter
+    template<typename H, H& object, void (H::*method)()>
+    static void call(V) { (object.*method)(); }
+
+    //! Thunk calling a member function with the value converted to a parameter
+    template<typename H, typename P, H& object, void (H::*method)(P)>
+    static void call_with(V value) { (object.*method)(static_cast<P>(value)); }
+
+    //! Are the entries of a table indexed by their event, starting at first? Holes are entries without thunk.
+    static constexpr bool is_indexed(const Entry* entries, size_t count, uint16_t first)
+    {
+        return count == 0 || (static_cast<uint16_t>(entries[0].event) == first && is_indexed(entries + 1, count - 1, first + 1));
+    }
+
+    //! Thunk of an event in a table, nullptr if there is none
+    //! @tparam READ    Provides static Thunk read(const Thunk*): reads a thunk from the memory of the table
+    //! @param entries  The entries, indexed by their event (is_indexed)
+    //! @param count    Number of entries
+    //! @param first    Event of the first entry
+    //! @param event    The event
+    template<typename READ>
+    static Thunk find(const Entry* entries, size_t count, uint16_t first, E event)
+    {
+        const uint16_t index = static_cast<uint16_t>(static_cast<uint16_t>(event) - first);
+        return index < count ? READ::read(&entries[index].thunk) : nullptr;
+    }
+};
+
+}
+
+#endif // ADV_DISPATCH_H
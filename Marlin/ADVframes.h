@@ -0,0 +1,233 @@
+/**
+ * ADVframes - Frames to the LCD panel gathered in bursts or cut in chunks
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ADV_FRAMES_H
+#define ADV_FRAMES_H
+
+#include <stdint.h>
+#include <string.h>
+
+namespace adv {
+
+//! Frames sent to a DGUS panel while a page is prepared, written together when it is shown.
+//! - Writes to contiguous VPs (variables) are merged into one frame
+//! - The other writes are kept in order and written with the others in one burst
+//! - The page switch (PictureID register) is always written last, so the panel never shows
+//!   the page with the data of before
+//! Read requests are not gathered: the writes before them are sent first, the page switch is kept.
+//! Nothing here depends on the rest of the firmware so it can be tested on the host.
+//! @tparam SIZE    Size of the buffer (bytes)
+//! @tparam SINK    Provides static bool write(const uint8_t* data, size_t size) - false on error
+template<uint16_t SIZE, typename SINK>
+struct FrameBatch
+{
+    static const uint8_t HEADER_SIZE = 3;       //!< 5A A5 Length
+    static const uint8_t WRITE_REGISTER = 0x80;
+    static const uint8_t WRITE_RAM = 0x82;
+    static const uint8_t WRITE_CURVE = 0x84;
+    static const uint8_t PICTURE_ID = 0x03;
+    static const uint8_t MAX_LENGTH = 0xFF;     //!< Maximum value of the length byte
+
+    //! Start to gather frames. Batches can be nested, frames are written at the end of the outermost.
+    void begin() { ++depth_; }
+
+    //! End of a batch. The outermost writes the frames gathered.
+    //! @return false if a write failed
+    bool end()
+    {
+        if(!depth_ || --depth_)
+            return !error_;
+        flush(true);
+        const bool ok = !error_;
+        error_ = false;
+        return ok;
+    }
+
+    //! Is a batch started?
+    bool active() const { return depth_ > 0; }
+
+    //! Add a frame to the batch
+    //! @param frame    The frame: header, length, command, data
+    //! @param size     Size of the frame
+    //! @return false if the frame is not gathered and has to be sent by the caller
+    bool add(const uint8_t* frame, uint16_t size)
+    {
+        if(!depth_ || size <= HEADER_SIZE + 1)
+            return false;
+
+        const uint8_t command = frame[HEADER_SIZE];
+        if(command == WRITE_REGISTER && size == HEADER_SIZE + 4 && frame[HEADER_SIZE + 1] == PICTURE_ID)
+        {
+            memcpy(page_, frame, size);
+            has_page_ = true;
+            return true;
+        }
+
+        if(command != WRITE_REGISTER && command != WRITE_RAM && command != WRITE_CURVE)
+        {
+            flush(false); // Keep the order of the writes and the read
+            return false;
+        }
+
+        if(command == WRITE_RAM && merge(frame, size))
+            return true;
+
+        if(size > SIZE - length_)
+            flush(false);
+        if(size > SIZE)
+            return false; // Too big, sent alone (after the frames gathered)
+
+        last_ = length_;
+        memcpy(buffer_ + length_, frame, size);
+        length_ += size;
+        return true;
+    }
+
+    //! Number of bytes gathered (page switch not included)
+    uint16_t pending() const { return length_; }
+    //! Number of writes to SINK
+    uint16_t bursts() const { return bursts_; }
+
+private:
+    //! VP (variable) of a write to RAM
+    static uint16_t vp(const uint8_t* frame) { return static_cast<uint16_t>(frame[HEADER_SIZE + 1] << 8 | frame[HEADER_SIZE + 2]); }
+
+    //! Append the data of a write to RAM to the previous one if it ends where it starts
+    bool merge(const uint8_t* frame, uint16_t size)
+    {
+        if(last_ == NONE)
+            return false;
+        uint8_t* previous = buffer_ + last_;
+        const uint8_t previous_length = previous[HEADER_SIZE - 1];
+        const uint8_t previous_data = previous_length - 3; // Command and VP
+        if(previous[HEADER_SIZE] != WRITE_RAM || (previous_data & 1))
+            return false;
+        if(vp(previous) + previous_data / 2 != vp(frame))
+            return false;
+
+        const uint16_t data = size - HEADER_SIZE - 3;
+        if(previous_length + data > MAX_LENGTH || length_ + data > SIZE)
+            return false;
+
+        memcpy(buffer_ + length_, frame + HEADER_SIZE + 3, data);
+        previous[HEADER_SIZE - 1] = static_cast<uint8_t>(previous_length + data);
+        length_ += data;
+        return true;
+    }
+
+    //! Write the frames gathered, and the page switch if asked and there is one
+    void flush(bool with_page)
+    {
+        if(with_page && has_page_)
+        {
+            if(length_ + sizeof(page_) > SIZE)
+                flush(false);
+            memcpy(buffer_ + length_, page_, sizeof(page_));
+            length_ += sizeof(page_);
+            has_page_ = false;
+        }
+
+        if(length_)
+        {
+            if(!SINK::write(buffer_, length_))
+                error_ = true;
+            ++bursts_;
+        }
+        length_ = 0;
+        last_ = NONE;
+    }
+
+private:
+    static const uint16_t NONE = 0xFFFF;
+
+    uint8_t buffer_[SIZE];
+    uint8_t page_[HEADER_SIZE + 4] = {};
+    uint16_t length_ = 0;
+    uint16_t last_ = NONE;      //!< Position of the last frame
+    uint16_t bursts_ = 0;
+    uint8_t depth_ = 0;
+    bool has_page_ = false;
+    bool error_ = false;
+};
+
+//! Words written to contiguous VPs (variables), in as many frames as needed.
+//! A frame of the panel carries at most 252 bytes: longer data (such as a large leveling grid)
+//! is cut in chunks, each written to the VP following the previous chunk.
+//! @tparam SINK    Provides static bool write(uint16_t vp, const uint8_t* data, uint8_t size) - false on error
+//! @tparam CHUNK   Maximum number of bytes in a frame (even)
+template<typename SINK, uint8_t CHUNK = 128>
+struct VPStream
+{
+    static_assert(CHUNK >= 2 && CHUNK % 2 == 0 && CHUNK <= 252, "The chunk is made of words and fits in a frame");
+
+    //! Stream starting at a VP
+    explicit VPStream(uint16_t vp): vp_{vp} {}
+    //! The remaining words are written
+    ~VPStream() { flush(); }
+
+    //! Append a word, writing a chunk when it is full
+    VPStream& write(uint16_t word)
+    {
+        buffer_[length_++] = static_cast<uint8_t>(word >> 8);
+        buffer_[length_++] = static_cast<uint8_t>(word & 0xFF);
+        if(length_ >= CHUNK)
+            flush();
+        return *this;
+    }
+
+    //! Write the words not yet written
+    //! @return false if a write failed, now or before
+    bool flush()
+    {
+        if(length_)
+        {
+            if(!SINK::write(vp_, buffer_, length_))
+                error_ = true;
+            vp_ += length_ / 2;
+            length_ = 0;
+            ++frames_;
+        }
+        return !error_;
+    }
+
+    //! Continue at another VP, once the words not yet written are written
+    //! (one stream, and one chunk on the stack, for several variables)
+    void seek(uint16_t vp)
+    {
+        flush();
+        vp_ = vp;
+    }
+
+    //! VP of the next word
+    uint16_t vp() const { return static_cast<uint16_t>(vp_ + length_ / 2); }
+    //! Number of frames written
+    uint8_t frames() const { return frames_; }
+
+private:
+    uint8_t buffer_[CHUNK];
+    uint16_t vp_;
+    uint8_t length_ = 0;
+    uint8_t frames_ = 0;
+    bool error_ = false;
+};
+
+}
+
+#endif // ADV_FRAMES_H
@@ -0,0 +1,108 @@
+/**
+ * ADVpresses - Repeated presses of +/- buttons merged into one change
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ADV_PRESSES_H
+#define ADV_PRESSES_H
+
+#include <stdint.h>
+
+namespace adv {
+
+//! Presses of +/- buttons (controls) of the LCD panel merged into one change, applied later.
+//! The presses of a control in the same direction are added. The sum is ready to be applied when
+//! the presses stop for WINDOW ms, or when the first press waits for LATENCY ms (button held).
+//! A press in the other direction makes the sum ready at once and starts a new one.
+//! Time is given by the caller (millis()), so it can be tested on the host.
+//! @tparam N        Number of controls
+//! @tparam WINDOW   Time without press after which the change is applied (ms)
+//! @tparam LATENCY  Maximum time between a press and its change (ms)
+template<uint8_t N, uint16_t WINDOW, uint16_t LATENCY>
+struct Presses
+{
+    static_assert(WINDOW <= LATENCY, "The window is shorter than the latency");
+
+    //! Add a press
+    //! @param control  Index of the control
+    //! @param delta    Change of this press
+    //! @param now      Current time
+    void add(uint8_t control, int16_t delta, uint32_t now)
+    {
+        Pending& pending = pending_[control];
+        if(pending.delta && (pending.delta > 0) != (delta > 0))
+        {
+            pending.ready = add(pending.ready, pending.delta);
+            pending.delta = 0;
+        }
+        if(!pending.delta)
+            pending.first = static_cast<uint16_t>(now);
+        pending.delta = add(pending.delta, delta);
+        pending.last = static_cast<uint16_t>(now);
+    }
+
+    //! Take the change of a control if it is ready
+    //! @param control  Index of the control
+    //! @param now      Current time
+    //! @return The change to apply, 0 if there is nothing to apply yet
+    int16_t take(uint8_t control, uint32_t now)
+    {
+        Pending& pending = pending_[control];
+        int16_t delta = pending.ready;
+        if(delta)
+        {
+            pending.ready = 0;
+            return delta;
+        }
+
+        delta = pending.delta;
+        const uint16_t time = static_cast<uint16_t>(now);
+        if(!delta || (static_cast<uint16_t>(time - pending.last) < WINDOW && static_cast<uint16_t>(time - pending.first) < LATENCY))
+            return 0;
+        pending.delta = 0;
+        return delta;
+    }
+
+    //! Is there a change waiting for a control?
+    bool pending(uint8_t control) const { return pending_[control].ready || pending_[control].delta; }
+
+    //! Forget all the presses
+    void clear() { for(auto& pending: pending_) pending = Pending{}; }
+
+private:
+    //! Saturated addition (INT16_MAX is not always defined in C++ by avr-libc)
+    static int16_t add(int16_t a, int16_t b)
+    {
+        const int32_t sum = static_cast<int32_t>(a) + b;
+        return sum > 32767 ? 32767 : sum < -32768 ? -32768 : static_cast<int16_t>(sum);
+    }
+
+    struct Pending
+    {
+        int16_t ready = 0;      //!< Change to apply at once (direction changed)
+        int16_t delta = 0;      //!< Sum of the presses in the current direction
+        uint16_t first = 0;     //!< Time of the first press of the sum (low bits of millis())
+        uint16_t last = 0;      //!< Time of the last press
+    };
+
+    Pending pending_[N];
+};
+
+}
+
+#endif // ADV_PRESSES_H
@@ -0,0 +1,269 @@
+/**
+ * ADVscheduler - Cooperative scheduler of periodic tasks without dynamic allocation
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ADV_SCHEDULER_H
+#define ADV_SCHEDULER_H
+
+#include <stdint.h>
+
+namespace adv {
+
+//! Handle of a scheduled task. The slot is in the low bits, a generation in the high bits
+//! so a handle of a cancelled task never matches a task added later in the same slot.
+using TaskHandle = uint8_t;
+const TaskHandle no_task = 0xFF;
+
+//! Statistics of a task
+struct TaskStats
+{
+    uint16_t period;        //!< Period of the task (ms)
+    uint16_t runs;          //!< Number of times the task was executed (saturated)
+    uint16_t overruns;      //!< Number of times it was executed more than a period late (saturated)
+    uint16_t max_late;      //!< Longest delay between its deadline and its execution (ms, saturated)
+};
+
+//! Fixed-capacity cooperative scheduler. Each task has a period and a deadline. The tasks are
+//! kept in a binary heap ordered by deadline, so execute() only looks at the top of the heap
+//! when nothing is due, whatever the number of tasks.
+//! Time is given by the caller (millis()), so it can be tested on the host.
+//! @tparam T   Type of the tasks, called with operator()
+//! @tparam N   Maximum number of tasks (at most 16)
+template<typename T, uint8_t N>
+struct Scheduler
+{
+    static_assert(N >= 1 && N <= 16, "From 1 to 16 tasks");
+
+    //! Add a task
+    //! @param task     The task
+    //! @param period   Period of the task (ms, at least 1)
+    //! @param now      Current time
+    //! @return The handle of the task or no_task if there is no free slot
+    TaskHandle add(const T& task, uint16_t period, uint32_t now)
+    {
+        if(count_ >= N)
+            return no_task;
+
+        uint8_t index = 0;
+        while(slots_[index].used)
+            ++index;
+
+        Slot& slot = slots_[index];
+        slot.task = task;
+        slot.used = true;
+        slot.period = period ? period : 1;
+        slot.deadline = now + slot.period;
+        slot.stats = TaskStats{slot.period, 0, 0, 0};
+        slot.generation = slot.generation < 14 ? slot.generation + 1 : 0; // Never 0xFF (no_task)
+
+        heap_[count_] = index;
+        slot.position = count_;
+        ++count_;
+        up(slot.position);
+        return static_cast<TaskHandle>(slot.generation << 4 | index);
+    }
+
+    //! Cancel a task. The handle is set to no_task.
+    //! @return true if the task was scheduled
+    bool cancel(TaskHandle& handle)
+    {
+        Slot* slot = find(handle);
+        handle = no_task;
+        if(!slot)
+            return false;
+
+        slot->used = false;
+        const uint8_t position = slot->position;
+        --count_;
+        if(position < count_)
+        {
+            move(count_, position);
+            if(!up(position))
+                down(position);
+        }
+        return true;
+    }
+
+    //! Is the task scheduled?
+    bool has(TaskHandle handle) const { return find(handle) != nullptr; }
+    //! Number of tasks scheduled
+    uint8_t count() const { return count_; }
+
+    //! Change the period of a task. It takes effect at its next deadline.
+    void set_period(TaskHandle handle, uint16_t period)
+    {
+        Slot* slot = find(handle);
+        if(slot)
+            slot->stats.period = slot->period = period ? period : 1;
+    }
+
+    //! Deadline of the next task to execute
+    //! @return false if there is no task
+    bool next_deadline(uint32_t& deadline) const
+    {
+        if(!count_)
+            return false;
+        deadline = slots_[heap_[0]].deadline;
+        return true;
+    }
+
+    //! Execute the tasks that are due, in deadline order, each at most once.
+    //! A task can add or cancel tasks, including itself.
+    //! @param now  Current time
+    //! @return Number of tasks executed
+    uint8_t execute(uint32_t now)
+    {
+        uint8_t executed = 0;
+        // Each task executed is rescheduled after now, so the loop ends
+        while(count_ && late(slots_[heap_[0]].deadline, now))
+        {
+            const uint8_t index = heap_[0];
+            Slot& slot = slots_[index];
+
+            const uint32_t delay = now - slot.deadline;
+            if(delay >= slot.period && slot.stats.overruns < 0xFFFF)
+                ++slot.stats.overruns;
+            if(delay > slot.stats.max_late)
+                slot.stats.max_late = delay < 0xFFFF ? static_cast<uint16_t>(delay) : 0xFFFF;
+            if(slot.stats.runs < 0xFFFF)
+                ++slot.stats.runs;
+
+            // Next deadline: one period later, or one period from now if it is behind
+            slot.deadline += slot.period;
+            if(late(slot.deadline, now))
+                slot.deadline = now + slot.period;
+            down(0);
+
+            // The task may cancel itself and its slot be reused: call a copy
+            T task = slot.task;
+            task();
+            ++executed;
+        }
+        return executed;
+    }
+
+    //! Get the statistics of a task
+    //! @return false if the handle is not a scheduled task
+    bool stats(TaskHandle handle, TaskStats& stats) const
+    {
+        const Slot* slot = find(handle);
+        if(!slot)
+            return false;
+        stats = slot->stats;
+        return true;
+    }
+
+    //! Handle of the task in a slot, to enumerate the tasks
+    //! @return no_task if the slot is free
+    TaskHandle handle(uint8_t index) const
+    {
+        return index < N && slots_[index].used ? static_cast<TaskHandle>(slots_[index].generation << 4 | index) : no_task;
+    }
+
+private:
+    struct Slot
+    {
+        T task{};
+        uint32_t deadline = 0;
+        uint16_t period = 0;
+        TaskStats stats{};
+        uint8_t position = 0;       //!< Position in the heap
+        uint8_t generation = 0;
+        bool used = false;
+    };
+
+    //! Is the deadline reached? (millis() wraps around)
+    static bool late(uint32_t deadline, uint32_t now) { return static_cast<int32_t>(now - deadline) >= 0; }
+
+    bool before(uint8_t a, uint8_t b) const
+    {
+        return static_cast<int32_t>(slots_[heap_[a]].deadline - slots_[heap_[b]].deadline) < 0;
+    }
+
+    const Slot* find(TaskHandle handle) const
+    {
+        const uint8_t index = handle & 0x0F;
+        if(handle == no_task || index >= N)
+            return nullptr;
+        const Slot& slot = slots_[index];
+        return slot.used && slot.generation == (handle >> 4) ? &slot : nullptr;
+    }
+
+    Slot* find(TaskHandle handle)
+    {
+        return const_cast<Slot*>(static_cast<const Scheduler*>(this)->find(handle));
+    }
+
+    void move(uint8_t from, uint8_t to)
+    {
+        heap_[to] = heap_[from];
+        slots_[heap_[to]].position = to;
+    }
+
+    void swap(uint8_t a, uint8_t b)
+    {
+        const uint8_t index = heap_[a];
+        move(b, a);
+        heap_[b] = index;
+        slots_[index].position = b;
+    }
+
+    //! Move an entry up the heap. Return true if it has moved.
+    bool up(uint8_t position)
+    {
+        bool moved = false;
+        while(position > 0)
+        {
+            const uint8_t parent = (position - 1) / 2;
+            if(!before(position, parent))
+                break;
+            swap(position, parent);
+            position = parent;
+            moved = true;
+        }
+        return moved;
+    }
+
+    //! Move an entry down the heap
+    void down(uint8_t position)
+    {
+        for(;;)
+        {
+            const uint8_t left = 2 * position + 1, right = left + 1;
+            uint8_t first = position;
+            if(left < count_ && before(left, first))
+                first = left;
+            if(right < count_ && before(right, first))
+                first = right;
+            if(first == position)
+                break;
+            swap(position, first);
+            position = first;
+        }
+    }
+
+private:
+    Slot slots_[N];
+    uint8_t heap_[N] = {};
+    uint8_t count_ = 0;
+};
+
+}
+
+#endif // ADV_SCHEDULER_H
@@ -1425,6 +1425,11 @@
   #define NOZZLE_PARK_Z_FEEDRATE NOZZLE_PARK_XY_FEEDRATE
 #endif
 
+// Text of the queued commands, as much as the former BUFSIZE x MAX_CMD_SIZE slots
+#ifndef COMMAND_BUFFER_SIZE
+  #define COMMAND_BUFFER_SIZE ((BUFSIZE) * (MAX_CMD_SIZE))
+#endif
+
 #if ENABLED(SDCARD_SORT_ALPHA)
   #define HAS_FOLDER_SORTING (FOLDER_SORTING || ENABLED(SDSORT_GCODE))
 #endif
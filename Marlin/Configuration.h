@@ -613,6 +613,19 @@
 // This will remove the need to poll the interrupt pins, saving many CPU cycles.
 //#define ENDSTOP_INTERRUPTS_FEATURE
 
+/**
+ * Endstop Change Detection
+ *
+ * For boards whose endstop pins can't raise interrupts but share a port
+ * (ENDSTOP_PORT, set by the pins file). At each poll the port is read once and
+ * the endstops are only updated when it has changed and stayed the same for
+ * ENDSTOP_CHANGE_SAMPLES polls (1ms each). While homing or probing, they are
+ * still checked at each poll, without delay.
+ */
+// @advi3++: The endstops of the 3DLabs Stealth are on port C, without pin change interrupts
+#define ENDSTOP_CHANGE_DETECTION
+#define ENDSTOP_CHANGE_SAMPLES 3
+
 /**
  * Endstop Noise Filter
  *
@@ -1092,6 +1105,11 @@
   #define SEGMENT_LEVELED_MOVES
   #define LEVELED_SEGMENT_LENGTH 5.0 // (mm) Length of all segments (except the last one)
 
+  // M429 reports the tilt plane of the mesh, how far the mesh is from it
+  // (warp and probe noise) and how much it changed since the last M500.
+  // The statistics are also shown on the Leveling Grid page of the LCD.
+  #define MESH_STATISTICS // @advi3++
+
   /**
    * Enable the G26 Mesh Validation Pattern tool.
    */
@@ -1157,6 +1175,9 @@
   #define UBL_MESH_EDIT_MOVES_Z     // Sophisticated users prefer no movement of nozzle
   #define UBL_SAVE_ACTIVE_ON_M500   // Save the currently active mesh in the current slot on M500
 
+  //#define UBL_FIXED_POINT_MESH      // Keep a fixed-point (micron) copy of the mesh with per-cell slopes for
+                                    // the Z corrections of leveled moves. Lighter on AVR. Uses 6 bytes per point.
+
   //#define UBL_Z_RAISE_WHEN_OFF_MESH 2.5 // When the nozzle is off the mesh, this value is used
                                           // as the Z-Height correction value.
 
@@ -911,7 +911,11 @@
 
 // The ASCII buffer for serial input
 #define MAX_CMD_SIZE 96
-#define BUFSIZE 5 // @advi3++ ADVi3++ needs more than just 4 commands
+// @advi3++ The queued commands share COMMAND_BUFFER_SIZE bytes instead of having
+// MAX_CMD_SIZE bytes each. The RAM of 5 x 96 bytes holds up to 12 commands (about
+// 10 of a print) or 4 of MAX_CMD_SIZE bytes.
+#define BUFSIZE 12
+#define COMMAND_BUFFER_SIZE 444
 
 // Transmission to Host Buffer Size
 // To save 386 bytes of PROGMEM (and TX_BUFFER_SIZE+3 bytes of RAM) set to 0.
@@ -951,6 +955,51 @@
 // @advi3++: Enable emergency parser to be able to intercept M108, M112, M410 (break, stop)
 #define EMERGENCY_PARSER
 
+// Real-time feed hold and overrides: single bytes sent by the host between lines,
+// taken by the emergency parser and applied by the stepper to the current move
+// within a millisecond, without waiting for the queued commands and moves.
+//   0x81 feed hold, 0x82 resume
+//   0x90 feed 100%, 0x91 feed +10%, 0x92 feed -10%
+//   0x95 rapid 100%, 0x96 rapid 50%, 0x97 rapid 25% (travel moves)
+// Requires EMERGENCY_PARSER
+// @advi3++: Enable real-time overrides so hosts can pause and slow down a print at once
+#define REALTIME_OVERRIDES
+#if ENABLED(REALTIME_OVERRIDES)
+  #define REALTIME_OVERRIDE_RAMP  2 // Fastest change of the speed factor per millisecond, in 1/256 (2: 128ms from 0 to 100%).
+                                    // Slower when the acceleration of the move would be exceeded.
+  #define REALTIME_FEED_MIN      10 // (%) Lowest feed override
+  #define REALTIME_FEED_MAX     150 // (%) Highest feed override. Above 100%, the planner lowers junction speeds, accelerations and speeds over M203 to compensate.
+#endif
+
+// Estimate the time remaining of a print from the durations of the moves planned
+// instead of the percentage of the file read. It learns the seconds of moves per
+// byte of G-code and the ratio between the actual and the planned time.
+// @advi3++: Enable the estimator for the time to complete displayed on the LCD panel
+#define PRINT_TIME_ESTIMATOR
+
+// Read the estimated time, filament length, layers and first layer temperatures
+// written by the slicer at the start and at the end of a file selected on the LCD
+// panel, before printing it. The results of the last files are kept in RAM.
+// Requires CH376_STORAGE_SUPPORT
+// @advi3++: Enable the scan of the G-code files printed from the USB disk
+#define GCODE_METADATA_SCAN
+#if ENABLED(GCODE_METADATA_SCAN)
+  #define GCODE_METADATA_CACHE_SIZE 4 // Number of files kept
+#endif
+
+// At the start of a print from the SD card or the USB disk, heat while homing
+// and probing: in the first lines of the file, M190 and M109 are made non-blocking
+// (M140, M104). The bed waits are done before the first G29/G30, all the waits
+// before the first move extruding.
+// The heaters are also turned on as soon as the file is selected on the LCD panel
+// if the slicer metadata gives the temperatures (GCODE_METADATA_SCAN).
+// Trade-off: the M190/M109 of the files no longer block where they are written.
+// The bed is at temperature when probing (it expands while heating, which would
+// skew the mesh) but the hotend may still be heating (PROBING_HEATERS_OFF is
+// disabled). Disable it if the start G-code relies on the order of its waits.
+// @advi3++: Overlap heating with homing and leveling to start the prints sooner
+#define JOB_START_OVERLAP
+
 // Bad Serial-connections can miss a received command by sending an 'ok'
 // Therefore some clients abort after 30 seconds in a timeout.
 // Some other clients start sending commands while receiving a 'wait'.
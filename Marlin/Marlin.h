@@ -43,8 +43,18 @@
 #include "fastio.h"
 #include "utility.h"
 #include "serial.h"
+#include "command_buffer.h"
 #include "advi3pp.h"
 
+#if ENABLED(MESH_STATISTICS)
+  #include "mesh_statistics.h"
+#endif
+
+#if ENABLED(JOB_START_OVERLAP)
+  #include "job_start.h"
+  extern JobStart job_start;
+#endif
+
 void idle(
   #if ENABLED(ADVANCED_PAUSE_FEATURE)
     bool no_stepper_sleep = false  // pass true to keep steppers from disabling on timeout
@@ -237,9 +247,7 @@ bool enqueue_and_echo_command(const char* cmd);           // Add a single comman
 void enqueue_and_echo_commands_P(const char * const cmd); // Set one or more commands to be prioritized over the next Serial/SD command.
 void clear_command_queue();
 
-#if ENABLED(M100_FREE_MEMORY_WATCHER) || ENABLED(POWER_LOSS_RECOVERY)
-  extern char command_queue[BUFSIZE][MAX_CMD_SIZE];
-#endif
+extern CommandBuffer<COMMAND_BUFFER_SIZE, BUFSIZE, MAX_CMD_SIZE> command_buffer;
 
 #define HAS_LCD_QUEUE_NOW (ENABLED(MALYAN_LCD) || (ENABLED(ULTIPANEL) && (ENABLED(AUTO_BED_LEVELING_UBL) || ENABLED(PID_AUTOTUNE_MENU) || ENABLED(ADVANCED_PAUSE_FEATURE))))
 #define HAS_QUEUE_NOW (ENABLED(SDSUPPORT) || HAS_LCD_QUEUE_NOW || ENABLED(CH376_STORAGE_SUPPORT))
@@ -260,7 +268,11 @@ inline void reset_stepper_timeout() { previous_move_ms = millis(); }
 extern float feedrate_mm_s;
 extern int16_t feedrate_percentage;
 
-#define MMS_SCALED(MM_S) ((MM_S)*feedrate_percentage*0.01f)
+#if ENABLED(REALTIME_OVERRIDES)
+  #define MMS_SCALED(MM_S) (MM_S) // The stepper applies feedrate_percentage to every move (Planner::update_feed_override)
+#else
+  #define MMS_SCALED(MM_S) ((MM_S)*feedrate_percentage*0.01f)
+#endif
 
 extern bool axis_relative_modes[XYZE];
 
@@ -454,6 +466,9 @@ void report_current_position();
   extern float bilinear_grid_factor[2],
                z_values[GRID_MAX_POINTS_X][GRID_MAX_POINTS_Y];
   float bilinear_z_offset(const float raw[XYZ]);
+  #if ENABLED(MESH_STATISTICS)
+    bool get_mesh_statistics(mesh_statistics_t &stats);
+  #endif
 #endif
 
 #if ENABLED(AUTO_BED_LEVELING_BILINEAR) || ENABLED(MESH_BED_LEVELING)
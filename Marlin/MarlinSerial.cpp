@@ -39,6 +39,7 @@
 
   #include "MarlinSerial.h"
   #include "Marlin.h"
+  #include "serial_lines.h"
 
   struct ring_buffer_r {
     unsigned char buffer[RX_BUFFER_SIZE];
@@ -54,6 +55,8 @@
 
   #if UART_PRESENT(SERIAL_PORT)
     ring_buffer_r rx_buffer = { { 0 }, 0, 0 };
+    // Where the lines stored in rx_buffer end (see serial_lines.h)
+    SerialLineEnds<RX_LINE_ENDS, ring_buffer_pos_t> rx_lines;
     #if TX_BUFFER_SIZE > 0
       ring_buffer_t tx_buffer = { { 0 }, 0, 0 };
     #endif
@@ -91,6 +94,17 @@
     #include "emergency_parser.h"
   #endif
 
+  // Give a received byte to the emergency parser.
+  // Return false if it was a real-time command, not to be stored.
+  FORCE_INLINE bool rx_emergency(const uint8_t c) {
+    #if ENABLED(EMERGENCY_PARSER)
+      return emergency_parser.update(c);
+    #else
+      UNUSED(c);
+      return true;
+    #endif
+  }
+
   // "Atomically" read the RX head index value without disabling interrupts:
   // This MUST be called with RX interrupts enabled, and CAN'T be called
   // from the RX ISR itself!
@@ -184,19 +198,18 @@
     // Read the character from the USART
     uint8_t c = M_UDRx;
 
-    #if ENABLED(EMERGENCY_PARSER)
-      emergency_parser.update(c);
-    #endif
+    const bool keep = rx_emergency(c);
 
     // If the character is to be stored at the index just before the tail
     // (such that the head would advance to the current tail), the RX FIFO is
     // full, so don't write the character or advance the head.
-    if (i != t) {
+    if (keep && i != t) {
       rx_buffer.buffer[h] = c;
+      rx_lines.stored(c, i);
       h = i;
     }
     #if ENABLED(SERIAL_STATS_DROPPED_RX)
-      else if (!++rx_dropped_bytes) --rx_dropped_bytes;
+      else if (keep && !++rx_dropped_bytes) --rx_dropped_bytes;
     #endif
 
     #if ENABLED(SERIAL_STATS_MAX_RX_QUEUED)
@@ -241,19 +254,18 @@
               // Read the character from the USART
               c = M_UDRx;
 
-              #if ENABLED(EMERGENCY_PARSER)
-                emergency_parser.update(c);
-              #endif
+              const bool keep = rx_emergency(c);
 
               // If the character is to be stored at the index just before the tail
               // (such that the head would advance to the current tail), the FIFO is
               // full, so don't write the character or advance the head.
-              if (i != t) {
+              if (keep && i != t) {
                 rx_buffer.buffer[h] = c;
+                rx_lines.stored(c, i);
                 h = i;
               }
               #if ENABLED(SERIAL_STATS_DROPPED_RX)
-                else if (!++rx_dropped_bytes) --rx_dropped_bytes;
+                else if (keep && !++rx_dropped_bytes) --rx_dropped_bytes;
               #endif
             }
             sw_barrier();
@@ -283,19 +295,18 @@
               // Read the character from the USART
               c = M_UDRx;
 
-              #if ENABLED(EMERGENCY_PARSER)
-                emergency_parser.update(c);
-              #endif
+              const bool keep = rx_emergency(c);
 
               // If the character is to be stored at the index just before the tail
               // (such that the head would advance to the current tail), the FIFO is
               // full, so don't write the character or advance the head.
-              if (i != t) {
+              if (keep && i != t) {
                 rx_buffer.buffer[h] = c;
+                rx_lines.stored(c, i);
                 h = i;
               }
               #if ENABLED(SERIAL_STATS_DROPPED_RX)
-                else if (!++rx_dropped_bytes) --rx_dropped_bytes;
+                else if (keep && !++rx_dropped_bytes) --rx_dropped_bytes;
               #endif
             }
             sw_barrier();
@@ -421,24 +432,9 @@
     return h == t ? -1 : rx_buffer.buffer[t];
   }
 
-  int MarlinSerial::read(void) {
-    const ring_buffer_pos_t h = atomic_read_rx_head();
-
-    // Read the tail. Main thread owns it, so it is safe to directly read it
-    ring_buffer_pos_t t = rx_buffer.tail;
-
-    // If nothing to read, return now
-    if (h == t) return -1;
-
-    // Get the next char
-    const int v = rx_buffer.buffer[t];
-    t = (ring_buffer_pos_t)(t + 1) & (RX_BUFFER_SIZE - 1);
-
-    // Advance tail - Making sure the RX ISR will always get an stable value, even
-    // if it interrupts the writing of the value of that variable in the middle.
-    atomic_set_rx_tail(t);
-
-    #if ENABLED(SERIAL_XON_XOFF)
+  #if ENABLED(SERIAL_XON_XOFF)
+    // Called after the tail moved to 't'
+    FORCE_INLINE void check_xon(const ring_buffer_pos_t h, const ring_buffer_pos_t t) {
       // If the XOFF char was sent, or about to be sent...
       if ((xon_xoff_state & XON_XOFF_CHAR_MASK) == XOFF_CHAR) {
         // Get count of bytes in the RX buffer
@@ -457,11 +453,60 @@
           #endif
         }
       }
+    }
+  #endif
+
+  int MarlinSerial::read(void) {
+    const ring_buffer_pos_t h = atomic_read_rx_head();
+
+    // Read the tail. Main thread owns it, so it is safe to directly read it
+    ring_buffer_pos_t t = rx_buffer.tail;
+
+    // If nothing to read, return now
+    if (h == t) return -1;
+
+    // Get the next char
+    const int v = rx_buffer.buffer[t];
+    t = (ring_buffer_pos_t)(t + 1) & (RX_BUFFER_SIZE - 1);
+
+    // Advance tail - Making sure the RX ISR will always get an stable value, even
+    // if it interrupts the writing of the value of that variable in the middle.
+    atomic_set_rx_tail(t);
+    rx_lines.reached(t);
+
+    #if ENABLED(SERIAL_XON_XOFF)
+      check_xon(h, t);
     #endif
 
     return v;
   }
 
+  bool MarlinSerial::read_line(char * const line, const uint8_t size, uint8_t &length) {
+    // The line ends before the head: the end of line behind each of them is then before the head
+    const bool lines = !rx_lines.empty();
+    const ring_buffer_pos_t h = atomic_read_rx_head(), t = rx_buffer.tail;
+
+    // A full buffer without a whole line can't wait, take the start of the line
+    const bool full = ((ring_buffer_pos_t)(h - t) & (ring_buffer_pos_t)(RX_BUFFER_SIZE - 1)) == RX_BUFFER_SIZE - 1;
+    if (!lines && !full) return false;
+
+    ring_buffer_pos_t next = t;
+    const bool complete = copy_serial_line<RX_BUFFER_SIZE>(rx_buffer.buffer, next, h, line, size, length, full);
+    if (next == t) {
+      if (lines) rx_lines.pop();  // No line before it, its bytes were dropped by flush
+      return false;
+    }
+
+    atomic_set_rx_tail(next);
+    rx_lines.reached(next);
+
+    #if ENABLED(SERIAL_XON_XOFF)
+      check_xon(h, next);
+    #endif
+
+    return complete;
+  }
+
   ring_buffer_pos_t MarlinSerial::available(void) {
     const ring_buffer_pos_t h = atomic_read_rx_head(), t = rx_buffer.tail;
     return (ring_buffer_pos_t)(RX_BUFFER_SIZE + h - t) & (RX_BUFFER_SIZE - 1);
@@ -469,6 +514,10 @@
 
   void MarlinSerial::flush(void) {
 
+    // Clear the line ends first: one noted before the head is read is then
+    // kept for bytes dropped rather than lost for a line kept (see serial_lines.h)
+    rx_lines.clear();
+
     // Set the tail to the head:
     //  - Read the RX head index in a safe way. (See atomic_read_rx_head.)
     //  - Set the tail, making sure the RX ISR will always get a stable value, even
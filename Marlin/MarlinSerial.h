@@ -84,6 +84,11 @@
 #ifndef RX_BUFFER_SIZE
   #define RX_BUFFER_SIZE 128
 #endif
+// Line ends noted by the RX ISR (at least 3). More lines than that are
+// still read, but only the last end is moved until the main loop catches up.
+#ifndef RX_LINE_ENDS
+  #define RX_LINE_ENDS 8
+#endif
 // 256 is the max TX buffer limit due to uint8_t head and tail.
 #ifndef TX_BUFFER_SIZE
   #define TX_BUFFER_SIZE 32
@@ -121,6 +126,7 @@
       static void end();
       static int peek(void);
       static int read(void);
+      static bool read_line(char * const line, const uint8_t size, uint8_t &length);
       static void flush(void);
       static ring_buffer_pos_t available(void);
       static void write(const uint8_t c);
@@ -203,6 +203,7 @@
  * M420 - Enable/Disable Leveling (with current values) S1=enable S0=disable (Requires MESH_BED_LEVELING or ABL)
  * M421 - Set a single Z coordinate in the Mesh Leveling grid. X<units> Y<units> Z<units> (Requires MESH_BED_LEVELING, AUTO_BED_LEVELING_BILINEAR, or AUTO_BED_LEVELING_UBL)
  * M428 - Set the home_offset based on the current_position. Nearest edge applies. (Disabled by NO_WORKSPACE_OFFSETS or DELTA)
+ * M429 - Report leveling mesh tilt, RMS, largest deviation and change since M500. (Requires MESH_STATISTICS)
  * M500 - Store parameters in EEPROM. (Requires EEPROM_SETTINGS)
  * M501 - Restore parameters from EEPROM. (Requires EEPROM_SETTINGS)
  * M502 - Revert to the default "factory settings". ** Does not write them to EEPROM! **
@@ -296,6 +297,11 @@
   #endif
 #elif ENABLED(MESH_BED_LEVELING)
   #include "mesh_bed_leveling.h"
+#elif ENABLED(AUTO_BED_LEVELING_BILINEAR)
+  #include "bilinear_split.h"
+  #if ENABLED(MESH_STATISTICS)
+    #include "least_squares_fit.h"
+  #endif
 #endif
 
 #if ENABLED(BEZIER_CURVE_SUPPORT)
@@ -428,9 +434,10 @@ static long gcode_N, gcode_LastN, Stopped_gcode_LastN = 0;
 
 /**
  * GCode Command Queue
- * A simple ring buffer of BUFSIZE command strings.
+ * A simple ring buffer of BUFSIZE commands, their strings packed
+ * in the COMMAND_BUFFER_SIZE bytes of command_buffer.
  *
- * Commands are copied into this buffer by the command injectors
+ * Commands are written into this buffer by the command injectors
  * (immediate, serial, sd card) and they are processed sequentially by
  * the main loop. The process_next_command function parses the next
  * command and hands off execution to individual handler functions.
@@ -439,7 +446,16 @@ uint8_t commands_in_queue = 0, // Count of commands in the queue
         cmd_queue_index_r = 0, // Ring buffer read (out) position
         cmd_queue_index_w = 0; // Ring buffer write (in) position
 
-char command_queue[BUFSIZE][MAX_CMD_SIZE];
+CommandBuffer<COMMAND_BUFFER_SIZE, BUFSIZE, MAX_CMD_SIZE> command_buffer;
+
+#if ENABLED(JOB_START_OVERLAP)
+  JobStart job_start;
+#endif
+
+#if ENABLED(POWER_LOSS_RECOVERY)
+  // File offset of each queued SD line, JOB_RECOVERY_NO_SDPOS for other sources
+  uint32_t command_queue_sdpos[BUFSIZE];
+#endif
 
 /**
  * Next Injected Command pointer. NULL if no commands are being injected.
@@ -770,7 +786,7 @@ void stop();
 
 void get_available_commands();
 void process_next_command();
-void process_parsed_command();
+void process_parsed_command(const bool no_ok=false);
 
 void get_cartesian_from_steppers();
 void set_current_from_steppers_for_axis(const AxisEnum axis);
@@ -890,26 +906,43 @@ void enqueue_and_echo_commands_P(const char * const pgcode) {
  */
 void clear_command_queue() {
   cmd_queue_index_r = cmd_queue_index_w = commands_in_queue = 0;
+  command_buffer.clear();
+}
+
+/**
+ * Where to write the next command, NULL if the queue is full
+ */
+FORCE_INLINE char* command_space() {
+  return command_buffer.space(cmd_queue_index_r, commands_in_queue);
 }
 
 /**
  * Once a new command is in the ring buffer, call this to commit it
  */
-inline void _commit_command(bool say_ok) {
+inline void _commit_command(const bool say_ok, const uint8_t length) {
+  command_buffer.commit(cmd_queue_index_w, length);
   send_ok[cmd_queue_index_w] = say_ok;
   if (++cmd_queue_index_w >= BUFSIZE) cmd_queue_index_w = 0;
   commands_in_queue++;
 }
 
 /**
- * Copy a command from RAM into the main command buffer.
+ * Copy a command from RAM into the main command buffer. A command
+ * read in place (at command_space) is only committed.
  * Return true if the command was successfully added.
  * Return false for a full buffer, or if the 'command' is a comment.
  */
 inline bool _enqueuecommand(const char* cmd, bool say_ok=false) {
-  if (*cmd == ';' || commands_in_queue >= BUFSIZE) return false;
-  strcpy(command_queue[cmd_queue_index_w], cmd);
-  _commit_command(say_ok);
+  char * const command = command_space();
+  if (*cmd == ';' || !command) return false;
+  if (cmd != command) {
+    strncpy(command, cmd, MAX_CMD_SIZE - 1);
+    command[MAX_CMD_SIZE - 1] = '\0';
+  }
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    command_queue_sdpos[cmd_queue_index_w] = JOB_RECOVERY_NO_SDPOS;
+  #endif
+  _commit_command(say_ok, strlen(command));
   return true;
 }
 
@@ -1034,6 +1067,123 @@ void gcode_line_error(const char* err, bool doFlush = true) {
   serial_count = 0;
 }
 
+/**
+ * Check a line received on the serial port (comments and escapes removed)
+ * and queue it. Return false if it was rejected: the rest was flushed and
+ * the host asked to resend it.
+ */
+static bool queue_serial_line(char * const line) {
+  char* command = line;
+
+  while (*command == ' ') command++;                // Skip leading spaces
+  char *npos = (*command == 'N') ? command : NULL;  // Require the N parameter to start the line
+
+  if (npos) {
+
+    bool M110 = strstr_P(command, PSTR("M110")) != NULL;
+
+    if (M110) {
+      char* n2pos = strchr(command + 4, 'N');
+      if (n2pos) npos = n2pos;
+    }
+
+    gcode_N = strtol(npos + 1, NULL, 10);
+
+    if (gcode_N != gcode_LastN + 1 && !M110) {
+      gcode_line_error(PSTR(MSG_ERR_LINE_NO));
+      return false;
+    }
+
+    char *apos = strrchr(command, '*');
+    if (apos) {
+      uint8_t checksum = 0, count = uint8_t(apos - command);
+      while (count) checksum ^= command[--count];
+      if (strtol(apos + 1, NULL, 10) != checksum) {
+        gcode_line_error(PSTR(MSG_ERR_CHECKSUM_MISMATCH));
+        return false;
+      }
+    }
+    else {
+      gcode_line_error(PSTR(MSG_ERR_NO_CHECKSUM));
+      return false;
+    }
+
+    gcode_LastN = gcode_N;
+  }
+  #if ENABLED(SDSUPPORT) || ENABLED(CH376_STORAGE_SUPPORT)
+    else if (card.saving && strcmp(command, "M29") != 0) { // No line number with M29 in Pronterface
+      gcode_line_error(PSTR(MSG_ERR_NO_CHECKSUM));
+      return false;
+    }
+  #endif
+
+  // Movement commands alert when stopped
+  if (IsStopped()) {
+    char* gpos = strchr(command, 'G');
+    if (gpos) {
+      switch (strtol(gpos + 1, NULL, 10)) {
+        case 0:
+        case 1:
+        #if ENABLED(ARC_SUPPORT)
+        case 2:
+        case 3:
+        #endif
+        #if ENABLED(BEZIER_CURVE_SUPPORT)
+          case 5:
+        #endif
+          SERIAL_ERRORLNPGM(MSG_ERR_STOPPED);
+          LCD_MESSAGEPGM(MSG_STOPPED);
+          break;
+      }
+    }
+  }
+
+  #if DISABLED(EMERGENCY_PARSER)
+    // Process critical commands early
+    if (strcmp(command, "M108") == 0) {
+      wait_for_heatup = false;
+      #if ENABLED(NEWPANEL)
+        wait_for_user = false;
+      #endif
+    }
+    if (strcmp(command, "M112") == 0) kill(PSTR(MSG_KILLED));
+    if (strcmp(command, "M410") == 0) quickstop_stepper();
+  #endif
+
+  #if ENABLED(CH376_STORAGE_SUPPORT)
+    // Uploading (M28): once the lines queued before are written, the others go straight
+    // to the file and are acknowledged at once, without waiting for room in the queue
+    if (card.saving && !card.logging && !commands_in_queue && !strstr_P(command, PSTR("M29"))) {
+      card.write_command(command);
+      SERIAL_PROTOCOLLNPGM(MSG_OK);
+      return true;
+    }
+  #endif
+
+  // Add the command to the queue
+  _enqueuecommand(line, true);
+  return true;
+}
+
+#if USE_MARLINSERIAL
+
+  /**
+   * Remove the escapes and the comment of a line read as a whole,
+   * the way get_serial_commands does it character by character.
+   * Return the new length of the line.
+   */
+  static uint8_t strip_serial_line(char * const line) {
+    char *dst = line;
+    for (const char *src = line; *src && *src != ';'; src++) {
+      if (*src == '\\' && !*++src) break;
+      *dst++ = *src;
+    }
+    *dst = '\0';
+    return dst - line;
+  }
+
+#endif
+
 /**
  * Get all commands waiting on the serial port and queue them.
  * Exit when the buffer is full or when no more characters are
@@ -1041,7 +1191,6 @@ void gcode_line_error(const char* err, bool doFlush = true) {
  */
 inline void get_serial_commands() {
   static char serial_line_buffer[MAX_CMD_SIZE];
-  static bool serial_comment_mode = false;
 
   // If the command buffer is empty for too long,
   // send "wait" to indicate Marlin is still waiting.
@@ -1054,118 +1203,83 @@ inline void get_serial_commands() {
     }
   #endif
 
-  /**
-   * Loop while serial characters are incoming and the queue is not full
-   */
-  int c;
-  while (commands_in_queue < BUFSIZE && (c = MYSERIAL0.read()) >= 0) {
-
-    char serial_char = c;
+  #if USE_MARLINSERIAL
 
     /**
-     * If the character ends the line
+     * Loop while whole lines are there (the RX ISR locates them) and the queue is not full.
+     * They are read straight into the queue, where they will be parsed.
      */
-    if (serial_char == '\n' || serial_char == '\r') {
-
-      serial_comment_mode = false;                      // end of line == end of comment
+    uint8_t length = serial_count;
+    char *line;
+    while ((line = command_space()) != NULL) {
+      // The start of a line longer than the RX buffer waits in serial_line_buffer:
+      // the queue may be written by others until the rest of the line is there
+      if (length) memcpy(line, serial_line_buffer, length);
+      if (!MYSERIAL0.read_line(line, MAX_CMD_SIZE, length)) {
+        if (length) memcpy(serial_line_buffer, line, length);
+        serial_count = length;
+        break;
+      }
+      length = serial_count = 0;                        // Reset buffer
 
       // Skip empty lines and comments
-      if (!serial_count) { thermalManager.manage_heater(); continue; }
-
-      serial_line_buffer[serial_count] = 0;             // Terminate string
-      serial_count = 0;                                 // Reset buffer
+      if (!strip_serial_line(line)) { thermalManager.manage_heater(); continue; }
 
-      char* command = serial_line_buffer;
+      if (!queue_serial_line(line)) return;
 
-      while (*command == ' ') command++;                // Skip leading spaces
-      char *npos = (*command == 'N') ? command : NULL;  // Require the N parameter to start the line
+      #if defined(NO_TIMEOUTS) && NO_TIMEOUTS > 0
+        last_command_time = ms;
+      #endif
+    }
 
-      if (npos) {
+  #else
 
-        bool M110 = strstr_P(command, PSTR("M110")) != NULL;
+    static bool serial_comment_mode = false;
 
-        if (M110) {
-          char* n2pos = strchr(command + 4, 'N');
-          if (n2pos) npos = n2pos;
-        }
+    /**
+     * Loop while serial characters are incoming and the queue is not full
+     */
+    int c;
+    while (commands_in_queue < BUFSIZE && (c = MYSERIAL0.read()) >= 0) {
 
-        gcode_N = strtol(npos + 1, NULL, 10);
+      char serial_char = c;
 
-        if (gcode_N != gcode_LastN + 1 && !M110)
-          return gcode_line_error(PSTR(MSG_ERR_LINE_NO));
+      /**
+       * If the character ends the line
+       */
+      if (serial_char == '\n' || serial_char == '\r') {
 
-        char *apos = strrchr(command, '*');
-        if (apos) {
-          uint8_t checksum = 0, count = uint8_t(apos - command);
-          while (count) checksum ^= command[--count];
-          if (strtol(apos + 1, NULL, 10) != checksum)
-            return gcode_line_error(PSTR(MSG_ERR_CHECKSUM_MISMATCH));
-        }
-        else
-          return gcode_line_error(PSTR(MSG_ERR_NO_CHECKSUM));
+        serial_comment_mode = false;                      // end of line == end of comment
 
-        gcode_LastN = gcode_N;
-      }
-      #if ENABLED(SDSUPPORT) || ENABLED(CH376_STORAGE_SUPPORT)
-        else if (card.saving && strcmp(command, "M29") != 0) // No line number with M29 in Pronterface
-          return gcode_line_error(PSTR(MSG_ERR_NO_CHECKSUM));
-      #endif
+        // Skip empty lines and comments
+        if (!serial_count) { thermalManager.manage_heater(); continue; }
 
-      // Movement commands alert when stopped
-      if (IsStopped()) {
-        char* gpos = strchr(command, 'G');
-        if (gpos) {
-          switch (strtol(gpos + 1, NULL, 10)) {
-            case 0:
-            case 1:
-            #if ENABLED(ARC_SUPPORT)
-            case 2:
-            case 3:
-            #endif
-            #if ENABLED(BEZIER_CURVE_SUPPORT)
-              case 5:
-            #endif
-              SERIAL_ERRORLNPGM(MSG_ERR_STOPPED);
-              LCD_MESSAGEPGM(MSG_STOPPED);
-              break;
-          }
-        }
-      }
+        serial_line_buffer[serial_count] = 0;             // Terminate string
+        serial_count = 0;                                 // Reset buffer
 
-      #if DISABLED(EMERGENCY_PARSER)
-        // Process critical commands early
-        if (strcmp(command, "M108") == 0) {
-          wait_for_heatup = false;
-          #if ENABLED(NEWPANEL)
-            wait_for_user = false;
-          #endif
-        }
-        if (strcmp(command, "M112") == 0) kill(PSTR(MSG_KILLED));
-        if (strcmp(command, "M410") == 0) quickstop_stepper();
-      #endif
+        if (!queue_serial_line(serial_line_buffer)) return;
 
-      #if defined(NO_TIMEOUTS) && NO_TIMEOUTS > 0
-        last_command_time = ms;
-      #endif
+        #if defined(NO_TIMEOUTS) && NO_TIMEOUTS > 0
+          last_command_time = ms;
+        #endif
+      }
+      else if (serial_count >= MAX_CMD_SIZE - 1) {
+        // Keep fetching, but ignore normal characters beyond the max length
+        // The command will be injected when EOL is reached
+      }
+      else if (serial_char == '\\') {   // Handle escapes
+        if ((c = MYSERIAL0.read()) >= 0 && !serial_comment_mode) // if we have one more character, copy it over
+          serial_line_buffer[serial_count++] = (char)c;
+        // otherwise do nothing
+      }
+      else { // it's not a newline, carriage return or escape char
+        if (serial_char == ';') serial_comment_mode = true;
+        if (!serial_comment_mode) serial_line_buffer[serial_count++] = serial_char;
+      }
 
-      // Add the command to the queue
-      _enqueuecommand(serial_line_buffer, true);
-    }
-    else if (serial_count >= MAX_CMD_SIZE - 1) {
-      // Keep fetching, but ignore normal characters beyond the max length
-      // The command will be injected when EOL is reached
-    }
-    else if (serial_char == '\\') {   // Handle escapes
-      if ((c = MYSERIAL0.read()) >= 0 && !serial_comment_mode) // if we have one more character, copy it over
-        serial_line_buffer[serial_count++] = (char)c;
-      // otherwise do nothing
-    }
-    else { // it's not a newline, carriage return or escape char
-      if (serial_char == ';') serial_comment_mode = true;
-      if (!serial_comment_mode) serial_line_buffer[serial_count++] = serial_char;
-    }
+    } // queue has space, serial has data
 
-  } // queue has space, serial has data
+  #endif
 }
 
 #if ENABLED(SDSUPPORT) || ENABLED(CH376_STORAGE_SUPPORT)
@@ -1196,7 +1310,8 @@ inline void get_serial_commands() {
 
     uint16_t sd_count = 0;
     bool card_eof = card.eof();
-    while (commands_in_queue < BUFSIZE && !card_eof && !stop_buffering) {
+    char *command = command_space(); // Lines are read straight into the queue
+    while (command && !card_eof && !stop_buffering) {
       const int16_t n = card.get();
       char sd_char = (char)n;
       card_eof = card.eof();
@@ -1230,10 +1345,19 @@ inline void get_serial_commands() {
               #endif
             #endif // PRINTER_EVENT_LEDS
           }
+
+          // A command queued at the end of the print (M31) is written where the last line was
+          if (command != command_space()) {
+            command = command_space();
+            sd_count = 0;
+          }
         }
         else if (n == -1) {
           SERIAL_ERROR_START();
           SERIAL_ECHOLNPGM(MSG_SD_ERR_READ);
+          #if ENABLED(PRINTCOUNTER)
+            print_job_timer.incReadErrors();
+          #endif
         }
         if (sd_char == '#') stop_buffering = true;
 
@@ -1242,10 +1366,13 @@ inline void get_serial_commands() {
         // Skip empty lines and comments
         if (!sd_count) { thermalManager.manage_heater(); continue; }
 
-        command_queue[cmd_queue_index_w][sd_count] = '\0'; // terminate string
+        command[sd_count] = '\0'; // terminate string
+        #if ENABLED(JOB_START_OVERLAP)
+          job_start.filter(command); // Same length
+        #endif
+        _commit_command(false, sd_count);
         sd_count = 0; // clear sd line buffer
-
-        _commit_command(false);
+        command = command_space();
       }
       else if (sd_count >= MAX_CMD_SIZE - 1) {
         /**
@@ -1255,7 +1382,12 @@ inline void get_serial_commands() {
       }
       else {
         if (sd_char == ';') sd_comment_mode = true;
-        if (!sd_comment_mode) command_queue[cmd_queue_index_w][sd_count++] = sd_char;
+        if (!sd_comment_mode) {
+          #if ENABLED(POWER_LOSS_RECOVERY)
+            if (!sd_count) command_queue_sdpos[cmd_queue_index_w] = card.getIndex(); // Where to resume this line
+          #endif
+          command[sd_count++] = sd_char;
+        }
       }
     }
   }
@@ -1278,6 +1410,33 @@ inline void get_serial_commands() {
 
 #endif // SDSUPPORT
 
+#if ENABLED(CH376_STORAGE_SUPPORT)
+
+  #define BINARY_UPLOAD_TIMEOUT 5000UL  // Longest pause of the host during a binary upload
+
+  static millis_t binary_upload_ms;
+
+  /**
+   * Binary upload (M28 B<bytes>): the bytes from the host go to the file as
+   * they are. If the host stops sending, the upload is abandoned.
+   */
+  inline void get_binary_upload() {
+    const millis_t ms = millis();
+    int c;
+    if ((c = MYSERIAL0.read()) < 0) {
+      if (ELAPSED(ms, binary_upload_ms + BINARY_UPLOAD_TIMEOUT)) {
+        card.closefile();
+        SERIAL_ERROR_START();
+        SERIAL_ERRORLNPGM("Binary upload timed out");
+      }
+      return;
+    }
+    binary_upload_ms = ms;
+    do card.write_binary(c); while (card.binary_upload() && (c = MYSERIAL0.read()) >= 0);
+  }
+
+#endif // CH376_STORAGE_SUPPORT
+
 /**
  * Add to the circular command queue the next command from:
  *  - The command-injection queue (injected_commands_P)
@@ -1290,6 +1449,11 @@ void get_available_commands() {
   // Immediate commands block the other queues
   if (drain_injected_commands_P()) return;
 
+  #if ENABLED(CH376_STORAGE_SUPPORT)
+    // A binary upload has the serial port to itself until the file is complete
+    if (card.binary_upload()) return get_binary_upload();
+  #endif
+
   get_serial_commands();
 
   #if ENABLED(POWER_LOSS_RECOVERY)
@@ -2597,6 +2761,9 @@ void clean_up_after_endstop_or_probe_move() {
         if (enabling) planner.unapply_leveling(current_position);
 
       #elif ENABLED(AUTO_BED_LEVELING_UBL)
+        #if ENABLED(UBL_FIXED_POINT_MESH)
+          if (enable) ubl.refresh_fixed_mesh();                // the mesh may have changed while leveling was off
+        #endif
         #if PLANNER_LEVELING
           if (planner.leveling_active) {                       // leveling from on to off
             // change unleveled current_position to physical current_position without moving steppers.
@@ -2882,6 +3049,58 @@ void clean_up_after_endstop_or_probe_move() {
     );
   }
 
+  #if ENABLED(MESH_STATISTICS)
+
+    /**
+     * The bilinear grid as seen by mesh_statistics(). Saved values are
+     * read one by one from the EEPROM, so no copy of the saved grid is kept.
+     */
+    struct BilinearStatisticsMesh {
+      const bool saved_valid;
+      BilinearStatisticsMesh() : saved_valid(
+        #if ENABLED(EEPROM_SETTINGS)
+          settings.saved_grid_valid()
+        #else
+          false
+        #endif
+      ) {}
+      uint8_t points_x() const { return GRID_MAX_POINTS_X; }
+      uint8_t points_y() const { return GRID_MAX_POINTS_Y; }
+      float x(const uint8_t i) const { return _GET_MESH_X(i); }
+      float y(const uint8_t j) const { return _GET_MESH_Y(j); }
+      float z(const uint8_t i, const uint8_t j) const { return z_values[i][j]; }
+      float saved(const uint8_t i, const uint8_t j) const {
+        #if ENABLED(EEPROM_SETTINGS)
+          if (saved_valid) return settings.saved_z_value(i, j);
+        #else
+          UNUSED(i); UNUSED(j);
+        #endif
+        return NAN;
+      }
+    };
+
+    /**
+     * Tilt plane by incremental least squares
+     */
+    struct IncrementalPlaneFit {
+      linear_fit_data lsf;
+      void reset() { incremental_LSF_reset(&lsf); }
+      void add(const float &x, const float &y, const float &z) { incremental_LSF(&lsf, x, y, z); }
+      bool finish(float &a, float &b, float &d) {
+        if (finish_incremental_LSF(&lsf)) return false;
+        a = -lsf.A; b = -lsf.B; d = -lsf.D; // LSF gives the plane A.x + B.y + z + D = 0
+        return true;
+      }
+    };
+
+    bool get_mesh_statistics(mesh_statistics_t &stats) {
+      const BilinearStatisticsMesh mesh;
+      IncrementalPlaneFit fit;
+      return mesh_statistics(mesh, fit, stats);
+    }
+
+  #endif // MESH_STATISTICS
+
   #if ENABLED(ABL_BILINEAR_SUBDIVISION)
 
     #define ABL_GRID_POINTS_VIRT_X (GRID_MAX_POINTS_X - 1) * (BILINEAR_SUBDIVISIONS) + 1
@@ -3424,7 +3643,7 @@ void gcode_get_destination() {
 
   #if ENABLED(PRINTCOUNTER)
     if (!DEBUGGING(DRYRUN))
-      print_job_timer.incFilamentUsed(destination[E_CART] - current_position[E_CART]);
+      print_job_timer.incFilamentUsed(destination[E_CART] - current_position[E_CART], active_extruder);
   #endif
 
   // Get ABCDHI mixing factors
@@ -7714,8 +7933,31 @@ inline void gcode_M17() {
   
     /**
      * M28: Start SD Write
+     *
+     *   M28 B<bytes> <file> - Binary upload. After the "Writing to file" and "Binary chunk: <n>"
+     *                         replies, the host sends the <bytes> bytes of the file as they
+     *                         are, waiting for "ok" after every <n> (half of the RX buffer).
+     *                         The end is acknowledged with "Done saving file." and the
+     *                         Fletcher-16 checksum of the bytes.
      */
-    inline void gcode_M28() { card.openFile(parser.string_arg, false); }
+    inline void gcode_M28() {
+      char *path = parser.string_arg;
+      uint32_t size = 0;
+      if (path && path[0] == 'B' && NUMERIC(path[1])) {
+        char *end;
+        const uint32_t bytes = strtoul(path + 1, &end, 10);
+        if (*end == ' ') {  // Not a file name starting with B and digits
+          size = bytes;
+          path = end;
+          while (*path == ' ') ++path;
+        }
+      }
+      card.openFile(path, false);
+      if (size && card.saving) {
+        card.start_binary_upload(size);
+        binary_upload_ms = millis();
+      }
+    }
   
     /**
      * M29: Stop SD Write
@@ -8461,6 +8703,9 @@ inline void gcode_M77() { print_job_timer.stop(); }
     // "M78 S78" will reset the statistics
     if (parser.intval('S') == 78)
       print_job_timer.initStats();
+    // "M78 R<seconds>" reports them periodically when they change, R0 to stop
+    else if (parser.seenval('R'))
+      print_job_timer.setReportInterval(parser.value_byte());
     else
       print_job_timer.showStats();
   }
@@ -8687,6 +8932,10 @@ inline void gcode_M109() {
   wait_for_heatup = true;
   millis_t now, next_temp_ms = 0, next_cool_check_ms = 0;
 
+  #if ENABLED(PRINTCOUNTER)
+    planner.waiting = true; // The moves may end while heating: not a starvation
+  #endif
+
   #if DISABLED(BUSY_WHILE_HEATING)
     KEEPALIVE_STATE(NOT_BUSY);
   #endif
@@ -8769,6 +9018,10 @@ inline void gcode_M109() {
 
   } while (wait_for_heatup && TEMP_CONDITIONS);
 
+  #if ENABLED(PRINTCOUNTER)
+    planner.waiting = false;
+  #endif
+
   if (wait_for_heatup) {
     lcd_reset_status();
     #if ENABLED(PRINTER_EVENT_LEDS)
@@ -8831,6 +9084,10 @@ inline void gcode_M109() {
     wait_for_heatup = true;
     millis_t now, next_temp_ms = 0, next_cool_check_ms = 0;
 
+    #if ENABLED(PRINTCOUNTER)
+      planner.waiting = true; // The moves may end while heating: not a starvation
+    #endif
+
     #if DISABLED(BUSY_WHILE_HEATING)
       KEEPALIVE_STATE(NOT_BUSY);
     #endif
@@ -8915,6 +9172,10 @@ inline void gcode_M109() {
 
     } while (wait_for_heatup && TEMP_BED_CONDITIONS);
 
+    #if ENABLED(PRINTCOUNTER)
+      planner.waiting = false;
+    #endif
+
     if (wait_for_heatup) lcd_reset_status();
     #if DISABLED(BUSY_WHILE_HEATING)
       KEEPALIVE_STATE(IN_HANDLER);
@@ -10120,6 +10381,9 @@ inline void gcode_M211() {
  */
 inline void gcode_M220() {
   if (parser.seenval('S')) feedrate_percentage = parser.value_int();
+  #if ENABLED(REALTIME_OVERRIDES)
+    planner.update_feed_override(); // At once, not after the moves already planned
+  #endif
 }
 
 /**
@@ -10977,12 +11241,52 @@ void quickstop_stepper() {
       SERIAL_ERROR_START();
       SERIAL_ERRORLNPGM(MSG_ERR_MESH_XY);
     }
-    else
+    else {
       ubl.z_values[ix][iy] = hasN ? NAN : parser.value_linear_units() + (hasQ ? ubl.z_values[ix][iy] : 0);
+      #if ENABLED(UBL_FIXED_POINT_MESH)
+        if (planner.leveling_active) ubl.refresh_fixed_mesh();
+      #endif
+    }
   }
 
 #endif // AUTO_BED_LEVELING_UBL
 
+#if ENABLED(MESH_STATISTICS)
+
+  /**
+   * M429: Report leveling mesh statistics
+   *
+   *   Slope X/Y, Offset : Tilt plane fitted through the mesh (z = SX.x + SY.y + O)
+   *   RMS               : RMS of the mesh around that plane (warp and probe noise)
+   *   Max               : Largest distance of a mesh point to the plane
+   *   Change            : Largest difference with the mesh saved by M500
+   */
+  inline void gcode_M429() {
+    mesh_statistics_t stats;
+    if (!get_mesh_statistics(stats)) {
+      SERIAL_ERROR_START();
+      SERIAL_ERRORLNPGM(MSG_ERR_MESH_STATISTICS);
+      return;
+    }
+
+    SERIAL_ECHO_START();
+    SERIAL_ECHOPAIR("Mesh Points:", stats.points);
+    SERIAL_ECHOPGM(" SlopeX:");  SERIAL_ECHO_F(stats.slope_x, 6);
+    SERIAL_ECHOPGM(" SlopeY:");  SERIAL_ECHO_F(stats.slope_y, 6);
+    SERIAL_ECHOPGM(" Offset:");  SERIAL_ECHO_F(stats.offset, 3);
+    SERIAL_ECHOPGM(" RMS:");     SERIAL_ECHO_F(stats.rms, 3);
+    SERIAL_ECHOPGM(" Max:");     SERIAL_ECHO_F(stats.max_deviation, 3);
+    SERIAL_ECHOPGM(" Change:");
+    if (isnan(stats.max_change))
+      SERIAL_ECHOLNPGM("unknown");
+    else {
+      SERIAL_ECHO_F(stats.max_change, 3);
+      SERIAL_EOL();
+    }
+  }
+
+#endif // MESH_STATISTICS
+
 #if HAS_M206_COMMAND
 
   /**
@@ -12884,9 +13188,10 @@ inline void gcode_T(const uint8_t tmp_extruder) {
 }
 
 /**
- * Process the parsed command and dispatch it to its handler
+ * Process the parsed command and dispatch it to its handler.
+ * With no_ok, the host is not answered: the command is not one of its lines.
  */
-void process_parsed_command() {
+void process_parsed_command(const bool no_ok/*=false*/) {
   KEEPALIVE_STATE(IN_HANDLER);
 
   // Handle a known G, M, or T
@@ -13258,6 +13563,10 @@ void process_parsed_command() {
         case 421: gcode_M421(); break;                            // M421: Set a Mesh Z value
       #endif
 
+      #if ENABLED(MESH_STATISTICS)
+        case 429: gcode_M429(); break;                            // M429: Report mesh statistics
+      #endif
+
       case 500: gcode_M500(); break;                              // M500: Store Settings in EEPROM
       case 501: gcode_M501(); break;                              // M501: Read Settings from EEPROM
       case 502: gcode_M502(); break;                              // M502: Revert Settings to defaults
@@ -13370,23 +13679,43 @@ void process_parsed_command() {
   }
 
   KEEPALIVE_STATE(NOT_BUSY);
-  ok_to_send();
+  if (!no_ok) ok_to_send();
 }
 
 void process_next_command() {
-  char * const current_command = command_queue[cmd_queue_index_r];
+  char * const current_command = command_buffer.command(cmd_queue_index_r);
 
   if (DEBUGGING(ECHO)) {
     SERIAL_ECHO_START();
     SERIAL_ECHOLN(current_command);
     #if ENABLED(M100_FREE_MEMORY_WATCHER)
       SERIAL_ECHOPAIR("slot:", cmd_queue_index_r);
-      M100_dump_routine("   Command Queue:", (const char*)command_queue, (const char*)(command_queue + sizeof(command_queue)));
+      M100_dump_routine("   Command Queue:", command_buffer.begin(), command_buffer.end());
     #endif
   }
 
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    // Blocks queued from now on belong to this line of the file
+    if (command_queue_sdpos[cmd_queue_index_r] != JOB_RECOVERY_NO_SDPOS)
+      job_recovery_lines.begin(command_queue_sdpos[cmd_queue_index_r], current_position, feedrate_mm_s);
+  #endif
+
+  #if ENABLED(JOB_START_OVERLAP)
+    // Wait for the bed before the first probing, for all the temperatures before the first move extruding
+    if (job_start.waiting()) {
+      char wait[JobStart::WAIT_SIZE];
+      const char *w;
+      while ((w = job_start.next_wait(current_command))) {
+        strcpy(wait, w);
+        parser.parse(wait);
+        process_parsed_command(true); // The "ok" is for the line of the host, sent once it is done
+      }
+    }
+  #endif
+
   // Parse the next command in the queue
   parser.parse(current_command);
+
   process_parsed_command();
 }
 
@@ -13415,7 +13744,7 @@ void ok_to_send() {
   if (!send_ok[cmd_queue_index_r]) return;
   SERIAL_PROTOCOLPGM(MSG_OK);
   #if ENABLED(ADVANCED_OK)
-    char* p = command_queue[cmd_queue_index_r];
+    char* p = command_buffer.command(cmd_queue_index_r);
     if (*p == 'N') {
       SERIAL_PROTOCOL(' ');
       SERIAL_ECHO(*p++);
@@ -14045,73 +14374,57 @@ void set_current_from_steppers_for_axis(const AxisEnum axis) {
     mesh_line_to_destination(fr_mm_s, x_splits, y_splits);
   }
 
-#elif ENABLED(AUTO_BED_LEVELING_BILINEAR)
+#endif // MESH_BED_LEVELING
 
-  #define CELL_INDEX(A,V) ((V - bilinear_start[_AXIS(A)]) * ABL_BG_FACTOR(_AXIS(A)))
+#if ENABLED(AUTO_BED_LEVELING_BILINEAR)
+
+  /**
+   * The leveling grid as seen by bilinear_split_line
+   */
+  struct BilinearGrid {
+    float start(const uint8_t a) const { return bilinear_start[a]; }
+    float spacing(const uint8_t a) const { return ABL_BG_SPACING(a); }
+    float factor(const uint8_t a) const { return ABL_BG_FACTOR(a); }
+    uint8_t points(const uint8_t a) const { return a == X_AXIS ? ABL_BG_POINTS_X : ABL_BG_POINTS_Y; }
+    float z(const uint8_t x, const uint8_t y) const { return ABL_BG_GRID(x, y); }
+    float offset(const float (&pos)[XYZE]) const { return bilinear_z_offset(pos); }
+  };
 
   /**
    * Prepare a bilinear-leveled linear move on Cartesian,
    * splitting the move where it crosses grid borders.
+   *
+   * With SEGMENT_LEVELED_MOVES, the parts between grid borders are also
+   * split into segments of segment_mm.
+   *
+   * The Z offsets are computed with the split, so segments go straight
+   * to buffer_segment instead of being leveled again by the planner.
    */
-  void bilinear_line_to_destination(const float fr_mm_s, uint16_t x_splits=0xFFFF, uint16_t y_splits=0xFFFF) {
-    // Get current and destination cells for this line
-    int cx1 = CELL_INDEX(X, current_position[X_AXIS]),
-        cy1 = CELL_INDEX(Y, current_position[Y_AXIS]),
-        cx2 = CELL_INDEX(X, destination[X_AXIS]),
-        cy2 = CELL_INDEX(Y, destination[Y_AXIS]);
-    cx1 = constrain(cx1, 0, ABL_BG_POINTS_X - 2);
-    cy1 = constrain(cy1, 0, ABL_BG_POINTS_Y - 2);
-    cx2 = constrain(cx2, 0, ABL_BG_POINTS_X - 2);
-    cy2 = constrain(cy2, 0, ABL_BG_POINTS_Y - 2);
-
-    // Start and end in the same cell? No split needed.
-    if (cx1 == cx2 && cy1 == cy2) {
-      buffer_line_to_destination(fr_mm_s);
-      set_current_from_destination();
-      return;
-    }
-
-    #define LINE_SEGMENT_END(A) (current_position[_AXIS(A)] + (destination[_AXIS(A)] - current_position[_AXIS(A)]) * normalized_dist)
-    #define LINE_SEGMENT_END_E (current_position[E_CART] + (destination[E_CART] - current_position[E_CART]) * normalized_dist)
-
-    float normalized_dist, end[XYZE];
-    const int8_t gcx = MAX(cx1, cx2), gcy = MAX(cy1, cy2);
-
-    // Crosses on the X and not already split on this X?
-    // The x_splits flags are insurance against rounding errors.
-    if (cx2 != cx1 && TEST(x_splits, gcx)) {
-      // Split on the X grid line
-      CBI(x_splits, gcx);
-      COPY(end, destination);
-      destination[X_AXIS] = bilinear_start[X_AXIS] + ABL_BG_SPACING(X_AXIS) * gcx;
-      normalized_dist = (destination[X_AXIS] - current_position[X_AXIS]) / (end[X_AXIS] - current_position[X_AXIS]);
-      destination[Y_AXIS] = LINE_SEGMENT_END(Y);
-    }
-    // Crosses on the Y and not already split on this Y?
-    else if (cy2 != cy1 && TEST(y_splits, gcy)) {
-      // Split on the Y grid line
-      CBI(y_splits, gcy);
-      COPY(end, destination);
-      destination[Y_AXIS] = bilinear_start[Y_AXIS] + ABL_BG_SPACING(Y_AXIS) * gcy;
-      normalized_dist = (destination[Y_AXIS] - current_position[Y_AXIS]) / (end[Y_AXIS] - current_position[Y_AXIS]);
-      destination[X_AXIS] = LINE_SEGMENT_END(X);
-    }
-    else {
-      // Must already have been split on these border(s)
-      buffer_line_to_destination(fr_mm_s);
-      set_current_from_destination();
-      return;
-    }
-
-    destination[Z_AXIS] = LINE_SEGMENT_END(Z);
-    destination[E_CART] = LINE_SEGMENT_END_E;
-
-    // Do the split and look for more borders
-    bilinear_line_to_destination(fr_mm_s, x_splits, y_splits);
-
-    // Restore destination from stack
-    COPY(destination, end);
-    bilinear_line_to_destination(fr_mm_s, x_splits, y_splits);
+  void bilinear_line_to_destination(const float fr_mm_s, const float segment_mm=0) {
+    auto segment = [fr_mm_s](const float (&end)[XYZE], const float offset) {
+      #if ENABLED(SEGMENT_LEVELED_MOVES)
+        static millis_t next_idle_ms = millis() + 200UL;
+        thermalManager.manage_heater();  // This returns immediately if not really needed.
+        if (ELAPSED(millis(), next_idle_ms)) {
+          next_idle_ms = millis() + 200UL;
+          idle();
+        }
+      #endif
+      #if ENABLED(SKEW_CORRECTION)
+        // Skew moves XY before leveling, let the planner do both
+        UNUSED(offset);
+        planner.buffer_line(end[X_AXIS], end[Y_AXIS], end[Z_AXIS], end[E_CART], fr_mm_s, active_extruder);
+      #else
+        const float fade_scaling_factor = planner.fade_scaling_factor_for_z(end[Z_AXIS]);
+        planner.buffer_segment(end[X_AXIS], end[Y_AXIS], end[Z_AXIS] + (fade_scaling_factor ? fade_scaling_factor * offset : 0.0),
+                               end[E_CART], fr_mm_s, active_extruder);
+      #endif
+    };
+    if (segment_mm)
+      bilinear_segment_line(BilinearGrid(), current_position, destination, segment_mm, segment);
+    else
+      bilinear_split_line(BilinearGrid(), current_position, destination, segment);
+    set_current_from_destination();
   }
 
 #endif // AUTO_BED_LEVELING_BILINEAR
@@ -14363,6 +14676,10 @@ void set_current_from_steppers_for_axis(const AxisEnum axis) {
         #if ENABLED(AUTO_BED_LEVELING_UBL)
           ubl.line_to_destination_cartesian(MMS_SCALED(feedrate_mm_s), active_extruder);  // UBL's motion routine needs to know about
           return true;                                                                    // all moves, including Z-only moves.
+        #elif ENABLED(SEGMENT_LEVELED_MOVES) && ENABLED(AUTO_BED_LEVELING_BILINEAR)
+          // Split on the grid borders too, the segments are leveled as they are split
+          bilinear_line_to_destination(MMS_SCALED(feedrate_mm_s), LEVELED_SEGMENT_LENGTH);
+          return true;
         #elif ENABLED(SEGMENT_LEVELED_MOVES)
           segmented_line_to_destination(MMS_SCALED(feedrate_mm_s));
           return false; // caller will update current_position
@@ -15153,6 +15470,10 @@ void manage_inactivity(const bool ignore_stepper_queue/*=false*/) {
   #endif
 
   planner.check_axes_activity();
+
+  #if ENABLED(REALTIME_OVERRIDES)
+    planner.update_feed_override();
+  #endif
 }
 
 /**
@@ -15181,6 +15502,10 @@ void idle(
 
   thermalManager.manage_heater();
 
+  #if ENABLED(CH376_STORAGE_SUPPORT)
+    USBFile::poll(); // Background reads of the USB disk
+  #endif
+
   #if ENABLED(PRINTCOUNTER)
     print_job_timer.tick();
   #endif
@@ -15235,6 +15560,11 @@ void kill(const char* lcd_msg) {
   _delay_ms(250); //Wait to ensure all interrupts routines stopped
   thermalManager.disable_all_heaters(); //turn off heaters again
 
+  #if ENABLED(PRINTCOUNTER)
+    // Thermal alarm counted: the heaters are off and no ISR can interrupt the EEPROM writes
+    print_job_timer.flushStats();
+  #endif
+
   #ifdef ACTION_ON_KILL
     SERIAL_ECHOLNPGM("//action:" ACTION_ON_KILL);
   #endif
@@ -15592,7 +15922,7 @@ void loop() {
     #if ENABLED(SDSUPPORT) || ENABLED(CH376_STORAGE_SUPPORT)
 
       if (card.saving) {
-        char* command = command_queue[cmd_queue_index_r];
+        char* command = command_buffer.command(cmd_queue_index_r);
         if (strstr_P(command, PSTR("M29"))) {
           // M29 closes the file
           card.closefile();
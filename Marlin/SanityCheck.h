@@ -924,6 +924,10 @@ static_assert(X_MAX_LENGTH >= X_BED_SIZE && Y_MAX_LENGTH >= Y_BED_SIZE,
     #error "AUTO_BED_LEVELING_UBL used to enable RESTORE_LEVELING_AFTER_G28. To keep this behavior enable RESTORE_LEVELING_AFTER_G28. Otherwise define it as 'false'."
   #endif
 
+  #if ENABLED(UBL_FIXED_POINT_MESH) && UBL_SEGMENTED
+    #error "UBL_FIXED_POINT_MESH is only used by Cartesian UBL motion. Disable it for DELTA."
+  #endif
+
 #elif OLDSCHOOL_ABL
 
   /**
@@ -975,6 +979,10 @@ static_assert(X_MAX_LENGTH >= X_BED_SIZE && Y_MAX_LENGTH >= Y_BED_SIZE,
   #error "G26_MESH_VALIDATION requires MESH_BED_LEVELING, AUTO_BED_LEVELING_BILINEAR, or AUTO_BED_LEVELING_UBL."
 #endif
 
+#if ENABLED(MESH_STATISTICS) && DISABLED(AUTO_BED_LEVELING_BILINEAR)
+  #error "MESH_STATISTICS requires AUTO_BED_LEVELING_BILINEAR."
+#endif
+
 #if ENABLED(MESH_EDIT_GFX_OVERLAY) && (DISABLED(AUTO_BED_LEVELING_UBL) || DISABLED(DOGLCD))
   #error "MESH_EDIT_GFX_OVERLAY requires AUTO_BED_LEVELING_UBL and a Graphical LCD."
 #endif
@@ -1366,6 +1374,34 @@ static_assert(X_MAX_LENGTH >= X_BED_SIZE && Y_MAX_LENGTH >= Y_BED_SIZE,
   #error "EMERGENCY_PARSER does not work on boards with AT90USB processors (USBCON)."
 #endif
 
+#if ENABLED(ENDSTOP_CHANGE_DETECTION)
+  #ifndef ENDSTOP_PORT
+    #error "ENDSTOP_CHANGE_DETECTION requires ENDSTOP_PORT, the port of all the endstop pins."
+  #elif ENABLED(ENDSTOP_INTERRUPTS_FEATURE) || ENABLED(ENDSTOP_NOISE_FILTER)
+    #error "ENDSTOP_CHANGE_DETECTION is incompatible with ENDSTOP_INTERRUPTS_FEATURE and ENDSTOP_NOISE_FILTER."
+  #elif !WITHIN(ENDSTOP_CHANGE_SAMPLES, 1, 255)
+    #error "ENDSTOP_CHANGE_SAMPLES must be between 1 and 255."
+  #endif
+#endif
+
+#if ENABLED(REALTIME_OVERRIDES)
+  #if DISABLED(EMERGENCY_PARSER)
+    #error "REALTIME_OVERRIDES requires EMERGENCY_PARSER."
+  #elif !WITHIN(REALTIME_OVERRIDE_RAMP, 1, 255)
+    #error "REALTIME_OVERRIDE_RAMP must be between 1 and 255."
+  #elif !WITHIN(REALTIME_FEED_MIN, 10, 99) || !WITHIN(REALTIME_FEED_MAX, 100, 199)
+    #error "REALTIME_FEED_MIN must be between 10 and 99, REALTIME_FEED_MAX between 100 and 199."
+  #endif
+#endif
+
+#if ENABLED(GCODE_METADATA_SCAN)
+  #if DISABLED(CH376_STORAGE_SUPPORT)
+    #error "GCODE_METADATA_SCAN requires CH376_STORAGE_SUPPORT."
+  #elif !WITHIN(GCODE_METADATA_CACHE_SIZE, 1, 16)
+    #error "GCODE_METADATA_CACHE_SIZE must be between 1 and 16."
+  #endif
+#endif
+
 /**
  * I2C bus
  */
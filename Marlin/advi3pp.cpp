@@ -37,6 +37,8 @@
 #include "advi3pp_dgus.h"
 #include "advi3pp_stack.h"
 #include "advi3pp_.h"
+#include "advi3pp_actions.h"
+#include "ADVdispatch.h"
 
 
 extern uint8_t progress_bar_percent;
@@ -105,6 +107,33 @@ inline namespace singletons
     extern AdvancedPause pause;
 }
 
+namespace
+{
+    using Actions = adv::Dispatch<Action, KeyValue>;
+
+    //! Handlers of the actions sent by the LCD panel, indexed by action (in flash)
+    constexpr Actions::Entry actions[] PROGMEM = ADVi3PP_DISPATCH_TABLE(ADVi3PP_ACTIONS);
+    constexpr Actions::Entry increments[] PROGMEM = ADVi3PP_DISPATCH_TABLE(ADVi3PP_INCREMENTS);
+    const uint16_t first_action = 0x0400, first_increment = 0x0500;
+
+    static_assert(Actions::is_indexed(actions, adv::count_of(actions), first_action), "Actions not in order");
+    static_assert(Actions::is_indexed(increments, adv::count_of(increments), first_increment), "Increments not in order");
+
+    //! Read a thunk from flash
+    struct Flash
+    {
+        static Actions::Thunk read(const Actions::Thunk* thunk) { return reinterpret_cast<Actions::Thunk>(pgm_read_ptr(thunk)); }
+    };
+
+    //! Handler of an action, nullptr if the action is unknown
+    Actions::Thunk find_action(Action action)
+    {
+        return static_cast<uint16_t>(action) < first_increment
+            ? Actions::find<Flash>(actions, adv::count_of(actions), first_action, action)
+            : Actions::find<Flash>(increments, adv::count_of(increments), first_increment, action);
+    }
+}
+
 //! Transform a value from a scale to another one.
 //! @param value        Value to be transformed
 //! @param valueScale   Current scale of the value (maximal)
@@ -260,6 +289,7 @@ void ADVi3pp_::init()
     reset_status();
     show_boot_page();
     set_status(F("Ready"));
+    task.add(BackgroundTask{this, &ADVi3pp_::send_status_data}, status_period);
 }
 
 //! Background idle tasks
@@ -270,9 +300,14 @@ void ADVi3pp_::idle()
 
     read_lcd_serial();
     dimming.check();
-    task.execute_background_task();
     update_progress();
-    send_status_data();
+    move.apply_presses();
+    print_settings.apply_presses();
+    babysteps_settings.apply_presses();
+#if ENABLED(GCODE_METADATA_SCAN)
+    sd_card.scan_metadata();
+#endif
+    task.execute();
 }
 
 //! Check if the printer is doing something or is idle
@@ -310,13 +345,9 @@ double ADVi3pp_::get_current_z_layer(int multiply) const
     return height;
 }
 
-//! Update the status of the printer on the LCD.
-void ADVi3pp_::send_status_data(bool force_update)
+//! Update the status of the printer on the LCD. Background task executed every status_period.
+void ADVi3pp_::send_status_data()
 {
-    // Right time for an update or force update?
-    if(!force_update && !task.is_update_time())
-        return;
-
     // Offset the progressbar so that it is full at 98% or higher
     auto adjusted_progress_bar = progress_bar_percent >= 98 ? 100 : progress_bar_percent + 2;
 
@@ -400,71 +431,14 @@ void ADVi3pp_::read_lcd_serial()
     Log::log() << F("=R=> ") << nb_words.byte << F(" words, Action = 0x") << static_cast<uint16_t>(action)
                << F(", KeyValue = 0x") << value.word << Log::endl();
 
-    switch(action)
+    auto handler = find_action(action);
+    if(handler == nullptr)
     {
-        case Action::Screen:                screens.handle(key_value); break;
-        case Action::PrintCommand:          print.handle(key_value); break;
-        case Action::Wait:                  wait.handle(key_value); break;
-        case Action::LoadUnload:            load_unload.handle(key_value); break;
-        case Action::Preheat:               preheat.handle(key_value); break;
-        case Action::Move:                  move.handle(key_value); break;
-        case Action::SdCard:                sd_card.handle(key_value); break;
-        case Action::FactoryReset:          factory_reset.handle(key_value); break;
-        case Action::ManualLeveling:        manual_leveling.handle(key_value); break;
-        case Action::ExtruderTuning:        extruder_tuning.handle(key_value); break;
-        case Action::PidTuning:             pid_tuning.handle(key_value); break;
-        case Action::SensorSettings:        sensor_settings.handle(key_value); break;
-        case Action::Babysteps:             babysteps_settings.handle(key_value); break;
-        case Action::LCD:                   lcd_settings.handle(key_value); break;
-        case Action::Statistics:            statistics.handle(key_value); break;
-        case Action::Versions:              versions.handle(key_value); break;
-        case Action::PrintSettings:         print_settings.handle(key_value); break;
-        case Action::PIDSettings:           pid_settings.handle(key_value); break;
-        case Action::StepsSettings:         steps_settings.handle(key_value); break;
-        case Action::FeedrateSettings:      feedrates_settings.handle(key_value); break;
-        case Action::AccelerationSettings:  accelerations_settings.handle(key_value); break;
-        case Action::JerkSettings:          jerks_settings.handle(key_value); break;
-        case Action::Copyrights:            copyrights.handle(key_value); break;
-        case Action::SensorTuning:          sensor_tuning.handle(key_value); break;
-        case Action::AutomaticLeveling:     automatic_leveling.handle(key_value); break;
-        case Action::SensorGrid:            leveling_grid.handle(key_value); break;
-        case Action::SensorZHeight:         sensor_z_height.handle(key_value); break;
-        case Action::ChangeFilament:        change_filament.handle(key_value); break;
-        case Action::EEPROMMismatch:        eeprom_mismatch.handle(key_value); break;
-        case Action::LinearAdvanceTuning:   linear_advance_tuning.handle(key_value); break;
-        case Action::LinearAdvanceSettings: linear_advance_settings.handle(key_value); break;
-        case Action::Temperatures:          temperatures.handle(key_value); break;
-
-        case Action::MoveXPlus:             move.x_plus_command(); break;
-        case Action::MoveXMinus:            move.x_minus_command(); break;
-        case Action::MoveYPlus:             move.y_plus_command(); break;
-        case Action::MoveYMinus:            move.y_minus_command(); break;
-        case Action::MoveZPlus:             move.z_plus_command(); break;
-        case Action::MoveZMinus:            move.z_minus_command(); break;
-        case Action::MoveEPlus:             move.e_plus_command(); break;
-        case Action::MoveEMinus:            move.e_minus_command(); break;
-        case Action::BabyMinus:             babysteps_settings.minus_command(); break;
-        case Action::BabyPlus:              babysteps_settings.plus_command(); break;
-        case Action::ZHeightMinus:          sensor_z_height.minus(); break;
-        case Action::ZHeightPlus:           sensor_z_height.plus(); break;
-        case Action::FeedrateMinus:         print_settings.feedrate_minus_command(); break;
-        case Action::FeedratePlus:          print_settings.feedrate_plus_command(); break;
-        case Action::FanMinus:              print_settings.fan1_minus_command(); break;
-        case Action::FanPlus:               print_settings.fan1_plus_command(); break;
-        case Action::Hotend1Minus:          print_settings.hotend1_minus_command(); break;
-        case Action::Hotend1Plus:           print_settings.hotend1_plus_command(); break;
-        case Action::Hotend2Minus:          print_settings.hotend2_minus_command(); break;
-        case Action::Hotend2Plus:           print_settings.hotend2_plus_command(); break;
-        case Action::BedMinus:              print_settings.bed_minus_command(); break;
-        case Action::BedPlus:               print_settings.bed_plus_command(); break;
-        case Action::EnclosureMinus:        print_settings.enclosure_minus_command(); break;
-        case Action::EnclosurePlus:         print_settings.enclosure_plus_command(); break;
-        case Action::LCDBrightness:         lcd_settings.change_brightness(static_cast<int16_t>(key_value)); break;
-        case Action::Fan2Minus:             print_settings.fan2_minus_command(); break;
-        case Action::Fan2Plus:              print_settings.fan2_plus_command(); break;
-
-        default:                            Log::error() << F("Invalid action ") << static_cast<uint16_t>(action) << Log::endl(); break;
+        Log::error() << F("Invalid action ") << static_cast<uint16_t>(action) << Log::endl();
+        return;
     }
+
+    handler(key_value);
 }
 
 // --------------------------------------------------------------------
@@ -475,7 +449,7 @@ void ADVi3pp_::read_lcd_serial()
 void ADVi3pp_::temperature_error(const FlashChar* message)
 {
     ADVi3pp_::set_status(message);
-    send_status_data(true);
+    send_status_data();
     pages.show_page(advi3pp::Page::ThermalRunawayError);
 }
 
@@ -560,6 +534,11 @@ void ADVi3pp_::compute_progress()
 
     auto durationSec = PrintCounter::duration();
     auto durationMin = durationSec / 60;
+#if ENABLED(PRINT_TIME_ESTIMATOR)
+    if(card.sdprinting)
+        print_time_estimator.update(card.getIndex(), card.getFileSize(), durationSec);
+#endif
+
     if(durationMin != lastET_)
     {
         lastET_ = durationMin;
@@ -569,11 +548,17 @@ void ADVi3pp_::compute_progress()
 
     if(percentChanged || etChanged)
     {
-        auto tcSec = percent_ <= 0 ? 0 : (durationSec * (100 - percent_) / percent_);
-        if (durationMin < 5 && percent_ < 5)
+        int32_t tcSec = -1;
+#if ENABLED(PRINT_TIME_ESTIMATOR)
+        tcSec = print_time_estimator.remaining(card.getIndex());
+#endif
+        // Without estimate, the time is proportional to the percentage (when it is meaningful)
+        if(tcSec < 0 && percent_ > 0 && (durationMin >= 5 || percent_ >= 5))
+            tcSec = durationSec * (100 - percent_) / percent_;
+        if(tcSec < 0)
             tc_.set(F("...")).align(Alignment::Left);
         else
-            tc_.set(duration_t{tcSec}, Duration::digital).align(Alignment::Left);
+            tc_.set(duration_t{static_cast<uint32_t>(tcSec)}, Duration::digital).align(Alignment::Left);
     }
 }
 
@@ -683,6 +668,7 @@ void ADVi3pp_::process_command(const GCodeParser& parser)
     {
         case 0: print.process_pause_resume_code(); break;
         case 1: print.process_stop_code(); break;
+        case 2: task.send_stats(); break;
         default: Log::error() << F("Invalid command ") << static_cast<uint16_t>(parser.codenum) << Log::endl(); break;
     }
 }
@@ -697,55 +683,63 @@ void ADVi3pp_::switch_tool(uint8_t index, bool no_move)
 // Background tasks
 // --------------------------------------------------------------------
 
-//! Set the next (minimal) update time
-//! @param delta    Duration to be added to the current time to compute the next (minimal) update time
-void Task::set_next_update_time(unsigned int delta)
+//! Add a background task
+//! @param task     The background task
+//! @param period   Period of execution of the task (ms)
+//! @return The handle of the task
+TaskHandle Task::add(const BackgroundTask& task, uint16_t period)
 {
-    next_update_time_ = millis() + delta;
+    auto handle = scheduler_.add(task, period, millis());
+    if(handle == adv::no_task)
+        Log::error() << F("Too many background tasks") << Log::endl();
+    return handle;
 }
 
-//! Is it the time to update?
-//! @return true if it is the time to update
-bool Task::is_update_time()
+//! Replace a background task (if any) by another one
+//! @param handle   Handle of the task, set to the new task
+//! @param task     The new background task
+//! @param period   Period of execution of the task (ms)
+void Task::set(TaskHandle& handle, const BackgroundTask& task, uint16_t period)
 {
-    auto current_time = millis();
-    if(!ELAPSED(current_time, next_update_time_))
-        return false;
-    set_next_update_time();
-    return true;
+    scheduler_.cancel(handle);
+    handle = add(task, period);
 }
 
-//! Set the next background task and its delay
-//! @param task     The next background task
-//! @param delta    Duration to be added to the current time to execute the background task
-void Task::set_background_task(const BackgroundTask& task, unsigned int delta)
+//! Cancel a background task
+//! @param handle   Handle of the task, reset
+void Task::cancel(TaskHandle& handle)
 {
-    op_time_delta_ = delta;
-    background_task_ = task;
-    next_op_time_ = millis() + delta;
+    scheduler_.cancel(handle);
 }
 
-//! Reset the background task
-void Task::clear_background_task()
+//! Check if a background task is scheduled
+//! @param handle   Handle of the task
+//! @return true if the background task is scheduled
+bool Task::has(TaskHandle handle) const
 {
-    background_task_ = nullptr;
+    return scheduler_.has(handle);
 }
 
-//! If there is an operating running, execute its next step
-void Task::execute_background_task()
+//! Execute the background tasks that are due
+void Task::execute()
 {
-    if(!background_task_ || !ELAPSED(millis(), next_op_time_))
-        return;
-
-    next_op_time_ = millis() + op_time_delta_;
-    background_task_();
+    scheduler_.execute(millis());
 }
 
-//! Check if there is a background task to execute
-//! @return true if there is a background task to execute
-bool Task::has_background_task() const
+//! Send the statistics of the background tasks to the host (A2)
+void Task::send_stats() const
 {
-    return bool(background_task_);
+    for(uint8_t index = 0; index < max_tasks; ++index)
+    {
+        adv::TaskStats stats;
+        if(!scheduler_.stats(scheduler_.handle(index), stats))
+            continue;
+        SERIAL_ECHOPAIR("Task ", index);
+        SERIAL_ECHOPAIR(" period:", stats.period);
+        SERIAL_ECHOPAIR(" runs:", stats.runs);
+        SERIAL_ECHOPAIR(" overruns:", stats.overruns);
+        SERIAL_ECHOLNPAIR(" max late:", stats.max_late);
+    }
 }
 
 // --------------------------------------------------------------------
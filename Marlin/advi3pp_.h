@@ -37,6 +37,8 @@
 #include "advi3pp_stack.h"
 #include "advi3pp_dgus.h"
 #include "ADVcallback.h"
+#include "ADVscheduler.h"
+#include "ADVpresses.h"
 #include "ADVcrtp.h"
 #include "advi3pp_bitmasks.h"
 
@@ -54,8 +56,13 @@ const size_t et_length = 8; //!< Size of the elaplsed time message to be display
 const uint16_t default_bed_temperature = 50; //!< Default target temperature for the bed
 const uint16_t default_hotend_temperature = 200; //!< Default target temperature for the hotend
 const uint16_t default_enclosure_temperature = 30; //!< Default target temperature for the enclosure
+const uint16_t heating_check_period = 200; //!< Period of the background tasks waiting for a temperature (ms)
+const uint16_t status_period = 500; //!< Period of the status updates sent to the LCD Panel (ms)
+const uint16_t press_window = 100; //!< Presses of a +/- button closer than this are merged (ms)
+const uint16_t press_latency = 300; //!< Maximum time between a press of a +/- button and its effect (ms)
 
 using adv::Callback;
+using adv::TaskHandle;
 using BackgroundTask = Callback<void(*)()>;
 using WaitCallback = Callback<bool(*)()>;
 
@@ -190,6 +197,9 @@ private:
     void show_print_settings();
     bool back();
 
+private:
+    TaskHandle task_ = adv::no_task;
+
     friend Parent;
 };
 
@@ -268,6 +278,7 @@ private:
 
 private:
     TemperatureKind hotend_ = TemperatureKind::Hotend1;
+    TaskHandle task_ = adv::no_task;
 
     friend Parent;
 };
@@ -323,14 +334,15 @@ struct Move: Handler<Move>
     void e_minus_command();
     void all_home_command();
     void disable_motors_command();
+    void apply_presses();
 
 private:
     bool do_dispatch(KeyValue key_value);
     Page do_prepare_page();
-    void move(const char* command, millis_t delay);
+    void jog(AxisEnum axis, int16_t distance);
 
 private:
-    millis_t last_move_time_ = 0;
+    adv::Presses<Z_AXIS + 1, press_window, press_latency> presses_; //!< Distances in hundredths of mm, by axis
 
     friend Parent;
 };
@@ -383,6 +395,11 @@ struct LevelingGrid: Handler<LevelingGrid>
 private:
     Page do_prepare_page();
     void do_save_command();
+#if ENABLED(MESH_STATISTICS)
+    void send_bands(WriteRamDataStream& frame);
+
+    static const uint8_t nb_bands = 8; //!< Bands of height of the heatmap (colors), 8 for the points not probed
+#endif
 
     friend Parent;
 };
@@ -409,6 +426,9 @@ private:
     void pointD_command();
     void leveling_task();
 
+private:
+    TaskHandle task_ = adv::no_task;
+
     friend Parent;
 };
 
@@ -420,6 +440,7 @@ private:
 struct Card: Handler<Card>
 {
     void show_first_page();
+    void scan_metadata();
 
 private:
     bool do_dispatch(KeyValue value);
@@ -429,6 +450,7 @@ private:
     void up_command();
     void down_command();
     void select_file_command(uint16_t file_index);
+    void use_metadata();
 
 private:
     static constexpr uint16_t nb_visible_sd_files = 5; //!< Number of files per page on the SD screen
@@ -436,6 +458,7 @@ private:
     uint16_t nb_files_ = 0;
     uint16_t last_file_index_ = 0;
     uint16_t page_index_ = 0;
+    bool starting_ = false; //!< The metadata of the file selected are read before printing it
 
     friend Parent;
 };
@@ -516,6 +539,7 @@ private:
 
 private:
     Multiplier multiplier_ = Multiplier::M1;
+    TaskHandle task_ = adv::no_task;
     friend Parent;
 };
 
@@ -547,6 +571,7 @@ private:
 
     TemperatureKind kind_ = TemperatureKind::Hotend1;
     float extruded_ = 0.0;
+    TaskHandle task_ = adv::no_task;
     friend Parent;
 };
 
@@ -672,14 +697,21 @@ struct PrintSettings: Handler<PrintSettings>
     void bed_plus_command();
     void enclosure_minus_command();
     void enclosure_plus_command();
+    void apply_presses();
 
 protected:
     bool do_dispatch(KeyValue value);
-    void fan_minus_command(FanIndex fan);
-    void fan_plus_command(FanIndex fan);
+    void fan_command(FanIndex fan, int16_t delta);
 
 private:
+    enum class Control: uint8_t { Feedrate, Fan1, Fan2, Hotend1, Hotend2, Bed, Enclosure, Count };
+
     Page do_prepare_page();
+    void press(Control control, int16_t delta);
+    void apply(Control control, int16_t delta);
+
+private:
+    adv::Presses<static_cast<uint8_t>(Control::Count), press_window, press_latency> presses_;
 
     friend Parent;
 };
@@ -693,6 +725,7 @@ struct BabyStepsSettings: Handler<BabyStepsSettings>
 {
     void minus_command();
     void plus_command();
+    void apply_presses();
 
     enum class Multiplier: uint8_t { M1 = 0, M2 = 1, M3 = 2 };
 
@@ -703,11 +736,12 @@ private:
     Page do_prepare_page();
     void send_data() const;
     double get_multiplier_value() const;
-    void babystep(double offset);
+    void babystep(int16_t offset);
 
 private:
     Multiplier multiplier_ = Multiplier::M1;
     uint16_t offset_ = 0;
+    adv::Presses<1, press_window, press_latency> presses_; //!< Offset in hundredths of mm
 
     friend Parent;
 };
@@ -861,8 +895,14 @@ struct Statistics: Handler<Statistics>
 {
 private:
     Page do_prepare_page();
+    void do_back_command();
+    void stats_task();
     void send_stats();
 
+private:
+    TaskHandle task_ = adv::no_task;
+    uint16_t version_ = 0; //!< Version of the statistics sent to the LCD panel
+
     friend Parent;
 };
 
@@ -965,23 +1005,19 @@ private:
 // Background Task
 // --------------------------------------------------------------------
 
-//! Background Task
+//! Background Tasks, executed periodically from idle()
 struct Task
 {
-    void set_background_task(const BackgroundTask& task, unsigned int delta = 500);
-    void clear_background_task();
-    void execute_background_task();
-    bool has_background_task() const;
-    bool is_update_time();
-
-private:
-    void set_next_update_time(unsigned int delta = 500);
+    TaskHandle add(const BackgroundTask& task, uint16_t period = 500);
+    void set(TaskHandle& handle, const BackgroundTask& task, uint16_t period = 500);
+    void cancel(TaskHandle& handle);
+    bool has(TaskHandle handle) const;
+    void execute();
+    void send_stats() const;
 
 private:
-    unsigned int op_time_delta_ = 500;
-    millis_t next_op_time_ = 0;
-    millis_t next_update_time_ = 0;
-    BackgroundTask background_task_;
+    static const uint8_t max_tasks = 8;
+    adv::Scheduler<BackgroundTask, max_tasks> scheduler_;
 };
 
 
@@ -1040,7 +1076,7 @@ private:
     void buzz_(long duration);
     void init();
     void update_progress();
-    void send_status_data(bool force_update = false);
+    void send_status_data();
     void send_gplv3_7b_notice(); // Forks: you have to keep this notice
     void read_lcd_serial();
     void show_boot_page();
@@ -1144,6 +1180,7 @@ void Handler<Self>::invalid(KeyValue value)
 template<typename Self>
 void Handler<Self>::show(ShowOptions options)
 {
+    BatchedFrames batch; // Data of the page and page switch in one burst
     Page page = prepare_page();
     if(page != Page::None)
         pages.show_page(page, options);
@@ -0,0 +1,111 @@
+/**
+ * Marlin 3D Printer Firmware For Wanhao Duplicator i3 Plus (ADVi3++)
+ *
+ * Copyright (C) 2017-2019 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ADV_I3_PLUS_PLUS_ACTIONS_H
+#define ADV_I3_PLUS_PLUS_ACTIONS_H
+
+// Actions sent by the LCD panel and the handlers they are dispatched to, in the order of their values
+// (one entry for each value, NONE for the values without action). The lists are expanded with:
+//   HANDLE(action, object)                 object.handle(key_value)
+//   CALL(action, object, method)           object.method()
+//   CALL_WITH(action, object, method, P)   object.method(static_cast<P>(key_value))
+//   NONE(value)                            no action with this value
+
+// 4 - Actions, from 0x0400
+#define ADVi3PP_ACTIONS(HANDLE, CALL, CALL_WITH, NONE) \
+    HANDLE(Screen,                  screens) \
+    HANDLE(PrintCommand,            print) \
+    HANDLE(Wait,                    wait) \
+    HANDLE(LoadUnload,              load_unload) \
+    HANDLE(Preheat,                 preheat) \
+    HANDLE(Move,                    move) \
+    HANDLE(SdCard,                  sd_card) \
+    HANDLE(FactoryReset,            factory_reset) \
+    HANDLE(ManualLeveling,          manual_leveling) \
+    HANDLE(ExtruderTuning,          extruder_tuning) \
+    HANDLE(AutomaticLeveling,       automatic_leveling) \
+    HANDLE(PidTuning,               pid_tuning) \
+    HANDLE(SensorSettings,          sensor_settings) \
+    HANDLE(Babysteps,               babysteps_settings) \
+    NONE(0x040E) \
+    HANDLE(LCD,                     lcd_settings) \
+    HANDLE(Statistics,              statistics) \
+    HANDLE(Versions,                versions) \
+    HANDLE(PrintSettings,           print_settings) \
+    HANDLE(PIDSettings,             pid_settings) \
+    HANDLE(StepsSettings,           steps_settings) \
+    HANDLE(FeedrateSettings,        feedrates_settings) \
+    HANDLE(AccelerationSettings,    accelerations_settings) \
+    HANDLE(JerkSettings,            jerks_settings) \
+    HANDLE(Copyrights,              copyrights) \
+    HANDLE(SensorTuning,            sensor_tuning) \
+    HANDLE(SensorGrid,              leveling_grid) \
+    HANDLE(SensorZHeight,           sensor_z_height) \
+    HANDLE(ChangeFilament,          change_filament) \
+    HANDLE(EEPROMMismatch,          eeprom_mismatch) \
+    NONE(0x041E) \
+    HANDLE(LinearAdvanceTuning,     linear_advance_tuning) \
+    HANDLE(LinearAdvanceSettings,   linear_advance_settings) \
+    NONE(0x0421) \
+    HANDLE(Temperatures,            temperatures)
+
+// 5 - Increments, from 0x0500
+#define ADVi3PP_INCREMENTS(HANDLE, CALL, CALL_WITH, NONE) \
+    CALL(MoveXMinus,                move, x_minus_command) \
+    CALL(MoveXPlus,                 move, x_plus_command) \
+    CALL(MoveYMinus,                move, y_minus_command) \
+    CALL(MoveYPlus,                 move, y_plus_command) \
+    CALL(MoveZMinus,                move, z_minus_command) \
+    CALL(MoveZPlus,                 move, z_plus_command) \
+    CALL(MoveEMinus,                move, e_minus_command) \
+    CALL(MoveEPlus,                 move, e_plus_command) \
+    CALL(BabyMinus,                 babysteps_settings, minus_command) \
+    CALL(BabyPlus,                  babysteps_settings, plus_command) \
+    CALL(ZHeightMinus,              sensor_z_height, minus) \
+    CALL(ZHeightPlus,               sensor_z_height, plus) \
+    CALL(FeedrateMinus,             print_settings, feedrate_minus_command) \
+    CALL(FeedratePlus,              print_settings, feedrate_plus_command) \
+    CALL(FanMinus,                  print_settings, fan1_minus_command) \
+    CALL(FanPlus,                   print_settings, fan1_plus_command) \
+    CALL(Hotend1Minus,              print_settings, hotend1_minus_command) \
+    CALL(Hotend1Plus,               print_settings, hotend1_plus_command) \
+    CALL(Hotend2Minus,              print_settings, hotend2_minus_command) \
+    CALL(Hotend2Plus,               print_settings, hotend2_plus_command) \
+    CALL(BedMinus,                  print_settings, bed_minus_command) \
+    CALL(BedPlus,                   print_settings, bed_plus_command) \
+    CALL(EnclosureMinus,            print_settings, enclosure_minus_command) \
+    CALL(EnclosurePlus,             print_settings, enclosure_plus_command) \
+    CALL_WITH(LCDBrightness,        lcd_settings, change_brightness, uint16_t) \
+    CALL(Fan2Minus,                 print_settings, fan2_minus_command) \
+    CALL(Fan2Plus,                  print_settings, fan2_plus_command)
+
+// Entries of an adv::Dispatch<Action, KeyValue> table, named Actions. For example:
+//   constexpr Actions::Entry actions[] PROGMEM = ADVi3PP_DISPATCH_TABLE(ADVi3PP_ACTIONS);
+#define ADVi3PP_DISPATCH_HANDLE(action, object) \
+    {Action::action, &Actions::handle<decltype(object), object>},
+#define ADVi3PP_DISPATCH_CALL(action, object, method) \
+    {Action::action, &Actions::call<decltype(object), object, &adv::TypeOf<decltype(object)>::method>},
+#define ADVi3PP_DISPATCH_CALL_WITH(action, object, method, P) \
+    {Action::action, &Actions::call_with<decltype(object), P, object, &adv::TypeOf<decltype(object)>::method>},
+#define ADVi3PP_DISPATCH_NONE(value) \
+    {static_cast<Action>(value), nullptr},
+#define ADVi3PP_DISPATCH_TABLE(LIST) \
+    { LIST(ADVi3PP_DISPATCH_HANDLE, ADVi3PP_DISPATCH_CALL, ADVi3PP_DISPATCH_CALL_WITH, ADVi3PP_DISPATCH_NONE) }
+
+#endif //ADV_I3_PLUS_PLUS_ACTIONS_H
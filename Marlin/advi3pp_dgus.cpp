@@ -28,6 +28,8 @@ namespace advi3pp {
 
 namespace { const size_t MAX_GARBAGE_BYTES = 5; }
 
+Frames frames;
+
 // --------------------------------------------------------------------
 // Frame
 // --------------------------------------------------------------------
@@ -162,7 +164,9 @@ bool Frame::send(bool logging)
 #endif
     }
     size_t size = 3 + buffer_[Position::Length];
-    return Serial3.write(buffer_, size) == size; // Header, length and data
+    if(frames.add(buffer_, size)) // Page being prepared?
+        return true;
+    return LcdSerial::write(buffer_, size); // Header, length and data
 }
 
 //! Reset this Frame as an input Frame
@@ -542,4 +546,27 @@ WriteCurveDataRequest::WriteCurveDataRequest(uint8_t channels)
     *this << Uint8{channels};
 }
 
+
+//! Write a chunk of a WriteRamDataStream
+//! @param vp       Variable of the first word
+//! @param data     Bytes of the words
+//! @param size     Number of bytes
+//! @return         True if the frame was sent
+bool RamChunk::write(uint16_t vp, const uint8_t* data, uint8_t size)
+{
+    WriteRamDataRequest frame{static_cast<Variable>(vp)};
+    for(uint8_t index = 0; index < size; ++index)
+        frame << Uint8(data[index]);
+    return frame.send();
+}
+
+//! Write to the serial port of the LCD panel
+//! @param data     Bytes to write
+//! @param size     Number of bytes
+//! @return         True if all the bytes were written
+bool LcdSerial::write(const uint8_t* data, size_t size)
+{
+    return Serial3.write(data, size) == size;
+}
+
 }
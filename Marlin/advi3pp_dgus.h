@@ -26,6 +26,7 @@
 #endif
 #include "duration_t.h"
 #include "ADVstring.h"
+#include "ADVframes.h"
 
 namespace advi3pp {
 
@@ -301,6 +302,43 @@ struct WriteCurveDataRequest: Frame
     explicit WriteCurveDataRequest(uint8_t channels);
 };
 
+// --------------------------------------------------------------------
+// BatchedFrames
+// --------------------------------------------------------------------
+
+//! Serial port of the LCD panel
+struct LcdSerial
+{
+    static bool write(const uint8_t* data, size_t size);
+};
+
+//! Sized for the largest page prepared with small frames: Sensor Settings, 57 bytes with its page switch.
+//! Larger frames (SD card names, statistics) are written alone, before the page switch.
+using Frames = adv::FrameBatch<64, LcdSerial>;
+extern Frames frames;
+
+//! Gather the frames sent during its lifetime and write them in one burst at its end, page switch last
+struct BatchedFrames
+{
+    BatchedFrames() { frames.begin(); }
+    ~BatchedFrames() { frames.end(); }
+};
+
+// --------------------------------------------------------------------
+// WriteRamDataStream
+// --------------------------------------------------------------------
+
+//! Write of a chunk of a WriteRamDataStream
+struct RamChunk
+{
+    static bool write(uint16_t vp, const uint8_t* data, uint8_t size);
+};
+
+//! Write of words to contiguous variables, in as many frames as needed
+using WriteRamDataStream = adv::VPStream<RamChunk>;
+
+inline WriteRamDataStream& operator<<(WriteRamDataStream& stream, const Uint16& data) { return stream.write(data.word); }
+
 // --------------------------------------------------------------------
 
 }
@@ -79,6 +79,9 @@ enum class Variable: uint16_t
     Value5                  = 0x0305,
     Value6                  = 0x0306,
     Value7                  = 0x0307,
+
+    // 6 - Leveling grid heatmap: band of each point
+    LevelingBands           = 0x0600,
 };
 
 //! List of actions sent by the LCD.
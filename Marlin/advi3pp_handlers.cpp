@@ -51,6 +51,7 @@ extern bool ensure_safe_temperature(AdvancedPauseMode mode=ADVANCED_PAUSE_MODE_P
 bool set_probe_deployed(bool);
 float run_z_probe();
 extern float zprobe_zoffset;
+extern uint8_t commands_in_queue;
 
 // --------------------------------------------------------------------
 
@@ -289,13 +290,13 @@ void Screens::show_print()
     }
 
     wait.show(F("Accessing the card..."));
-    task.set_background_task(BackgroundTask{this, &Screens::show_card_or_error_page});
+    task.set(task_, BackgroundTask{this, &Screens::show_card_or_error_page});
 }
 
 //! Show the SD card page (if a SD card is inserted) or the Temperature page
 void Screens::show_card_or_error_page()
 {
-    task.clear_background_task();
+    task.cancel(task_);
 
     card.initsd(); // Can take some time
     advi3pp.reset_status();
@@ -570,7 +571,7 @@ void LoadUnload::prepare(const BackgroundTask& background)
     enqueue_and_echo_commands_P(PSTR("M83"));       // relative E mode
     enqueue_and_echo_commands_P(PSTR("G92 E0"));    // reset E axis
 
-    task.set_background_task(background);
+    task.set(task_, background, heating_check_period);
     wait.show(F("Wait until the target temp is reached..."), WaitCallback{this, &LoadUnload::stop});
 }
 
@@ -593,7 +594,7 @@ bool LoadUnload::stop()
     Log::log() << F("Load/Unload Stop") << Log::endl();
 
     advi3pp.reset_status();
-    task.set_background_task(BackgroundTask(this, &LoadUnload::stop_task));
+    task.set(task_, BackgroundTask(this, &LoadUnload::stop_task));
     clear_command_queue();
     Temperature::setTargetHotend(0, get_current_hotend_index());
     return true;
@@ -602,10 +603,10 @@ bool LoadUnload::stop()
 //! Check if the process is actually stopped and reset E axis
 void LoadUnload::stop_task()
 {
-    if(advi3pp.is_busy() || !task.has_background_task())
+    if(advi3pp.is_busy() || !task.has(task_))
         return;
 
-    task.clear_background_task();
+    task.cancel(task_);
 
     // Do this asynchronously to avoid race conditions
     enqueue_and_echo_commands_P(PSTR("M82"));       // absolute E mode
@@ -623,7 +624,7 @@ void LoadUnload::start_task(const char* command, const BackgroundTask& back_task
         Log::log() << F("Load/Unload Filament") << Log::endl();
         advi3pp.buzz(); // Inform the user that the extrusion starts
         enqueue_and_echo_commands_P(command);
-        task.set_background_task(back_task);
+        task.set(task_, back_task);
         advi3pp.set_status(F("Press Back when the filament comes out..."));
     }
 }
@@ -871,53 +872,73 @@ Page Move::do_prepare_page()
     return Page::Move;
 }
 
-//! Move the nozzle. Check that the command is not send too early when multiple move commands are send in a short time
-//! (i.e. when the user keep the button presses)
-//! @params command Actual command to move the nozzle.
-void Move::move(const char* command, millis_t delay)
+//! Jog the nozzle. The distance is the sum of the presses merged by presses_.
+//! @param axis     The axis to move
+//! @param distance The distance in hundredths of mm
+void Move::jog(AxisEnum axis, int16_t distance)
 {
-    if(!ELAPSED(millis(), last_move_time_ + delay))
+    ADVString<24> command;
+    command << F("G1 ") << axis_codes[axis] << (distance / 100.0) << (axis == Z_AXIS ? F(" F240") : F(" F1000"));
+
+    enqueue_and_echo_command("G91");
+    enqueue_and_echo_command(command.get());
+    enqueue_and_echo_command("G90");
+}
+
+//! Apply the moves of the buttons pressed (called by idle).
+//! Nothing is taken while the previous moves are still in the command queue: the presses received meanwhile
+//! are merged into the next move instead of flooding the queue.
+void Move::apply_presses()
+{
+    if(commands_in_queue > 0)
         return;
-    enqueue_and_echo_commands_P(PSTR("G91"));
-    enqueue_and_echo_commands_P(command);
-    enqueue_and_echo_commands_P(PSTR("G90"));
-    last_move_time_ = millis();
+
+    const auto now = millis();
+    for(uint8_t axis = X_AXIS; axis <= Z_AXIS; ++axis)
+    {
+        auto distance = presses_.take(axis, now);
+        if(distance != 0)
+        {
+            jog(static_cast<AxisEnum>(axis), distance);
+            return; // The queue is not empty anymore
+        }
+    }
 }
 
 //! Move the nozzle (+X)
 void Move::x_plus_command()
 {
-    move(PSTR("G1 X4 F1000"), 150);
+    presses_.add(X_AXIS, 400, millis());
 }
 
 //! Move the nozzle (-X)
 void Move::x_minus_command()
 {
-    move(PSTR("G1 X-4 F1000"), 150);
+    presses_.add(X_AXIS, -400, millis());
 }
 
 //! Move the nozzle (+Y)
 void Move::y_plus_command()
 {
-    move(PSTR("G1 Y4 F1000"), 150);
+    presses_.add(Y_AXIS, 400, millis());
 }
 
 //! Move the nozzle (-Y)
 void Move::y_minus_command()
 {
-    move(PSTR("G1 Y-4 F1000"), 150);
+    presses_.add(Y_AXIS, -400, millis());
 }
 
 //! Move the nozzle (+Z)
 void Move::z_plus_command()
 {
-    move(PSTR("G1 Z0.5 F240"), 10);
+    presses_.add(Z_AXIS, 50, millis());
 }
 
 //! Move the nozzle (-Z)
 void Move::z_minus_command()
 {
-    move(PSTR("G1 Z-0.5 F240"), 10);
+    presses_.add(Z_AXIS, -50, millis());
 }
 
 //! Extrude some filament.
@@ -1103,18 +1124,59 @@ bool AutomaticLeveling::g29_leveling_failed()
 // --------------------------------------------------------------------
 
 //! Prepare the page before being displayed and return the right Page value
+//! The grid (hundredths of mm) is followed by the mesh statistics (microns):
+//! tilt along X and Y over the grid, RMS and largest deviation to the tilt plane, change since saved (-1 if unknown).
+//! The heatmap of the grid is sent to LevelingBands.
 //! @return The index of the page to display
 Page LevelingGrid::do_prepare_page()
 {
-    WriteRamDataRequest frame{Variable::Value0};
+    // Grids larger than 10x10 do not fit in one frame
+    WriteRamDataStream frame{static_cast<uint16_t>(Variable::Value0)};
     for(auto y = 0; y < GRID_MAX_POINTS_Y; y++)
         for(auto x = 0; x < GRID_MAX_POINTS_X; x++)
             frame << Uint16(static_cast<int16_t>(z_values[x][y] * 100));
-    frame.send();
 
+#if ENABLED(MESH_STATISTICS)
+    mesh_statistics_t stats;
+    if(get_mesh_statistics(stats))
+    {
+        const float width = (GRID_MAX_POINTS_X - 1) * bilinear_grid_spacing[X_AXIS],
+                    depth = (GRID_MAX_POINTS_Y - 1) * bilinear_grid_spacing[Y_AXIS];
+        frame << Uint16(static_cast<int16_t>(stats.slope_x * width * 1000))
+              << Uint16(static_cast<int16_t>(stats.slope_y * depth * 1000))
+              << Uint16(static_cast<int16_t>(stats.rms * 1000))
+              << Uint16(static_cast<int16_t>(stats.max_deviation * 1000))
+              << Uint16(static_cast<int16_t>(isnan(stats.max_change) ? -1 : stats.max_change * 1000));
+    }
+    else
+        frame << 0_u16 << 0_u16 << 0_u16 << 0_u16 << Uint16(static_cast<int16_t>(-1));
+
+    send_bands(frame);
+#endif
+
+    frame.flush();
     return Page::SensorGrid;
 }
 
+#if ENABLED(MESH_STATISTICS)
+//! Send the heatmap of the grid: the band of height of each point, in the same order as the points
+//! @param frame    Stream of the grid, continued at LevelingBands: a single chunk is on the stack
+void LevelingGrid::send_bands(WriteRamDataStream& frame)
+{
+    MeshBands<nb_bands> bands;
+    bands.reset();
+    for(auto y = 0; y < GRID_MAX_POINTS_Y; y++)
+        for(auto x = 0; x < GRID_MAX_POINTS_X; x++)
+            bands.add(z_values[x][y]);
+    bands.finish();
+
+    frame.seek(static_cast<uint16_t>(Variable::LevelingBands));
+    for(auto y = 0; y < GRID_MAX_POINTS_Y; y++)
+        for(auto x = 0; x < GRID_MAX_POINTS_X; x++)
+            frame << Uint16(static_cast<uint16_t>(bands.band(z_values[x][y])));
+}
+#endif
+
 //! Handles the Save (Continue) command
 void LevelingGrid::do_save_command()
 {
@@ -1171,7 +1233,7 @@ Page ManualLeveling::do_prepare_page()
     ::axis_known_position = 0;
     enqueue_and_echo_commands_P(PSTR("G90")); // absolute mode
     enqueue_and_echo_commands_P((PSTR("G28 F6000"))); // homing
-    task.set_background_task(BackgroundTask(this, &ManualLeveling::leveling_task), 200);
+    task.set(task_, BackgroundTask(this, &ManualLeveling::leveling_task), 200);
     return Page::None;
 }
 
@@ -1183,7 +1245,7 @@ void ManualLeveling::leveling_task()
 
     Log::log() << F("Leveling Homed, start process") << Log::endl();
     advi3pp.reset_status();
-    task.clear_background_task();
+    task.cancel(task_);
     pages.show_page(Page::ManualLeveling, ShowOptions::None);
 }
 
@@ -1412,12 +1474,66 @@ void Card::select_file_command(uint16_t file_index)
     advi3pp.set_progress_name(filename);
 
     card.openFile(card.filename, true); // use always short filename so it will work even if the filename is long
+#if ENABLED(GCODE_METADATA_SCAN)
+    card.startMetadataScan(); // The print starts when it is done (scan_metadata)
+    starting_ = true;
+#else
     card.startFileprint();
     PrintCounter::start();
+#endif
 
     pages.show_page(Page::Print, ShowOptions::None);
 }
 
+#if ENABLED(GCODE_METADATA_SCAN)
+
+//! Read the metadata of the file selected, a chunk each time it is called (by idle). Then start to print it.
+void Card::scan_metadata()
+{
+    if(!starting_ || card.scanMetadata())
+        return;
+
+    starting_ = false;
+    if(!card.isFileOpen()) // The print was stopped
+        return;
+
+    use_metadata();
+    card.startFileprint();
+    PrintCounter::start(); // Not before: the scan is not print time
+}
+
+//! Use the metadata of the file selected: time remaining, preheating and status with the totals given by the slicer
+void Card::use_metadata()
+{
+    const GCodeMetadata& metadata = card.getMetadata();
+
+#if ENABLED(PRINT_TIME_ESTIMATOR)
+    print_time_estimator.set_slicer_time(metadata.time, card.getFileSize());
+#endif
+
+#if ENABLED(JOB_START_OVERLAP)
+    // Start to heat before the first lines of the file are read
+    if(metadata.bed > 0 && Temperature::degTargetBed() < metadata.bed)
+        Temperature::setTargetBed(metadata.bed);
+    if(metadata.hotend > 0 && Temperature::degTargetHotend(0) < metadata.hotend)
+        Temperature::setTargetHotend(metadata.hotend, 0);
+#endif
+
+    if(!metadata.time && !metadata.filament)
+        return;
+
+    ADVString<message_length> message;
+    if(metadata.time)
+        message << ADVString<8>{duration_t{metadata.time}, Duration::digital}.get();
+    if(metadata.filament)
+        message << (metadata.time ? F(", ") : F("")) << (metadata.filament / 1000.0) << F(" m");
+    if(metadata.layers)
+        message << F(", ") << metadata.layers << F(" layers");
+    advi3pp.set_status(message.get());
+}
+
+#endif
+
 // --------------------------------------------------------------------
 // Printing
 // --------------------------------------------------------------------
@@ -1646,7 +1762,7 @@ Page SensorZHeight::do_prepare_page()
     zprobe_zoffset = 0;  // reset offset
     wait.show(F("Homing..."));
     enqueue_and_echo_commands_P((PSTR("G28 F6000")));  // homing
-    task.set_background_task(BackgroundTask(this, &SensorZHeight::post_home_task), 200);
+    task.set(task_, BackgroundTask(this, &SensorZHeight::post_home_task), 200);
     return Page::None;
 }
 
@@ -1664,7 +1780,7 @@ void SensorZHeight::post_home_task()
     if(advi3pp.is_busy())
         return;
 
-    task.clear_background_task();
+    task.cancel(task_);
     advi3pp.reset_status();
 
     reset();
@@ -1835,7 +1951,7 @@ void ExtruderTuning::start_command()
     wait.show(F("Heating the extruder..."), WaitCallback{this, &ExtruderTuning::cancel}, ShowOptions::None);
     Temperature::setTargetHotend(temperature.word, get_current_hotend_index());
 
-    task.set_background_task(BackgroundTask(this, &ExtruderTuning::heating_task));
+    task.set(task_, BackgroundTask(this, &ExtruderTuning::heating_task), heating_check_period);
 }
 
 //! Extruder tuning background task.
@@ -1844,7 +1960,7 @@ void ExtruderTuning::heating_task()
     auto hotend_index = get_current_hotend_index();
     if(Temperature::current_temperature[hotend_index] < Temperature::target_temperature[hotend_index] - 10)
         return;
-    task.clear_background_task();
+    task.cancel(task_);
 
     advi3pp.set_status(F("Wait until the extrusion is finished..."));
     advi3pp.switch_tool(hotend_index, true);
@@ -1855,7 +1971,7 @@ void ExtruderTuning::heating_task()
     ADVString<20> command; command << F("G1 E") << tuning_extruder_filament << " F50"; // Extrude slowly
     enqueue_and_echo_command(command.get());
 
-    task.set_background_task(BackgroundTask(this, &ExtruderTuning::extruding_task));
+    task.set(task_, BackgroundTask(this, &ExtruderTuning::extruding_task));
 }
 
 //! Extruder tuning background task.
@@ -1863,12 +1979,12 @@ void ExtruderTuning::extruding_task()
 {
     if(current_position[E_AXIS] < tuning_extruder_filament || advi3pp.is_busy())
         return;
-    task.clear_background_task();
+    task.cancel(task_);
 
     extruded_ = current_position[E_AXIS];
 
     Temperature::setTargetHotend(0, get_current_hotend_index());
-    task.clear_background_task();
+    task.cancel(task_);
     advi3pp.reset_status();
     finished();
 }
@@ -1880,8 +1996,9 @@ void ExtruderTuning::finished()
     enqueue_and_echo_commands_P(PSTR("M82"));       // absolute E mode
     enqueue_and_echo_commands_P(PSTR("G92 E0"));    // reset E axis
 
-    task.clear_background_task();
+    task.cancel(task_);
 
+    BatchedFrames batch;
     // Always set to default 20mm
     WriteRamDataRequest frame{Variable::Value1};
     frame << 200_u16; // 20.0
@@ -1894,7 +2011,7 @@ void ExtruderTuning::finished()
 bool ExtruderTuning::cancel()
 {
     ::wait_for_user = ::wait_for_heatup = false;
-    task.clear_background_task();
+    task.cancel(task_);
     Temperature::setTargetHotend(0, get_current_hotend_index());
     return false;
 }
@@ -1902,7 +2019,7 @@ bool ExtruderTuning::cancel()
 //! Execute the Back command
 void ExtruderTuning::do_back_command()
 {
-    task.clear_background_task();
+    task.cancel(task_);
 
     Temperature::setTargetHotend(0, get_current_hotend_index());
 
@@ -2352,150 +2469,141 @@ Page PrintSettings::do_prepare_page()
     return Page::PrintSettings;
 }
 
-//! Handle the -Feedrate command
-void PrintSettings::feedrate_minus_command()
+//! Record a press of a +/- button. It is applied later by apply_presses.
+void PrintSettings::press(Control control, int16_t delta)
 {
-    if(feedrate_percentage <= 50)
-        return;
+    presses_.add(static_cast<uint8_t>(control), delta, millis());
+}
 
-    feedrate_percentage -= 1;
+//! Apply the changes of the buttons pressed (called by idle)
+void PrintSettings::apply_presses()
+{
+    const auto now = millis();
+    for(uint8_t control = 0; control < static_cast<uint8_t>(Control::Count); ++control)
+    {
+        auto delta = presses_.take(control, now);
+        if(delta != 0)
+            apply(static_cast<Control>(control), delta);
+    }
 }
 
-//! Handle the +Feedrate command
-void PrintSettings::feedrate_plus_command()
+//! Apply the change of a control, in its limits
+//! @param control  The control (feedrate, fan, temperature)
+//! @param delta    The sum of its presses
+void PrintSettings::apply(Control control, int16_t delta)
 {
-    if(feedrate_percentage >= 150)
-        return;
+    switch(control)
+    {
+        case Control::Feedrate:
+            feedrate_percentage = constrain(feedrate_percentage + delta, 50, 150);
+#if ENABLED(REALTIME_OVERRIDES)
+            planner.update_feed_override(); // Applied by the stepper to the current move
+#endif
+            break;
 
-    feedrate_percentage += 1;
+        case Control::Fan1:         fan_command(FanIndex::Fan1, delta); break;
+        case Control::Fan2:         fan_command(FanIndex::Fan2, delta); break;
+        case Control::Hotend1:      Temperature::setTargetHotend(constrain(Temperature::degTargetHotend(0) + delta, 0, 420), 0); break;
+        case Control::Hotend2:      Temperature::setTargetHotend(constrain(Temperature::degTargetHotend(1) + delta, 0, 420), 1); break;
+        case Control::Bed:          Temperature::setTargetBed(constrain(Temperature::degTargetBed() + delta, 0, 180)); break;
+        case Control::Enclosure:    Temperature::setTargetChamber(constrain(Temperature::degTargetChamber() + delta, 0, 90)); break;
+        default:                    break;
+    }
 }
 
-//! Handle the -Fan command
-void PrintSettings::fan_minus_command(FanIndex fan)
+//! Change the speed of a fan
+//! @param fan      The fan
+//! @param delta    The change of speed (%)
+void PrintSettings::fan_command(FanIndex fan, int16_t delta)
 {
     int index = static_cast<int>(fan);
-    auto speed = scale(fanSpeeds[index], 255, 100);
-    if(speed <= 0)
-        return;
-
-    speed = speed <= 5 ? 0 : speed - 5;
+    int16_t speed = scale(fanSpeeds[index], 255, 100);
+    speed = constrain(speed + delta, 0, 100);
     fanSpeeds[index] = scale(speed, 100, 255);
 }
 
-//! Handle the +Fan command
-void PrintSettings::fan_plus_command(FanIndex fan)
+//! Handle the -Feedrate command
+void PrintSettings::feedrate_minus_command()
 {
-    int index = static_cast<int>(fan);
-    auto speed = scale(fanSpeeds[index], 255, 100);
-    if(speed >= 100)
-        return;
+    press(Control::Feedrate, -1);
+}
 
-    speed = speed >= 100 - 5 ? 100 : speed + 5;
-    fanSpeeds[index] = scale(speed, 100, 255);
+//! Handle the +Feedrate command
+void PrintSettings::feedrate_plus_command()
+{
+    press(Control::Feedrate, 1);
 }
 
 //! Handle the -Fan command
 void PrintSettings::fan1_minus_command()
 {
-    fan_minus_command(FanIndex::Fan1);
+    press(Control::Fan1, -5);
 }
 
 //! Handle the +Fan command
 void PrintSettings::fan1_plus_command()
 {
-    fan_plus_command(FanIndex::Fan1);
+    press(Control::Fan1, 5);
 }
 
 //! Handle the -Fan 2 command
 void PrintSettings::fan2_minus_command()
 {
-    fan_minus_command(FanIndex::Fan2);
+    press(Control::Fan2, -5);
 }
 
 //! Handle the +Fan 2 command
 void PrintSettings::fan2_plus_command()
 {
-    fan_plus_command(FanIndex::Fan2);
+    press(Control::Fan2, 5);
 }
 
 //! Handle the -Hotend Temperature command
 void PrintSettings::hotend1_minus_command()
 {
-    auto temperature = Temperature::degTargetHotend(0);
-    if(temperature <= 0)
-        return;
-
-    Temperature::setTargetHotend(temperature - 1, 0);
+    press(Control::Hotend1, -1);
 }
 
 //! Handle the +Hotend Temperature command
 void PrintSettings::hotend1_plus_command()
 {
-    auto temperature = Temperature::degTargetHotend(0);
-    if(temperature >= 420)
-        return;
-
-    Temperature::setTargetHotend(temperature + 1, 0);
+    press(Control::Hotend1, 1);
 }
 
 //! Handle the -Hotend Temperature command
 void PrintSettings::hotend2_minus_command()
 {
-    auto temperature = Temperature::degTargetHotend(1);
-    if(temperature <= 0)
-        return;
-
-    Temperature::setTargetHotend(temperature - 1, 1);
+    press(Control::Hotend2, -1);
 }
 
 //! Handle the +Hotend Temperature command
 void PrintSettings::hotend2_plus_command()
 {
-    auto temperature = Temperature::degTargetHotend(1);
-    if(temperature >= 420)
-        return;
-
-    Temperature::setTargetHotend(temperature + 1, 1);
+    press(Control::Hotend2, 1);
 }
 
 //! Handle the -Bed Temperature command
 void PrintSettings::bed_minus_command()
 {
-    auto temperature = Temperature::degTargetBed();
-    if(temperature <= 0)
-        return;
-
-    Temperature::setTargetBed(temperature - 1);
+    press(Control::Bed, -1);
 }
 
 //! Handle the +Bed Temperature command
 void PrintSettings::bed_plus_command()
 {
-    auto temperature = Temperature::degTargetBed();
-    if(temperature >= 180)
-        return;
-
-    Temperature::setTargetBed(temperature + 1);
+    press(Control::Bed, 1);
 }
 
 //! Handle the -Enclosure Temperature command
 void PrintSettings::enclosure_minus_command()
 {
-    auto temperature = Temperature::degTargetChamber();
-    if(temperature <= 0)
-        return;
-
-    Temperature::setTargetChamber(temperature - 1);
+    press(Control::Enclosure, -1);
 }
 
 //! Handle the +Enclosure Temperature command
 void PrintSettings::enclosure_plus_command()
 {
-    auto temperature = Temperature::degTargetChamber();
-    if(temperature >= 90)
-        return;
-
-    Temperature::setTargetChamber(temperature + 1);
+    press(Control::Enclosure, 1);
 }
 
 // --------------------------------------------------------------------
@@ -2552,23 +2660,33 @@ Page BabyStepsSettings::do_prepare_page()
     return Page::Babystepping;
 }
 
-void BabyStepsSettings::babystep(double offset)
+//! Babystep the Z axis and send the new offset to the LCD panel
+//! @param offset   The offset in hundredths of mm
+void BabyStepsSettings::babystep(int16_t offset)
 {
-    offset_ += static_cast<int16_t>(offset * 100);
-    Temperature::babystep_axis(Z_AXIS, static_cast<int16_t>(offset * planner.axis_steps_per_mm[Z_AXIS]));
+    offset_ += offset;
+    Temperature::babystep_axis(Z_AXIS, static_cast<int16_t>(lround(offset * planner.axis_steps_per_mm[Z_AXIS] / 100)));
     send_data();
 }
 
+//! Apply the babysteps of the buttons pressed (called by idle): one babystep and one frame for all of them
+void BabyStepsSettings::apply_presses()
+{
+    auto offset = presses_.take(0, millis());
+    if(offset != 0)
+        babystep(offset);
+}
+
 //! Handle the -Babystep command
 void BabyStepsSettings::minus_command()
 {
-    babystep(-get_multiplier_value());
+    presses_.add(0, -static_cast<int16_t>(lround(get_multiplier_value() * 100)), millis());
 }
 
 //! Handle the +Babystep command
 void BabyStepsSettings::plus_command()
 {
-    babystep(get_multiplier_value());
+    presses_.add(0, static_cast<int16_t>(lround(get_multiplier_value() * 100)), millis());
 }
 
 
@@ -3165,13 +3283,37 @@ void FactoryReset::do_save_command()
 //! @return The index of the page to display
 Page Statistics::do_prepare_page()
 {
+    // The Value and LongText variables are shared with other pages, so always send them
+    PrintCounter::changedSince(version_);
     send_stats();
+    task.set(task_, BackgroundTask(this, &Statistics::stats_task), 1000);
     return Page::Statistics;
 }
 
+//! Handle the Back command
+void Statistics::do_back_command()
+{
+    task.cancel(task_);
+    Parent::do_back_command();
+}
+
+//! Background task: send the statistics again when they change (during a print for example)
+void Statistics::stats_task()
+{
+    if(pages.get_current_page() != Page::Statistics)
+    {
+        task.cancel(task_);
+        return;
+    }
+
+    if(PrintCounter::changedSince(version_))
+        send_stats();
+}
+
 void Statistics::send_stats()
 {
     printStatistics stats = PrintCounter::getStats();
+    const printStatisticsExtra& extra = PrintCounter::getExtraStats();
 
     ADVString<48> printTime{duration_t{stats.printTime}};
     ADVString<48> longestPrint{duration_t{stats.longestPrint}};
@@ -3182,16 +3324,39 @@ void Statistics::send_stats()
                   << (static_cast<unsigned int>(stats.filamentUsed / 100) % 10)
                   << 'm';
 
+    ADVString<48> extruders;
+    for(uint8_t e = 0; e < EXTRUDERS; ++e)
+        extruders << (e ? F(" E") : F("E")) << static_cast<uint16_t>(e + 1) << ' '
+                  << static_cast<unsigned int>(extra.filamentUsed[e] / 1000)
+                  << '.'
+                  << (static_cast<unsigned int>(extra.filamentUsed[e] / 100) % 10)
+                  << 'm';
+
+    ADVString<48> heaters;
+    for(uint8_t h = 0; h < STATS_HEATERS; ++h)
+    {
+        if(h < HOTENDS)
+            heaters << (h ? F(" E") : F("E")) << static_cast<uint16_t>(h + 1);
+        else
+            heaters << (h == STATS_HEATER_BED ? F(" Bed") : F(" Ch."));
+        heaters << ' ' << static_cast<unsigned int>(extra.heaterTime[h] / 3600) << 'h';
+    }
+
     WriteRamDataRequest frame{Variable::Value0};
     frame << Uint16(stats.totalPrints)
           << Uint16(stats.finishedPrints)
-          << Uint16(static_cast<uint16_t>(freeMemory()));
+          << Uint16(static_cast<uint16_t>(freeMemory()))
+          << Uint16(extra.starvations)
+          << Uint16(extra.readErrors)
+          << Uint16(extra.thermalAlarms);
     frame.send();
 
     frame.reset(Variable::LongText0);
     frame << printTime.align(Alignment::Left)
           << longestPrint.align(Alignment::Left)
-          << filament_used.align(Alignment::Left);
+          << filament_used.align(Alignment::Left)
+          << extruders.align(Alignment::Left)
+          << heaters.align(Alignment::Left);
     frame.send();
 }
 
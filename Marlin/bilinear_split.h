@@ -0,0 +1,192 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * bilinear_split.h - Split a move where it crosses the bilinear leveling grid
+ *
+ * The grid lines crossed by a move are walked in one pass, X and Y lines
+ * merged in the order the move meets them. Every segment end lies on a grid
+ * line, where the bilinear surface reduces to a linear interpolation between
+ * the two grid points of that line, so the Z offset of each segment costs a
+ * single lerp. Only the final end point needs the full bilinear evaluation.
+ *
+ * The grid is accessed through GRID, which must provide:
+ *
+ *   float start(axis), spacing(axis), factor(axis)   - as bilinear_start etc.
+ *   uint8_t points(axis)                             - grid points on the axis
+ *   float z(x, y)                                    - probed Z at a grid point
+ *   float offset(const float (&pos)[4])              - full bilinear Z offset
+ *
+ * bilinear_segment_line() also cuts each of these pieces into segments of a
+ * given length, as SEGMENT_LEVELED_MOVES does. The ends that are not on a grid
+ * line need the full bilinear evaluation.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _BILINEAR_SPLIT_H_
+#define _BILINEAR_SPLIT_H_
+
+#include <stdint.h>
+#include <math.h>
+
+/**
+ * Z offset on a grid line. 'axis' is the axis the line is perpendicular to,
+ * 'v' the position along the line.
+ */
+template<typename GRID>
+float bilinear_line_offset(const GRID &grid, const uint8_t axis, const uint8_t line, const float v) {
+  const uint8_t other = 1 - axis, last = grid.points(other) - 1;
+
+  #ifdef EXTRAPOLATE_BEYOND_GRID
+    const int8_t far_edge_or_box = 2; // Keep using the last grid box
+  #else
+    const int8_t far_edge_or_box = 1; // Just use the grid far edge
+  #endif
+
+  float ratio = (v - grid.start(other)) * grid.factor(other);
+  float g = floorf(ratio);
+  if (g < 0) g = 0;
+  if (g > last + 1 - far_edge_or_box) g = last + 1 - far_edge_or_box;
+  ratio -= g;
+
+  #ifndef EXTRAPOLATE_BEYOND_GRID
+    if (ratio < 0) ratio = 0; // Beyond the grid maintain height at grid edges
+  #endif
+
+  const uint8_t g1 = g, g2 = g1 < last ? g1 + 1 : last;
+  const float z1 = axis ? grid.z(g1, line) : grid.z(line, g1),
+              z2 = axis ? grid.z(g2, line) : grid.z(line, g2);
+  return z1 + (z2 - z1) * ratio;
+}
+
+/**
+ * Grid cell holding a coordinate, constrained to the grid
+ */
+template<typename GRID>
+int8_t bilinear_cell(const GRID &grid, const uint8_t axis, const float v) {
+  const int cell = (v - grid.start(axis)) * grid.factor(axis),
+            last = grid.points(axis) - 2;
+  return cell < 0 ? 0 : cell > last ? last : cell;
+}
+
+/**
+ * Split the move from 'from' to 'to' (XYZE) on the grid lines it crosses.
+ * For each segment, in order, segment(end, z_offset) is called with the end
+ * point of the segment and the leveling Z offset at that point.
+ */
+template<typename GRID, typename SEGMENT>
+void bilinear_split_line(const GRID &grid, const float (&from)[4], const float (&to)[4], SEGMENT &segment) {
+  const int8_t cx1 = bilinear_cell(grid, 0, from[0]), cx2 = bilinear_cell(grid, 0, to[0]),
+               cy1 = bilinear_cell(grid, 1, from[1]), cy2 = bilinear_cell(grid, 1, to[1]);
+
+  // Grid lines still to cross and the first of them, in the direction of the move
+  uint8_t nx = cx2 > cx1 ? cx2 - cx1 : cx1 - cx2,
+          ny = cy2 > cy1 ? cy2 - cy1 : cy1 - cy2;
+  const int8_t sx = cx2 > cx1 ? 1 : -1, sy = cy2 > cy1 ? 1 : -1;
+  int8_t gx = cx2 > cx1 ? cx1 + 1 : cx1,
+         gy = cy2 > cy1 ? cy1 + 1 : cy1;
+
+  const float delta[4] = { to[0] - from[0], to[1] - from[1], to[2] - from[2], to[3] - from[3] },
+              inv_dx = nx ? 1.0f / delta[0] : 0,
+              inv_dy = ny ? 1.0f / delta[1] : 0;
+
+  // Fraction of the move at which the next X and Y grid lines are met
+  float lx = grid.start(0) + grid.spacing(0) * gx, tx = (lx - from[0]) * inv_dx,
+        ly = grid.start(1) + grid.spacing(1) * gy, ty = (ly - from[1]) * inv_dy;
+
+  float end[4];
+  while (nx || ny) {
+    const bool on_x = nx && (!ny || tx <= ty),
+               corner = nx && ny && tx == ty; // Both an X and a Y crossing
+    const float t = on_x ? tx : ty;
+
+    end[0] = on_x ? lx : from[0] + delta[0] * t;
+    end[1] = on_x ? from[1] + delta[1] * t : ly;
+    end[2] = from[2] + delta[2] * t;
+    end[3] = from[3] + delta[3] * t;
+
+    segment(end, on_x ? bilinear_line_offset(grid, 0, gx, end[1]) : bilinear_line_offset(grid, 1, gy, end[0]));
+
+    if (on_x || corner) {
+      --nx; gx += sx;
+      lx = grid.start(0) + grid.spacing(0) * gx;
+      tx = (lx - from[0]) * inv_dx;
+    }
+    if (!on_x || corner) {
+      --ny; gy += sy;
+      ly = grid.start(1) + grid.spacing(1) * gy;
+      ty = (ly - from[1]) * inv_dy;
+    }
+  }
+
+  segment(to, grid.offset(to));
+}
+
+/**
+ * Cut each piece of a split move into segments of about 'length' in XY
+ * (at least one segment per piece) before handing it to SEGMENT.
+ */
+template<typename GRID, typename SEGMENT>
+class BilinearSegmenter {
+  public:
+    BilinearSegmenter(const GRID &grid, const float (&from)[4], const float length, SEGMENT &segment)
+      : grid_(grid), inv_length_(1.0f / length), segment_(segment) {
+      for (uint8_t i = 0; i < 4; i++) last_[i] = from[i];
+    }
+
+    void operator()(const float (&end)[4], const float offset) {
+      const float delta[4] = { end[0] - last_[0], end[1] - last_[1], end[2] - last_[2], end[3] - last_[3] };
+      uint16_t segments = sqrtf(delta[0] * delta[0] + delta[1] * delta[1]) * inv_length_;
+      if (!segments) segments = 1;
+
+      const float inv_segments = 1.0f / segments;
+      float point[4];
+      for (uint16_t n = 1; n < segments; n++) {
+        const float t = n * inv_segments;
+        for (uint8_t i = 0; i < 4; i++) point[i] = last_[i] + delta[i] * t;
+        segment_(point, grid_.offset(point));
+      }
+
+      // The end of the piece is exact, and so is its offset
+      segment_(end, offset);
+      for (uint8_t i = 0; i < 4; i++) last_[i] = end[i];
+    }
+
+  private:
+    const GRID &grid_;
+    const float inv_length_;
+    SEGMENT &segment_;
+    float last_[4];
+};
+
+/**
+ * Split the move from 'from' to 'to' (XYZE) on the grid lines it crosses and
+ * into segments of about 'length' in XY.
+ */
+template<typename GRID, typename SEGMENT>
+void bilinear_segment_line(const GRID &grid, const float (&from)[4], const float (&to)[4], const float length, SEGMENT &segment) {
+  BilinearSegmenter<GRID, SEGMENT> segmenter(grid, from, length, segment);
+  bilinear_split_line(grid, from, to, segmenter);
+}
+
+#endif // _BILINEAR_SPLIT_H_
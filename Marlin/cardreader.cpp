@@ -960,21 +960,68 @@ void CardReader::printingHasFinished() {
     return exists;
   }
 
-  int16_t CardReader::saveJobRecoveryInfo() {
-    jobRecoveryFile.seekSet(0);
-    const int16_t ret = jobRecoveryFile.write(&job_recovery_info, sizeof(job_recovery_info));
+  /**
+   * Create the recovery file at its final size, cold record and slots zeroed
+   */
+  bool CardReader::prepareJobRecoveryFile() {
+    if (!cardOK) return false;
+    if (jobRecoveryFile.isOpen()) jobRecoveryFile.close();
+    openJobRecoveryFile(false);
+    if (!jobRecoveryFile.isOpen()) return false;
+    uint8_t zero[64] = { 0 };
+    for (uint16_t i = 0; i < JOB_RECOVERY_FILE_SIZE / sizeof(zero); i++)
+      if (jobRecoveryFile.write(zero, sizeof(zero)) == -1) return false;
+    return true;
+  }
+
+  /**
+   * Write the hot record in its slot, preceded by the cold record in its slot if it changed
+   */
+  int16_t CardReader::saveJobRecoveryInfo(const bool save_cold) {
+    int16_t ret = 0;
+    if (save_cold) {
+      jobRecoveryFile.seekSet(JOB_RECOVERY_COLD_OFFSET(job_recovery_info.cold_slot));
+      ret = jobRecoveryFile.write(&job_recovery_info.cold, sizeof(job_recovery_info.cold));
+    }
+    if (ret != -1) {
+      jobRecoveryFile.seekSet(JOB_RECOVERY_SLOT_OFFSET(job_recovery_slot(job_recovery_info.hot.sequence)));
+      ret = jobRecoveryFile.write(&job_recovery_info.hot, sizeof(job_recovery_info.hot));
+    }
     #if ENABLED(DEBUG_POWER_LOSS_RECOVERY)
       if (ret == -1) SERIAL_PROTOCOLLNPGM("Power-loss file write failed.");
     #endif
     return ret;
   }
 
-  int16_t CardReader::loadJobRecoveryInfo() {
-    return jobRecoveryFile.read(&job_recovery_info, sizeof(job_recovery_info));
+  /**
+   * Load the most recent valid cold record and hot slot
+   */
+  bool CardReader::loadJobRecoveryInfo() {
+    job_recovery_cold_t cold;
+    job_recovery_hot_t slot;
+    memset(&job_recovery_info, 0, sizeof(job_recovery_info));
+
+    for (uint8_t i = 0; i < JOB_RECOVERY_COLD_SLOTS; i++)
+      if (jobRecoveryFile.seekSet(JOB_RECOVERY_COLD_OFFSET(i))
+          && jobRecoveryFile.read(&cold, sizeof(cold)) == sizeof(cold)
+          && job_recovery_newer(cold, job_recovery_info.cold)) {
+        job_recovery_info.cold = cold;
+        job_recovery_info.cold_slot = i;
+      }
+    if (!job_recovery_valid(job_recovery_info.cold)) return false;
+
+    for (uint8_t i = 0; i < JOB_RECOVERY_SLOTS; i++)
+      if (jobRecoveryFile.seekSet(JOB_RECOVERY_SLOT_OFFSET(i))
+          && jobRecoveryFile.read(&slot, sizeof(slot)) == sizeof(slot)
+          && job_recovery_newer(slot, job_recovery_info.hot))
+        job_recovery_info.hot = slot;
+
+    return job_recovery_valid(job_recovery_info.hot);
   }
 
   void CardReader::removeJobRecoveryFile() {
-    job_recovery_info.valid_head = job_recovery_info.valid_foot = job_recovery_commands_count = 0;
+    memset(&job_recovery_info, 0, sizeof(job_recovery_info));
+    job_recovery_commands_count = 0;
     if (jobRecoverFileExists()) {
       closefile();
       removeFile(job_recovery_file_name);
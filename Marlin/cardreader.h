@@ -92,8 +92,9 @@ public:
     void openJobRecoveryFile(const bool read);
     void closeJobRecoveryFile();
     bool jobRecoverFileExists();
-    int16_t saveJobRecoveryInfo();
-    int16_t loadJobRecoveryInfo();
+    bool prepareJobRecoveryFile();
+    int16_t saveJobRecoveryInfo(const bool save_cold);
+    bool loadJobRecoveryInfo();
     void removeJobRecoveryFile();
   #endif
 
@@ -103,6 +104,7 @@ public:
   FORCE_INLINE int16_t get() { sdpos = file.curPosition(); return (int16_t)file.read(); }
   FORCE_INLINE void setIndex(const uint32_t index) { sdpos = index; file.seekSet(index); }
   FORCE_INLINE uint32_t getIndex() { return sdpos; }
+  FORCE_INLINE uint32_t getFileSize() { return filesize; }
   FORCE_INLINE uint8_t percentDone() { return (isFileOpen() && filesize) ? sdpos / ((filesize + 99) / 100) : 0; }
   FORCE_INLINE char* getWorkDirName() { workDir.getFilename(filename); return filename; }
 
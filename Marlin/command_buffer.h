@@ -0,0 +1,90 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * command_buffer.h - The text of the queued commands, packed in a ring of bytes
+ *
+ * The command queue used to give each command a slot of MAX_CMD_SIZE bytes,
+ * most of it unused: a G1 of a print is some 30 bytes. Here the commands follow
+ * each other in a ring of SIZE bytes and a slot only keeps where its command
+ * starts, so the same RAM holds a deeper queue. The slots are still indexed by
+ * cmd_queue_index_r, cmd_queue_index_w and commands_in_queue.
+ *
+ * A command is never split by the end of the ring: a reader asks for room for
+ * MAX bytes in one piece (space), writes the command there (serial and SD lines
+ * are read straight into it and parsed there) then commits what it used.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _COMMAND_BUFFER_H_
+#define _COMMAND_BUFFER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+template<uint16_t SIZE, uint8_t SLOTS, uint8_t MAX>
+class CommandBuffer {
+  static_assert(SIZE >= 2 * MAX, "The command buffer must hold at least two commands of MAX bytes");
+
+  public:
+    void clear() { pos_ = 0; }
+
+    /**
+     * Room for a command of up to MAX bytes (its NUL included) after the 'count'
+     * commands from slot 'r'. NULL if there are no more slots or not enough bytes.
+     * It doesn't change until a command is committed.
+     */
+    char* space(const uint8_t r, const uint8_t count) {
+      if (count >= SLOTS) return NULL;
+      if (!count) pos_ = 0;
+      else {
+        const uint16_t read = start_[r];
+        if (pos_ > read) {
+          if (SIZE - pos_ < MAX) {
+            if (read < MAX) return NULL;
+            pos_ = 0;                           // The end of the ring is left unused
+          }
+        }
+        else if (read - pos_ < MAX) return NULL;
+      }
+      return &buffer_[pos_];
+    }
+
+    // The command written in space() is now in slot 'w'. 'length' doesn't count its NUL.
+    void commit(const uint8_t w, const uint8_t length) {
+      start_[w] = pos_;
+      pos_ += length + 1;
+    }
+
+    char* command(const uint8_t r) { return &buffer_[start_[r]]; }
+
+    const char* begin() const { return buffer_; }
+    const char* end() const { return buffer_ + SIZE; }
+
+  private:
+    char buffer_[SIZE];
+    uint16_t start_[SLOTS];
+    uint16_t pos_ = 0;
+};
+
+#endif // _COMMAND_BUFFER_H_
@@ -1752,6 +1752,11 @@ void MarlinSettings::postprocess() {
         uint8_t * const dest = into ? (uint8_t*)into : (uint8_t*)&ubl.z_values;
         read_data(pos, dest, sizeof(ubl.z_values), &crc);
 
+        #if ENABLED(UBL_FIXED_POINT_MESH)
+          // Leveling may already be active, restored by load()
+          if (!into) ubl.refresh_fixed_mesh();
+        #endif
+
         // Compare crc with crc from MAT, or read from end
 
         #if ENABLED(EEPROM_CHITCHAT)
@@ -1770,6 +1775,37 @@ void MarlinSettings::postprocess() {
 
   #endif // AUTO_BED_LEVELING_UBL
 
+  #if ENABLED(MESH_STATISTICS)
+
+    /**
+     * True if the EEPROM holds settings of this version with a grid of this size.
+     * The CRC is not checked: that would mean reading all the settings.
+     */
+    bool MarlinSettings::saved_grid_valid() {
+      uint16_t crc = 0;
+      char stored_ver[4];
+      uint8_t grid_max[2];
+      int pos = EEPROM_OFFSET;
+      read_data(pos, (uint8_t*)stored_ver, sizeof(stored_ver), &crc, true);
+      pos = EEPROM_OFFSET + offsetof(SettingsData, grid_max_x);
+      read_data(pos, grid_max, sizeof(grid_max), &crc, true);
+      return !eeprom_error && strncmp(version, stored_ver, 3) == 0
+          && grid_max[0] == GRID_MAX_POINTS_X && grid_max[1] == GRID_MAX_POINTS_Y;
+    }
+
+    /**
+     * A point of the bilinear grid as saved by M500, read without loading the settings
+     */
+    float MarlinSettings::saved_z_value(const uint8_t x, const uint8_t y) {
+      uint16_t crc = 0;
+      float z = NAN;
+      int pos = EEPROM_OFFSET + offsetof(SettingsData, z_values) + (x * (GRID_MAX_POINTS_Y) + y) * sizeof(z);
+      read_data(pos, (uint8_t*)&z, sizeof(z), &crc, true);
+      return z;
+    }
+
+  #endif // MESH_STATISTICS
+
 #else // !EEPROM_SETTINGS
 
   bool MarlinSettings::save() {
@@ -63,6 +63,11 @@ class MarlinSettings {
         //static void delete_mesh();    // necessary if we have a MAT
         //static void defrag_meshes();  // "
       #endif
+
+      #if ENABLED(MESH_STATISTICS)
+        static bool saved_grid_valid();
+        static float saved_z_value(const uint8_t x, const uint8_t y);
+      #endif
     #else
       FORCE_INLINE
       static bool load() { reset(); report(); return true; }
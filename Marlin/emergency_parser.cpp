@@ -33,6 +33,7 @@
 // Static data members
 bool EmergencyParser::killed_by_M112; // = false
 EmergencyParser::State EmergencyParser::state; // = EP_RESET
+bool EmergencyParser::enabled = true;
 
 // Global instance
 EmergencyParser emergency_parser;
@@ -22,6 +22,10 @@
 
 /**
  * emergency_parser.h - Intercept special commands directly in the serial stream
+ *
+ * With REALTIME_OVERRIDES, it also takes the single-byte real-time commands
+ * (feed_override.h) found between lines. They are acted upon here and not
+ * stored in the RX buffer.
  */
 
 #ifndef _EMERGENCY_PARSER_H_
@@ -30,6 +34,9 @@
 // External references
 extern volatile bool wait_for_user, wait_for_heatup;
 void quickstop_stepper();
+#if ENABLED(REALTIME_OVERRIDES)
+  bool realtime_override(const uint8_t c);
+#endif
 
 class EmergencyParser {
 
@@ -53,11 +60,19 @@ public:
 
   static bool killed_by_M112;
   static State state;
+  static bool enabled;
 
   EmergencyParser() {}
 
+  // Off while the host sends raw bytes (binary upload)
+  static void enable() { state = EP_RESET; enabled = true; }
+  static void disable() { enabled = false; }
+
+  // Return false if the character is not to be stored (a real-time command)
   __attribute__((always_inline)) inline
-  static void update(const uint8_t c) {
+  static bool update(const uint8_t c) {
+
+    if (!enabled) return true;
 
     switch (state) {
       case EP_RESET:
@@ -65,7 +80,11 @@ public:
           case ' ': break;
           case 'N': state = EP_N;      break;
           case 'M': state = EP_M;      break;
-          default: state  = EP_IGNORE;
+          default:
+            #if ENABLED(REALTIME_OVERRIDES)
+              if (realtime_override(c)) return false;
+            #endif
+            state  = EP_IGNORE;
         }
         break;
 
@@ -135,6 +154,7 @@ public:
           state = EP_RESET;
         }
     }
+    return true;
   }
 
 };
@@ -0,0 +1,73 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * endstop_change.h - Endstops updated only when their pins change
+ *
+ * Without pin change interrupts (the endstops of some boards are on ports that
+ * have none), every poll has to run Endstops::update(), which reads and tests
+ * each endstop pin one by one. When the pins share a port, a single read of the
+ * port tells if any of them changed. EndstopChange follows these reads and
+ * says when the endstops are to be updated: once a change has settled, after
+ * SAMPLES polls with the same pins. Shorter glitches are ignored.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _ENDSTOP_CHANGE_H_
+#define _ENDSTOP_CHANGE_H_
+
+#include <stdint.h>
+
+template<typename BITS, uint8_t SAMPLES>
+class EndstopChange {
+  static_assert(SAMPLES >= 1, "At least one sample is needed");
+
+  public:
+    // Start from the current pins, taken as settled
+    void reset(const BITS pins) { last_ = state_ = pins; count_ = 0; }
+
+    /**
+     * The pins read at a poll.
+     * Return true if they are settled on a new state: the endstops are to be updated.
+     */
+    bool sample(const BITS pins) {
+      if (pins != last_) {
+        last_ = pins;
+        count_ = SAMPLES;     // (Re)start the debounce
+        return false;
+      }
+      if (!count_ || --count_) return false;
+      if (pins == state_) return false; // A glitch, back to the same state
+      state_ = pins;
+      return true;
+    }
+
+    bool pending() const { return count_ != 0; }   // A change is settling
+    BITS state() const { return state_; }           // The last settled pins
+
+  private:
+    BITS last_ = 0, state_ = 0;
+    uint8_t count_ = 0;
+};
+
+#endif // _ENDSTOP_CHANGE_H_
@@ -53,6 +53,38 @@ Endstops::esbits_t Endstops::live_state = 0;
   uint8_t Endstops::endstop_poll_count;
 #endif
 
+#if ENABLED(ENDSTOP_CHANGE_DETECTION)
+  EndstopChange<uint8_t, ENDSTOP_CHANGE_SAMPLES> Endstops::port_change;
+
+  // The bits of ENDSTOP_PORT read by update()
+  #define __PORT_BIT(IO) _BV(DIO ## IO ## _PIN)
+  #define _PORT_BIT(IO) __PORT_BIT(IO)
+  static constexpr uint8_t endstop_port_mask = 0
+    #if HAS_X_MIN
+      | _PORT_BIT(X_MIN_PIN)
+    #endif
+    #if HAS_X_MAX
+      | _PORT_BIT(X_MAX_PIN)
+    #endif
+    #if HAS_Y_MIN
+      | _PORT_BIT(Y_MIN_PIN)
+    #endif
+    #if HAS_Y_MAX
+      | _PORT_BIT(Y_MAX_PIN)
+    #endif
+    #if HAS_Z_MIN
+      | _PORT_BIT(Z_MIN_PIN)
+    #endif
+    #if HAS_Z_MAX
+      | _PORT_BIT(Z_MAX_PIN)
+    #endif
+    #if ENABLED(Z_MIN_PROBE_ENDSTOP)
+      | _PORT_BIT(Z_MIN_PROBE_PIN)
+    #endif
+  ;
+  #define ENDSTOP_PORT_PINS() (ENDSTOP_PORT & endstop_port_mask)
+#endif
+
 #if HAS_BED_PROBE
   volatile bool Endstops::z_probe_enabled = false;
 #endif
@@ -182,6 +214,10 @@ void Endstops::init() {
     setup_endstop_interrupts();
   #endif
 
+  #if ENABLED(ENDSTOP_CHANGE_DETECTION)
+    port_change.reset(ENDSTOP_PORT_PINS());
+  #endif
+
   // Enable endstops
   enable_globally(
     #if ENABLED(ENDSTOPS_ALWAYS_ON_DEFAULT)
@@ -200,7 +236,11 @@ void Endstops::poll() {
     run_monitor();  // report changes in endstop status
   #endif
 
-  #if ENABLED(ENDSTOP_INTERRUPTS_FEATURE) && ENABLED(ENDSTOP_NOISE_FILTER)
+  #if ENABLED(ENDSTOP_CHANGE_DETECTION)
+    // One read of the port. While a switch can abort the move, check them all
+    // each time, as without this feature. Otherwise only when they have changed.
+    if (port_change.sample(ENDSTOP_PORT_PINS()) || abort_enabled()) update();
+  #elif ENABLED(ENDSTOP_INTERRUPTS_FEATURE) && ENABLED(ENDSTOP_NOISE_FILTER)
     if (endstop_poll_count) update();
   #elif DISABLED(ENDSTOP_INTERRUPTS_FEATURE) || ENABLED(ENDSTOP_NOISE_FILTER)
     update();
@@ -399,7 +439,7 @@ void _O2 Endstops::M119() {
 // Check endstops - Could be called from Temperature ISR!
 void Endstops::update() {
 
-  #if DISABLED(ENDSTOP_NOISE_FILTER)
+  #if DISABLED(ENDSTOP_NOISE_FILTER) && DISABLED(ENDSTOP_CHANGE_DETECTION)
     if (!abort_enabled()) return;
   #endif
 
@@ -549,6 +589,11 @@ void Endstops::update() {
 
     if (!abort_enabled()) return;
 
+  #elif ENABLED(ENDSTOP_CHANGE_DETECTION)
+
+    // live_state follows the pins even when they can't abort a move (M119)
+    if (!abort_enabled()) return;
+
   #endif
 
   // Test the current status of an endstop
@@ -29,6 +29,10 @@
 
 #include "MarlinConfig.h"
 
+#if ENABLED(ENDSTOP_CHANGE_DETECTION)
+  #include "endstop_change.h"
+#endif
+
 // @advi3++: Do not validate when using the Simulator
 #ifndef ADVi3PP_SIMULATOR
 #define VALIDATE_HOMING_ENDSTOPS
@@ -80,6 +84,10 @@ class Endstops {
       static uint8_t endstop_poll_count;    // Countdown from threshold for polling
     #endif
 
+    #if ENABLED(ENDSTOP_CHANGE_DETECTION)
+      static EndstopChange<uint8_t, ENDSTOP_CHANGE_SAMPLES> port_change; // Pins of ENDSTOP_PORT, debounced
+    #endif
+
   public:
     Endstops() {};
 
@@ -104,6 +112,20 @@ class Endstops {
      */
     static void poll();
 
+    /**
+     * Stepper ISR, a block starts: are the endstops to be checked before it runs?
+     * With ENDSTOP_CHANGE_DETECTION, only if a switch can abort it (homing, probing).
+     */
+    FORCE_INLINE static bool check_on_block() {
+      return
+        #if ENABLED(ENDSTOP_CHANGE_DETECTION)
+          abort_enabled()
+        #else
+          true
+        #endif
+      ;
+    }
+
     /**
      * Update endstops bits from the pins. Apply filtering to get a verified state.
      * If abort_enabled() and moving towards a triggered switch, abort the current move.
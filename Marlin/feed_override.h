@@ -0,0 +1,178 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * feed_override.h - Real-time feed hold and overrides, applied by the stepper
+ *
+ * Otherwise the feedrate percentage (M220) is applied when a move is planned,
+ * so a change waits behind the command queue and every block already in the
+ * planner. Here the step rate the stepper ISR computes for the current block
+ * is scaled by a live factor instead, the feed override being the feedrate
+ * percentage. It acts within a millisecond: the blocks keep their
+ * speeds, the stepper runs them faster or slower. Above 100%, junction speeds,
+ * accelerations and maximum feedrates would be exceeded, so the planner plans
+ * the blocks not busy again with lower limits (Planner::update_feed_override).
+ * Each block gives the highest factor it was planned for, so a speed-up waits
+ * for the first block planned for it.
+ *
+ * The factor moves towards its target by 1/256 every ramp_ticks(), so a feed
+ * hold is a deceleration to a stop and a resume an acceleration back, at the
+ * acceleration of the block. RAMP_STEP/256 per millisecond is the fastest.
+ * Extruding moves target the feed override, travel moves the feed override
+ * times the rapid override.
+ *
+ * The targets are set by command(), from the serial RX ISR (real-time bytes
+ * intercepted by the emergency parser), and by set_feed() from the main loop
+ * with interrupts off (M220, LCD). They are single bytes, so the stepper
+ * ISR, which can be interrupted by the serial ISR, always reads stable values.
+ * Everything else is only used by the stepper ISR.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _FEED_OVERRIDE_H_
+#define _FEED_OVERRIDE_H_
+
+#include <stdint.h>
+
+// Real-time commands, sent alone (between lines) by the host. As G-code is ASCII,
+// they can't be confused with the commands, only with UTF-8 bytes inside comments.
+enum FeedOverrideCommand : uint8_t {
+  RT_FEED_HOLD    = 0x81,   // Decelerate to a stop, the move is kept
+  RT_RESUME       = 0x82,   // Accelerate back after a feed hold
+  RT_FEED_RESET   = 0x90,   // Feed override at 100%
+  RT_FEED_PLUS    = 0x91,   // Feed override +10%
+  RT_FEED_MINUS   = 0x92,   // Feed override -10%
+  RT_RAPID_FULL   = 0x95,   // Rapid override at 100%
+  RT_RAPID_HALF   = 0x96,   // Rapid override at 50%
+  RT_RAPID_LOW    = 0x97    // Rapid override at 25%
+};
+
+template<uint16_t TICKS_PER_MS, uint8_t RAMP_STEP, uint8_t FEED_MIN, uint8_t FEED_MAX>
+class FeedOverride {
+  static_assert(FEED_MAX <= 199, "The feed override is at most 199%");
+  static_assert(FEED_MIN >= 10 && FEED_MIN < 100, "The feed override minimum must be between 10% and 99%");
+  static_assert(RAMP_STEP >= 1, "The feed override ramp must be at least 1");
+
+  public:
+    static constexpr uint16_t UNIT = 256;       // 100% for the live factor
+
+    // Serial RX ISR: act on a real-time command. Return false if 'c' is not one.
+    bool command(const uint8_t c) {
+      switch (c) {
+        case RT_FEED_HOLD:  hold_ = true; break;
+        case RT_RESUME:     hold_ = false; break;
+        case RT_FEED_RESET: set_feed(100); break;
+        case RT_FEED_PLUS:  set_feed(feed_percent_ + 10); break;
+        case RT_FEED_MINUS: set_feed(feed_percent_ - 10); break;
+        case RT_RAPID_FULL: rapid_ = target(100); break;
+        case RT_RAPID_HALF: rapid_ = target(50); break;
+        case RT_RAPID_LOW:  rapid_ = target(25); break;
+        default: return false;
+      }
+      return true;
+    }
+
+    void set_feed(int16_t percent) {
+      if (percent < FEED_MIN) percent = FEED_MIN;
+      if (percent > FEED_MAX) percent = FEED_MAX;
+      feed_percent_ = percent;
+      feed_ = target(percent);
+    }
+
+    uint8_t feed_percent() const { return feed_percent_; }
+    uint8_t rapid_percent() const { return (uint16_t(rapid_) * 100 + 64) >> 7; }
+    bool hold_requested() const { return hold_; }
+
+    // The stepper is stopped by a feed hold
+    bool held() const { return hold_ && !scale_; }
+
+    /**
+     * Stepper ISR: a new block starts. Its factor changes by 1/256 every 'ramp' ticks
+     * and is at most 'limit' (see limit()).
+     */
+    void block(const bool travel, const uint16_t ramp, const uint8_t limit) {
+      travel_ = travel; ramp_ = ramp; limit_ = limit;
+    }
+
+    // Planner: the limit of a block planned for a feed override of 'percent'
+    static uint8_t limit(const uint8_t percent) { return target(percent < 100 ? 100 : percent); }
+
+    /**
+     * Planner: the ticks between two changes of the factor for a block, so its speed
+     * changes at most by its acceleration (steps/s^2) from its nominal rate (steps/s):
+     * a stop takes rate / acceleration. Never faster than RAMP_STEP/256 per ms.
+     */
+    static uint16_t ramp_ticks(const uint32_t rate, const uint32_t acceleration) {
+      const float ticks = acceleration ? float(TICKS_PER_MS) * (1000.0f / UNIT) * rate / acceleration : 65535.0f;
+      return ticks < MIN_RAMP_TICKS ? MIN_RAMP_TICKS : ticks > 65535.0f ? 65535 : uint16_t(ticks);
+    }
+
+    // Stepper ISR: the step rate to use for 'rate'
+    uint32_t apply(const uint32_t rate) const { return scale_ == UNIT ? rate : (rate * scale_) >> 8; }
+    uint16_t scale() const { return scale_; }
+
+    /**
+     * Stepper ISR: 'ticks' more will have elapsed at the next call.
+     * Move the factor towards its target. Return true if it changed.
+     */
+    bool elapsed(const uint32_t ticks) {
+      ticks_ += ticks;
+      if (ticks_ < ramp_) return false;
+      uint16_t step = 0;
+      do { ticks_ -= ramp_; ++step; } while (ticks_ >= ramp_);
+
+      const uint16_t goal = this->goal();
+      if (scale_ == goal) return false;
+      if (scale_ < goal)
+        scale_ = (goal - scale_ > step) ? scale_ + step : goal;
+      else
+        scale_ = (scale_ - goal > step) ? scale_ - step : goal;
+      return true;
+    }
+
+    // Stop at once (quick stop, kill): no ramp back from a hold
+    void reset() { hold_ = false; scale_ = goal(); ticks_ = 0; }
+
+  private:
+    static constexpr uint16_t MIN_RAMP_TICKS = TICKS_PER_MS / RAMP_STEP;
+
+    // Percentage to a target (128 = 100%)
+    static uint8_t target(const uint8_t percent) { return (uint16_t(percent) * 128 + 50) / 100; }
+
+    // The factor to move towards (in UNIT)
+    uint16_t goal() const {
+      if (hold_) return 0;
+      const uint16_t goal = travel_ ? (uint16_t(feed_) * rapid_) >> 6 : uint16_t(feed_) << 1,
+                     limit = uint16_t(limit_) << 1;
+      return goal < limit ? goal : limit;
+    }
+
+    volatile uint8_t feed_ = 128, rapid_ = 128, feed_percent_ = 100;
+    uint8_t limit_ = 128;
+    volatile bool hold_ = false;
+    bool travel_ = false;
+    uint16_t scale_ = UNIT, ramp_ = MIN_RAMP_TICKS;
+    uint32_t ticks_ = 0;
+};
+
+#endif // _FEED_OVERRIDE_H_
@@ -0,0 +1,160 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * job_start.h - Heating overlapped with homing and leveling at the start of a print
+ *
+ * The start G-code of a file usually heats the bed and waits for it (M190),
+ * heats the hotend and waits for it (M109), then homes (G28) and probes the
+ * bed (G29): one after the other, though homing and probing don't need the
+ * heaters. Here, in the first MAX_LINES lines of the file read, the waits are
+ * made non-blocking when they are read (M190 -> M140, M109 -> M104, in place,
+ * same length) and kept. The bed waits are done before the first probing (G29,
+ * G30): a bed still heating expands and would skew the mesh. All the waits are
+ * done before the first move extruding or retracting (G0-G3 with E). So homing
+ * runs while the bed heats, and homing and probing while the hotends heat.
+ *
+ * A later M104/M140 (or M109/M190) of the same heater replaces the wait kept
+ * for it: the wait is for the last target set. The file is looked at until its
+ * first extruding move or MAX_LINES lines. Waits for cooling (M109 R) and lines
+ * too long to be kept are left as they are.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _JOB_START_H_
+#define _JOB_START_H_
+
+#include <stdint.h>
+#include <string.h>
+
+class JobStart {
+  public:
+    static constexpr uint8_t MAX_LINES = 64;  // Lines of the file looked at
+    static constexpr uint8_t MAX_WAITS = 3;   // Waits kept (bed and two hotends)
+    static constexpr uint8_t WAIT_SIZE = 24;  // Longest wait kept, terminator included
+
+    // A print starts from the beginning of its file
+    void start() { stop(); lines_ = MAX_LINES; }
+
+    // The print stops: the waits are forgotten
+    void stop() { lines_ = 0; count_ = 0; done_ = 0; }
+
+    bool filtering() const { return lines_ != 0; }
+    bool waiting() const { return done_ != (1 << count_) - 1; }
+
+    /**
+     * A line of the file read, before it is queued (without comment).
+     * Waits for temperatures are made non-blocking and kept.
+     */
+    void filter(char *line) {
+      if (!lines_) return;
+      --lines_;
+
+      while (*line == ' ') ++line;
+      if (is_extruding(line)) { lines_ = 0; return; }
+      if (line[0] != 'M') return;
+
+      const bool wait = is(line, "M109") || is(line, "M190"),
+                 bed = is(line, "M140") || is(line, "M190");
+      if (!wait && !bed && !is(line, "M104")) return;
+
+      const char tool = parameter(line, 'T');
+      const int8_t index = find(bed, tool);
+      if (!wait) {
+        // A new target for a heater waited for: wait for it instead
+        if (index >= 0) keep(index, line, bed);
+        return;
+      }
+
+      if (parameter(line, 'R') || !parameter(line, 'S')) return;
+      if (index >= 0 ? !keep(index, line, bed) : count_ >= MAX_WAITS || !keep(count_, line, bed)) return;
+      if (index < 0) ++count_;
+      line[2] = bed ? '4' : '0';  // M190 -> M140, M109 -> M104
+      line[3] = bed ? '0' : '4';
+    }
+
+    /**
+     * Before a command (without comment) is executed: the waits to do first,
+     * all of them if it extrudes, those of the bed if it probes.
+     * Return the next wait (to execute) or NULL.
+     */
+    const char* next_wait(const char *command) {
+      if (!waiting()) return NULL;
+      const bool extruding = is_extruding(command);
+      if (!extruding && !is_probing(command)) return NULL;
+      for (uint8_t i = 0; i < count_; ++i)
+        if (!(done_ & (1 << i)) && (extruding || bed_[i])) {
+          done_ |= 1 << i;
+          return waits_[i];
+        }
+      return NULL;
+    }
+
+    // Does a command (without comment) move the extruder?
+    static bool is_extruding(const char *line) {
+      if (line[0] != 'G' || line[1] < '0' || line[1] > '3' || (line[2] >= '0' && line[2] <= '9')) return false;
+      return strchr(line, 'E') != NULL;
+    }
+
+    // Does a command (without comment) probe the bed?
+    static bool is_probing(const char *line) {
+      if (line[0] != 'G' || (line[3] >= '0' && line[3] <= '9')) return false;
+      return (line[1] == '2' && line[2] == '9') || (line[1] == '3' && line[2] == '0');
+    }
+
+  private:
+    static bool is(const char *line, const char *command) {
+      return !strncmp(line, command, 4) && (line[4] < '0' || line[4] > '9');
+    }
+
+    // The first character of the value of a parameter, or 0 if it is not present
+    static char parameter(const char *line, const char name) {
+      const char *p = strchr(line + 4, name);
+      return p ? (p[1] ? p[1] : ' ') : 0;
+    }
+
+    int8_t find(const bool bed, const char tool) const {
+      for (uint8_t i = 0; i < count_; ++i)
+        if (bed_[i] == bed && tool_[i] == tool) return i;
+      return -1;
+    }
+
+    // Keep the wait for a line setting a temperature (M104 and M140 become M109 and M190)
+    bool keep(const uint8_t index, const char *line, const bool bed) {
+      if (strlen(line) >= WAIT_SIZE) return false;
+      done_ &= ~(1 << index); // A wait done for the previous target is done again
+      strcpy(waits_[index], line);
+      waits_[index][2] = bed ? '9' : '0';
+      waits_[index][3] = bed ? '0' : '9';
+      bed_[index] = bed;
+      tool_[index] = parameter(line, 'T');
+      return true;
+    }
+
+    char waits_[MAX_WAITS][WAIT_SIZE];
+    bool bed_[MAX_WAITS];
+    char tool_[MAX_WAITS];
+    uint8_t count_ = 0, done_ = 0, lines_ = 0;  // done_: a bit by wait
+};
+
+#endif // _JOB_START_H_
@@ -174,6 +174,7 @@
 #define MSG_ERR_ARC_ARGS                    "G2/G3 bad parameters"
 #define MSG_ERR_PROTECTED_PIN               "Protected Pin"
 #define MSG_ERR_M420_FAILED                 "Failed to enable Bed Leveling"
+#define MSG_ERR_MESH_STATISTICS             "Not enough mesh points for a plane"
 #define MSG_ERR_M428_TOO_FAR                "Too far from reference point"
 #define MSG_ERR_M303_DISABLED               "PIDTEMP disabled"
 #define MSG_M119_REPORT                     "Reporting endstop status"
@@ -0,0 +1,122 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * CH376_async.h - CH376 operations running in the background
+ *
+ * Writing a CH376 command takes microseconds, but the chip may then need
+ * milliseconds to access the USB disk before it pulls INT# low. Instead of
+ * spinning on INT# like Wait376Interrupt, an operation is a step function
+ * called once to write its first command (status CH376_ASYNC_START) and then
+ * once per interrupt with the interrupt status. The step writes the next
+ * command and returns false to wait for the next interrupt, or returns true
+ * when the operation is over.
+ *
+ * poll() is called from the idle loop: it only looks at INT#, so the printer
+ * keeps running while the chip works. If no interrupt comes in time, the step
+ * is called with CH376_ASYNC_TIMEOUT and the operation ends.
+ *
+ * Only one operation runs at a time, and nothing else may talk to the chip
+ * while it runs: finish() completes it first.
+ *
+ * The chip is accessed through HAL, which must provide:
+ *
+ *   static bool interrupt()       - INT# is low
+ *   static uint8_t status()       - read and clear the interrupt status
+ *   static uint32_t millis()      - time in milliseconds
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _CH376_ASYNC_H_
+#define _CH376_ASYNC_H_
+
+#include <stdint.h>
+
+#define CH376_ASYNC_START    0x00   // First call of a step, no interrupt yet
+#define CH376_ASYNC_TIMEOUT  0xFA   // Same as ERR_USB_UNKNOWN
+
+template<typename HAL>
+class CH376Async {
+  public:
+    typedef bool (*step_t)(void *context, uint8_t status);
+
+    bool busy() const { return step_ != 0; }
+
+    // True while the chip is accessed on behalf of the operation (status read or step)
+    bool owns_chip() const { return owns_chip_; }
+
+    /**
+     * Start an operation, 'timeout' is the longest wait for each interrupt.
+     * Return false if another operation is still running.
+     */
+    bool start(const step_t step, void * const context, const uint16_t timeout) {
+      if (busy()) return false;
+      step_ = step;
+      context_ = context;
+      timeout_ = timeout;
+      run(CH376_ASYNC_START);
+      return true;
+    }
+
+    /**
+     * Progress the operation if the chip has answered. Return true if there is
+     * no operation running anymore.
+     */
+    bool poll() {
+      if (!busy()) return true;
+      if (HAL::interrupt()) {
+        owns_chip_ = true;
+        run(HAL::status());
+      }
+      else if (int32_t(HAL::millis() - deadline_) >= 0)
+        run(CH376_ASYNC_TIMEOUT);
+      return !busy();
+    }
+
+    /**
+     * Wait for the operation to end, calling yield() in between polls
+     */
+    template<typename YIELD>
+    void finish(YIELD yield) {
+      while (!poll()) yield();
+    }
+
+  private:
+    step_t step_ = 0;
+    void *context_ = 0;
+    uint32_t deadline_ = 0;
+    uint16_t timeout_ = 0;
+    bool owns_chip_ = false;
+
+    void run(const uint8_t status) {
+      owns_chip_ = true;
+      const bool over = step_(context_, status) || status == CH376_ASYNC_TIMEOUT;
+      owns_chip_ = false;
+      if (over)
+        step_ = 0;
+      else
+        deadline_ = HAL::millis() + timeout_;
+    }
+};
+
+#endif // _CH376_ASYNC_H_
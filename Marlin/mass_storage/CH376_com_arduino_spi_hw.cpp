@@ -84,14 +84,51 @@ UINT8 Spi376Exchange( UINT8 d )  /* 硬件SPI输出且输入8个位数据 */
   SPSR &= ~ SPI_IF_TRANS;  // 清除SPI字节传输完成标志,有的单片机会自动清除 
   return( SPDR );  // 先查询SPI状态寄存器以等待SPI字节传输完成,然后从SPI数据寄存器读出数据 
   */
-  CH376DebugOut("USB-!");
+  #ifdef CH376_DEBUG
+    CH376DebugOut("USB-!");
+  #endif
   SPDR = d;
   while (!TEST(SPSR, SPIF)) { /* Intentionally left empty */ }
-  CH376DebugOut("USB!");
+  #ifdef CH376_DEBUG
+    CH376DebugOut("USB!");
+  #endif
   SPSR &= ~ SPI_IF_TRANS;  // 清除SPI字节传输完成标志,有的单片机会自动清除 
   return( SPDR );
 }
 
+/**
+ * Data blocks (64 bytes of file data, directory info...) are moved back to back:
+ * the next transfer is started as soon as the previous one completes and the
+ * byte received is stored while the next one is on the wire. At SPI_INIT_RATE
+ * a byte takes longer than the 0.6us read/write cycle of the CH376, so the
+ * per-byte software delay of xReadCH376Data / xWriteCH376Data is not needed.
+ * The command itself has already waited for BZ in xWriteCH376Cmd.
+ */
+void xReadCH376Block( PUINT8 buf, UINT8 len )
+{
+  SPDR = 0xFF;
+  while (--len) {
+    while (!TEST(SPSR, SPIF)) { /* Intentionally left empty */ }
+    const UINT8 d = SPDR;
+    SPDR = 0xFF;            // Start the next byte...
+    *buf++ = d;             // ...and store this one while it is transferred
+  }
+  while (!TEST(SPSR, SPIF)) { /* Intentionally left empty */ }
+  *buf = SPDR;
+}
+
+void xWriteCH376Block( PUINT8 buf, UINT8 len )
+{
+  SPDR = *buf++;
+  while (--len) {
+    const UINT8 d = *buf++; // Fetch the next byte while this one is transferred
+    while (!TEST(SPSR, SPIF)) { /* Intentionally left empty */ }
+    SPDR = d;
+  }
+  while (!TEST(SPSR, SPIF)) { /* Intentionally left empty */ }
+  (void)SPDR;               // Clear SPIF
+}
+
 
 //#define	xEndCH376Cmd( )  /* 结束CH376命令,仅用于SPI接口方式 */
 
@@ -106,6 +143,8 @@ void	xWriteCH376Cmd( UINT8 mCmd )  /* 向CH376写命令 */
     UINT8 i;
   #endif
 
+  CH376BeforeCmd( );  // Let a background command finish first
+
   /*
   CH376_SPI_SCS = 1;  // 防止之前未通过xEndCH376Cmd禁止SPI片选 
   // 对于双向I/O引脚模拟SPI接口,那么必须确保已经设置SPI_SCS,SPI_SCK,SPI_SDI为输出方向,SPI_SDO为输入方向
@@ -43,6 +43,8 @@ void xEndCH376Cmd()
 
 void	xWriteCH376Cmd( UINT8 mCmd )  /* 向CH376写命令 */
 {
+  CH376BeforeCmd( );  // Let a background command finish first
+
   // geo-f: 原始程序在发送完一个字节后是等待其发送完成的，
   // 但这个 write 函数好像并没有等待，而是放在了发送队列中
   Serial3.write(SER_SYNC_CODE1);
@@ -70,6 +72,16 @@ UINT8	xReadCH376Data( void )  /* 从CH376读数据 */
   return ( 0 ); /* 不应该发生的情况 */
 }
 
+void	xReadCH376Block( PUINT8 buf, UINT8 len )
+{
+	do *buf++ = xReadCH376Data( ); while ( -- len );
+}
+
+void	xWriteCH376Block( PUINT8 buf, UINT8 len )
+{
+	do xWriteCH376Data( *buf++ ); while ( -- len );
+}
+
 /* 查询CH376中断(INT#低电平) */
 UINT8	Query376Interrupt( void )
 {
@@ -26,12 +26,7 @@ UINT8	CH376ReadBlock( PUINT8 buf )  /* 从当前主机端点的接收缓冲区
 	UINT8	s, l;
 	xWriteCH376Cmd( CMD01_RD_USB_DATA0 );
 	s = l = xReadCH376Data( );  /* 长度 */
-	if ( l ) {
-		do {
-			*buf = xReadCH376Data( );
-			buf ++;
-		} while ( -- l );
-	}
+	if ( l ) xReadCH376Block( buf, l );
 	xEndCH376Cmd( );
 	return( s );
 }
@@ -41,12 +36,7 @@ UINT8	CH376WriteReqBlock( PUINT8 buf )  /* 向内部指定缓冲区写入请求
 	UINT8	s, l;
 	xWriteCH376Cmd( CMD01_WR_REQ_DATA );
 	s = l = xReadCH376Data( );  /* 长度 */
-	if ( l ) {
-		do {
-			xWriteCH376Data( *buf );
-			buf ++;
-		} while ( -- l );
-	}
+	if ( l ) xWriteCH376Block( buf, l );
 	xEndCH376Cmd( );
 	return( s );
 }
@@ -55,12 +45,7 @@ void	CH376WriteHostBlock( PUINT8 buf, UINT8 len )  /* 向USB主机端点的发
 {
 	xWriteCH376Cmd( CMD10_WR_HOST_DATA );
 	xWriteCH376Data( len );  /* 长度 */
-	if ( len ) {
-		do {
-			xWriteCH376Data( *buf );
-			buf ++;
-		} while ( -- len );
-	}
+	if ( len ) xWriteCH376Block( buf, len );
 	xEndCH376Cmd( );
 }
 
@@ -69,12 +54,7 @@ void	CH376WriteOfsBlock( PUINT8 buf, UINT8 ofs, UINT8 len )  /* 向内部缓冲
 	xWriteCH376Cmd( CMD20_WR_OFS_DATA );
 	xWriteCH376Data( ofs );  /* 偏移地址 */
 	xWriteCH376Data( len );  /* 长度 */
-	if ( len ) {
-		do {
-			xWriteCH376Data( *buf );
-			buf ++;
-		} while ( -- len );
-	}
+	if ( len ) xWriteCH376Block( buf, len );
 	xEndCH376Cmd( );
 }
 
@@ -770,7 +750,7 @@ UINT8	CH376LocateInUpDir( PUINT8 PathName )  /* 在上级目录(文件夹)中移
 	xEndCH376Cmd( );
 	s = CH376SeparatePath( PathName );  /* 从路径中分离出最后一级文件名或者目录名,返回最后一级文件名或者目录名的偏移 */
 	if ( s ) s = CH376FileOpenDir( PathName, s );  /* 是多级目录,打开多级目录下的最后一级目录,即打开文件的上级目录 */
-	else s = CH376FileOpen( "/" );  /* 根目录下的文件,则打开根目录 */
+	else s = CH376FileOpen( (PUINT8)"/" );  /* 根目录下的文件,则打开根目录 */
 	if ( s != ERR_OPEN_DIR ) return( s );
 	*(PUINT32)(&GlobalBuf[0]) = 0;  /* 目录扇区偏移扇区数,保存在全局缓冲区中,节约RAM */
 	while ( 1 ) {  /* 不断移动文件指针,直到与当前文件目录信息所在的扇区LBA地址匹配 */
@@ -792,7 +772,7 @@ UINT8	CH376GetLongName( PUINT8 PathName, PUINT8 LongName )  /* 由短文件名
 {
 	UINT8	s;
 	UINT16	NameCount;	/* 长文件名字节计数 */
-	CH376DebugOut(PathName);
+	CH376DebugOut( (const char *)PathName );
 	s = CH376FileOpenPath( PathName );  /* 打开多级目录下的文件或者目录 */
 	if ( s != USB_INT_SUCCESS && s != ERR_OPEN_DIR ) return( s );
 	s = CH376DirInfoRead( );  /* 读取当前文件的目录信息FAT_DIR_INFO,将相关数据调到内存中 */
@@ -19,6 +19,8 @@
 
 //#define DEF_INT_TIMEOUT 0 // 一直等
 #define DEF_INT_TIMEOUT 800000 // 相当于500ms
+#define NO_DEFAULT_CH376_INT      // Wait376Interrupt is in cardusbfile.cpp
+#define CH376_INT_TIMEOUT_MS 500  // Longest wait for a CH376 interrupt
 #define	EN_DISK_QUERY		1	/* 启用磁盘查询 */
 #define EN_LONG_NAME
 #define	DEF_IC_V43_U	1	/* 推荐定义 DEF_IC_V43_U 以优化代码 */
@@ -62,9 +64,7 @@ UINT8	CH376GetDiskStatus( void );  /* 获取磁盘和文件系统的工作状态
 
 UINT8	CH376GetIntStatus( void );  /* 获取中断状态并取消中断请求 */
 
-#ifndef	NO_DEFAULT_CH376_INT
 UINT8	Wait376Interrupt( void );  /* 等待CH376中断(INT#低电平)，返回中断状态码, 超时则返回ERR_USB_UNKNOWN */
-#endif
 
 UINT8	CH376SendCmdWaitInt( UINT8 mCmd );  /* 发出命令码后,等待中断 */
 
@@ -84,10 +84,16 @@ void	xEndCH376Cmd( void );			/* 结束CH376命令,仅用于SPI接口方式 */
 
 void	xWriteCH376Cmd( UINT8 mCmd );	/* 向CH376写命令 */
 
+void	CH376BeforeCmd( void );			/* Called by xWriteCH376Cmd, see CH376_async.h */
+
 void	xWriteCH376Data( UINT8 mData );	/* 向CH376写数据 */
 
 UINT8	xReadCH376Data( void );			/* 从CH376读数据 */
 
+void	xReadCH376Block( PUINT8 buf, UINT8 len );	/* Read len data bytes back to back, len > 0 */
+
+void	xWriteCH376Block( PUINT8 buf, UINT8 len );	/* Write len data bytes back to back, len > 0 */
+
 //UINT8	CH376_init();			/* 初始化CH376 */
 
 UINT8	CH376_init( EM_STORAGE_TYPE storage_type);			/* 初始化CH376 */
@@ -0,0 +1,118 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * CH376_seek_map.h - Cluster checkpoints of the file being read
+ *
+ * BYTE_LOCATE walks the FAT chain from the start cluster of the file, so a
+ * seek near the end of a big file follows thousands of FAT entries. While
+ * the file is read sequentially, the cluster holding the file pointer is
+ * noted every 'spacing' bytes. A seek then starts from the nearest checkpoint
+ * before the target and only walks the clusters after it.
+ *
+ * The map has a fixed size. When it is full, every other checkpoint is
+ * dropped and the spacing doubles, so it always covers what has been read.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _CH376_SEEK_MAP_H_
+#define _CH376_SEEK_MAP_H_
+
+#include <stdint.h>
+
+template<uint8_t SIZE>
+class ClusterCheckpoints {
+  static_assert(SIZE >= 2, "SIZE must be at least 2.");
+
+  public:
+    /**
+     * Forget all checkpoints. A 'cluster_bytes' of 0 (unknown) disables the map.
+     */
+    void reset(const uint32_t cluster_bytes, const uint32_t spacing) {
+      cluster_bytes_ = cluster_bytes;
+      spacing_ = spacing < cluster_bytes ? cluster_bytes : spacing;
+      next_ = spacing_;
+      count_ = 0;
+    }
+
+    /**
+     * True if a file pointer at 'offset' is worth noting. At a cluster
+     * boundary the chip may be on either cluster so it is not.
+     */
+    bool wanted(const uint32_t offset) const {
+      return cluster_bytes_ && offset >= next_ && offset % cluster_bytes_;
+    }
+
+    /**
+     * The file pointer is at 'offset' in 'cluster': note where that cluster starts
+     */
+    void note(const uint32_t offset, const uint32_t cluster) {
+      if (!wanted(offset)) return;
+      if (count_ == SIZE) {
+        thin_out();
+        next_ = start_[count_ - 1] + spacing_;
+        if (!wanted(offset)) return;
+      }
+      const uint32_t start = offset - offset % cluster_bytes_;
+      start_[count_] = start;
+      cluster_[count_] = cluster;
+      ++count_;
+      next_ = start + spacing_;
+    }
+
+    /**
+     * Nearest checkpoint at or before 'offset'. Return false if there is none.
+     */
+    bool nearest(const uint32_t offset, uint32_t &start, uint32_t &cluster) const {
+      uint8_t lo = 0, hi = count_;          // Checkpoints are sorted by offset
+      while (lo < hi) {
+        const uint8_t mid = (lo + hi) / 2;
+        if (start_[mid] <= offset) lo = mid + 1; else hi = mid;
+      }
+      if (!lo) return false;
+      start = start_[lo - 1];
+      cluster = cluster_[lo - 1];
+      return true;
+    }
+
+    uint8_t count() const { return count_; }
+    uint32_t spacing() const { return spacing_; }
+
+  private:
+    uint32_t start_[SIZE], cluster_[SIZE];
+    uint32_t cluster_bytes_ = 0, spacing_ = 0, next_ = 0;
+    uint8_t count_ = 0;
+
+    // Keep checkpoints 1, 3, 5... which are twice the spacing apart
+    void thin_out() {
+      uint8_t kept = 0;
+      for (uint8_t i = 1; i < count_; i += 2, ++kept) {
+        start_[kept] = start_[i];
+        cluster_[kept] = cluster_[i];
+      }
+      count_ = kept;
+      spacing_ *= 2;
+    }
+};
+
+#endif // _CH376_SEEK_MAP_H_
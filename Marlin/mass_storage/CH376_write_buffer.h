@@ -0,0 +1,128 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * CH376_write_buffer.h - Uploads (M28) written a whole sector at a time
+ *
+ * Each CH376ByteWrite costs a command, an interrupt per 64-byte block and a
+ * write of the sector to the USB disk, however few bytes it carries. Writing
+ * an upload line by line pays all of it for every line. Here the bytes are
+ * gathered in RAM and handed to SINK when SIZE of them are there: as uploads
+ * are written from the start of the file, a 512-byte buffer makes each write
+ * cover exactly one sector of the disk.
+ *
+ * The SIZE bytes of RAM are given by the caller when it starts, so they are
+ * only taken while a file is uploaded. Without them, the bytes are handed to
+ * SINK as they come.
+ *
+ * SINK must provide:
+ *
+ *   static bool write(const uint8_t *data, uint16_t length)  - false on error
+ *
+ * BinaryUpload follows the raw bytes of a binary upload (M28 B<bytes>): how
+ * many are still expected and their Fletcher-16 checksum, reported to the
+ * host at the end.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _CH376_WRITE_BUFFER_H_
+#define _CH376_WRITE_BUFFER_H_
+
+#include <stdint.h>
+#include <string.h>
+
+template<uint16_t SIZE, typename SINK>
+class WriteBuffer {
+  public:
+    // Start with a buffer of SIZE bytes, or NULL to write straight to SINK
+    void reset(uint8_t * const buffer) { buffer_ = buffer; length_ = 0; written_ = 0; error_ = false; }
+
+    /**
+     * Add bytes, writing the buffer each time it is full.
+     * Return false if a write failed, now or before.
+     */
+    bool write(const void * const data, uint16_t length) {
+      const uint8_t *src = static_cast<const uint8_t*>(data);
+      if (!buffer_) {
+        if (length && !error_) {
+          error_ = !SINK::write(src, length);
+          if (!error_) written_ += length;
+        }
+        return !error_;
+      }
+      while (length && !error_) {
+        uint16_t n = SIZE - length_;
+        if (n > length) n = length;
+        memcpy(&buffer_[length_], src, n);
+        length_ += n;
+        src += n;
+        length -= n;
+        if (length_ == SIZE) flush();
+      }
+      return !error_;
+    }
+
+    // Write what is in the buffer. Return false if a write failed, now or before.
+    bool flush() {
+      if (length_ && !error_) {
+        error_ = !SINK::write(buffer_, length_);
+        if (!error_) written_ += length_;
+      }
+      length_ = 0;
+      return !error_;
+    }
+
+    uint16_t pending() const { return length_; }       // Bytes not written yet
+    uint32_t written() const { return written_; }      // Bytes handed to SINK
+    bool error() const { return error_; }
+
+  private:
+    uint8_t *buffer_ = NULL;
+    uint16_t length_ = 0;
+    uint32_t written_ = 0;
+    bool error_ = false;
+};
+
+class BinaryUpload {
+  public:
+    void start(const uint32_t size) { size_ = remaining_ = size; sum1_ = sum2_ = 0; }
+    void stop() { remaining_ = 0; }
+    bool active() const { return remaining_ != 0; }
+    uint32_t remaining() const { return remaining_; }
+    uint32_t received() const { return size_ - remaining_; }
+
+    // Count a byte of the file. Return true if it was the last one.
+    bool add(const uint8_t c) {
+      sum1_ = (sum1_ + c) % 255;
+      sum2_ = (sum2_ + sum1_) % 255;
+      return --remaining_ == 0;
+    }
+
+    uint16_t checksum() const { return (uint16_t)sum2_ << 8 | sum1_; }
+
+  private:
+    uint32_t size_ = 0, remaining_ = 0;
+    uint8_t sum1_ = 0, sum2_ = 0;
+};
+
+#endif // _CH376_WRITE_BUFFER_H_
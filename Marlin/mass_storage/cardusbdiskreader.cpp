@@ -31,15 +31,51 @@
 #include "../stepper.h"
 #include "../language.h"
 #include "../printcounter.h"
+#if ENABLED(JOB_START_OVERLAP)
+  #include "../job_start.h"
+  extern JobStart job_start;
+#endif
 
 #include "CH376_hal.h"
 #include "CH376_file_sys.h"
 #include "CH376_debug.h"
 
+#if ENABLED(EMERGENCY_PARSER)
+  #include "../emergency_parser.h"
+#endif
+
 #if ENABLED(POWER_LOSS_RECOVERY)
   #include "power_loss_recovery.h"
 #endif
 
+/**
+ * Uploads (M28) are written to the USB disk a sector at a time, see
+ * CH376_write_buffer.h. The file is written from its start so each write
+ * covers a whole sector. The sector is only allocated while a file is
+ * uploaded: uploads are rare and RAM is not.
+ */
+#define USB_UPLOAD_BUFFER_SIZE 512
+
+/**
+ * The host waits for "ok" after each USB_UPLOAD_ACK_SIZE bytes of a binary
+ * upload, so they always fit in the RX buffer, even when the main loop is
+ * busy writing a sector to the disk.
+ */
+#ifndef RX_BUFFER_SIZE
+  #define USB_UPLOAD_ACK_SIZE 32 // HardwareSerial keeps 64 bytes
+#elif RX_BUFFER_SIZE / 2 < USB_UPLOAD_BUFFER_SIZE
+  #define USB_UPLOAD_ACK_SIZE (RX_BUFFER_SIZE / 2)
+#else
+  #define USB_UPLOAD_ACK_SIZE USB_UPLOAD_BUFFER_SIZE
+#endif
+
+struct UploadSink {
+  static bool write(const uint8_t *data, uint16_t length) { return card.file.write(data, length) == length; }
+};
+
+static WriteBuffer<USB_UPLOAD_BUFFER_SIZE, UploadSink> upload_buffer;
+static uint8_t *upload_sector = NULL;
+
 USBReader::USBReader() {
   #if ENABLED(SDCARD_SORT_ALPHA)
     sort_count = 0;
@@ -655,6 +691,9 @@ void USBReader::openAndPrintFile(const char *name) {
 
 void USBReader::startFileprint() {
   if (cardOK) {
+    #if ENABLED(JOB_START_OVERLAP)
+      if (!sdpos) job_start.start(); // Not when resuming
+    #endif
     sdprinting = true;
     #if SD_RESORT
       flush_presort();
@@ -662,6 +701,53 @@ void USBReader::startFileprint() {
   }
 }
 
+#if ENABLED(GCODE_METADATA_SCAN)
+
+  /**
+   * Start the scan of the metadata of the file opened, read by scanMetadata().
+   * A file already scanned is not read again.
+   */
+  void USBReader::startMetadataScan() {
+    metadataScan.start(filesize);
+    char name[FILENAME_LENGTH];
+    file.getFilename(name);
+    const GCodeMetadata *metadata = metadataCache.find(name, filesize);
+    if (metadata) {
+      metadataScan.set(*metadata);
+      metadataScan.stop();
+    }
+  }
+
+  /**
+   * Read a chunk of the file for the scan of its metadata. Called from idle().
+   * Return false when the scan is done: the file is then at its start.
+   */
+  bool USBReader::scanMetadata() {
+    if (!metadataScan.active()) return false;
+
+    uint8_t buffer[GCodeMetadataScan::CHUNK_SIZE];
+    uint32_t position = 0;
+    const uint8_t length = metadataScan.next(position);
+    // Seek only to the start of the tail: each seek is a BYTE_LOCATE from the start of the file
+    const bool located = isFileOpen() && (file.curPosition() == position || file.seekSet(position));
+    const int16_t read = length && located ? file.read(buffer, length) : -1;
+    if (read != length) {
+      metadataScan.stop(); // Stopped or read error: not kept in the cache
+      if (isFileOpen()) setIndex(0);
+      return false;
+    }
+
+    if (metadataScan.feed(buffer, length)) return true;
+
+    char name[FILENAME_LENGTH];
+    file.getFilename(name);
+    metadataCache.store(name, filesize, metadataScan.metadata());
+    setIndex(0);
+    return false;
+  }
+
+#endif // GCODE_METADATA_SCAN
+
 void USBReader::stopSDPrint(
   #if SD_RESORT
     const bool re_sort/*=false*/
@@ -671,6 +757,9 @@ void USBReader::stopSDPrint(
     did_pause_print = 0;
   #endif
   sdprinting = false;
+  #if ENABLED(JOB_START_OVERLAP)
+    job_start.stop();
+  #endif
   
   if (isFileOpen()) file.close();
   file.init(); // geo-f:add 20190228
@@ -805,6 +894,9 @@ void USBReader::openFile(char * const path, const bool read, const bool subcall/
     #endif
   }
   else { //write
+    // USBFile::open only opens existing files: create the file first, the CH376 empties it if it exists
+    CH376WriteVar32(VAR_START_CLUSTER, curDir->getDirStartClust());
+    CH376FileCreate((PUINT8)fname);
     if (!file.open(curDir, fname, O_CREAT | O_APPEND | O_WRITE | O_TRUNC)) {
       SERIAL_PROTOCOLPAIR(MSG_SD_OPEN_FILE_FAIL, fname);
       SERIAL_PROTOCOLCHAR('.');
@@ -812,6 +904,9 @@ void USBReader::openFile(char * const path, const bool read, const bool subcall/
     }
     else {
       saving = true;
+      // Without enough free RAM for the sector, lines are written as they come
+      if (!upload_sector) upload_sector = new uint8_t[USB_UPLOAD_BUFFER_SIZE];
+      upload_buffer.reset(upload_sector);
       SERIAL_PROTOCOLLNPAIR(MSG_SD_WRITE_TO_FILE, path);
       lcd_setstatus(fname);
     }
@@ -858,21 +953,47 @@ void USBReader::write_command(char *buf) {
   char* npos = NULL;
   char* end = buf + strlen(buf) - 1;
 
-  file.writeError = false;
   if ((npos = strchr(buf, 'N')) != NULL) {
     begin = strchr(npos, ' ') + 1;
     end = strchr(npos, '*') - 1;
   }
-  end[1] = '\r';
-  end[2] = '\n';
-  end[3] = '\0';
-  file.write(begin);
-  if (file.writeError) {
+  if (!upload_buffer.write(begin, end - begin + 1) || !upload_buffer.write("\r\n", 2)) {
     SERIAL_ERROR_START();
     SERIAL_ERRORLNPGM(MSG_SD_ERR_WRITE_TO_FILE);
   }
 }
 
+/**
+ * Binary upload (M28 B<bytes>): the next 'size' bytes from the host are the
+ * file itself. They bypass the command queue and are acknowledged with "ok"
+ * every USB_UPLOAD_ACK_SIZE bytes, once they are on the disk. The emergency
+ * parser is off until the file is closed: a byte of the file, or a sequence
+ * like M112, is not a command.
+ */
+void USBReader::start_binary_upload(const uint32_t size) {
+  if (!saving || !size) return;
+  upload.start(size);
+  #if ENABLED(EMERGENCY_PARSER)
+    emergency_parser.disable();
+  #endif
+  SERIAL_PROTOCOLLNPAIR("Binary chunk: ", USB_UPLOAD_ACK_SIZE);
+}
+
+void USBReader::write_binary(const uint8_t c) {
+  if (!upload.active()) return;
+  const bool last = upload.add(c);
+  upload_buffer.write(&c, 1); // Errors are reported when the file is closed
+  if (last) {
+    const uint16_t checksum = upload.checksum();
+    closefile();
+    SERIAL_PROTOCOLLNPGM(MSG_FILE_SAVED);
+    SERIAL_PROTOCOLLNPAIR("Checksum: ", checksum);
+    SERIAL_PROTOCOLLNPGM(MSG_OK);
+  }
+  else if (upload.received() % USB_UPLOAD_ACK_SIZE == 0)
+    SERIAL_PROTOCOLLNPGM(MSG_OK);
+}
+
 #ifdef FYS_ULTILCD2_COMPATIBLE
 bool USBReader::write_string(char* buffer)
 {
@@ -937,6 +1058,18 @@ void USBReader::closefile(const bool store_location) {
   //file.sync();
   //file.close();
 
+  if (saving && !upload_buffer.flush()) {
+    SERIAL_ERROR_START();
+    SERIAL_ERRORLNPGM(MSG_SD_ERR_WRITE_TO_FILE);
+  }
+  upload_buffer.reset(NULL);
+  delete[] upload_sector;
+  upload_sector = NULL;
+  #if ENABLED(EMERGENCY_PARSER)
+    if (!emergency_parser.enabled) emergency_parser.enable();
+  #endif
+  upload.stop();
+
   file.close();
     
   saving = logging = false;
@@ -1698,27 +1831,102 @@ void USBReader::printingHasFinished() {
     return exists;
   }
 
-  int16_t USBReader::saveJobRecoveryInfo() {
+  /**
+   * Create the recovery file at its final size, cold record and slots zeroed.
+   * Saves then only overwrite bytes inside the file: the FAT and the
+   * directory entry are left alone until the job ends.
+   */
+  bool USBReader::prepareJobRecoveryFile() {
+    if (!cardOK) return false;
+    #if ENABLED(DEBUG_POWER_LOSS_RECOVERY)
+      SERIAL_PROTOCOLLNPGM("---- prepareJobRecoveryFile. ----");
+    #endif
+
+    CH376WriteVar32(VAR_START_CLUSTER, root.getDirStartClust());
+    UINT8 s = CH376FileCreate((PUINT8)job_recovery_file_name);  // Truncates a leftover file
+    if (s != USB_INT_SUCCESS) {
+      SERIAL_PROTOCOLPAIR("create file fail:", job_recovery_file_name);
+      SERIAL_PROTOCOLCHAR('.');
+      SERIAL_EOL();
+      return false;
+    }
+
+    UINT8 zero[CH376_DAT_BLOCK_LEN];
+    memset(zero, 0, sizeof(zero));
+    for (uint16_t i = 0; i < JOB_RECOVERY_FILE_SIZE / sizeof(zero) && s == USB_INT_SUCCESS; i++)
+      s = CH376ByteWrite(zero, sizeof(zero), NULL);
+
+    // Update the file length in the directory entry, this time only
+    if (CH376FileClose(TRUE) != USB_INT_SUCCESS || s != USB_INT_SUCCESS) {
+      mStopIfError(s);
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Write the hot record in its slot, preceded by the cold record in its slot if it changed.
+   * Each record stays within one sector of the pre-sized file.
+   */
+  int16_t USBReader::saveJobRecoveryInfo(const bool save_cold) {
     #if ENABLED(DEBUG_POWER_LOSS_RECOVERY)
       SERIAL_PROTOCOLLNPGM("---- saveJobRecoveryInfo. ----");
     #endif
-    jobRecoveryFile.seekSet(0);
-    const int16_t ret = jobRecoveryFile.write(&job_recovery_info, sizeof(job_recovery_info));
+    if (!jobRecoveryFile.open(&root, job_recovery_file_name, O_WRITE)) return -1;
+
+    int16_t ret = 0;
+    if (save_cold) {
+      if (!jobRecoveryFile.seekSet(JOB_RECOVERY_COLD_OFFSET(job_recovery_info.cold_slot))
+          || jobRecoveryFile.write(&job_recovery_info.cold, sizeof(job_recovery_info.cold)) < 0)
+        ret = -1;
+    }
+    if (ret != -1) {
+      if (!jobRecoveryFile.seekSet(JOB_RECOVERY_SLOT_OFFSET(job_recovery_slot(job_recovery_info.hot.sequence))))
+        ret = -1;
+      else
+        ret = jobRecoveryFile.write(&job_recovery_info.hot, sizeof(job_recovery_info.hot));
+    }
+
+    jobRecoveryFile.close(false); // Same size, no directory update
     #if ENABLED(DEBUG_POWER_LOSS_RECOVERY)
       if (ret == -1) SERIAL_PROTOCOLLNPGM("Power-loss file write failed.");
     #endif
     return ret;
   }
 
-  int16_t USBReader::loadJobRecoveryInfo() {
-    return jobRecoveryFile.read(&job_recovery_info, sizeof(job_recovery_info));
+  /**
+   * Load the most recent valid cold record and hot slot.
+   * A slot torn by a power cut fails its CRC and the previous one is used.
+   */
+  bool USBReader::loadJobRecoveryInfo() {
+    job_recovery_cold_t cold;
+    job_recovery_hot_t slot;
+    memset(&job_recovery_info, 0, sizeof(job_recovery_info));
+
+    for (uint8_t i = 0; i < JOB_RECOVERY_COLD_SLOTS; i++)
+      if (jobRecoveryFile.seekSet(JOB_RECOVERY_COLD_OFFSET(i))
+          && jobRecoveryFile.read(&cold, sizeof(cold)) == sizeof(cold)
+          && job_recovery_newer(cold, job_recovery_info.cold)) {
+        job_recovery_info.cold = cold;
+        job_recovery_info.cold_slot = i;
+      }
+    if (!job_recovery_valid(job_recovery_info.cold)) return false;
+
+    for (uint8_t i = 0; i < JOB_RECOVERY_SLOTS; i++)
+      if (jobRecoveryFile.seekSet(JOB_RECOVERY_SLOT_OFFSET(i))
+          && jobRecoveryFile.read(&slot, sizeof(slot)) == sizeof(slot)
+          && job_recovery_newer(slot, job_recovery_info.hot))
+        job_recovery_info.hot = slot;
+
+    return job_recovery_valid(job_recovery_info.hot);
   }
 
   void USBReader::removeJobRecoveryFile() {
     #if ENABLED(DEBUG_POWER_LOSS_RECOVERY)
       SERIAL_PROTOCOLLNPGM("---- removeJobRecoveryFile. ----");
     #endif
-    job_recovery_info.valid_head = job_recovery_info.valid_foot = job_recovery_commands_count = 0;
+    memset(&job_recovery_info, 0, sizeof(job_recovery_info));
+    job_recovery_commands_count = 0;
     if (jobRecoverFileExists()) {
       //closefile();
       jobRecoveryFile.close();
@@ -32,6 +32,10 @@
 #define MAX_DIR_DEPTH 10          // Maximum folder depth
 
 #include "cardusbfile.h"
+#include "CH376_write_buffer.h"
+#if ENABLED(GCODE_METADATA_SCAN)
+  #include "gcode_metadata.h"
+#endif
 #include "../SdFatConfig.h"
 
 // 这些定义是从 sdfat.h 拷贝过来
@@ -67,6 +71,9 @@ public:
 
   void initsd();
   void write_command(char *buf);
+  void start_binary_upload(const uint32_t size);
+  void write_binary(const uint8_t c);
+  FORCE_INLINE bool binary_upload() { return upload.active(); }
   #ifdef FYS_ULTILCD2_COMPATIBLE
     bool write_string(char* buffer);
     FORCE_INLINE int16_t fgets(char* str, int16_t num) { return file.fgets(str, num, NULL); }
@@ -76,7 +83,6 @@ public:
     //FORCE_INLINE void clearError() { sd2card.error(0); }
     FORCE_INLINE void clearError() {  } // 暂时先用这个
     FORCE_INLINE uint32_t getFilePos() { return sdpos; }
-    FORCE_INLINE uint32_t getFileSize() { return filesize; }
   #endif
   //files auto[0-9].g on the sd card are performed in a row
   //this is to delay autostart and hence the initialisaiton of the sd card to some seconds after the normal init, so the device is available quick after a reset
@@ -135,8 +141,9 @@ public:
     void openJobRecoveryFile(const bool read);
     void closeJobRecoveryFile();
     bool jobRecoverFileExists();
-    int16_t saveJobRecoveryInfo();
-    int16_t loadJobRecoveryInfo();
+    bool prepareJobRecoveryFile();
+    int16_t saveJobRecoveryInfo(const bool save_cold);
+    bool loadJobRecoveryInfo();
     void removeJobRecoveryFile();
   #endif
 
@@ -154,6 +161,7 @@ public:
   FORCE_INLINE int16_t get() { sdpos = file.curPosition(); return (int16_t)file.read(); }
   FORCE_INLINE void setIndex(const uint32_t index) { sdpos = index; file.seekSet(index); }
   FORCE_INLINE uint32_t getIndex() { return sdpos; }
+  FORCE_INLINE uint32_t getFileSize() { return filesize; }
   FORCE_INLINE uint8_t percentDone() { return (isFileOpen() && filesize) ? sdpos / ((filesize + 99) / 100) : 0; }
   FORCE_INLINE char* getWorkDirName() { workDir.getFilename(filename); return filename; }
 
@@ -168,6 +176,13 @@ public:
 
   FORCE_INLINE char* longest_filename() { return longFilename[0] ? longFilename : filename; }
 
+  #if ENABLED(GCODE_METADATA_SCAN)
+    void startMetadataScan();
+    bool scanMetadata();
+    FORCE_INLINE bool scanningMetadata() { return metadataScan.active(); }
+    FORCE_INLINE const GCodeMetadata& getMetadata() { return metadataScan.metadata(); }
+  #endif
+
 public:
   bool saving, logging, sdprinting, cardOK, filenameIsDir, abort_sd_printing;
   char filename[FILENAME_LENGTH], longFilename[LONG_FILENAME_LENGTH];
@@ -243,6 +258,8 @@ private:
   //SdVolume volume;
   //SdFile file;
   USBFile file; // 用于保存当前正在打印的文件
+  friend struct UploadSink;
+  BinaryUpload upload;
 
   #if ENABLED(POWER_LOSS_RECOVERY)
     USBFile jobRecoveryFile;
@@ -265,6 +282,11 @@ private:
     uint32_t imageFilesize, imageSdpos;
   #endif
 
+  #if ENABLED(GCODE_METADATA_SCAN)
+    GCodeMetadataScan metadataScan;
+    GCodeMetadataCache<GCODE_METADATA_CACHE_SIZE> metadataCache;
+  #endif
+
   LsAction lsAction; //stored for recursion.
   uint16_t nrFiles; //counter for the files in the current directory and recycled as position counter for getting the nrFiles'th name in the directory.
   char* diveDirName;
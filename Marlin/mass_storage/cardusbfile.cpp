@@ -8,8 +8,11 @@
 #include "CH376_hal.h"
 #include "CH376_file_sys.h"
 #include "CH376_debug.h"
+#include "CH376_async.h"
+#include "CH376_seek_map.h"
 
 #include "../serial.h"
+#include "../temperature.h"
 
 /** Mask for file/subdirectory tests */
 uint8_t const DIR_ATT_FILE_TYPE_MASK = (ATTR_DIRECTORY | ATTR_VOLUME_ID);
@@ -25,6 +28,98 @@ USBFile::USBFile(){
   writeError = false;
 }
 
+/**
+ * Read-ahead of CH376 data blocks. Reading byte by byte with BYTE_READ costs
+ * a command, two interrupt waits and a BYTE_RD_GO per byte; here a whole block
+ * is read at once and bytes are then served from RAM. While they are, the
+ * following block is read in the background (see CH376_async.h) so the next
+ * read usually finds it ready.
+ *
+ * The CH376 has only one file open at a time, so the blocks are shared by all
+ * USBFile: each belongs to the file that filled it.
+ */
+struct ReadAheadBlock {
+  const USBFile *owner;
+  UINT32 position;                  // File offset of data[0]
+  UINT8 length;                     // Valid bytes in data
+  UINT8 data[CH376_DAT_BLOCK_LEN];
+};
+
+static ReadAheadBlock blocks[2];
+static ReadAheadBlock *read_ahead = &blocks[0], // Bytes are served from this one
+                      *prefetch = &blocks[1];   // The following block, read in the background
+static bool prefetch_ready;
+
+// What the CH376 holds: the file, the offset its file pointer counts from
+// (not 0 after a seek from a checkpoint) and where that pointer is
+#define CHIP_POSITION_UNKNOWN 0xFFFFFFFFUL
+static const USBFile *chip_file;
+static UINT32 chip_base, chip_position = CHIP_POSITION_UNKNOWN;
+
+static bool chipAt(const USBFile * const file, const UINT32 position) {
+  return chip_file == file && chip_position == position;
+}
+
+// Cluster checkpoints of the file read sequentially, see CH376_seek_map.h
+#define USB_SEEK_CHECKPOINTS        16
+#define USB_SEEK_CHECKPOINT_SPACING 0x10000UL   // To begin with, doubles as the file is read
+
+static struct {
+  const USBFile *owner;
+  UINT32 start_cluster;             // Real start cluster of the file
+  ClusterCheckpoints<USB_SEEK_CHECKPOINTS> checkpoints;
+} seek_map;
+
+struct CH376AsyncHAL {
+  static bool interrupt() { return Query376Interrupt(); }
+  static uint8_t status() { return CH376GetIntStatus(); }
+  static uint32_t millis() { return ::millis(); }
+};
+
+static CH376Async<CH376AsyncHAL> usb_async;
+
+// What to do while waiting for the CH376: keep the heaters (and the watchdog) going
+static void wait_yield() { thermalManager.manage_heater(); }
+
+static void dropReadAhead() {
+  usb_async.finish(wait_yield);
+  read_ahead->owner = prefetch->owner = NULL;
+}
+
+// The CH376 is about to open or close a file
+static void forgetChipFile() {
+  dropReadAhead();
+  chip_file = NULL;
+  chip_base = 0;
+  chip_position = CHIP_POSITION_UNKNOWN;
+}
+
+/**
+ * Replaces the default Wait376Interrupt (NO_DEFAULT_CH376_INT): the wait is
+ * bounded in time instead of loop iterations, and manages the heaters.
+ */
+UINT8 Wait376Interrupt( void ) {
+  const millis_t deadline = millis() + CH376_INT_TIMEOUT_MS;
+  while (!Query376Interrupt()) {
+    if (ELAPSED(millis(), deadline)) {
+      CH376DebugOut("Wait376Interrupt timeout");
+      return ERR_USB_UNKNOWN;
+    }
+    wait_yield();
+  }
+  return CH376GetIntStatus();
+}
+
+// Called by xWriteCH376Cmd: a command from the foreground lets the background one finish first
+void CH376BeforeCmd( void ) {
+  if (!usb_async.owns_chip()) usb_async.finish(wait_yield);
+}
+
+// From idle(): progress the background read
+void USBFile::poll() {
+  usb_async.poll();
+}
+
 void USBFile::init(){
   dirStartClust = 0;
   memset(name,0,sizeof(name));
@@ -219,6 +314,8 @@ bool USBFile::open(USBFile* dirFile, const char* path, uint8_t oflag) {
   if (!dirFile || isOpen()) return false;
 
   SERIAL_ECHOLN("USBFile::open");
+  forgetChipFile(); // Another file is about to be opened in the CH376
+  if (seek_map.owner == this) seek_map.owner = NULL;
 
   // 将当前目录的上级目录的起始簇号设置为当前簇号,相当于打开上级目录
   // 在同一个目录中的所有文件都保有这 目录其实簇号  
@@ -383,10 +480,20 @@ void USBFile::setFileOpenState(bool flag){
   is_open = flag;
 }
 
-bool USBFile::close() {
+// update_size 为 false 时不更新目录项中的文件长度，用于只覆盖文件内已有字节的情况
+bool USBFile::close(const bool update_size) {
   SERIAL_ECHOLN("USBFile::close");
+  dropReadAhead();
+
+  // Give the CH376 back the real start and size of the file before it updates the directory entry
+  if (chip_file == this && chip_base) {
+    CH376WriteVar32( VAR_START_CLUSTER, seek_map.start_cluster );
+    CH376WriteVar32( VAR_FILE_SIZE, size );
+  }
+  forgetChipFile();
+  if (seek_map.owner == this) seek_map.owner = NULL;
 
-  UINT8 s = CH376FileClose( TRUE );  /* 关闭文件,对于字节读写建议自动更新文件长度 */
+  UINT8 s = CH376FileClose( update_size ? TRUE : FALSE );  /* 关闭文件,对于字节读写建议自动更新文件长度 */
   if ( s != USB_INT_SUCCESS ) {
     mStopIfError(s);
     return false;  
@@ -400,176 +507,259 @@ UINT32 USBFile::curPosition() {
 }
 
 bool USBFile::seekSet(UINT32 pos) {
-  UINT32 s = CH376ByteLocate( pos );  /* 以字节为单位移动当前文件指针到上次复制结束位置 */
-  if ( s != USB_INT_SUCCESS ) {
-    mStopIfError(s);
-    return false;  
-  }
-
+  dropReadAhead();
+  if (!locateChip(pos)) return false;
   curPosition_ = pos;
-  
   return true;
 }
 
-// 读取一个字节，错误则返回-1
-#if DISABLED(POWER_LOSS_RECOVERY)
-INT16 USBFile::read(){
-  UINT8 s;
-  UINT8 buffer;
-  UINT16 realCnt; // 实际读出来的字节数
+/**
+ * Make the CH376 count from the nearest checkpoint before 'pos': the file is
+ * said to start at the cluster of the checkpoint, and to be shorter by as
+ * much. Return the offset to locate.
+ */
+UINT32 USBFile::rebaseChip(const UINT32 pos) {
+  if (chip_file != this) {
+    chip_file = this;
+    chip_base = 0;
+  }
+  if (seek_map.owner != this) return pos;
 
-  // 以字节为单位从当前位置读取数据块,返回实际长度在realCnt中 
-  s = CH376ByteRead( &buffer, 1, &realCnt );  			
-  //s = CH376ByteReadOne(&buffer, &realCnt);
-  if ( s != USB_INT_SUCCESS ) {
-    mStopIfError(s);
-    return -1;  
+  uint32_t base = 0, cluster = seek_map.start_cluster;
+  seek_map.checkpoints.nearest(pos, base, cluster);
+  if (base != chip_base) {
+    CH376WriteVar32( VAR_START_CLUSTER, cluster );
+    CH376WriteVar32( VAR_FILE_SIZE, size - base );
+    chip_base = base;
   }
+  return pos - base;
+}
 
-  if(realCnt!=1) { // 读取到的和需要读取的字节不一样，应该是到文件末尾了
-    SERIAL_ECHO("readCnt:");
-    SERIAL_PRINTLN(realCnt,10);    
-    return -1;
+// Move the CH376 file pointer to 'pos'
+bool USBFile::locateChip(const UINT32 pos) {
+  const UINT8 s = CH376ByteLocate( rebaseChip(pos) );  /* 以字节为单位移动当前文件指针到上次复制结束位置 */
+  if ( s != USB_INT_SUCCESS ) {
+    chip_position = CHIP_POSITION_UNKNOWN;
+    mStopIfError(s);
+    return false;
   }
+  chip_position = pos;
+  return true;
+}
 
-  curPosition_++;
-  
-  return buffer;
+// While the file is read sequentially, note where its clusters are
+void USBFile::noteCluster() {
+  if (seek_map.owner != this) {
+    // The first file read takes the map, until it is closed
+    if (chip_base || (seek_map.owner && seek_map.owner->is_open)) return;
+    seek_map.owner = this;
+    seek_map.start_cluster = CH376ReadVar32( VAR_START_CLUSTER );
+    seek_map.checkpoints.reset(UINT32(CH376ReadVar8( VAR_SEC_PER_CLUS )) * DEF_SECTOR_SIZE, USB_SEEK_CHECKPOINT_SPACING);
+  }
+  if (seek_map.checkpoints.wanted(chip_position))
+    seek_map.checkpoints.note(chip_position, CH376ReadVar32( VAR_CURRENT_CLUST ));
 }
 
-#else
+// Bytes of the read-ahead available at the current position
+UINT8 USBFile::readAheadAvailable() const {
+  if (read_ahead->owner != this || curPosition_ < read_ahead->position) return 0;
+  const UINT32 offset = curPosition_ - read_ahead->position;
+  return offset < read_ahead->length ? read_ahead->length - offset : 0;
+}
 
-// 读取一个字节，错误则返回-1
-INT16 USBFile::read(){
-  UINT8 s;
-  UINT8 buffer;
-  UINT16 realCnt; // 实际读出来的字节数
+// Put the CH376 file pointer at curPosition_
+bool USBFile::locate() {
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    // The recovery file may have been opened since the last read: reopen this file
+    CH376WriteVar32( VAR_START_CLUSTER, dirStartClust );
+    const UINT8 s = CH376FileOpen( name );  /* 打开文件 采用的是多级目录文件名中，最后的文件名部分*/
+    if ( s != USB_INT_SUCCESS ) {
+      forgetChipFile();
+      mStopIfError(s);
+      return false;
+    }
+    chip_file = this;
+    chip_base = 0;
+    chip_position = 0;
+  #endif
 
-  /* 将目标文件所在的上级目录的起始簇号设置为当前簇号,相当于打开上级目录 */
-  //SERIAL_ECHO("read clust:");
-  //SERIAL_ECHOLN(dirStartClust);
-  //SERIAL_ECHO("pos:");
-  //SERIAL_ECHOLN(curPosition_);
-  char * const p = &name[0];
-  //SERIAL_PROTOCOLPAIR("name11:", p);
-  //CH376FileClose( FALSE );
-  //SERIAL_ECHO("1o");
-//	CH376WriteVar32( VAR_START_CLUSTER, dirStartClust );
-	CH376WriteVar32( VAR_START_CLUSTER, dirStartClust ); 
-	//SERIAL_ECHO("oo");
-	s = CH376FileOpen( p );  /* 打开文件 采用的是多级目录文件名中，最后的文件名部分*/
-	if ( s != USB_INT_SUCCESS ) {    
-    SERIAL_ECHOLNPGM("bb");
-    mStopIfError(s);
-    return -1;  
-	}
+  if (chipAt(this, curPosition_)) return true; // Reading sequentially
+  return locateChip(curPosition_);
+}
 
-	/* 以字节为单位移动当前文件指针到上次复制结束位置 */
-	s = CH376ByteLocate( curPosition_ );  
-	if ( s != USB_INT_SUCCESS ) {	  
-	  SERIAL_ECHOLNPGM("cc");
-	  mStopIfError(s);
-    return -1;  
-	}
+bool USBFile::fillReadAhead() {
+  read_ahead->owner = NULL;
+  if (!locate()) return false;
 
-  // 以字节为单位从当前位置读取数据块,返回实际长度在realCnt中 
-  s = CH376ByteRead( &buffer, 1, &realCnt );  			
-  //s = CH376ByteReadOne(&buffer, &realCnt);
+  UINT16 realCnt; // 实际读出来的字节数
+  const UINT8 s = CH376ByteRead( read_ahead->data, CH376_DAT_BLOCK_LEN, &realCnt );
   if ( s != USB_INT_SUCCESS ) {
-    SERIAL_ECHOLNPGM("dd");
+    chip_position = CHIP_POSITION_UNKNOWN;
     mStopIfError(s);
-    return -1;  
+    return false;
   }
 
-  if(realCnt!=1) { // 读取到的和需要读取的字节不一样，应该是到文件末尾了
-    SERIAL_ECHO("readCnt:");
-    SERIAL_PRINTLN(realCnt,10);    
-    return -1;
+  chip_position += realCnt;
+  noteCluster();
+  read_ahead->owner = this;
+  read_ahead->position = curPosition_;
+  read_ahead->length = realCnt;
+  startPrefetch();
+  return realCnt != 0;
+}
+
+// Make the next block current, from the background read if it has it
+bool USBFile::nextReadAhead() {
+  if (prefetch->owner == this && prefetch->position == curPosition_) {
+    usb_async.finish(wait_yield); // Usually already over, polled from idle()
+    if (prefetch->owner == this && prefetch_ready) {
+      ReadAheadBlock * const block = read_ahead;
+      read_ahead = prefetch;
+      prefetch = block;
+      prefetch->owner = NULL;
+      startPrefetch();
+      return read_ahead->length != 0;
+    }
   }
+  return fillReadAhead(); // Also reports the errors of the background read, if any
+}
 
-  curPosition_++;
-  //SERIAL_ECHO("pos:");
-  //SERIAL_ECHOLN(curPosition_);
-  
-  return buffer;
+// Start reading the block after the current one in the background
+void USBFile::startPrefetch() {
+  const UINT32 next = read_ahead->position + read_ahead->length;
+  if (read_ahead->length < CH376_DAT_BLOCK_LEN || next >= size) return; // End of file
+  #if DISABLED(POWER_LOSS_RECOVERY)
+    if (!chipAt(this, next)) return;
+  #endif
+
+  usb_async.finish(wait_yield);
+  prefetch->owner = this;
+  prefetch->position = next;
+  prefetch->length = 0;
+  prefetch_ready = false;
+  usb_async.start(prefetchStep, this, CH376_INT_TIMEOUT_MS);
 }
-#endif
 
-// 读取n个字节，错误则返回-1
-#if DISABLED(POWER_LOSS_RECOVERY)
-INT16 USBFile::read(void* buf, uint16_t nbyte){
-  UINT8 s;
-  //UINT8 buffer;
-  UINT16 realCnt; // 实际读出来的字节数
+/**
+ * Background read of the prefetch block, one call per CH376 interrupt. With
+ * power-loss recovery the file is reopened and located first, as in locate().
+ */
+bool USBFile::prefetchStep(void *context, uint8_t status) {
+  enum : uint8_t { PREFETCH_OPEN, PREFETCH_LOCATE, PREFETCH_READ };
+  static uint8_t phase;
+  USBFile * const file = static_cast<USBFile*>(context);
+
+  if (status == CH376_ASYNC_START) {
+    #if ENABLED(POWER_LOSS_RECOVERY)
+      CH376WriteVar32( VAR_START_CLUSTER, file->dirStartClust );
+      CH376SetFileName( const_cast<PUINT8>(file->name) );
+      xWriteCH376Cmd( CMD0H_FILE_OPEN );
+      xEndCH376Cmd( );
+      phase = PREFETCH_OPEN;
+      return false;
+    #else
+      phase = PREFETCH_LOCATE;
+      status = USB_INT_SUCCESS; // The file pointer is already there
+    #endif
+  }
+
+  switch (phase) {
+    case PREFETCH_OPEN: {
+      if (status != USB_INT_SUCCESS) break;
+      chip_file = NULL; // Reopened: counts from the start of the file
+      const UINT32 offset = file->rebaseChip(prefetch->position);
+      xWriteCH376Cmd( CMD4H_BYTE_LOCATE );
+      xWriteCH376Data( (UINT8)offset );
+      xWriteCH376Data( (UINT8)(offset >> 8) );
+      xWriteCH376Data( (UINT8)(offset >> 16) );
+      xWriteCH376Data( (UINT8)(offset >> 24) );
+      xEndCH376Cmd( );
+      phase = PREFETCH_LOCATE;
+      return false;
+    }
 
-  uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
+    case PREFETCH_LOCATE:
+      if (status != USB_INT_SUCCESS) break;
+      xWriteCH376Cmd( CMD2H_BYTE_READ );
+      xWriteCH376Data( CH376_DAT_BLOCK_LEN );
+      xWriteCH376Data( 0 );
+      xEndCH376Cmd( );
+      phase = PREFETCH_READ;
+      return false;
 
-  // 以字节为单位从当前位置读取数据块,返回实际长度在realCnt中 
-  s = CH376ByteRead( dst, nbyte, &realCnt );  			
-  //s = CH376ByteReadOne(&buffer, &realCnt);
-  if ( s != USB_INT_SUCCESS ) {
-    mStopIfError(s);
-    return -1;  
+    case PREFETCH_READ:
+      if (status == USB_INT_DISK_READ) {
+        prefetch->length += CH376ReadBlock( &prefetch->data[prefetch->length] );
+        xWriteCH376Cmd( CMD0H_BYTE_RD_GO );
+        xEndCH376Cmd( );
+        return false;
+      }
+      if (status != USB_INT_SUCCESS) break;
+      chip_position = prefetch->position + prefetch->length;
+      file->noteCluster();
+      prefetch_ready = true;
+      return true;
   }
 
-  if(realCnt!=nbyte) { // 读取到的和需要读取的字节不一样，应该是到文件末尾了
-    SERIAL_ECHO("readCnt:");
-    SERIAL_PRINTLN(realCnt,10);    
-    return -1;
+  // Failed or timed out: the block will be read again in the foreground, reporting the error
+  prefetch->owner = NULL;
+  chip_position = CHIP_POSITION_UNKNOWN;
+  return true;
+}
+
+// Before a write, put back the CH376 file pointer if it is not at curPosition_
+bool USBFile::syncForWrite() {
+  const bool moved = chip_file == this && chip_position != curPosition_;
+  if (read_ahead->owner == this || prefetch->owner == this) {
+    usb_async.finish(wait_yield);
+    read_ahead->owner = prefetch->owner = NULL; // The data is about to change
   }
+  return moved ? seekSet(curPosition_) : true;
+}
 
-  curPosition_+=realCnt;
-  
-  return realCnt;
+// 读取一个字节，错误则返回-1
+INT16 USBFile::read() {
+  if (!readAheadAvailable() && !nextReadAhead()) return -1; // Error or end of file
+  return read_ahead->data[curPosition_++ - read_ahead->position];
 }
-#else
-// 读取n个字节，错误则返回-1
-INT16 USBFile::read(void* buf, uint16_t nbyte){
-  UINT8 s;
-  //UINT8 buffer;
-  UINT16 realCnt; // 实际读出来的字节数
 
+// 读取n个字节，错误则返回-1
+INT16 USBFile::read(void* buf, uint16_t nbyte) {
   uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
 
-  /* 将目标文件所在的上级目录的起始簇号设置为当前簇号,相当于打开上级目录 */
-  CH376WriteVar32( VAR_START_CLUSTER, dirStartClust );  
-  char * const p = &name[0];
-  s = CH376FileOpen( p );  /* 打开文件 采用的是多级目录文件名中，最后的文件名部分*/
-  if ( s != USB_INT_SUCCESS ) {
-    SERIAL_ECHOLNPGM("11");
-    mStopIfError(s);    
-    return -1;  
+  // First what is already read ahead
+  UINT16 done = readAheadAvailable();
+  if (done > nbyte) done = nbyte;
+  if (done) {
+    memcpy(dst, &read_ahead->data[curPosition_ - read_ahead->position], done);
+    curPosition_ += done;
   }
+  if (done == nbyte) return nbyte;
 
-  /* 以字节为单位移动当前文件指针到上次复制结束位置 */
-  s = CH376ByteLocate( curPosition_ );  
-  if ( s != USB_INT_SUCCESS ) {    
-    SERIAL_ECHOLNPGM("22");
-    mStopIfError(s);
-    return -1;  
-  }
+  // The rest straight from the CH376 into the destination
+  usb_async.finish(wait_yield);
+  read_ahead->owner = prefetch->owner = NULL;
+  if (!locate()) return -1;
 
-  // 以字节为单位从当前位置读取数据块,返回实际长度在realCnt中 
-  s = CH376ByteRead( dst, nbyte, &realCnt );  			
-  //s = CH376ByteReadOne(&buffer, &realCnt);
+  UINT16 realCnt; // 实际读出来的字节数
+  // 以字节为单位从当前位置读取数据块,返回实际长度在realCnt中
+  const UINT8 s = CH376ByteRead( dst + done, nbyte - done, &realCnt );
   if ( s != USB_INT_SUCCESS ) {
+    chip_position = CHIP_POSITION_UNKNOWN;
     mStopIfError(s);
-    return -1;  
+    return -1;
   }
 
-  if(realCnt!=nbyte) { // 读取到的和需要读取的字节不一样，应该是到文件末尾了
+  chip_position += realCnt;
+  curPosition_ += realCnt;
+  if (realCnt != nbyte - done) { // 读取到的和需要读取的字节不一样，应该是到文件末尾了
     SERIAL_ECHO("readCnt:");
-    SERIAL_PRINTLN(realCnt,10);    
+    SERIAL_PRINTLN(realCnt,10);
     return -1;
   }
 
-  curPosition_+=realCnt;
-  SERIAL_ECHO("pos:");
-  SERIAL_ECHOLN(curPosition_);
-  
-  return realCnt;
+  return nbyte;
 }
-#endif
 
 /**
  * Get a string from a file.
@@ -620,10 +810,12 @@ void USBFile::write(UINT8 *pData) {
     mStopIfError(0);
   }
 
+  if (!syncForWrite()) return;
+
   // 先获取pData指向数据大小
   UINT16 len=0;
   UINT8 *p = pData;
-  while(p!='\0') { len++; p++;}
+  while(*p!='\0') { len++; p++;}
 
   // 以字节为单位向当前位置写入数据块,不知道是否有最大写入字节的限制
   UINT8 s = CH376ByteWrite( pData, len, NULL );  
@@ -631,7 +823,12 @@ void USBFile::write(UINT8 *pData) {
 	  writeError = true;
 	}
   else {
-    curPosition_++; // geo-f:这里是否需要增加当前位置
+    curPosition_ += len;
+    if (chip_file != this) {
+      chip_file = this;
+      chip_base = 0;
+    }
+    chip_position = curPosition_;
     writeError = false;
   }
 }
@@ -645,6 +842,8 @@ int16_t USBFile::write(const void* buf, uint16_t nbyte) {
     mStopIfError(0);
   }
 
+  if (!syncForWrite()) return -1;
+
   // 先获取pData指向数据大小
   //UINT16 len=0;
   //UINT8 *p = pData;
@@ -661,6 +860,11 @@ int16_t USBFile::write(const void* buf, uint16_t nbyte) {
   else {
     writeError = false;
     curPosition_+=nbyte;
+    if (chip_file != this) {
+      chip_file = this;
+      chip_base = 0;
+    }
+    chip_position = curPosition_;
     return nbyte;
   }
 }
@@ -726,6 +930,7 @@ int8_t USBFile::readDir(FAT_DIR_INFO* dir, char* longFilename) {
 bool USBFile::remove(USBFile* dirFile, const char* path) {
   // 将当前目录的上级目录的起始簇号设置为当前簇号,相当于打开上级目录
   // 在同一个目录中的所有文件都保有这 目录其实簇号
+  forgetChipFile();
   CH376WriteVar32( VAR_START_CLUSTER, dirFile->dirStartClust );  
   SERIAL_ECHO("remove: ");
   CH376DebugOut( path );
@@ -29,9 +29,10 @@ public:
   INT16 fgets(char* str, INT16 num, char* delim);
   void write(UINT8 *pData);
   int16_t write(const void* buf, uint16_t nbyte);
-  bool close();
+  bool close(const bool update_size = true);
   int8_t readDir(FAT_DIR_INFO* dir, char* longFilename);
   bool remove(USBFile* dirFile, const char* path);
+  static void poll();
 
 public :
   bool writeError;
@@ -43,6 +44,17 @@ private:
   UINT8 name[8+1+3+1];    /* 文件名,共8+3字节,分隔符,结束符,因为未包含上级目录名所以是相对路径 */
   UINT8 attr;    
   bool is_open; // 标记文件是否打开  
+
+  UINT8 readAheadAvailable() const;
+  bool locate();
+  UINT32 rebaseChip(const UINT32 pos);
+  bool locateChip(const UINT32 pos);
+  void noteCluster();
+  bool fillReadAhead();
+  bool nextReadAhead();
+  void startPrefetch();
+  static bool prefetchStep(void *context, uint8_t status);
+  bool syncForWrite();
 };
 
 #endif
@@ -0,0 +1,252 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * gcode_metadata.h - What the slicer wrote about a G-code file, found before printing it
+ *
+ * Slicers write the estimated time, the filament length, the number of layers
+ * and the temperatures in comments at the start or at the end of the file.
+ * GCodeMetadataScan reads the first HEAD_SIZE and the last TAIL_SIZE bytes of
+ * a file, CHUNK_SIZE bytes at a time so it can run from idle(), and keeps the
+ * values of the keys it knows:
+ *
+ *   Cura          ;TIME:6500  ;Filament used: 12.3456m  ;LAYER_COUNT:120
+ *   PrusaSlicer   ; estimated printing time (normal mode) = 1h 48m 20s
+ *                 ; filament used [mm] = 12345.6  ; total layers count = 120
+ *                 ; first_layer_temperature = 215  ; first_layer_bed_temperature = 60
+ *   Simplify3D    ;   Build time: 1 hours 48 minutes  ;   Filament length: 12345.6 mm
+ *
+ * The first M104/M109 and M140/M190 of the file give the temperatures when the
+ * comments don't. For each value, the first one found is kept.
+ *
+ * GCodeMetadataCache keeps the results of the last files, by short name and
+ * size, so a file printed again is not read again.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _GCODE_METADATA_H_
+#define _GCODE_METADATA_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct GCodeMetadata {
+  uint32_t time;        // Estimated duration of the print (s), 0 if unknown
+  uint32_t filament;    // Length of filament (mm), 0 if unknown
+  uint16_t layers;      // Number of layers, 0 if unknown
+  int16_t hotend, bed;  // Temperatures of the first layer (°C), 0 if unknown
+};
+
+class GCodeMetadataParser {
+  public:
+    static constexpr uint8_t LINE_SIZE = 80;  // Longer lines are truncated
+
+    // Start again, the next bytes being at the start of a line or not
+    void reset(const bool at_line_start=true) { length_ = 0; skip_ = !at_line_start; }
+    void clear() { memset(&metadata_, 0, sizeof(metadata_)); reset(); }
+
+    void feed(const uint8_t *data, uint16_t length) {
+      while (length--) {
+        const char c = (char)*data++;
+        if (c == '\n' || c == '\r') {
+          if (!skip_) parse();
+          reset();
+        }
+        else if (!skip_ && length_ < LINE_SIZE - 1)
+          line_[length_++] = c;
+      }
+    }
+
+    // Parse the last line, if it does not end with a new line
+    void finish() { if (!skip_) parse(); reset(); }
+
+    const GCodeMetadata& metadata() const { return metadata_; }
+    void set(const GCodeMetadata &metadata) { metadata_ = metadata; }
+
+    // Duration like "1d 2h 3m 4s" or "1 hours 48 minutes", in seconds. A number without unit is in seconds.
+    static uint32_t parse_duration(const char *s) {
+      uint32_t total = 0;
+      while (*s) {
+        if (*s < '0' || *s > '9') { ++s; continue; }
+        const uint32_t n = strtoul(s, (char**)&s, 10);
+        while (*s == ' ') ++s;
+        switch (*s) {
+          case 'd': total += n * 86400UL; break;
+          case 'h': total += n * 3600UL; break;
+          case 'm': total += n * 60UL; break;
+          default:  total += n; break;
+        }
+        while (*s && *s != ' ' && (*s < '0' || *s > '9')) ++s;
+      }
+      return total;
+    }
+
+  private:
+    // The value after a key at the start of s, or NULL
+    static const char* after(const char *s, const char *key) {
+      const size_t length = strlen(key);
+      if (strncmp(s, key, length)) return NULL;
+      s += length;
+      while (*s == ' ' || *s == '=' || *s == ':') ++s;
+      return s;
+    }
+
+    template<typename T> static void keep(T &field, const T value) { if (!field && value > 0) field = value; }
+
+    static int16_t temperature(const char *s) { return (int16_t)strtol(s, NULL, 10); }
+
+    // Value of the S parameter of a command, or 0
+    static int16_t s_parameter(const char *s) {
+      const char *p = strstr(s, " S");
+      return p ? temperature(p + 2) : 0;
+    }
+
+    void parse() {
+      line_[length_] = 0;
+      const char *s = line_, *v;
+      while (*s == ' ' || *s == '\t') ++s;
+
+      if (*s != ';') {
+        if (!strncmp(s, "M104 ", 5) || !strncmp(s, "M109 ", 5)) keep(metadata_.hotend, s_parameter(s));
+        else if (!strncmp(s, "M140 ", 5) || !strncmp(s, "M190 ", 5)) keep(metadata_.bed, s_parameter(s));
+        return;
+      }
+
+      do ++s; while (*s == ' ');
+      if ((v = after(s, "TIME:"))) keep(metadata_.time, (uint32_t)strtoul(v, NULL, 10));
+      else if ((v = after(s, "estimated printing time"))) {
+        if ((v = strchr(v, '='))) keep(metadata_.time, parse_duration(v + 1));
+      }
+      else if ((v = after(s, "Build time:"))) keep(metadata_.time, parse_duration(v));
+      else if ((v = after(s, "Filament used:"))) keep(metadata_.filament, (uint32_t)(strtod(v, NULL) * 1000));
+      else if ((v = after(s, "filament used [mm]"))) keep(metadata_.filament, (uint32_t)strtod(v, NULL));
+      else if ((v = after(s, "Filament length:"))) keep(metadata_.filament, (uint32_t)strtod(v, NULL));
+      else if ((v = after(s, "LAYER_COUNT:"))) keep(metadata_.layers, (uint16_t)strtoul(v, NULL, 10));
+      else if ((v = after(s, "total layers count"))) keep(metadata_.layers, (uint16_t)strtoul(v, NULL, 10));
+      else if ((v = after(s, "first_layer_temperature"))) keep(metadata_.hotend, temperature(v));
+      else if ((v = after(s, "first_layer_bed_temperature"))) keep(metadata_.bed, temperature(v));
+    }
+
+    GCodeMetadata metadata_{};
+    char line_[LINE_SIZE];
+    uint8_t length_ = 0;
+    bool skip_ = false;   // In a line started before the part read
+};
+
+class GCodeMetadataScan {
+  public:
+    static constexpr uint16_t HEAD_SIZE = 4096, TAIL_SIZE = 4096;
+    static constexpr uint8_t CHUNK_SIZE = 64;
+
+    void start(const uint32_t size) {
+      parser_.clear();
+      size_ = size;
+      head_end_ = size < HEAD_SIZE ? size : HEAD_SIZE;
+      tail_start_ = size > head_end_ + TAIL_SIZE ? size - TAIL_SIZE : head_end_;
+      position_ = 0;
+      active_ = true;
+    }
+
+    void stop() { parser_.finish(); active_ = false; }
+    bool active() const { return active_; }
+
+    /**
+     * The next chunk of the file to read.
+     * Return its length and set its position, 0 when all has been read.
+     */
+    uint8_t next(uint32_t &position) {
+      if (position_ == head_end_ && tail_start_ > head_end_) {
+        position_ = tail_start_;
+        parser_.reset(false); // The tail starts in the middle of a line
+      }
+      if (position_ >= size_) return 0;
+      position = position_;
+      const uint32_t end = position_ < head_end_ ? head_end_ : size_;
+      return end - position_ < CHUNK_SIZE ? (uint8_t)(end - position_) : CHUNK_SIZE;
+    }
+
+    // The bytes of the chunk read. Return false when the scan is done.
+    bool feed(const uint8_t *data, const uint8_t length) {
+      parser_.feed(data, length);
+      position_ += length;
+      uint32_t position;
+      if (!length || !next(position)) stop();
+      return active_;
+    }
+
+    const GCodeMetadata& metadata() const { return parser_.metadata(); }
+    void set(const GCodeMetadata &metadata) { parser_.set(metadata); } // Known from the cache
+
+  private:
+    GCodeMetadataParser parser_;
+    uint32_t size_ = 0, head_end_ = 0, tail_start_ = 0, position_ = 0;
+    bool active_ = false;
+};
+
+template<uint8_t N>
+class GCodeMetadataCache {
+  public:
+    static constexpr uint8_t NAME_SIZE = 13;  // 8.3 name
+
+    // The metadata of a file, or NULL if it is not known. The entry found becomes the most recent.
+    // Empty files are not kept: a size of 0 is a free entry.
+    const GCodeMetadata* find(const char *name, const uint32_t size) {
+      if (!size) return NULL;
+      for (uint8_t i = 0; i < N; ++i) {
+        if (entries_[i].size != size || strncmp(entries_[i].name, name, NAME_SIZE - 1)) continue;
+        promote(i);
+        return &entries_[0].metadata;
+      }
+      return NULL;
+    }
+
+    // Keep the metadata of a file, in place of the oldest one
+    void store(const char *name, const uint32_t size, const GCodeMetadata &metadata) {
+      if (!size) return;
+      promote(N - 1);
+      Entry &entry = entries_[0];
+      strncpy(entry.name, name, NAME_SIZE - 1);
+      entry.name[NAME_SIZE - 1] = 0;
+      entry.size = size;
+      entry.metadata = metadata;
+    }
+
+  private:
+    struct Entry {
+      char name[NAME_SIZE];
+      uint32_t size;
+      GCodeMetadata metadata;
+    };
+
+    // Move an entry to the front, the most recent first
+    void promote(const uint8_t index) {
+      const Entry entry = entries_[index];
+      memmove(&entries_[1], &entries_[0], index * sizeof(Entry));
+      entries_[0] = entry;
+    }
+
+    Entry entries_[N] = {};
+};
+
+#endif // _GCODE_METADATA_H_
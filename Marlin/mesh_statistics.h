@@ -0,0 +1,146 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * mesh_statistics.h - Tilt, warp and change of a leveling mesh
+ *
+ * Two passes over the mesh: the first fits the tilt plane through the valid
+ * points, the second measures what the plane does not explain (the warp of
+ * the bed plus probe noise) and how far each point moved since the mesh was
+ * last saved.
+ *
+ * The mesh is accessed through MESH, which must provide:
+ *
+ *   uint8_t points_x(), points_y()    - grid size
+ *   float x(i), y(j)                  - position of a grid column / row
+ *   float z(i, j)                     - current Z, NAN if not probed
+ *   float saved(i, j)                 - saved Z, NAN if unknown
+ *
+ * and the plane fit through FIT, which must provide:
+ *
+ *   void reset()
+ *   void add(x, y, z)
+ *   bool finish(float &a, float &b, float &d)   - z = a.x + b.y + d, false if degenerate
+ *
+ * MeshBands puts each point in a band of height, for a heatmap of the mesh on
+ * the LCD: the scale is computed once, then each point costs a multiply.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _MESH_STATISTICS_H_
+#define _MESH_STATISTICS_H_
+
+#include <stdint.h>
+#include <math.h>
+
+struct mesh_statistics_t {
+  float slope_x, slope_y, offset,   // Tilt plane: z = slope_x * x + slope_y * y + offset
+        rms,                        // RMS of the residuals to the plane
+        max_deviation,              // Largest residual, in absolute value
+        max_change;                 // Largest difference with the saved mesh, NAN if not known
+  uint8_t points;                   // Valid points used
+};
+
+/**
+ * Compute the statistics of a mesh. Return false if there are not enough
+ * points for a plane (or they are all aligned).
+ */
+template<typename MESH, typename FIT>
+bool mesh_statistics(const MESH &mesh, FIT &fit, mesh_statistics_t &stats) {
+  const uint8_t nx = mesh.points_x(), ny = mesh.points_y();
+
+  stats.points = 0;
+  fit.reset();
+  for (uint8_t i = 0; i < nx; i++)
+    for (uint8_t j = 0; j < ny; j++) {
+      const float z = mesh.z(i, j);
+      if (isnan(z)) continue;
+      fit.add(mesh.x(i), mesh.y(j), z);
+      stats.points++;
+    }
+
+  if (stats.points < 3 || !fit.finish(stats.slope_x, stats.slope_y, stats.offset)) return false;
+
+  float sum_sq = 0, max_dev = 0, max_change = 0;
+  bool change_known = true;
+  for (uint8_t i = 0; i < nx; i++) {
+    const float px = stats.slope_x * mesh.x(i) + stats.offset;
+    for (uint8_t j = 0; j < ny; j++) {
+      const float z = mesh.z(i, j);
+      if (isnan(z)) continue;
+
+      const float r = z - (px + stats.slope_y * mesh.y(j)), ar = fabs(r);
+      sum_sq += r * r;
+      if (ar > max_dev) max_dev = ar;
+
+      const float s = mesh.saved(i, j);
+      if (isnan(s))
+        change_known = false;             // Not in the saved mesh, or nothing saved
+      else {
+        const float c = fabs(z - s);
+        if (c > max_change) max_change = c;
+      }
+    }
+  }
+
+  stats.rms = sqrt(sum_sq / stats.points);
+  stats.max_deviation = max_dev;
+  stats.max_change = change_known ? max_change : NAN;
+  return true;
+}
+
+/**
+ * Bands of height of the points of a mesh: 0 for the lowest point, BANDS - 1
+ * for the highest, BANDS for the points not probed. A flat mesh is in the
+ * middle band. Add all the points, finish, then ask for their band.
+ */
+template<uint8_t BANDS>
+class MeshBands {
+  public:
+    static const uint8_t NOT_PROBED = BANDS;
+
+    void reset() { low_ = high_ = NAN; scale_ = 0; }
+
+    void add(const float z) {
+      if (isnan(z)) return;
+      if (isnan(low_) || z < low_) low_ = z;
+      if (isnan(high_) || z > high_) high_ = z;
+    }
+
+    void finish() { scale_ = high_ > low_ ? BANDS / (high_ - low_) : 0; }
+
+    uint8_t band(const float z) const {
+      if (isnan(z)) return NOT_PROBED;
+      if (scale_ == 0) return BANDS / 2;
+      const int16_t b = (int16_t)((z - low_) * scale_);
+      return b < 0 ? 0 : b >= BANDS ? BANDS - 1 : (uint8_t)b;
+    }
+
+    float low() const { return low_; }
+    float high() const { return high_; }
+
+  private:
+    float low_ = NAN, high_ = NAN, scale_ = 0;
+};
+
+#endif // _MESH_STATISTICS_H_
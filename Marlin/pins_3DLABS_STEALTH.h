@@ -55,6 +55,9 @@
 #define Z_MIN_PIN          33
 #define Z_MAX_PIN          32
 
+// The limit switches are all on port C, which has no pin change interrupts
+#define ENDSTOP_PORT       PINC
+
 //
 // Filament Runout Sensors
 //
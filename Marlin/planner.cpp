@@ -69,6 +69,10 @@
 #include "language.h"
 #include "parser.h"
 
+#if ENABLED(PRINTCOUNTER)
+  #include "printcounter.h"
+#endif
+
 #include "Marlin.h"
 
 #if ENABLED(MESH_BED_LEVELING)
@@ -81,12 +85,20 @@
   #include "power.h"
 #endif
 
+#if ENABLED(POWER_LOSS_RECOVERY)
+  #include "power_loss_recovery.h"
+#endif
+
 // Delay for delivery of first block to the stepper ISR, if the queue contains 2 or
 // fewer movements. The delay is measured in milliseconds, and must be less than 250ms
 #define BLOCK_DELAY_FOR_1ST_MOVE 100
 
 Planner planner;
 
+#if ENABLED(PRINT_TIME_ESTIMATOR)
+  PrintTimeEstimator print_time_estimator;
+#endif
+
   // public:
 
 /**
@@ -100,6 +112,11 @@ volatile uint8_t Planner::block_buffer_head,    // Index of the next block to be
 uint16_t Planner::cleaning_buffer_counter;      // A counter to disable queuing of blocks
 uint8_t Planner::delay_before_delivering;       // This counter delays delivery of blocks when queue becomes empty to allow the opportunity of merging blocks
 
+#if ENABLED(PRINTCOUNTER)
+  volatile bool Planner::waiting,               // The main loop waits for the queue to empty or for a heater (synchronize, M109, M190)
+                Planner::starved;               // The stepper ran out of blocks during a print while the main loop was not waiting
+#endif
+
 uint32_t Planner::max_acceleration_mm_per_s2[NUM_AXIS_N],    // (mm/s^2) M201 XYZE
          Planner::max_acceleration_steps_per_s2[NUM_AXIS_N], // (steps/s^2) Derived from mm_per_s2
          Planner::min_segment_time_us;                       // (µs) M205 Q
@@ -146,6 +163,14 @@ float Planner::max_feedrate_mm_s[NUM_AXIS_N], // (mm/s) M203 XYZE - Max speeds
 
 int16_t Planner::flow_percentage[EXTRUDERS] = ARRAY_BY_EXTRUDERS1(100); // Extrusion factor for each extruder
 
+#if ENABLED(REALTIME_OVERRIDES)
+  uint8_t Planner::feed_percent = 100;
+  float Planner::feed_limit_sqr = 1.0f;
+  #define FEED_LIMITED(V) ((V) * feed_limit_sqr)
+#else
+  #define FEED_LIMITED(V) (V)
+#endif
+
 float Planner::e_factor[EXTRUDERS] = ARRAY_BY_EXTRUDERS1(1.0f); // The flow percentage and volumetric multiplier combine to scale E movement
 
 #if DISABLED(NO_VOLUMETRICS)
@@ -713,7 +738,7 @@ void Planner::calculate_trapezoid_for_block(block_t* const block, const float &e
     uint32_t cruise_rate = initial_rate;
   #endif
 
-  const int32_t accel = block->acceleration_steps_per_s2;
+  const int32_t accel = FEED_LIMITED(block->acceleration_steps_per_s2);
 
           // Steps required for acceleration, deceleration to/from nominal rate
   uint32_t accelerate_steps = CEIL(estimate_acceleration_distance(initial_rate, block->nominal_rate, accel)),
@@ -762,6 +787,9 @@ void Planner::calculate_trapezoid_for_block(block_t* const block, const float &e
     block->cruise_rate = cruise_rate;
   #endif
   block->final_rate = final_rate;
+  #if ENABLED(REALTIME_OVERRIDES) && DISABLED(S_CURVE_ACCELERATION)
+    block->acceleration_rate = (uint32_t)(accel * (4096.0f * 4096.0f / (STEPPER_TIMER_RATE)));
+  #endif
 }
 
 /*                            PLANNER SPEED DEFINITION
@@ -833,7 +861,7 @@ void Planner::reverse_pass_kernel(block_t* const current, const block_t * const
     // in the next block, there is no need to recheck. Block is cruising and there is no need to
     // compute anything for this block,
     // If not, block entry speed needs to be recalculated to ensure maximum possible planned speed.
-    const float max_entry_speed_sqr = current->max_entry_speed_sqr;
+    const float max_entry_speed_sqr = FEED_LIMITED(current->max_entry_speed_sqr);
 
     // Compute maximum entry speed decelerating over the current block from its exit speed.
     // If not at the maximum entry speed, or the previous block entry speed changed
@@ -849,7 +877,7 @@ void Planner::reverse_pass_kernel(block_t* const current, const block_t * const
 
       const float new_entry_speed_sqr = TEST(current->flag, BLOCK_BIT_NOMINAL_LENGTH)
         ? max_entry_speed_sqr
-        : MIN(max_entry_speed_sqr, max_allowable_speed_sqr(-current->acceleration, next ? next->entry_speed_sqr : sq(float(MINIMUM_PLANNER_SPEED)), current->millimeters));
+        : MIN(max_entry_speed_sqr, max_allowable_speed_sqr(-FEED_LIMITED(current->acceleration), next ? next->entry_speed_sqr : sq(float(MINIMUM_PLANNER_SPEED)), current->millimeters));
       if (current->entry_speed_sqr != new_entry_speed_sqr) {
 
         // Need to recalculate the block speed - Mark it now, so the stepper
@@ -934,7 +962,7 @@ void Planner::forward_pass_kernel(const block_t* const previous, block_t* const
       previous->entry_speed_sqr < current->entry_speed_sqr) {
 
       // Compute the maximum allowable speed
-      const float new_entry_speed_sqr = max_allowable_speed_sqr(-previous->acceleration, previous->entry_speed_sqr, previous->millimeters);
+      const float new_entry_speed_sqr = max_allowable_speed_sqr(-FEED_LIMITED(previous->acceleration), previous->entry_speed_sqr, previous->millimeters);
 
       // If true, current block is full-acceleration and we can move the planned pointer forward.
       if (new_entry_speed_sqr < current->entry_speed_sqr) {
@@ -968,7 +996,7 @@ void Planner::forward_pass_kernel(const block_t* const previous, block_t* const
     // point in the buffer. When the plan is bracketed by either the beginning of the
     // buffer and a maximum entry speed or two maximum entry speeds, every block in between
     // cannot logically be further improved. Hence, we don't have to recompute them anymore.
-    if (current->entry_speed_sqr == current->max_entry_speed_sqr)
+    if (current->entry_speed_sqr == FEED_LIMITED(current->max_entry_speed_sqr))
       block_buffer_planned = block_index;
   }
 }
@@ -1133,6 +1161,109 @@ void Planner::recalculate() {
   recalculate_trapezoids();
 }
 
+#if ENABLED(REALTIME_OVERRIDES)
+
+  /**
+   * Set the nominal speed of a block for the feed override the plan is made for.
+   * Above 100%, it is lowered so that each axis stays within its maximum feedrate
+   * (M203) once the stepper applies the factor. Entry speeds need no more: they
+   * are at most the nominal speeds at 100% and FEED_LIMITED divides them by the factor.
+   */
+  void Planner::limit_feed_override(block_t * const block) {
+    uint32_t rate = block->feed_rate;
+    if (feed_percent > 100) {
+      // Each axis makes steps[i] of the step events, at most max_feedrate * steps_per_mm per second
+      const float factor = (100.0f / feed_percent) * block->step_event_count;
+      float max_rate = rate;
+      LOOP_NUM_AXIS(i) if (block->steps[i]) {
+        uint8_t axis = i;
+        #if ENABLED(DISTINCT_E_FACTORS)
+          if (i == E_AXIS) axis += block->active_extruder;
+        #endif
+        NOMORE(max_rate, max_feedrate_mm_s[axis] * axis_steps_per_mm[axis] * factor / block->steps[i]);
+      }
+      rate = MAX(max_rate, 1.0f);
+    }
+    if (rate != block->nominal_rate) {
+      block->nominal_rate = rate;
+      block->nominal_speed_sqr = sq(rate * block->millimeters / block->step_event_count);
+    }
+    block->feed_limit = stepper.feed_override.limit(feed_percent);
+  }
+
+  /**
+   * Plan the blocks not busy again for a feed override. The first one keeps its
+   * entry speed (the exit speed of the busy block), so the re-plan is bounded:
+   * only its exit and the blocks after it can change.
+   */
+  void Planner::replan_feed_override(const uint8_t percent) {
+    feed_percent = percent;
+    feed_limit_sqr = percent > 100 ? sq(100.0f / percent) : 1.0f;
+
+    // The ISR moves the planned pointer too
+    const bool was_enabled = STEPPER_ISR_ENABLED();
+    if (was_enabled) DISABLE_STEPPER_DRIVER_INTERRUPT();
+    uint8_t block_index = block_buffer_planned = block_buffer_nonbusy;
+    if (was_enabled) ENABLE_STEPPER_DRIVER_INTERRUPT();
+
+    const uint8_t head_block_index = block_buffer_head;
+    while (block_index != head_block_index) {
+      block_t * const block = &block_buffer[block_index];
+      if (!TEST(block->flag, BLOCK_BIT_SYNC_POSITION)) {
+        // Same race as in the reverse pass: the block may have become busy
+        SBI(block->flag, BLOCK_BIT_RECALCULATE);
+        if (stepper.is_block_busy(block))
+          CBI(block->flag, BLOCK_BIT_RECALCULATE);
+        else {
+          limit_feed_override(block);
+          // Can the block still reach its nominal speed from a stop with the limited acceleration?
+          const float v_allowable_sqr = max_allowable_speed_sqr(-FEED_LIMITED(block->acceleration), sq(float(MINIMUM_PLANNER_SPEED)), block->millimeters);
+          if (block->nominal_speed_sqr <= v_allowable_sqr)
+            SBI(block->flag, BLOCK_BIT_NOMINAL_LENGTH);
+          else
+            CBI(block->flag, BLOCK_BIT_NOMINAL_LENGTH);
+        }
+      }
+      block_index = next_block_index(block_index);
+    }
+
+    recalculate();
+  }
+
+  void Planner::update_feed_override() {
+    static uint8_t target = 100; // The feed override last given to or taken from the stepper
+
+    if (feedrate_percentage != target) {
+      // Set by M220 or the LCD. The serial RX ISR changes it too (real-time bytes).
+      target = constrain(feedrate_percentage, REALTIME_FEED_MIN, REALTIME_FEED_MAX);
+      CRITICAL_SECTION_START;
+      stepper.feed_override.set_feed(target);
+      CRITICAL_SECTION_END;
+    }
+    else
+      target = stepper.feed_override.feed_percent(); // Set by a real-time byte
+    feedrate_percentage = target;
+
+    // Below 100%, the plan for 100% is kept
+    const uint8_t percent = MAX(target, 100);
+    if (percent == feed_percent) return;
+
+    if (percent > feed_percent) {
+      // Going faster, the stepper only applies it to the blocks planned for it (block_t::feed_limit)
+      replan_feed_override(percent);
+    }
+    else {
+      // Going slower, the limits are raised once the stepper has slowed down
+      CRITICAL_SECTION_START;
+      const uint16_t scale = stepper.feed_override.scale();
+      CRITICAL_SECTION_END;
+      if (scale <= uint16_t(stepper.feed_override.limit(percent)) << 1)
+        replan_feed_override(percent);
+    }
+  }
+
+#endif // REALTIME_OVERRIDES
+
 #if ENABLED(AUTOTEMP)
 
   void Planner::getHighESpeed() {
@@ -1536,7 +1667,15 @@ float Planner::get_axis_position_mm(const AxisEnum axis) {
 /**
  * Block until all buffered steps are executed / cleaned
  */
-void Planner::synchronize() { while (has_blocks_queued() || cleaning_buffer_counter) idle(); }
+void Planner::synchronize() {
+  #if ENABLED(PRINTCOUNTER)
+    waiting = true; // The queue running empty now is not a starvation
+  #endif
+  while (has_blocks_queued() || cleaning_buffer_counter) idle();
+  #if ENABLED(PRINTCOUNTER)
+    waiting = false;
+  #endif
+}
 
 #if ENABLED(UNREGISTERED_MOVE_SUPPORT)
   #define COUNT_MOVE count_it
@@ -1603,6 +1742,13 @@ bool Planner::_buffer_steps(const int32_t (&target)[NUM_AXIS]
   // Move buffer head
   block_buffer_head = next_buffer_head;
 
+  #if ENABLED(PRINTCOUNTER)
+    // Count the move, and whether the stepper ran out of blocks before it
+    const bool was_starved = starved;
+    starved = false;
+    print_job_timer.incMoves(was_starved);
+  #endif
+
   // Recalculate and optimize trapezoidal speed profiles
   recalculate();
 
@@ -1734,6 +1880,10 @@ bool Planner::_populate_block(block_t * const block, bool split_move,
     block->count_it = count_it;
   #endif
 
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    block->recovery_line = job_recovery_lines.tag();
+  #endif
+
   // Number of steps for each axis
   // See http://www.corexy.com/theory.html
   #if CORE_IS_XY
@@ -2126,6 +2276,14 @@ bool Planner::_populate_block(block_t * const block, bool split_move,
     block->nominal_speed_sqr = block->nominal_speed_sqr * sq(speed_factor);
   }
 
+  #if ENABLED(REALTIME_OVERRIDES)
+    block->feed_rate = block->nominal_rate;
+  #endif
+
+  #if ENABLED(PRINT_TIME_ESTIMATOR)
+    print_time_estimator.add_move(float(block->step_event_count) / block->nominal_rate);
+  #endif
+
   // Compute and limit the acceleration rate for the trapezoid generator.
   const float steps_per_mm = block->step_event_count * inverse_millimeters;
   uint32_t accel;
@@ -2237,6 +2395,10 @@ bool Planner::_populate_block(block_t * const block, bool split_move,
   }
   block->acceleration_steps_per_s2 = accel;
   block->acceleration = accel / steps_per_mm;
+  #if ENABLED(REALTIME_OVERRIDES)
+    // A feed hold or an override change is a speed change at this acceleration
+    block->override_ramp = stepper.feed_override.ramp_ticks(block->nominal_rate, accel);
+  #endif
   #if DISABLED(S_CURVE_ACCELERATION)
     block->acceleration_rate = (uint32_t)(accel * (4096.0f * 4096.0f / (STEPPER_TIMER_RATE)));
   #endif
@@ -2438,12 +2600,18 @@ bool Planner::_populate_block(block_t * const block, bool split_move,
   // Max entry speed of this block equals the max exit speed of the previous block.
   block->max_entry_speed_sqr = vmax_junction_sqr;
 
+  #if ENABLED(REALTIME_OVERRIDES)
+    // Junctions are planned at 100% (FEED_LIMITED), the nominal speed at the feed override
+    const float feed_nominal_speed_sqr = block->nominal_speed_sqr;
+    limit_feed_override(block);
+  #endif
+
   // Initialize block entry speed. Compute based on deceleration to user-defined MINIMUM_PLANNER_SPEED.
-  const float v_allowable_sqr = max_allowable_speed_sqr(-block->acceleration, sq(float(MINIMUM_PLANNER_SPEED)), block->millimeters);
+  const float v_allowable_sqr = max_allowable_speed_sqr(-FEED_LIMITED(block->acceleration), sq(float(MINIMUM_PLANNER_SPEED)), block->millimeters);
 
   // If we are trying to add a split block, start with the
   // max. allowed speed to avoid an interrupted first move.
-  block->entry_speed_sqr = !split_move ? sq(float(MINIMUM_PLANNER_SPEED)) : MIN(vmax_junction_sqr, v_allowable_sqr);
+  block->entry_speed_sqr = !split_move ? sq(float(MINIMUM_PLANNER_SPEED)) : MIN(FEED_LIMITED(vmax_junction_sqr), v_allowable_sqr);
 
   // Initialize planner efficiency flags
   // Set flag if block will always reach maximum junction speed regardless of entry/exit speeds.
@@ -2457,7 +2625,13 @@ bool Planner::_populate_block(block_t * const block, bool split_move,
 
   // Update previous path unit_vector and nominal speed
   COPY(previous_speed, current_speed);
-  previous_nominal_speed_sqr = block->nominal_speed_sqr;
+  previous_nominal_speed_sqr =
+    #if ENABLED(REALTIME_OVERRIDES)
+      feed_nominal_speed_sqr
+    #else
+      block->nominal_speed_sqr
+    #endif
+  ;
 
   // Update the position (only when a move was queued)
   static_assert(COUNT(target) > 1, "Parameter to _populate_block must be (&target)["
@@ -2494,6 +2668,10 @@ void Planner::buffer_sync_block() {
 
   block->flag = BLOCK_FLAG_SYNC_POSITION;
 
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    block->recovery_line = job_recovery_lines.tag();
+  #endif
+
   block->position[A_AXIS] = position[A_AXIS];
   block->position[B_AXIS] = position[B_AXIS];
   block->position[C_AXIS] = position[C_AXIS];
@@ -102,6 +102,10 @@ typedef struct {
 
   uint8_t active_extruder;                  // The extruder to move (if E move)
 
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    uint8_t recovery_line;                  // Entry of the file line that queued this block (see power_loss_recovery_lines.h)
+  #endif
+
   #if ENABLED(MIXING_EXTRUDER)
     uint32_t mix_steps[MIXING_STEPPERS];    // Scaled steps[E_AXIS] for the mixing steppers
   #endif
@@ -136,6 +140,12 @@ typedef struct {
            final_rate,                      // The minimal rate at exit
            acceleration_steps_per_s2;       // acceleration steps/sec^2
 
+  #if ENABLED(REALTIME_OVERRIDES)
+    uint32_t feed_rate;                     // The nominal rate at 100%, nominal_rate being lowered above
+    uint16_t override_ramp;                 // STEP timer counts between two changes of the feed override factor
+    uint8_t feed_limit;                     // Highest feed override factor the block is planned for (FeedOverride::limit)
+  #endif
+
   #if FAN_COUNT > 0
     uint16_t fan_speed[FAN_COUNT];
   #endif
@@ -176,6 +186,11 @@ class Planner {
     static uint16_t cleaning_buffer_counter;        // A counter to disable queuing of blocks
     static uint8_t delay_before_delivering;         // This counter delays delivery of blocks when queue becomes empty to allow the opportunity of merging blocks
 
+    #if ENABLED(PRINTCOUNTER)
+      static volatile bool waiting,                 // The main loop waits for the queue to empty or for a heater (synchronize, M109, M190)
+                           starved;                 // The stepper ran out of blocks during a print while the main loop was not waiting
+    #endif
+
 
     #if ENABLED(DISTINCT_E_FACTORS)
       static uint8_t last_extruder;                 // Respond to extruder change
@@ -183,6 +198,12 @@ class Planner {
 
     static int16_t flow_percentage[EXTRUDERS];      // Extrusion factor for each extruder
 
+    #if ENABLED(REALTIME_OVERRIDES)
+      static uint8_t feed_percent;                  // Feed override (applied by the stepper) the plan is made for
+      static float feed_limit_sqr;                  // Above 100%, junction speeds and accelerations are planned lower by its square,
+                                                    // nominal speeds so that each axis stays within its maximum feedrate
+    #endif
+
     static float e_factor[EXTRUDERS];               // The flow percentage and volumetric multiplier combine to scale E movement
 
     #if DISABLED(NO_VOLUMETRICS)
@@ -334,6 +355,17 @@ class Planner {
     static void reset_acceleration_rates();
     static void refresh_positioning();
 
+    #if ENABLED(REALTIME_OVERRIDES)
+      /**
+       * Follow the feed override: feedrate_percentage (M220, LCD) is given to the
+       * stepper, a real-time change is given back to feedrate_percentage. Above
+       * 100%, the blocks not busy are planned again to stay within limits: at once
+       * going faster (the stepper waits for them), once the stepper has slowed
+       * down going slower.
+       */
+      static void update_feed_override();
+    #endif
+
     FORCE_INLINE static void refresh_e_factor(const uint8_t e) {
       e_factor[e] = (flow_percentage[e] * 0.01f
         #if DISABLED(NO_VOLUMETRICS)
@@ -878,6 +910,11 @@ class Planner {
     static void reverse_pass();
     static void forward_pass();
 
+    #if ENABLED(REALTIME_OVERRIDES)
+      static void limit_feed_override(block_t * const block);
+      static void replan_feed_override(const uint8_t percent);
+    #endif
+
     static void recalculate_trapezoids();
 
     static void recalculate();
@@ -905,4 +942,9 @@ class Planner {
 
 extern Planner planner;
 
+#if ENABLED(PRINT_TIME_ESTIMATOR)
+  #include "print_time_estimator.h"
+  extern PrintTimeEstimator print_time_estimator;
+#endif
+
 #endif // PLANNER_H
@@ -45,66 +45,68 @@
 job_recovery_info_t job_recovery_info;
 JobRecoveryPhase job_recovery_phase = JOB_RECOVERY_IDLE;
 uint8_t job_recovery_commands_count; //=0
-char job_recovery_commands[BUFSIZE + APPEND_CMD_COUNT][MAX_CMD_SIZE];
+job_recovery_lines_t job_recovery_lines;
+char job_recovery_commands[JOB_RECOVERY_CMD_COUNT][MAX_CMD_SIZE];
 // Extern
 extern uint8_t active_extruder, commands_in_queue, cmd_queue_index_r;
+extern uint32_t command_queue_sdpos[BUFSIZE];
+
+static_assert(sizeof(job_recovery_cold_t) <= JOB_RECOVERY_SECTOR_SIZE, "job_recovery_cold_t must fit in one sector.");
+static_assert(sizeof(job_recovery_hot_t) <= JOB_RECOVERY_SECTOR_SIZE, "job_recovery_hot_t must fit in one sector.");
 
 #if ENABLED(DEBUG_POWER_LOSS_RECOVERY)
   void debug_print_job_recovery(const bool recovery) {
+    const job_recovery_cold_t &cold = job_recovery_info.cold;
+    const job_recovery_hot_t &hot = job_recovery_info.hot;
     SERIAL_PROTOCOLLNPGM("---- Job Recovery Info ----");
-    SERIAL_PROTOCOLPAIR("valid_head:", int(job_recovery_info.valid_head));
-    SERIAL_PROTOCOLLNPAIR(" valid_foot:", int(job_recovery_info.valid_foot));
-    if (job_recovery_info.valid_head) {
-      if (job_recovery_info.valid_head == job_recovery_info.valid_foot) {
-        SERIAL_PROTOCOLPGM("current_position: ");
-        LOOP_XYZE(i) {
-          SERIAL_PROTOCOL(job_recovery_info.current_position[i]);
-          if (i < E_AXIS) SERIAL_CHAR(',');
-        }
-        SERIAL_EOL();
-        SERIAL_PROTOCOLLNPAIR("feedrate: ", job_recovery_info.feedrate);
+    SERIAL_PROTOCOLPAIR("sequence:", hot.sequence);
+    SERIAL_PROTOCOLPAIR(" slot:", int(job_recovery_slot(hot.sequence)));
+    SERIAL_PROTOCOLLNPAIR(" cold slot:", int(job_recovery_info.cold_slot));
+    if (job_recovery_valid(cold) && job_recovery_valid(hot)) {
+      SERIAL_PROTOCOLPGM("current_position: ");
+      LOOP_XYZE(i) {
+        SERIAL_PROTOCOL(hot.current_position[i]);
+        if (i < E_AXIS) SERIAL_CHAR(',');
+      }
+      SERIAL_EOL();
+      SERIAL_PROTOCOLLNPAIR("feedrate: ", hot.feedrate);
 
-        #if HOTENDS > 1
-          SERIAL_PROTOCOLLNPAIR("active_hotend: ", int(job_recovery_info.active_hotend));
-        #endif
+      #if HOTENDS > 1
+        SERIAL_PROTOCOLLNPAIR("active_hotend: ", int(cold.active_hotend));
+      #endif
 
-        SERIAL_PROTOCOLPGM("target_temperature: ");
-        HOTEND_LOOP() {
-          SERIAL_PROTOCOL(job_recovery_info.target_temperature[e]);
-          if (e < HOTENDS - 1) SERIAL_CHAR(',');
-        }
-        SERIAL_EOL();
+      SERIAL_PROTOCOLPGM("target_temperature: ");
+      HOTEND_LOOP() {
+        SERIAL_PROTOCOL(hot.target_temperature[e]);
+        if (e < HOTENDS - 1) SERIAL_CHAR(',');
+      }
+      SERIAL_EOL();
 
-        #if HAS_HEATED_BED
-          SERIAL_PROTOCOLLNPAIR("target_temperature_bed: ", job_recovery_info.target_temperature_bed);
-        #endif
+      #if HAS_HEATED_BED
+        SERIAL_PROTOCOLLNPAIR("target_temperature_bed: ", hot.target_temperature_bed);
+      #endif
 
-        #if FAN_COUNT
-          SERIAL_PROTOCOLPGM("fanSpeeds: ");
-          for (int8_t i = 0; i < FAN_COUNT; i++) {
-            SERIAL_PROTOCOL(job_recovery_info.fanSpeeds[i]);
-            if (i < FAN_COUNT - 1) SERIAL_CHAR(',');
-          }
-          SERIAL_EOL();
-        #endif
+      #if FAN_COUNT
+        SERIAL_PROTOCOLPGM("fanSpeeds: ");
+        for (int8_t i = 0; i < FAN_COUNT; i++) {
+          SERIAL_PROTOCOL(hot.fanSpeeds[i]);
+          if (i < FAN_COUNT - 1) SERIAL_CHAR(',');
+        }
+        SERIAL_EOL();
+      #endif
 
-        #if HAS_LEVELING
-          SERIAL_PROTOCOLPAIR("leveling: ", int(job_recovery_info.leveling));
-          SERIAL_PROTOCOLLNPAIR(" fade: ", int(job_recovery_info.fade));
-        #endif
-        SERIAL_PROTOCOLLNPAIR("cmd_queue_index_r: ", int(job_recovery_info.cmd_queue_index_r));
-        SERIAL_PROTOCOLLNPAIR("commands_in_queue: ", int(job_recovery_info.commands_in_queue));
-        if (recovery)
-          for (uint8_t i = 0; i < job_recovery_commands_count; i++) SERIAL_PROTOCOLLNPAIR("> ", job_recovery_commands[i]);
-        else
-          for (uint8_t i = 0; i < job_recovery_info.commands_in_queue; i++) SERIAL_PROTOCOLLNPAIR("> ", job_recovery_info.command_queue[i]);
-        SERIAL_PROTOCOLLNPAIR("sd_filename: ", job_recovery_info.sd_filename);
-        SERIAL_PROTOCOLLNPAIR("sdpos: ", job_recovery_info.sdpos);
-        SERIAL_PROTOCOLLNPAIR("print_job_elapsed: ", job_recovery_info.print_job_elapsed);
-      }
-      else
-        SERIAL_PROTOCOLLNPGM("INVALID DATA");
+      #if HAS_LEVELING
+        SERIAL_PROTOCOLPAIR("leveling: ", int(cold.leveling));
+        SERIAL_PROTOCOLLNPAIR(" fade: ", int(cold.fade));
+      #endif
+      if (recovery)
+        for (uint8_t i = 0; i < job_recovery_commands_count; i++) SERIAL_PROTOCOLLNPAIR("> ", job_recovery_commands[i]);
+      SERIAL_PROTOCOLLNPAIR("sd_filename: ", cold.sd_filename);
+      SERIAL_PROTOCOLLNPAIR("sdpos: ", hot.sdpos);
+      SERIAL_PROTOCOLLNPAIR("print_job_elapsed: ", hot.print_job_elapsed);
     }
+    else
+      SERIAL_PROTOCOLLNPGM("INVALID DATA");
     SERIAL_PROTOCOLLNPGM("---------------------------");
   }
 #endif // DEBUG_POWER_LOSS_RECOVERY
@@ -124,16 +126,18 @@ void check_print_job_recovery() {
   if (card.cardOK) {
 
     #if ENABLED(DEBUG_POWER_LOSS_RECOVERY)
-      SERIAL_PROTOCOLLNPAIR("Init job recovery info. Size: ", int(sizeof(job_recovery_info)));
+      SERIAL_PROTOCOLPAIR("Init job recovery info. Cold: ", int(sizeof(job_recovery_cold_t)));
+      SERIAL_PROTOCOLLNPAIR(" Hot: ", int(sizeof(job_recovery_hot_t)));
     #endif
 
     if (card.jobRecoverFileExists()) {
       card.openJobRecoveryFile(true);
-      card.loadJobRecoveryInfo();
+      const bool valid = card.loadJobRecoveryInfo();
       card.closeJobRecoveryFile();
-      //card.removeJobRecoveryFile();
 
-      if (job_recovery_info.valid_head && job_recovery_info.valid_head == job_recovery_info.valid_foot) {
+      if (valid) {
+        const job_recovery_cold_t &cold = job_recovery_info.cold;
+        const job_recovery_hot_t &hot = job_recovery_info.hot;
 
         uint8_t ind = 0;
 
@@ -154,16 +158,16 @@ void check_print_job_recovery() {
         char str_1[16], str_2[16];
 
         #if HAS_LEVELING
-          if (job_recovery_info.fade || job_recovery_info.leveling) {
+          if (cold.fade || cold.leveling) {
             // Restore leveling state before G92 sets Z
             // This ensures the steppers correspond to the native Z
-            dtostrf(job_recovery_info.fade, 1, 1, str_1);
-            sprintf_P(job_recovery_commands[ind++], PSTR("M420 S%i Z%s"), int(job_recovery_info.leveling), str_1);
+            dtostrf(cold.fade, 1, 1, str_1);
+            sprintf_P(job_recovery_commands[ind++], PSTR("M420 S%i Z%s"), int(cold.leveling), str_1);
           }
         #endif
 
-        dtostrf(job_recovery_info.current_position[Z_AXIS] + 2, 1, 3, str_1);
-        dtostrf(job_recovery_info.current_position[E_CART]
+        dtostrf(hot.current_position[Z_AXIS] + 2, 1, 3, str_1);
+        dtostrf(hot.current_position[E_CART]
           #if ENABLED(SAVE_EACH_CMD_MODE)
             - 5
           #endif
@@ -171,15 +175,17 @@ void check_print_job_recovery() {
         );
         sprintf_P(job_recovery_commands[ind++], PSTR("G92.0 Z%s E%s"), str_1, str_2); // Current Z + 2 and E
 
-        uint8_t r = job_recovery_info.cmd_queue_index_r, c = job_recovery_info.commands_in_queue;
-        while (c--) {
-          strcpy(job_recovery_commands[ind++], job_recovery_info.command_queue[r]);
-          r = (r + 1) % BUFSIZE;
-        }
+        // Go where the line to resume starts, XY first then down to Z
+        dtostrf(hot.current_position[X_AXIS], 1, 3, str_1);
+        dtostrf(hot.current_position[Y_AXIS], 1, 3, str_2);
+        sprintf_P(job_recovery_commands[ind++], PSTR("G0 X%s Y%s"), str_1, str_2);
+        dtostrf(hot.current_position[Z_AXIS], 1, 3, str_1);
+        dtostrf(MMS_TO_MMM(hot.feedrate), 1, 0, str_2);
+        sprintf_P(job_recovery_commands[ind++], PSTR("G1 Z%s F%s"), str_1, str_2);     // Feedrate of the line
 
-        if (job_recovery_info.sd_filename[0] == '/') job_recovery_info.sd_filename[0] = ' ';
-        sprintf_P(job_recovery_commands[ind++], PSTR("M23 %s"), job_recovery_info.sd_filename);
-        sprintf_P(job_recovery_commands[ind++], PSTR("M24 S%ld T%ld"), job_recovery_info.sdpos, job_recovery_info.print_job_elapsed);
+        // Nothing from the planner or the command queue is saved, the file is resumed from the line that did not complete
+        sprintf_P(job_recovery_commands[ind++], PSTR("M23 %s"), cold.sd_filename[0] == '/' ? &cold.sd_filename[1] : cold.sd_filename);
+        sprintf_P(job_recovery_commands[ind++], PSTR("M24 S%ld T%ld"), hot.sdpos, hot.print_job_elapsed);
 
         job_recovery_commands_count = ind;
 
@@ -188,18 +194,51 @@ void check_print_job_recovery() {
         #endif
       }
       else {
-        if (job_recovery_info.valid_head != job_recovery_info.valid_foot)
-          LCD_ALERTMESSAGEPGM("INVALID DATA");
+        LCD_ALERTMESSAGEPGM("INVALID DATA");
         memset(&job_recovery_info, 0, sizeof(job_recovery_info));
       }
     }
   }
 }
 
+/**
+ * Where the job has to resume: the line of the oldest block still in the
+ * planner, as recorded by job_recovery_lines. With an empty planner, the
+ * first SD line still waiting in the command queue, or the current read
+ * position if there is none.
+ * Called right after the command at cmd_queue_index_r has been executed.
+ */
+static uint32_t job_recovery_resume_position(float (&position)[XYZE], float &feedrate) {
+  if (planner.has_blocks_queued()) {
+    const uint8_t tag = planner.block_buffer[planner.block_buffer_tail].recovery_line;
+    COPY(position, job_recovery_lines.position(tag));
+    feedrate = job_recovery_lines.feedrate(tag);
+    return job_recovery_lines.sdpos(tag);
+  }
+
+  COPY(position, current_position);
+  feedrate = feedrate_mm_s;
+  uint8_t r = cmd_queue_index_r, c = commands_in_queue;
+  while (c > 1) {
+    if (++r >= BUFSIZE) r = 0;
+    --c;
+    if (command_queue_sdpos[r] != JOB_RECOVERY_NO_SDPOS) return command_queue_sdpos[r];
+  }
+  return card.getIndex();
+}
+
 /**
  * Save the current machine state to the power-loss recovery file
+ *
+ * Only the hot record is written, into the next slot of the ring. The cold
+ * record is written when it changes, which in practice is once per job, into
+ * the cold slot not holding the previous one.
  */
 void save_job_recovery_info() {
+  job_recovery_cold_t &cold = job_recovery_info.cold;
+  job_recovery_hot_t &hot = job_recovery_info.hot;
+  static float saved_z; // = 0  // Planned Z at the last save, the saved position lags behind
+
   #if SAVE_INFO_INTERVAL_MS > 0
     static millis_t next_save_ms; // = 0;  // Init on reset
     millis_t ms = millis();
@@ -218,38 +257,25 @@ void save_job_recovery_info() {
         ELAPSED(ms, next_save_ms) ||
       #endif
       // Save on every new Z height
-      (current_position[Z_AXIS] > 0 && current_position[Z_AXIS] > job_recovery_info.current_position[Z_AXIS])
+      (current_position[Z_AXIS] > 0 && (current_position[Z_AXIS] > saved_z || !hot.sequence))
     #endif
   ) {
     #if SAVE_INFO_INTERVAL_MS > 0
       next_save_ms = ms + SAVE_INFO_INTERVAL_MS;
     #endif
+    saved_z = current_position[Z_AXIS];
 
-    // Head and foot will match if valid data was saved
-    if (!++job_recovery_info.valid_head) ++job_recovery_info.valid_head; // non-zero in sequence
-    job_recovery_info.valid_foot = job_recovery_info.valid_head;
-
-    // Machine state
-    COPY(job_recovery_info.current_position, current_position);
-    job_recovery_info.feedrate = feedrate_mm_s;
+    // The first save of a job creates the file with all its slots
+    if (!hot.sequence && !card.prepareJobRecoveryFile()) return;
 
+    // Cold record: the CRC no longer matches if anything changed since the last write
     #if HOTENDS > 1
-      job_recovery_info.active_hotend = active_extruder;
-    #endif
-
-    COPY(job_recovery_info.target_temperature, thermalManager.target_temperature);
-
-    #if HAS_HEATED_BED
-      job_recovery_info.target_temperature_bed = thermalManager.target_temperature_bed;
-    #endif
-
-    #if FAN_COUNT
-      COPY(job_recovery_info.fanSpeeds, fanSpeeds);
+      cold.active_hotend = active_extruder;
     #endif
 
     #if HAS_LEVELING
-      job_recovery_info.leveling = planner.leveling_active;
-      job_recovery_info.fade = (
+      cold.leveling = planner.leveling_active;
+      cold.fade = (
         #if ENABLED(ENABLE_LEVELING_FADE_HEIGHT)
           planner.z_fade_height
         #else
@@ -258,25 +284,39 @@ void save_job_recovery_info() {
       );
     #endif
 
-    // Commands in the queue
-    job_recovery_info.cmd_queue_index_r = cmd_queue_index_r;
-    job_recovery_info.commands_in_queue = commands_in_queue;
-    COPY(job_recovery_info.command_queue, command_queue);
+    card.getAbsFilename(cold.sd_filename);
+
+    const bool save_cold = !job_recovery_valid(cold);
+
+    // Machine state, where the line to resume starts
+    hot.sdpos = job_recovery_resume_position(hot.current_position, hot.feedrate);
+
+    COPY(hot.target_temperature, thermalManager.target_temperature);
+
+    #if HAS_HEATED_BED
+      hot.target_temperature_bed = thermalManager.target_temperature_bed;
+    #endif
+
+    #if FAN_COUNT
+      COPY(hot.fanSpeeds, fanSpeeds);
+    #endif
 
     // Elapsed print job time
-    job_recovery_info.print_job_elapsed = print_job_timer.duration();
+    hot.print_job_elapsed = print_job_timer.duration();
 
-    // SD file position
-    card.getAbsFilename(job_recovery_info.sd_filename);
-    job_recovery_info.sdpos = card.getIndex();
+    job_recovery_seal(hot, hot.sequence + 1);
+    if (save_cold) {
+      // Keep the previous cold record until the new one is complete
+      job_recovery_info.cold_slot ^= 1;
+      job_recovery_seal(cold, hot.sequence);
+    }
 
     #if ENABLED(DEBUG_POWER_LOSS_RECOVERY)
       SERIAL_PROTOCOLLNPGM("Saving...");
       debug_print_job_recovery(false);
     #endif
 
-    card.openJobRecoveryFile(false);
-    (void)card.saveJobRecoveryInfo();
+    (void)card.saveJobRecoveryInfo(save_cold);
 
     // If power-loss pin was triggered, write just once then kill
     #if PIN_EXISTS(POWER_LOSS)
@@ -34,21 +34,43 @@
 #endif
 #include "types.h"
 #include "MarlinConfig.h"
+#include "power_loss_recovery_slots.h"
+#include "power_loss_recovery_lines.h"
 
 #define SAVE_INFO_INTERVAL_MS 0
 //#define SAVE_EACH_CMD_MODE
 //#define DEBUG_POWER_LOSS_RECOVERY
 
+/**
+ * Rarely changing part of the snapshot, kept in one of the two cold slots of the recovery file
+ */
 typedef struct {
-  uint8_t valid_head;
-
-  // Machine state
-  float current_position[NUM_AXIS], feedrate;
+  uint32_t sequence;
+  uint16_t crc;
 
   #if HOTENDS > 1
     uint8_t active_hotend;
   #endif
 
+  #if HAS_LEVELING
+    bool leveling;
+    float fade;
+  #endif
+
+  // SD Filename
+  char sd_filename[MAXPATHNAMELENGTH];
+} job_recovery_cold_t;
+
+/**
+ * Part of the snapshot that changes on every save, one ring slot per save
+ */
+typedef struct {
+  uint32_t sequence;
+  uint16_t crc;
+
+  // Machine state, at the start of the line at sdpos
+  float current_position[NUM_AXIS], feedrate;
+
   int16_t target_temperature[HOTENDS];
 
   #if HAS_HEATED_BED
@@ -59,23 +81,17 @@ typedef struct {
     int16_t fanSpeeds[FAN_COUNT];
   #endif
 
-  #if HAS_LEVELING
-    bool leveling;
-    float fade;
-  #endif
-
-  // Command queue
-  uint8_t cmd_queue_index_r, commands_in_queue;
-  char command_queue[BUFSIZE][MAX_CMD_SIZE];
-
-  // SD Filename and position
-  char sd_filename[MAXPATHNAMELENGTH];
+  // File offset of the first line not completed, and where it starts
   uint32_t sdpos;
 
   // Job elapsed time
   millis_t print_job_elapsed;
+} job_recovery_hot_t;
 
-  uint8_t valid_foot;
+typedef struct {
+  job_recovery_cold_t cold;
+  job_recovery_hot_t hot;
+  uint8_t cold_slot;  // Cold slot of 'cold' in the file, a new cold record goes to the other one
 } job_recovery_info_t;
 
 extern job_recovery_info_t job_recovery_info;
@@ -88,13 +104,18 @@ enum JobRecoveryPhase : unsigned char {
 };
 extern JobRecoveryPhase job_recovery_phase;
 
+#define JOB_RECOVERY_NO_SDPOS 0xFFFFFFFFUL
+
 #if HAS_LEVELING
-  #define APPEND_CMD_COUNT 9
+  #define JOB_RECOVERY_CMD_COUNT 10
 #else
-  #define APPEND_CMD_COUNT 7
+  #define JOB_RECOVERY_CMD_COUNT 8
 #endif
 
-extern char job_recovery_commands[BUFSIZE + APPEND_CMD_COUNT][MAX_CMD_SIZE];
+typedef JobRecoveryLineIndex<BLOCK_BUFFER_SIZE, XYZE> job_recovery_lines_t;
+extern job_recovery_lines_t job_recovery_lines;
+
+extern char job_recovery_commands[JOB_RECOVERY_CMD_COUNT][MAX_CMD_SIZE];
 extern uint8_t job_recovery_commands_count;
 
 void check_print_job_recovery();
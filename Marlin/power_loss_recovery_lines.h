@@ -0,0 +1,93 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * power_loss_recovery_lines.h - File lines of the blocks in the planner
+ *
+ * Each line of the printed file calls begin() before it runs. The first block
+ * it queues creates its entry: file offset, start position and feedrate. Every
+ * block carries the tag of the last entry, so blocks queued by commands from
+ * other sources belong to the last line begun.
+ *
+ * job_recovery_resume_position() takes the entry of the block at the planner
+ * tail: the job resumes from the start of that line, and the lines after it
+ * are replayed, those queuing no block (M104, M106...) included. With an empty
+ * planner, it resumes from the next file line in the command queue instead, or
+ * from the read position of the file.
+ *
+ * The planner holds less than BLOCK_BUFFER_SIZE blocks, so a ring of that
+ * many entries is never overwritten while a block still refers to it.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _POWER_LOSS_RECOVERY_LINES_H_
+#define _POWER_LOSS_RECOVERY_LINES_H_
+
+#include <stdint.h>
+#include <string.h>
+
+template<uint8_t SIZE, uint8_t AXES>
+class JobRecoveryLineIndex {
+  static_assert(SIZE && !(SIZE & (SIZE - 1)), "SIZE must be a power of 2.");
+
+  public:
+    void reset() { memset(this, 0, sizeof(*this)); }
+
+    /**
+     * A line of the file is about to be executed from the given position
+     */
+    void begin(const uint32_t sdpos, const float (&position)[AXES], const float feedrate) {
+      pending_sdpos = sdpos;
+      memcpy(pending_position, position, sizeof(pending_position));
+      pending_feedrate = feedrate;
+      pending = true;
+    }
+
+    /**
+     * Tag of the line queuing a block. The first block of a line creates its entry.
+     */
+    uint8_t tag() {
+      if (pending) {
+        head = (head + 1) & (SIZE - 1);
+        sdpos_[head] = pending_sdpos;
+        memcpy(position_[head], pending_position, sizeof(pending_position));
+        feedrate_[head] = pending_feedrate;
+        pending = false;
+      }
+      return head;
+    }
+
+    uint32_t sdpos(const uint8_t tag) const { return sdpos_[tag]; }
+    const float (&position(const uint8_t tag) const)[AXES] { return position_[tag]; }
+    float feedrate(const uint8_t tag) const { return feedrate_[tag]; }
+
+  private:
+    uint32_t sdpos_[SIZE];
+    float position_[SIZE][AXES], feedrate_[SIZE];
+    uint32_t pending_sdpos;
+    float pending_position[AXES], pending_feedrate;
+    uint8_t head;
+    bool pending;
+};
+
+#endif // _POWER_LOSS_RECOVERY_LINES_H_
@@ -0,0 +1,122 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * power_loss_recovery_slots.h - Layout of the power-loss recovery file
+ *
+ * The recovery file is created once per job at its final size:
+ *
+ *   sector 0..1   cold records A and B (file name, leveling), written when they change
+ *   sector 2..N+1 ring of hot records (position, sdpos, temperatures, fans)
+ *
+ * Every save writes one hot record into the next slot of the ring. A changed
+ * cold record goes to the cold slot not holding the current one. A slot
+ * never straddles a sector, so a power cut during a save can only damage
+ * the slot being written: the other cold slot, and the rest of the ring,
+ * still hold the previous records. Each record carries a sequence number and
+ * a CRC; on recovery the valid slot with the highest sequence number wins,
+ * among the cold slots and among the hot slots.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _POWER_LOSS_RECOVERY_SLOTS_H_
+#define _POWER_LOSS_RECOVERY_SLOTS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef JOB_RECOVERY_SLOTS
+  #define JOB_RECOVERY_SLOTS 4
+#endif
+
+#define JOB_RECOVERY_SECTOR_SIZE 512
+#define JOB_RECOVERY_COLD_SLOTS 2
+#define JOB_RECOVERY_COLD_OFFSET(N) (uint32_t(N) * JOB_RECOVERY_SECTOR_SIZE)
+#define JOB_RECOVERY_SLOT_OFFSET(N) (uint32_t((N) + JOB_RECOVERY_COLD_SLOTS) * JOB_RECOVERY_SECTOR_SIZE)
+#define JOB_RECOVERY_FILE_SIZE JOB_RECOVERY_SLOT_OFFSET(JOB_RECOVERY_SLOTS)
+
+/**
+ * CRC-16/XMODEM, same polynomial as crc16() in utility.cpp
+ */
+inline uint16_t job_recovery_crc(uint16_t crc, const void * const data, uint16_t cnt) {
+  const uint8_t *ptr = (const uint8_t *)data;
+  while (cnt--) {
+    crc = (uint16_t)(crc ^ (uint16_t)(((uint16_t)*ptr++) << 8));
+    for (uint8_t i = 0; i < 8; i++)
+      crc = (uint16_t)((crc & 0x8000) ? ((uint16_t)(crc << 1) ^ 0x1021) : (crc << 1));
+  }
+  return crc;
+}
+
+/**
+ * CRC of a record, skipping its own 'crc' member
+ */
+template<typename T>
+uint16_t job_recovery_record_crc(const T &rec) {
+  const uint8_t * const p = (const uint8_t *)&rec;
+  const uint16_t before = (uint16_t)((const uint8_t *)&rec.crc - p),
+                 after = before + sizeof(rec.crc);
+  return job_recovery_crc(job_recovery_crc(0, p, before), p + after, sizeof(T) - after);
+}
+
+/**
+ * Stamp a record with its sequence number and CRC just before it is written.
+ * Sequence 0 is reserved for "never written" (a zero-filled slot).
+ */
+template<typename T>
+void job_recovery_seal(T &rec, const uint32_t sequence) {
+  rec.sequence = sequence ? sequence : 1;
+  rec.crc = job_recovery_record_crc(rec);
+}
+
+template<typename T>
+bool job_recovery_valid(const T &rec) {
+  return rec.sequence != 0 && rec.crc == job_recovery_record_crc(rec);
+}
+
+/**
+ * Slot written by the save with the given sequence number
+ */
+inline uint8_t job_recovery_slot(const uint32_t sequence) { return sequence % JOB_RECOVERY_SLOTS; }
+
+/**
+ * True if 'candidate' is valid and more recent than 'best'
+ */
+template<typename T>
+bool job_recovery_newer(const T &candidate, const T &best) {
+  return job_recovery_valid(candidate) && (!job_recovery_valid(best) || candidate.sequence > best.sequence);
+}
+
+/**
+ * Index of the most recent valid slot, or -1 if none survived
+ */
+template<typename T>
+int8_t job_recovery_latest(const T * const slots, const uint8_t count) {
+  int8_t latest = -1;
+  for (uint8_t i = 0; i < count; i++)
+    if (latest < 0 ? job_recovery_valid(slots[i]) : job_recovery_newer(slots[i], slots[latest]))
+      latest = i;
+  return latest;
+}
+
+#endif // _POWER_LOSS_RECOVERY_SLOTS_H_
@@ -0,0 +1,91 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * print_statistics.h - Extended print statistics kept in RAM
+ *
+ * The counters are updated in RAM as things happen: filament pushed by each
+ * extruder, time each heater had a target, moves printed, planner starvations,
+ * errors reading the file printed and thermal alarms. Writing them to the
+ * EEPROM each time would wear it out (about 100 000 writes per byte), so
+ * StatisticsJournal only tells when they have to be saved: at most once per
+ * interval while they change, or as soon as possible after an urgent change
+ * (end of a print, thermal alarm). The save itself is expected to rewrite
+ * only the bytes that have changed (eeprom_update_block).
+ *
+ * Each change also bumps a version, so the LCD panel and the reports only
+ * format and send the counters when they are not what was sent last time.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _PRINT_STATISTICS_H_
+#define _PRINT_STATISTICS_H_
+
+#include <stdint.h>
+
+template<uint8_t EXTRUDERS_COUNT, uint8_t HEATERS_COUNT>
+struct printStatisticsExtended {
+  float    filamentUsed[EXTRUDERS_COUNT]; // Filament pushed by each extruder in mm
+  uint32_t heaterTime[HEATERS_COUNT];     // Time each heater had a target in seconds
+  uint32_t moves;                         // Moves printed
+  uint16_t starvations;                   // Moves queued after the stepper ran out of blocks
+  uint16_t readErrors;                    // Errors reading the file printed
+  uint16_t thermalAlarms;                 // Thermal runaway, min and max temperature errors
+};
+
+class StatisticsJournal {
+  public:
+    // Start from saved counters
+    void reset(const uint32_t now) { dirty_ = urgent_ = false; last_ = now; }
+
+    // The counters have changed. If urgent, save them as soon as possible.
+    void changed(const bool urgent = false) {
+      if (!++version_) version_ = 1; // 0 is never a version so it can be used as "nothing seen"
+      dirty_ = true;
+      if (urgent) urgent_ = true;
+    }
+
+    // Have the counters to be saved? Time is in any unit, as long as interval uses the same.
+    bool due(const uint32_t now, const uint32_t interval) const {
+      return dirty_ && (urgent_ || now - last_ >= interval);
+    }
+
+    void saved(const uint32_t now) { reset(now); }
+
+    bool dirty() const { return dirty_; }
+    uint16_t version() const { return version_; }
+
+    // Have the counters changed since the version seen? If so, it becomes the current one.
+    bool changedSince(uint16_t &seen) const {
+      if (seen == version_) return false;
+      seen = version_;
+      return true;
+    }
+
+  private:
+    uint32_t last_ = 0;       // Time of the last save
+    uint16_t version_ = 1;
+    bool dirty_ = false, urgent_ = false;
+};
+
+#endif // _PRINT_STATISTICS_H_
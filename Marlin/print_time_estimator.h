@@ -0,0 +1,137 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * print_time_estimator.h - Time remaining of a print, learnt from the planner
+ *
+ * The time remaining computed from the percentage of the file read assumes
+ * that each byte takes the same time. It is badly wrong with long preambles,
+ * slow first layers or variable infill. Here the planner gives the duration of
+ * each block it plans (add_move) and update() relates it to the bytes of the
+ * file read in the meantime. Two quantities are learnt with an exponential
+ * smoothing, each time at least MIN_BYTES and MIN_SECONDS have passed:
+ *
+ *   - the seconds of moves planned per byte of G-code,
+ *   - the ratio between the actual time and the planned time, which accounts
+ *     for accelerations, dwells, heating and feedrate changes.
+ *
+ * Learning starts with the first move: the heating before it does not count.
+ * When the slicer gives the duration of the moves of the file
+ * (set_slicer_time), the time remaining is what it has not been planned yet,
+ * times the ratio: the slicer knows how the moves are distributed in the file.
+ * Otherwise, it is the bytes not read yet, times the seconds per byte and the
+ * ratio. remaining() returns -1 when there is no estimate.
+ *
+ * A new print is detected by a change of the file size or a position going
+ * backwards. The slicer time is kept if it was given for a file of this size.
+ * The moves planned outside of prints are forgotten when learning starts.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _PRINT_TIME_ESTIMATOR_H_
+#define _PRINT_TIME_ESTIMATOR_H_
+
+#include <stdint.h>
+
+class PrintTimeEstimator {
+  public:
+    static constexpr uint16_t MIN_BYTES = 512;    // Bytes read between two learning steps
+    static constexpr uint16_t MIN_SECONDS = 10;   // Seconds between two learning steps
+    static constexpr float SMOOTHING = 0.25f;     // Weight of a new learning step
+    static constexpr float MIN_RATIO = 0.5f, MAX_RATIO = 4.0f;
+
+    void reset() { *this = PrintTimeEstimator(); }
+
+    // Duration of a block planned, in seconds at its nominal rate
+    void add_move(const float seconds) { planned_ += seconds; }
+
+    // Time of the print of a file given by the slicer (0 if unknown)
+    void set_slicer_time(const uint32_t seconds, const uint32_t size) { slicer_ = seconds; slicer_size_ = size; }
+
+    /**
+     * Learn from the moves planned since the last call. Called periodically while printing.
+     *  position - Position in the file (bytes read)
+     *  size     - Size of the file
+     *  elapsed  - Duration of the print, in seconds
+     */
+    void update(const uint32_t position, const uint32_t size, const uint32_t elapsed) {
+      if (size != size_ || position < position_) {
+        const uint32_t slicer = slicer_size_ == size ? slicer_ : 0;
+        reset();
+        size_ = size;
+        set_slicer_time(slicer, size);
+      }
+
+      if (!started_) {
+        started_ = planned_ > 0;
+        planned_ = total_ = 0;
+        position_ = position;
+        elapsed_ = elapsed;
+        return;
+      }
+
+      const uint32_t bytes = position - position_, seconds = elapsed - elapsed_;
+      if (bytes < MIN_BYTES || seconds < MIN_SECONDS) return;
+
+      total_ += planned_;
+      learn(seconds_per_byte_, planned_ / bytes);
+      if (planned_ > 0) {
+        float ratio = seconds / planned_;
+        if (ratio < MIN_RATIO) ratio = MIN_RATIO;
+        if (ratio > MAX_RATIO) ratio = MAX_RATIO;
+        learn(ratio_, ratio);
+      }
+      if (samples_ < 0xFF) ++samples_;
+
+      planned_ = 0;
+      position_ = position;
+      elapsed_ = elapsed;
+    }
+
+    // Time remaining, in seconds, or -1 if it is not known. position is the position in the file.
+    int32_t remaining(const uint32_t position) const {
+      const float planned = total_ + planned_;
+      if (slicer_ > planned) return (int32_t)((slicer_ - planned) * ratio_ + 0.5f);
+      if (!samples_ || position > size_) return -1;
+      return (int32_t)((size_ - position) * seconds_per_byte_ * ratio_ + 0.5f);
+    }
+
+    uint8_t samples() const { return samples_; }
+    float seconds_per_byte() const { return seconds_per_byte_; }
+    float ratio() const { return ratio_; }
+
+  private:
+    void learn(float &value, const float sample) {
+      value = samples_ ? value + (sample - value) * SMOOTHING : sample;
+    }
+
+    float planned_ = 0;             // Seconds of moves planned since the last learning step
+    float total_ = 0;               // Seconds of moves planned before the last learning step
+    float seconds_per_byte_ = 0;
+    float ratio_ = 1;
+    uint32_t size_ = 0, position_ = 0, elapsed_ = 0, slicer_ = 0, slicer_size_ = 0;
+    uint8_t samples_ = 0;
+    bool started_ = false;
+};
+
+#endif // _PRINT_TIME_ESTIMATOR_H_
@@ -32,6 +32,8 @@ Stopwatch print_job_timer;      // Global Print Job Timer instance
 #include "printcounter.h"
 #include "duration_t.h"
 #include "Marlin.h"
+#include "temperature.h"
+#include "planner.h"
 
 PrintCounter print_job_timer;   // Global Print Job Timer instance
 
@@ -42,13 +44,24 @@ PrintCounter print_job_timer;   // Global Print Job Timer instance
   #define STATS_EEPROM_ADDRESS 0x32
 #endif
 
+// The first bytes of the EEPROM are not used by the settings (EEPROM_OFFSET).
+// Address 0 is the most exposed to corruption on brown-out so it is skipped.
+#define STATS_EXTRA_EEPROM_ADDRESS 0x04
+static_assert(STATS_EXTRA_EEPROM_ADDRESS + sizeof(uint8_t) + sizeof(printStatisticsExtra) <= STATS_EEPROM_ADDRESS,
+              "The extended statistics overlap the statistics in EEPROM");
+
 const PrintCounter::promdress PrintCounter::address = STATS_EEPROM_ADDRESS;
+const PrintCounter::promdress PrintCounter::extraAddress = STATS_EXTRA_EEPROM_ADDRESS;
 
 const uint16_t PrintCounter::updateInterval = 10;
 const uint16_t PrintCounter::saveInterval = 3600;
 printStatistics PrintCounter::data;
+printStatisticsExtra PrintCounter::extra;
+StatisticsJournal PrintCounter::journal;
 millis_t PrintCounter::lastDuration;
 bool PrintCounter::loaded = false;
+uint8_t PrintCounter::reportInterval = 0;
+uint16_t PrintCounter::reportedVersion = 0;
 
 millis_t PrintCounter::deltaDuration() {
   #if ENABLED(DEBUG_PRINTCOUNTER)
@@ -60,15 +73,44 @@ millis_t PrintCounter::deltaDuration() {
   return lastDuration - tmp;
 }
 
-void PrintCounter::incFilamentUsed(float const &amount) {
+void PrintCounter::incFilamentUsed(float const &amount, const uint8_t extruder) {
   #if ENABLED(DEBUG_PRINTCOUNTER)
     debug(PSTR("incFilamentUsed"));
   #endif
 
   // Refuses to update data if object is not loaded
-  if (!isLoaded()) return;
+  if (!isLoaded() || !amount) return;
 
   data.filamentUsed += amount; // mm
+  if (extruder < EXTRUDERS) extra.filamentUsed[extruder] += amount;
+  journal.changed();
+}
+
+void PrintCounter::incMoves(const bool starved) {
+  if (!isLoaded() || !isRunning()) return;
+
+  extra.moves++;
+  if (starved && extra.starvations < 0xFFFF) extra.starvations++;
+  journal.changed();
+}
+
+void PrintCounter::incReadErrors() {
+  if (!isLoaded()) return;
+
+  if (extra.readErrors < 0xFFFF) extra.readErrors++;
+  journal.changed();
+}
+
+void PrintCounter::incThermalAlarms() {
+  #if ENABLED(DEBUG_PRINTCOUNTER)
+    debug(PSTR("incThermalAlarms"));
+  #endif
+
+  if (!isLoaded()) return;
+
+  // Called from the temperature ISR too: no EEPROM write here, kill() saves it (flushStats)
+  if (extra.thermalAlarms < 0xFFFF) extra.thermalAlarms++;
+  journal.changed(true);
 }
 
 void PrintCounter::initStats() {
@@ -78,9 +120,12 @@ void PrintCounter::initStats() {
 
   loaded = true;
   data = { 0, 0, 0, 0, 0.0 };
+  extra = {};
+  journal.changed(true);
 
   saveStats();
   eeprom_write_byte((uint8_t*)address, 0x16);
+  eeprom_write_byte((uint8_t*)extraAddress, 0x17);
 }
 
 void PrintCounter::loadStats() {
@@ -90,10 +135,24 @@ void PrintCounter::loadStats() {
 
   // Checks if the EEPROM block is initialized
   if (eeprom_read_byte((uint8_t*)address) != 0x16) initStats();
-  else eeprom_read_block(&data,
-    (void*)(address + sizeof(uint8_t)), sizeof(printStatistics));
+  else {
+    eeprom_read_block(&data,
+      (void*)(address + sizeof(uint8_t)), sizeof(printStatistics));
+
+    // The extended statistics start from zero when they are not there yet
+    loaded = true;
+    if (eeprom_read_byte((uint8_t*)extraAddress) != 0x17) {
+      extra = {};
+      journal.changed(true);
+      saveStats();
+      eeprom_write_byte((uint8_t*)extraAddress, 0x17);
+    }
+    else eeprom_read_block(&extra,
+      (void*)(extraAddress + sizeof(uint8_t)), sizeof(printStatisticsExtra));
+  }
 
   loaded = true;
+  journal.reset(millis());
 }
 
 void PrintCounter::saveStats() {
@@ -104,9 +163,17 @@ void PrintCounter::saveStats() {
   // Refuses to save data if object is not loaded
   if (!isLoaded()) return;
 
-  // Saves the struct to EEPROM
+  // Saves the structs to EEPROM, only the bytes that have changed are written
   eeprom_update_block(&data,
     (void*)(address + sizeof(uint8_t)), sizeof(printStatistics));
+  eeprom_update_block(&extra,
+    (void*)(extraAddress + sizeof(uint8_t)), sizeof(printStatisticsExtra));
+
+  journal.saved(millis());
+}
+
+void PrintCounter::flushStats() {
+  if (journal.dirty()) saveStats();
 }
 
 void PrintCounter::showStats() {
@@ -158,14 +225,53 @@ void PrintCounter::showStats() {
   SERIAL_ECHO(data.filamentUsed / 1000);
   SERIAL_CHAR('m');
 
+  #if EXTRUDERS > 1
+    for (uint8_t e = 0; e < EXTRUDERS; e++) {
+      SERIAL_ECHOPAIR(", E", e);
+      SERIAL_ECHOPGM(": ");
+      SERIAL_ECHO(extra.filamentUsed[e] / 1000);
+      SERIAL_CHAR('m');
+    }
+  #endif
+
+  SERIAL_EOL();
+  SERIAL_PROTOCOLPGM(MSG_STATS);
+
+  SERIAL_ECHOPGM("Heaters on: ");
+  for (uint8_t h = 0; h < STATS_HEATERS; h++) {
+    if (h) SERIAL_ECHOPGM(", ");
+    if (h < HOTENDS) SERIAL_ECHOPAIR("E", h);
+    else if (h == STATS_HEATER_BED) SERIAL_ECHOPGM("Bed");
+    else SERIAL_ECHOPGM("Chamber");
+    SERIAL_ECHOPGM(": ");
+    elapsed = extra.heaterTime[h];
+    elapsed.toString(buffer);
+    SERIAL_ECHO(buffer);
+  }
+
+  SERIAL_EOL();
+  SERIAL_PROTOCOLPGM(MSG_STATS);
+
+  SERIAL_ECHOPGM("Moves: ");
+  SERIAL_ECHO(extra.moves);
+
+  SERIAL_ECHOPGM(", Planner starved: ");
+  SERIAL_ECHO(extra.starvations);
+
+  SERIAL_ECHOPGM(", Read errors: ");
+  SERIAL_ECHO(extra.readErrors);
+
+  SERIAL_ECHOPGM(", Thermal alarms: ");
+  SERIAL_ECHO(extra.thermalAlarms);
+
   SERIAL_EOL();
 }
 
 void PrintCounter::tick() {
-  if (!isRunning()) return;
+  if (!isLoaded()) return;
 
   static uint32_t update_last = millis(),
-                  eeprom_last = millis();
+                  report_last = millis();
 
   millis_t now = millis();
 
@@ -177,15 +283,41 @@ void PrintCounter::tick() {
       debug(PSTR("tick"));
     #endif
 
-    data.printTime += deltaDuration();
-    update_last = now;
+    // Whole seconds, the remainder is counted next time
+    const uint16_t seconds = (now - update_last) / 1000;
+    update_last += seconds * 1000UL;
+
+    bool changed = false;
+    HOTEND_LOOP() if (thermalManager.degTargetHotend(e)) {
+      extra.heaterTime[e] += seconds;
+      changed = true;
+    }
+    if (thermalManager.degTargetBed()) {
+      extra.heaterTime[STATS_HEATER_BED] += seconds;
+      changed = true;
+    }
+    #if HAS_HEATED_CHAMBER
+      if (thermalManager.degTargetChamber()) {
+        extra.heaterTime[STATS_HEATER_CHAMBER] += seconds;
+        changed = true;
+      }
+    #endif
+
+    if (isRunning()) {
+      data.printTime += deltaDuration();
+      changed = true;
+    }
+
+    if (changed) journal.changed();
   }
 
   // Trying to get the amount of calculations down to the bare min
-  const static millis_t j = saveInterval * 1000;
-  if (now - eeprom_last >= j) {
-    eeprom_last = now;
-    saveStats();
+  const static millis_t j = saveInterval * 1000UL;
+  if (journal.due(now, j)) saveStats();
+
+  if (reportInterval && now - report_last >= reportInterval * 1000UL) {
+    report_last = now;
+    if (journal.changedSince(reportedVersion)) showStats();
   }
 }
 
@@ -198,9 +330,11 @@ bool PrintCounter::start() {
   bool paused = isPaused();
 
   if (super::start()) {
+    planner.starved = false; // The queue ran out before the print (re)started
     if (!paused) {
       data.totalPrints++;
       lastDuration = 0;
+      journal.changed();
     }
     return true;
   }
@@ -215,12 +349,14 @@ bool PrintCounter::stop() {
   #endif
 
   if (super::stop()) {
+    planner.starved = false; // The end of the last move is not a starvation
     data.finishedPrints++;
     data.printTime += deltaDuration();
 
     if (duration() > data.longestPrint)
       data.longestPrint = duration();
 
+    journal.changed(true);
     saveStats();
     return true;
   }
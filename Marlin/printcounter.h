@@ -29,6 +29,7 @@
 #include "macros.h"
 #include "language.h"
 #include "stopwatch.h"
+#include "print_statistics.h"
 #include <avr/eeprom.h>
 
 struct printStatistics {    // 16 bytes
@@ -40,6 +41,13 @@ struct printStatistics {    // 16 bytes
   float    filamentUsed;    // Accumulated filament consumed in mm
 };
 
+// Heaters of the extended statistics: the hotends, then the bed and the chamber
+#define STATS_HEATER_BED      HOTENDS
+#define STATS_HEATER_CHAMBER  (HOTENDS + 1)
+#define STATS_HEATERS         (HOTENDS + 1 + (HAS_HEATED_CHAMBER ? 1 : 0))
+
+typedef printStatisticsExtended<EXTRUDERS, STATS_HEATERS> printStatisticsExtra;
+
 class PrintCounter: public Stopwatch {
   private:
     typedef Stopwatch super;
@@ -52,12 +60,29 @@ class PrintCounter: public Stopwatch {
 
     static printStatistics data;
 
+    /**
+     * @brief Extended statistics
+     * @details Kept in RAM and saved with data when the journal tells so.
+     */
+    static printStatisticsExtra extra;
+
+    /**
+     * @brief Changes of the statistics not saved yet
+     */
+    static StatisticsJournal journal;
+
     /**
      * @brief EEPROM address
      * @details Defines the start offset address where the data is stored.
      */
     static const promdress address;
 
+    /**
+     * @brief EEPROM address of the extended statistics
+     * @details Separate from data so the layout of data does not change.
+     */
+    static const promdress extraAddress;
+
     /**
      * @brief Interval in seconds between counter updates
      * @details This const value defines what will be the time between each
@@ -90,6 +115,16 @@ class PrintCounter: public Stopwatch {
      */
     static bool loaded;
 
+    /**
+     * @brief Interval in seconds between automatic reports, 0 to disable
+     */
+    static uint8_t reportInterval;
+
+    /**
+     * @brief Version of the statistics reported last
+     */
+    static uint16_t reportedVersion;
+
   protected:
     /**
      * @brief dT since the last call
@@ -121,8 +156,30 @@ class PrintCounter: public Stopwatch {
      * @details The total filament used counter will be incremented by "amount".
      *
      * @param amount The amount of filament used in mm
+     * @param extruder The extruder that pushed it
+     */
+    static void incFilamentUsed(float const &amount, const uint8_t extruder);
+
+    /**
+     * @brief Count a move queued in the planner
+     * @details Only the moves of a print job are counted.
+     *
+     * @param starved The stepper ran out of blocks before this one while the main
+     *                loop was not waiting (planner.synchronize(), M109, M190)
      */
-    static void incFilamentUsed(float const &amount);
+    static void incMoves(const bool starved);
+
+    /**
+     * @brief Count an error reading the file printed
+     */
+    static void incReadErrors();
+
+    /**
+     * @brief Count a thermal alarm
+     * @details The printer is about to be stopped: kill() saves the statistics
+     * once the heaters are off (see flushStats).
+     */
+    static void incThermalAlarms();
 
     /**
      * @brief Reset the Print Statistics
@@ -143,6 +200,12 @@ class PrintCounter: public Stopwatch {
      */
     static void saveStats();
 
+    /**
+     * @brief Save the Print Statistics if they have changed
+     * @details Used when tick() will not be called anymore (kill)
+     */
+    static void flushStats();
+
     /**
      * @brief Serial output the Print Statistics
      * @details This function may change in the future, for now it directly
@@ -156,10 +219,30 @@ class PrintCounter: public Stopwatch {
      */
     static printStatistics getStats() { return data; }
 
+    /**
+     * @brief Return the currently loaded extended statistics
+     */
+    static const printStatisticsExtra& getExtraStats() { return extra; }
+
+    /**
+     * @brief Have the statistics changed since a given version?
+     * @details If so, the version is updated to the current one.
+     *
+     * @param seen Version last seen, 0 for none
+     */
+    static bool changedSince(uint16_t &seen) { return journal.changedSince(seen); }
+
+    /**
+     * @brief Report the statistics periodically, when they change
+     *
+     * @param seconds Interval between reports, 0 to disable them
+     */
+    static void setReportInterval(const uint8_t seconds) { reportInterval = seconds; }
+
     /**
      * @brief Loop function
      * @details This function should be called at loop, it will take care of
-     * periodically save the statistical data to EEPROM and do time keeping.
+     * save the statistical data to EEPROM when needed and do time keeping.
      */
     static void tick();
 
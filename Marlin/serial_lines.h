@@ -0,0 +1,131 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * serial_lines.h - Lines located in the serial RX buffer as they arrive
+ *
+ * Taking commands one character at a time costs a read() for each of them,
+ * each reading the head and setting the tail of the RX buffer, then a test of
+ * the character in get_serial_commands. Here the RX interrupt notes where the
+ * lines end while it stores their bytes, so that the main loop only looks at
+ * the buffer once a whole line is there and copies it in one go, setting the
+ * tail once.
+ *
+ * The end of a line is noted as the index following its '\n' or '\r' (unless
+ * escaped with '\\'). When the ring of line ends is full, the last one is moved
+ * instead: an end then follows one or more complete lines. The main loop drops
+ * an end when its tail reaches it, be it after a line or after a character, or
+ * when there is no line before it (the bytes were dropped by flush). An end that
+ * is missing only delays its line until the next one so, when in doubt, the
+ * main loop keeps them.
+ *
+ * Only the RX interrupt calls stored() and only the main loop calls the other
+ * methods. The main loop never reads the end the interrupt may move (there are
+ * at least 3 of them) so nothing has to disable interrupts.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _SERIAL_LINES_H_
+#define _SERIAL_LINES_H_
+
+#include <stdint.h>
+
+template<uint8_t COUNT, typename POS>
+class SerialLineEnds {
+  static_assert(COUNT >= 3, "SerialLineEnds needs at least 3 entries");
+
+  public:
+    // RX interrupt: 'c' was stored and the next byte goes at 'next'
+    void stored(const uint8_t c, const POS next) {
+      if (escape_) { escape_ = false; return; }
+      if (c == '\\') { escape_ = true; return; }
+      if (c != '\n' && c != '\r') return;
+      const uint8_t h = head_, i = (h + 1) % COUNT;
+      if (i == tail_)
+        ends_[(h + COUNT - 1) % COUNT] = next;  // Full: move the last end
+      else {
+        ends_[h] = next;
+        head_ = i;
+      }
+    }
+
+    bool empty() const { return head_ == tail_; }
+    POS front() const { return ends_[tail_]; }
+
+    // The tail of the RX buffer is now 'pos': drop the end there, if any
+    void reached(const POS pos) {
+      const uint8_t t = tail_;
+      if (t != head_ && ends_[t] == pos) tail_ = (t + 1) % COUNT;
+    }
+
+    void pop() { tail_ = (tail_ + 1) % COUNT; }
+    void clear() { tail_ = head_; }
+
+  private:
+    volatile POS ends_[COUNT];
+    volatile uint8_t head_ = 0, tail_ = 0;
+    bool escape_ = false;
+};
+
+/**
+ * Copy the line at 'tail' of a ring buffer of SIZE bytes (a power of 2), looking
+ * no further than 'head', after the 'length' characters already in 'line'. The end
+ * of line is not copied and the characters beyond size - 1 are skipped. Escapes are
+ * kept: they are only followed to find the end of the line, like SerialLineEnds.
+ *
+ * Return true with 'tail' following the end of the line if it is there. Otherwise
+ * return false and, if 'partial' (the ring buffer is full), copy what is there but
+ * a final escape; the rest of the line is appended by the next calls.
+ */
+template<uint16_t SIZE, typename POS>
+bool copy_serial_line(const uint8_t * const ring, POS &tail, const POS head, char * const line, const uint8_t size, uint8_t &length, const bool partial) {
+  POS t = tail;
+  uint8_t n = length;
+  bool escape = false;
+  while (t != head) {
+    const char c = ring[t];
+    const POS next = (POS)(t + 1) & (POS)(SIZE - 1);
+    if (escape)
+      escape = false;
+    else if (c == '\\') {
+      if (next == head && t != tail) break;   // Keep it with the character it escapes
+      escape = true;
+    }
+    else if (c == '\n' || c == '\r') {
+      line[n] = '\0';
+      length = n;
+      tail = next;
+      return true;
+    }
+    if (n < size - 1) line[n++] = c;
+    t = next;
+  }
+  if (partial) {
+    line[n] = '\0';
+    length = n;
+    tail = t;
+  }
+  return false;
+}
+
+#endif // _SERIAL_LINES_H_
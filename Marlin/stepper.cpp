@@ -96,6 +96,10 @@
   #include <SPI.h>
 #endif
 
+#if ENABLED(PRINTCOUNTER)
+  #include "printcounter.h"
+#endif
+
 Stepper stepper; // Singleton
 
 // public:
@@ -117,6 +121,13 @@ uint8_t Stepper::last_direction_bits = 0,
 
 bool Stepper::abort_current_block;
 
+#if ENABLED(REALTIME_OVERRIDES)
+  FeedOverride<STEPPER_TIMER_RATE / 1000, REALTIME_OVERRIDE_RAMP, REALTIME_FEED_MIN, REALTIME_FEED_MAX> Stepper::feed_override;
+
+  // Called by the emergency parser from the serial RX ISR
+  bool realtime_override(const uint8_t c) { return Stepper::feed_override.command(c); }
+#endif
+
 #if DISABLED(MIXING_EXTRUDER)
   uint8_t Stepper::last_moved_extruder = 0xFF;
 #endif
@@ -1300,11 +1311,19 @@ void Stepper::stepper_pulse_phase_isr() {
       current_block = NULL;
       planner.discard_current_block();
     }
+    #if ENABLED(REALTIME_OVERRIDES)
+      feed_override.reset(); // A quick stop ends a feed hold
+    #endif
   }
 
   // If there is no current block, do nothing
   if (!current_block) return;
 
+  #if ENABLED(REALTIME_OVERRIDES)
+    // Stopped by a feed hold: no steps until resumed
+    if (feed_override.held()) return;
+  #endif
+
   // Count of pending loops and events for this iteration
   const uint32_t pending_events = step_event_count - step_events_completed;
   uint8_t events_to_do = MIN(pending_events, steps_per_isr);
@@ -1466,11 +1485,29 @@ void Stepper::stepper_pulse_phase_isr() {
 // properly schedules blocks from the planner. This is executed after creating
 // the step pulses, so it is not time critical, as pulses are already done.
 
+// With a feed override, the block runs OVERRIDE_RATE of its planned rate, so its
+// planned time (acceleration_time, deceleration_time) advances OVERRIDE_TIME of the time.
+#if ENABLED(REALTIME_OVERRIDES)
+  #define OVERRIDE_RATE(R) feed_override.apply(R)
+  #define OVERRIDE_TIME(T) feed_override.apply(T)
+#else
+  #define OVERRIDE_RATE(R) (R)
+  #define OVERRIDE_TIME(T) (T)
+#endif
+
 uint32_t Stepper::stepper_block_phase_isr() {
 
   // If no queued movements, just wait 1ms for the next move
   uint32_t interval = (STEPPER_TIMER_RATE / 1000);
 
+  #if ENABLED(REALTIME_OVERRIDES)
+    // Stopped by a feed hold: check again in 1ms, the block stays where it is
+    if (current_block && feed_override.held()) {
+      feed_override.elapsed(interval);
+      return interval;
+    }
+  #endif
+
   // If there is a current block
   if (current_block) {
 
@@ -1479,6 +1516,11 @@ uint32_t Stepper::stepper_block_phase_isr() {
       axis_did_move = 0;
       current_block = NULL;
       planner.discard_current_block();
+      #if ENABLED(PRINTCOUNTER)
+        // Out of moves during a print while the main loop was not waiting for them to end
+        if (!planner.has_blocks_queued() && !planner.waiting && print_job_timer.isRunning())
+          planner.starved = true;
+      #endif
     }
     else {
       // Step events not completed yet...
@@ -1500,8 +1542,8 @@ uint32_t Stepper::stepper_block_phase_isr() {
         // acc_step_rate is in steps/second
 
         // step_rate to timer interval and steps per stepper isr
-        interval = calc_timer_interval(acc_step_rate, oversampling_factor, &steps_per_isr);
-        acceleration_time += interval;
+        interval = calc_timer_interval(OVERRIDE_RATE(acc_step_rate), oversampling_factor, &steps_per_isr);
+        acceleration_time += OVERRIDE_TIME(interval);
 
         #if ENABLED(LIN_ADVANCE)
           if (LA_use_advance_lead) {
@@ -1545,8 +1587,8 @@ uint32_t Stepper::stepper_block_phase_isr() {
         // step_rate is in steps/second
 
         // step_rate to timer interval and steps per stepper isr
-        interval = calc_timer_interval(step_rate, oversampling_factor, &steps_per_isr);
-        deceleration_time += interval;
+        interval = calc_timer_interval(OVERRIDE_RATE(step_rate), oversampling_factor, &steps_per_isr);
+        deceleration_time += OVERRIDE_TIME(interval);
 
         #if ENABLED(LIN_ADVANCE)
           if (LA_use_advance_lead) {
@@ -1570,7 +1612,7 @@ uint32_t Stepper::stepper_block_phase_isr() {
         // Calculate the ticks_nominal for this nominal speed, if not done yet
         if (ticks_nominal < 0) {
           // step_rate to timer interval and loops for the nominal speed
-          ticks_nominal = calc_timer_interval(current_block->nominal_rate, oversampling_factor, &steps_per_isr);
+          ticks_nominal = calc_timer_interval(OVERRIDE_RATE(current_block->nominal_rate), oversampling_factor, &steps_per_isr);
         }
 
         // The timer interval is just the nominal value for the nominal speed
@@ -1776,7 +1818,7 @@ uint32_t Stepper::stepper_block_phase_isr() {
       // done against the endstop. So, check the limits here: If the movement
       // is against the limits, the block will be marked as to be killed, and
       // on the next call to this ISR, will be discarded.
-      endstops.update();
+      if (endstops.check_on_block()) endstops.update();
 
       #if ENABLED(Z_LATE_ENABLE)
         // If delayed Z enable, enable it now. This option will severely interfere with
@@ -1788,6 +1830,12 @@ uint32_t Stepper::stepper_block_phase_isr() {
       // Mark the time_nominal as not calculated yet
       ticks_nominal = -1;
 
+      #if ENABLED(REALTIME_OVERRIDES)
+        // Travel moves (no extrusion) also follow the rapid override. The factor changes at
+        // the acceleration of the block, up to the feed override it was planned for.
+        feed_override.block(!current_block->steps[E_AXIS], current_block->override_ramp, current_block->feed_limit);
+      #endif
+
       #if DISABLED(S_CURVE_ACCELERATION)
         // Set as deceleration point the initial rate of the block
         acc_step_rate = current_block->initial_rate;
@@ -1801,10 +1849,15 @@ uint32_t Stepper::stepper_block_phase_isr() {
       #endif
 
       // Calculate the initial timer interval
-      interval = calc_timer_interval(current_block->initial_rate, oversampling_factor, &steps_per_isr);
+      interval = calc_timer_interval(OVERRIDE_RATE(current_block->initial_rate), oversampling_factor, &steps_per_isr);
     }
   }
 
+  #if ENABLED(REALTIME_OVERRIDES)
+    // Move the factor toward its goal. In the cruise, the nominal interval is then computed again.
+    if (feed_override.elapsed(interval)) ticks_nominal = -1;
+  #endif
+
   // Return the interval to wait
   return interval;
 }
@@ -195,6 +195,10 @@
 #include "language.h"
 #include "types.h"
 
+#if ENABLED(REALTIME_OVERRIDES)
+  #include "feed_override.h"
+#endif
+
 // intRes = intIn1 * intIn2 >> 16
 // uses:
 // r26 to store 0
@@ -237,6 +241,11 @@ class Stepper {
       static uint32_t motor_current_setting[3];
     #endif
 
+    #if ENABLED(REALTIME_OVERRIDES)
+      // Live factor on the step rate: feed hold and overrides sent as real-time bytes
+      static FeedOverride<STEPPER_TIMER_RATE / 1000, REALTIME_OVERRIDE_RAMP, REALTIME_FEED_MIN, REALTIME_FEED_MAX> feed_override;
+    #endif
+
   private:
 
     static block_t* current_block;          // A pointer to the block currently being traced
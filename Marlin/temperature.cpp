@@ -624,6 +624,9 @@ void Temperature::_temp_error(const int8_t e, const char * const serial_msg, con
     	if(e == -2)
     		SERIAL_ERRORLNPGM("Chamber");
     }
+    #if ENABLED(PRINTCOUNTER)
+      print_job_timer.incThermalAlarms();
+    #endif
   } 
   #if DISABLED(BOGUS_TEMPERATURE_FAILSAFE_OVERRIDE)
     static bool killed = false;
@@ -118,6 +118,10 @@
 
   float unified_bed_leveling::z_values[GRID_MAX_POINTS_X][GRID_MAX_POINTS_Y];
 
+  #if ENABLED(UBL_FIXED_POINT_MESH)
+    UBLFixedMesh<GRID_MAX_POINTS_X, GRID_MAX_POINTS_Y> unified_bed_leveling::fixed_mesh;
+  #endif
+
   // 15 is the maximum nubmer of grid points supported + 1 safety margin for now,
   // until determinism prevails
   constexpr float unified_bed_leveling::_mesh_index_to_xpos[16],
@@ -142,6 +146,9 @@
       planner.set_z_fade_height(10.0);
     #endif
     ZERO(z_values);
+    #if ENABLED(UBL_FIXED_POINT_MESH)
+      refresh_fixed_mesh();
+    #endif
     if (was_enabled) report_current_position();
   }
 
@@ -156,6 +163,9 @@
         z_values[x][y] = value;
       }
     }
+    #if ENABLED(UBL_FIXED_POINT_MESH)
+      refresh_fixed_mesh();
+    #endif
   }
 
   static void serial_echo_xy(const uint8_t sp, const int16_t x, const int16_t y) {
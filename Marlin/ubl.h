@@ -32,6 +32,10 @@
 #include "math.h"
 #include "configuration_store.h"
 
+#if ENABLED(UBL_FIXED_POINT_MESH)
+  #include "ubl_fixed_mesh.h"
+#endif
+
 #define UBL_VERSION "1.01"
 #define UBL_OK false
 #define UBL_ERR true
@@ -125,6 +129,15 @@ class unified_bed_leveling {
 
     static float z_values[GRID_MAX_POINTS_X][GRID_MAX_POINTS_Y];
 
+    #if ENABLED(UBL_FIXED_POINT_MESH)
+      static UBLFixedMesh<GRID_MAX_POINTS_X, GRID_MAX_POINTS_Y> fixed_mesh;
+
+      // Rebuild fixed_mesh from z_values. Needed after any change to z_values.
+      FORCE_INLINE static void refresh_fixed_mesh() {
+        fixed_mesh.load(z_values, MESH_MIN_X, MESH_MIN_Y, MESH_X_DIST, MESH_Y_DIST);
+      }
+    #endif
+
     // 15 is the maximum nubmer of grid points supported + 1 safety margin for now,
     // until determinism prevails
     static constexpr float _mesh_index_to_xpos[16] PROGMEM = {
@@ -230,12 +243,16 @@ class unified_bed_leveling {
         );
       }
 
-      const float xratio = (rx0 - mesh_index_to_xpos(x1_i)) * (1.0 / (MESH_X_DIST)),
-                  z1 = z_values[x1_i][yi];
+      #if ENABLED(UBL_FIXED_POINT_MESH)
+        return fixed_mesh.on_x_line(rx0, x1_i, yi);
+      #else
+        const float xratio = (rx0 - mesh_index_to_xpos(x1_i)) * (1.0 / (MESH_X_DIST)),
+                    z1 = z_values[x1_i][yi];
 
-      return z1 + xratio * (z_values[MIN(x1_i, GRID_MAX_POINTS_X - 2) + 1][yi] - z1); // Don't allow x1_i+1 to be past the end of the array
-                                                                                      // If it is, it is clamped to the last element of the
-                                                                                      // z_values[][] array and no correction is applied.
+        return z1 + xratio * (z_values[MIN(x1_i, GRID_MAX_POINTS_X - 2) + 1][yi] - z1); // Don't allow x1_i+1 to be past the end of the array
+                                                                                        // If it is, it is clamped to the last element of the
+                                                                                        // z_values[][] array and no correction is applied.
+      #endif
     }
 
     //
@@ -264,12 +281,16 @@ class unified_bed_leveling {
         );
       }
 
-      const float yratio = (ry0 - mesh_index_to_ypos(y1_i)) * (1.0 / (MESH_Y_DIST)),
-                  z1 = z_values[xi][y1_i];
+      #if ENABLED(UBL_FIXED_POINT_MESH)
+        return fixed_mesh.on_y_line(ry0, xi, y1_i);
+      #else
+        const float yratio = (ry0 - mesh_index_to_ypos(y1_i)) * (1.0 / (MESH_Y_DIST)),
+                    z1 = z_values[xi][y1_i];
 
-      return z1 + yratio * (z_values[xi][MIN(y1_i, GRID_MAX_POINTS_Y - 2) + 1] - z1); // Don't allow y1_i+1 to be past the end of the array
-                                                                                      // If it is, it is clamped to the last element of the
-                                                                                      // z_values[][] array and no correction is applied.
+        return z1 + yratio * (z_values[xi][MIN(y1_i, GRID_MAX_POINTS_Y - 2) + 1] - z1); // Don't allow y1_i+1 to be past the end of the array
+                                                                                        // If it is, it is clamped to the last element of the
+                                                                                        // z_values[][] array and no correction is applied.
+      #endif
     }
 
     /**
@@ -365,6 +386,11 @@ class unified_bed_leveling {
 
 extern unified_bed_leveling ubl;
 
-FORCE_INLINE void gcode_G29() { ubl.G29(); }
+FORCE_INLINE void gcode_G29() {
+  ubl.G29();
+  #if ENABLED(UBL_FIXED_POINT_MESH)
+    ubl.refresh_fixed_mesh(); // Any of the G29 phases and options may have changed z_values
+  #endif
+}
 
 #endif // UNIFIED_BED_LEVELING_H
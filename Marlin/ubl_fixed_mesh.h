@@ -0,0 +1,140 @@
+/**
+ * Marlin 3D Printer Firmware
+ * Copyright (C) 2016 MarlinFirmware [https://github.com/MarlinFirmware/Marlin]
+ *
+ * Based on Sprinter and grbl.
+ * Copyright (C) 2011 Camiel Gubbels / Erik van der Zalm
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * ubl_fixed_mesh.h - Fixed-point copy of the UBL mesh for motion
+ *
+ * The mesh is held in integer microns, next to the Z delta of every mesh line
+ * segment: dzx[x][y] from point (x,y) to (x+1,y) and dzy[x][y] from (x,y) to
+ * (x,y+1). These are the X and Y slopes of cell (x,y), and the difference of
+ * two X slopes is its twist, so any Z correction is a couple of 16x16-bit
+ * multiplies by a Q12 cell fraction instead of float lookups and lerps.
+ *
+ * Undefined points (NAN in z_values) are kept as UBL_FIXED_INVALID and make
+ * any line or cell using them return NAN, as the float code does.
+ *
+ * The tables must be rebuilt with load() whenever z_values changes.
+ *
+ * Nothing here depends on the rest of Marlin so it can be tested on the host.
+ */
+
+#ifndef _UBL_FIXED_MESH_H_
+#define _UBL_FIXED_MESH_H_
+
+#include <stdint.h>
+#include <math.h>
+
+#define UBL_FIXED_INVALID   INT16_MIN
+#define UBL_FIXED_LIMIT     16000   // Microns. Keeps deltas between two points within int16.
+#define UBL_FIXED_SHIFT     12      // Cell fractions are Q12
+#define UBL_FIXED_ONE       (1L << UBL_FIXED_SHIFT)
+
+template<uint8_t NX, uint8_t NY>
+class UBLFixedMesh {
+  static_assert(NX > 1 && NY > 1, "The mesh needs at least 2x2 points.");
+
+  public:
+    /**
+     * Convert the float mesh (mm) and precompute the slopes
+     */
+    void load(const float (&z_mm)[NX][NY], const float min_x, const float min_y, const float dist_x, const float dist_y) {
+      x0 = min_x; y0 = min_y;
+      kx = UBL_FIXED_ONE / dist_x;
+      ky = UBL_FIXED_ONE / dist_y;
+
+      for (uint8_t x = 0; x < NX; x++)
+        for (uint8_t y = 0; y < NY; y++)
+          z[x][y] = to_microns(z_mm[x][y]);
+
+      // The last column and row have no segment beyond them: a zero slope, like
+      // the MIN(x1_i, GRID_MAX_POINTS_X - 2) + 1 clamp of the float code
+      for (uint8_t x = 0; x < NX; x++)
+        for (uint8_t y = 0; y < NY; y++) {
+          dzx[x][y] = x < NX - 1 ? delta(z[x][y], z[x + 1][y]) : z[x][y] == UBL_FIXED_INVALID ? UBL_FIXED_INVALID : 0;
+          dzy[x][y] = y < NY - 1 ? delta(z[x][y], z[x][y + 1]) : z[x][y] == UBL_FIXED_INVALID ? UBL_FIXED_INVALID : 0;
+        }
+    }
+
+    /**
+     * Z correction at 'rx' on horizontal mesh line 'yi', in the segment starting at 'xi'.
+     * Same as z_correction_for_x_on_horizontal_mesh_line for in-bounds indexes.
+     */
+    float on_x_line(const float rx, const int8_t xi, const int8_t yi) const {
+      const int16_t s = dzx[xi][yi];
+      if (s == UBL_FIXED_INVALID) return NAN;
+      return to_mm(z[xi][yi] + scale(s, fraction(rx, x0, kx, xi)));
+    }
+
+    /**
+     * Z correction at 'ry' on vertical mesh line 'xi', in the segment starting at 'yi'.
+     * Same as z_correction_for_y_on_vertical_mesh_line for in-bounds indexes.
+     */
+    float on_y_line(const float ry, const int8_t xi, const int8_t yi) const {
+      const int16_t s = dzy[xi][yi];
+      if (s == UBL_FIXED_INVALID) return NAN;
+      return to_mm(z[xi][yi] + scale(s, fraction(ry, y0, ky, yi)));
+    }
+
+    /**
+     * Bilinear Z correction at (rx, ry) in cell (xi, yi). Cells on the last
+     * row or column are beyond the mesh and get no correction.
+     */
+    float in_cell(const float rx, const float ry, const int8_t xi, const int8_t yi) const {
+      if (xi >= NX - 1 || yi >= NY - 1) return 0;
+      const int16_t sx0 = dzx[xi][yi], sx1 = dzx[xi][yi + 1], sy = dzy[xi][yi];
+      if (sx0 == UBL_FIXED_INVALID || sx1 == UBL_FIXED_INVALID || sy == UBL_FIXED_INVALID) return NAN;
+      const int32_t fx = fraction(rx, x0, kx, xi), fy = fraction(ry, y0, ky, yi),
+                    z1 = scale(sx0, fx),                    // X slope along the bottom edge
+                    z2 = sy + scale(sx1, fx);               // Top edge, relative to the bottom left point
+      return to_mm(z[xi][yi] + z1 + scale(z2 - z1, fy));
+    }
+
+    int16_t z_microns(const uint8_t x, const uint8_t y) const { return z[x][y]; }
+
+  private:
+    int16_t z[NX][NY], dzx[NX][NY], dzy[NX][NY];
+    float x0, y0, kx, ky;
+
+    static int16_t to_microns(const float mm) {
+      if (isnan(mm)) return UBL_FIXED_INVALID;
+      const float um = mm * 1000.0f;
+      return um > UBL_FIXED_LIMIT ? UBL_FIXED_LIMIT : um < -UBL_FIXED_LIMIT ? -UBL_FIXED_LIMIT : int16_t(lroundf(um));
+    }
+
+    static float to_mm(const int32_t um) { return um * 0.001f; }
+
+    static int16_t delta(const int16_t a, const int16_t b) {
+      return a == UBL_FIXED_INVALID || b == UBL_FIXED_INVALID ? UBL_FIXED_INVALID : b - a;
+    }
+
+    // Q12 position of 'v' inside the segment starting at mesh index 'i'. Not
+    // clamped: like the float code, positions outside the segment extrapolate.
+    static int32_t fraction(const float v, const float origin, const float k, const int8_t i) {
+      return int32_t(lroundf((v - origin) * k)) - (int32_t(i) << UBL_FIXED_SHIFT);
+    }
+
+    static int32_t scale(const int32_t dz, const int32_t f) {
+      return (dz * f + (UBL_FIXED_ONE >> 1)) >> UBL_FIXED_SHIFT;
+    }
+};
+
+#endif // _UBL_FIXED_MESH_H_
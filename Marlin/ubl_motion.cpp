@@ -96,19 +96,27 @@
 
         FINAL_MOVE:
 
-        // The distance is always MESH_X_DIST so multiply by the constant reciprocal.
-        const float xratio = (end[X_AXIS] - mesh_index_to_xpos(cell_dest_xi)) * (1.0f / (MESH_X_DIST));
+        #if ENABLED(UBL_FIXED_POINT_MESH)
 
-        float z1 = z_values[cell_dest_xi    ][cell_dest_yi    ] + xratio *
-                  (z_values[cell_dest_xi + 1][cell_dest_yi    ] - z_values[cell_dest_xi][cell_dest_yi    ]),
-              z2 = z_values[cell_dest_xi    ][cell_dest_yi + 1] + xratio *
-                  (z_values[cell_dest_xi + 1][cell_dest_yi + 1] - z_values[cell_dest_xi][cell_dest_yi + 1]);
+          const float z0 = fixed_mesh.in_cell(end[X_AXIS], end[Y_AXIS], cell_dest_xi, cell_dest_yi) * planner.fade_scaling_factor_for_z(end[Z_AXIS]);
 
-        if (cell_dest_xi >= GRID_MAX_POINTS_X - 1) z1 = z2 = 0.0;
+        #else
 
-        // X cell-fraction done. Interpolate the two Z offsets with the Y fraction for the final Z offset.
-        const float yratio = (end[Y_AXIS] - mesh_index_to_ypos(cell_dest_yi)) * (1.0f / (MESH_Y_DIST)),
-                    z0 = cell_dest_yi < GRID_MAX_POINTS_Y - 1 ? (z1 + (z2 - z1) * yratio) * planner.fade_scaling_factor_for_z(end[Z_AXIS]) : 0.0;
+          // The distance is always MESH_X_DIST so multiply by the constant reciprocal.
+          const float xratio = (end[X_AXIS] - mesh_index_to_xpos(cell_dest_xi)) * (1.0f / (MESH_X_DIST));
+
+          float z1 = z_values[cell_dest_xi    ][cell_dest_yi    ] + xratio *
+                    (z_values[cell_dest_xi + 1][cell_dest_yi    ] - z_values[cell_dest_xi][cell_dest_yi    ]),
+                z2 = z_values[cell_dest_xi    ][cell_dest_yi + 1] + xratio *
+                    (z_values[cell_dest_xi + 1][cell_dest_yi + 1] - z_values[cell_dest_xi][cell_dest_yi + 1]);
+
+          if (cell_dest_xi >= GRID_MAX_POINTS_X - 1) z1 = z2 = 0.0;
+
+          // X cell-fraction done. Interpolate the two Z offsets with the Y fraction for the final Z offset.
+          const float yratio = (end[Y_AXIS] - mesh_index_to_ypos(cell_dest_yi)) * (1.0f / (MESH_Y_DIST)),
+                      z0 = cell_dest_yi < GRID_MAX_POINTS_Y - 1 ? (z1 + (z2 - z1) * yratio) * planner.fade_scaling_factor_for_z(end[Z_AXIS]) : 0.0;
+
+        #endif
 
         // Undefined parts of the Mesh in z_values[][] are NAN.
         // Replace NAN corrections with 0.0 to prevent NAN propagation.
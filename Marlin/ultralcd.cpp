@@ -881,7 +881,7 @@ void lcd_quick_feedback(const bool clear_buttons) {
       ));
 
       #if HAS_HEATED_BED
-        const int16_t bt = job_recovery_info.target_temperature_bed;
+        const int16_t bt = job_recovery_info.hot.target_temperature_bed;
         if (bt) {
           // Restore the bed temperature
           sprintf_P(cmd, PSTR("M190 S%i"), bt);
@@ -891,7 +891,7 @@ void lcd_quick_feedback(const bool clear_buttons) {
 
       // Restore all hotend temperatures
       HOTEND_LOOP() {
-        const int16_t et = job_recovery_info.target_temperature[e];
+        const int16_t et = job_recovery_info.hot.target_temperature[e];
         if (et) {
           #if HOTENDS > 1
             sprintf_P(cmd, PSTR("T%i"), e);
@@ -903,13 +903,13 @@ void lcd_quick_feedback(const bool clear_buttons) {
       }
 
       #if HOTENDS > 1
-        sprintf_P(cmd, PSTR("T%i"), job_recovery_info.active_hotend);
+        sprintf_P(cmd, PSTR("T%i"), job_recovery_info.cold.active_hotend);
         enqueue_and_echo_command(cmd);
       #endif
 
       // Restore print cooling fan speeds
       for (uint8_t i = 0; i < FAN_COUNT; i++) {
-        int16_t f = job_recovery_info.fanSpeeds[i];
+        int16_t f = job_recovery_info.hot.fanSpeeds[i];
         if (f) {
           sprintf_P(cmd, PSTR("M106 P%i S%i"), i, f);
           enqueue_and_echo_command(cmd);
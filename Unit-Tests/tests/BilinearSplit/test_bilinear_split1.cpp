@@ -0,0 +1,404 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "catch.hpp"
+#include "BilinearSplit.h"
+
+namespace
+{
+    const int X = 0, Y = 1, Z = 2, E = 3;
+
+    struct Point
+    {
+        float axis[4];
+        float offset;
+    };
+
+    template<int NX, int NY>
+    struct Grid
+    {
+        int start_[2];
+        int spacing_[2];
+        float factor_[2];
+        float z_[NX][NY];
+
+        Grid(int sx, int sy, int spx, int spy, unsigned seed)
+        : start_{sx, sy}, spacing_{spx, spy}, factor_{1.0f / spx, 1.0f / spy}
+        {
+            std::mt19937 random{seed};
+            std::uniform_real_distribution<float> z{-0.5f, 0.5f};
+            for(auto& column: z_)
+                for(auto& v: column)
+                    v = z(random);
+        }
+
+        float start(uint8_t a) const { return start_[a]; }
+        float spacing(uint8_t a) const { return spacing_[a]; }
+        float factor(uint8_t a) const { return factor_[a]; }
+        uint8_t points(uint8_t a) const { return a == X ? NX : NY; }
+        float z(uint8_t x, uint8_t y) const { return z_[x][y]; }
+
+        // Same computation as bilinear_z_offset, without the cache
+        float offset(const float (&pos)[4]) const
+        {
+            float ratio_x = (pos[X] - start_[X]) * factor_[X],
+                  ratio_y = (pos[Y] - start_[Y]) * factor_[Y];
+            const float gx = std::min(std::max(std::floor(ratio_x), 0.0f), float(NX - 1)),
+                        gy = std::min(std::max(std::floor(ratio_y), 0.0f), float(NY - 1));
+            ratio_x = std::max(ratio_x - gx, 0.0f);
+            ratio_y = std::max(ratio_y - gy, 0.0f);
+            const int gridx = gx, gridy = gy,
+                      nextx = std::min(gridx + 1, NX - 1), nexty = std::min(gridy + 1, NY - 1);
+            const float z1 = z_[gridx][gridy], d2 = z_[gridx][nexty] - z1,
+                        z3 = z_[nextx][gridy], d4 = z_[nextx][nexty] - z3;
+            const float L = z1 + d2 * ratio_y, R = z3 + d4 * ratio_y;
+            return L + ratio_x * (R - L);
+        }
+    };
+
+    // The recursive bilinear_line_to_destination this replaces, leveled as by the planner
+    template<typename GRID>
+    struct Recursive
+    {
+        const GRID& grid;
+        float current[4];
+        float destination[4];
+        std::vector<Point> points;
+
+        int cell(int a, float v) const
+        {
+            const int c = (v - grid.start(a)) * grid.factor(a);
+            return std::min(std::max(c, 0), grid.points(a) - 2);
+        }
+
+        void buffer_line()
+        {
+            Point p;
+            std::memcpy(p.axis, destination, sizeof(p.axis));
+            p.offset = grid.offset(destination);
+            points.push_back(p);
+            std::memcpy(current, destination, sizeof(current));
+        }
+
+        void line_to_destination(uint16_t x_splits = 0xFFFF, uint16_t y_splits = 0xFFFF)
+        {
+            const int cx1 = cell(X, current[X]), cy1 = cell(Y, current[Y]),
+                      cx2 = cell(X, destination[X]), cy2 = cell(Y, destination[Y]);
+            if(cx1 == cx2 && cy1 == cy2)
+                return buffer_line();
+
+            float normalized_dist, end[4];
+            const int gcx = std::max(cx1, cx2), gcy = std::max(cy1, cy2);
+            if(cx2 != cx1 && (x_splits & (1 << gcx)))
+            {
+                x_splits &= ~(1 << gcx);
+                std::memcpy(end, destination, sizeof(end));
+                destination[X] = grid.start(X) + grid.spacing(X) * gcx;
+                normalized_dist = (destination[X] - current[X]) / (end[X] - current[X]);
+                destination[Y] = current[Y] + (destination[Y] - current[Y]) * normalized_dist;
+            }
+            else if(cy2 != cy1 && (y_splits & (1 << gcy)))
+            {
+                y_splits &= ~(1 << gcy);
+                std::memcpy(end, destination, sizeof(end));
+                destination[Y] = grid.start(Y) + grid.spacing(Y) * gcy;
+                normalized_dist = (destination[Y] - current[Y]) / (end[Y] - current[Y]);
+                destination[X] = current[X] + (destination[X] - current[X]) * normalized_dist;
+            }
+            else
+                return buffer_line();
+
+            destination[Z] = current[Z] + (destination[Z] - current[Z]) * normalized_dist;
+            destination[E] = current[E] + (destination[E] - current[E]) * normalized_dist;
+            line_to_destination(x_splits, y_splits);
+            std::memcpy(destination, end, sizeof(end));
+            line_to_destination(x_splits, y_splits);
+        }
+    };
+
+    template<typename GRID>
+    std::vector<Point> split_recursive(const GRID& grid, const float (&from)[4], const float (&to)[4])
+    {
+        Recursive<GRID> recursive{grid, {from[X], from[Y], from[Z], from[E]}, {to[X], to[Y], to[Z], to[E]}, {}};
+        recursive.line_to_destination();
+        return recursive.points;
+    }
+
+    template<typename GRID>
+    std::vector<Point> split_iterative(const GRID& grid, const float (&from)[4], const float (&to)[4])
+    {
+        std::vector<Point> points;
+        auto segment = [&points](const float (&end)[4], float offset)
+        {
+            Point p;
+            std::memcpy(p.axis, end, sizeof(p.axis));
+            p.offset = offset;
+            points.push_back(p);
+        };
+        bilinear_split_line(grid, from, to, segment);
+        return points;
+    }
+
+    // Segments of (almost) no length are dropped by the planner
+    std::vector<Point> without_empty(const std::vector<Point>& points, const float (&from)[4])
+    {
+        std::vector<Point> result;
+        const float* last = from;
+        for(auto& p: points)
+        {
+            if(std::fabs(p.axis[X] - last[X]) < 1e-3f && std::fabs(p.axis[Y] - last[Y]) < 1e-3f)
+                continue;
+            result.push_back(p);
+            last = p.axis;
+        }
+        return result;
+    }
+
+    void require_same_point(const Point& actual, const Point& expected)
+    {
+        for(int a = 0; a < 4; ++a)
+            REQUIRE(actual.axis[a] == Approx(expected.axis[a]).margin(1e-3));
+        REQUIRE(actual.offset == Approx(expected.offset).margin(1e-5));
+    }
+
+    template<typename GRID>
+    void check_same_segments(const GRID& grid, const float (&from)[4], const float (&to)[4])
+    {
+        const auto expected = without_empty(split_recursive(grid, from, to), from);
+        const auto actual = without_empty(split_iterative(grid, from, to), from);
+
+        REQUIRE(actual.size() == expected.size());
+        for(size_t i = 0; i < actual.size(); ++i)
+            require_same_point(actual[i], expected[i]);
+    }
+
+    template<typename GRID>
+    std::vector<Point> segment_iterative(const GRID& grid, const float (&from)[4], const float (&to)[4], float length)
+    {
+        std::vector<Point> points;
+        auto segment = [&points](const float (&end)[4], float offset)
+        {
+            Point p;
+            std::memcpy(p.axis, end, sizeof(p.axis));
+            p.offset = offset;
+            points.push_back(p);
+        };
+        bilinear_segment_line(grid, from, to, length, segment);
+        return points;
+    }
+
+    bool on_grid_line(const Point& p, int a, float start, float spacing)
+    {
+        const float n = (p.axis[a] - start) / spacing;
+        return std::fabs(n - std::round(n)) < 1e-4f;
+    }
+
+    // With more than one grid line to cross on an axis, the recursive version
+    // splits on some of them only, depending on how (line - start) * factor rounds.
+    // All its ends must still be found, in the same order, and every other end
+    // must be on a grid line.
+    template<typename GRID>
+    void check_more_segments(const GRID& grid, const float (&from)[4], const float (&to)[4])
+    {
+        const auto expected = without_empty(split_recursive(grid, from, to), from);
+        const auto actual = without_empty(split_iterative(grid, from, to), from);
+
+        REQUIRE(actual.size() >= expected.size());
+        size_t e = 0;
+        for(size_t i = 0; i < actual.size(); ++i)
+        {
+            const Point& p = actual[i];
+            REQUIRE(p.offset == Approx(grid.offset(p.axis)).margin(1e-5));
+            if(e < expected.size() && std::fabs(p.axis[X] - expected[e].axis[X]) < 1e-3f && std::fabs(p.axis[Y] - expected[e].axis[Y]) < 1e-3f)
+                require_same_point(p, expected[e++]);
+            else
+                REQUIRE((on_grid_line(p, X, grid.start(X), grid.spacing(X)) || on_grid_line(p, Y, grid.start(Y), grid.spacing(Y))));
+        }
+        REQUIRE(e == expected.size());
+
+        // Each segment stays in one cell, the cells at the edges extending beyond the grid
+        const float* last = from;
+        for(auto& p: actual)
+        {
+            for(int a = 0; a < 2; ++a)
+            {
+                const int cell = bilinear_cell(grid, a, (last[a] + p.axis[a]) / 2);
+                const float lo = cell == 0 ? -1e9f : grid.start(a) + cell * grid.spacing(a),
+                            hi = cell == grid.points(a) - 2 ? 1e9f : grid.start(a) + (cell + 1) * grid.spacing(a);
+                REQUIRE(std::min(last[a], p.axis[a]) >= lo - 1e-3f);
+                REQUIRE(std::max(last[a], p.axis[a]) <= hi + 1e-3f);
+            }
+            last = p.axis;
+        }
+    }
+}
+
+SCENARIO("Moves are split on the grid lines like the recursive version", "[bilinear]")
+{
+    GIVEN("A 3x3 grid like on our printers")
+    {
+        Grid<3, 3> grid{30, 30, 80, 80, 3};
+
+        WHEN("A move stays in one cell")
+        {
+            const float from[4] = {40, 40, 0.2f, 0}, to[4] = {100, 90, 0.2f, 5};
+            auto points = split_iterative(grid, from, to);
+
+            THEN("It is not split")
+            {
+                REQUIRE(points.size() == 1);
+                REQUIRE(points[0].offset == Approx(grid.offset(to)));
+            }
+        }
+
+        WHEN("A move crosses the middle grid lines")
+        {
+            const float from[4] = {40, 50, 0.2f, 0}, to[4] = {180, 160, 0.4f, 10};
+            auto points = split_iterative(grid, from, to);
+
+            THEN("It is split on each line, in order")
+            {
+                REQUIRE(points.size() == 3);
+                REQUIRE(points[0].axis[X] == Approx(110));
+                REQUIRE(points[0].axis[Y] == Approx(105));
+                REQUIRE(points[1].axis[Y] == Approx(110));
+                REQUIRE(points[1].axis[E] == Approx(10.0f * 60 / 110));
+                REQUIRE(points[2].axis[X] == Approx(180));
+            }
+            THEN("It gives the same segments as the recursive version")
+            {
+                check_same_segments(grid, from, to);
+            }
+        }
+
+        WHEN("A move goes backward through a grid corner")
+        {
+            const float from[4] = {180, 180, 0.2f, 0}, to[4] = {40, 40, 0.2f, 3};
+            auto points = split_iterative(grid, from, to);
+
+            THEN("It is split once at the corner")
+            {
+                REQUIRE(points.size() == 2);
+                REQUIRE(points[0].axis[X] == Approx(110));
+                REQUIRE(points[0].axis[Y] == Approx(110));
+                REQUIRE(points[0].offset == Approx(grid.z(1, 1)));
+            }
+        }
+    }
+
+    GIVEN("Random moves on a 3x3 grid, inside and outside the probed area")
+    {
+        std::mt19937 random{2018};
+        std::uniform_real_distribution<float> xy{0, 220}, z{0, 2}, e{0, 50};
+        Grid<3, 3> grid{30, 30, 80, 80, 11};
+
+        THEN("They give the same segments as the recursive version")
+        {
+            for(int i = 0; i < 5000; ++i)
+            {
+                const float from[4] = {xy(random), xy(random), z(random), e(random)},
+                            to[4] = {xy(random), xy(random), z(random), e(random)};
+                check_same_segments(grid, from, to);
+            }
+        }
+    }
+
+    GIVEN("Random moves on larger grids")
+    {
+        std::mt19937 random{2018};
+        std::uniform_real_distribution<float> xy{0, 220}, z{0, 2}, e{0, 50};
+        Grid<5, 5> grid5{20, 25, 45, 40, 5};
+        Grid<7, 4> grid7{10, 30, 32, 55, 7};
+
+        THEN("They are split on every grid line crossed, including the ends found by the recursive version")
+        {
+            for(int i = 0; i < 5000; ++i)
+            {
+                const float from[4] = {xy(random), xy(random), z(random), e(random)},
+                            to[4] = {xy(random), xy(random), z(random), e(random)};
+                check_more_segments(grid5, from, to);
+                check_more_segments(grid7, from, to);
+            }
+        }
+    }
+}
+
+SCENARIO("Moves are split on the grid lines and into segments", "[bilinear]")
+{
+    GIVEN("A 3x3 grid and segments of 5mm, like on our printers")
+    {
+        Grid<3, 3> grid{30, 30, 80, 80, 3};
+
+        WHEN("A move crosses the middle grid lines")
+        {
+            const float from[4] = {40, 50, 0.2f, 0}, to[4] = {180, 160, 0.4f, 10};
+            const auto split = split_iterative(grid, from, to);
+            const auto points = segment_iterative(grid, from, to, 5);
+
+            THEN("The grid line ends are kept and the pieces are cut in segments of about 5mm")
+            {
+                size_t s = 0;
+                const float* last = from;
+                for(auto& p: points)
+                {
+                    const float length = std::hypot(p.axis[X] - last[X], p.axis[Y] - last[Y]);
+                    REQUIRE(length <= 10.0f);
+                    REQUIRE(p.offset == Approx(grid.offset(p.axis)).margin(1e-5));
+                    // On a straight line, E follows the XY distance
+                    REQUIRE(p.axis[E] == Approx(10.0f * (p.axis[X] - from[X]) / (to[X] - from[X])).margin(1e-3));
+                    if(s < split.size() && std::fabs(p.axis[X] - split[s].axis[X]) < 1e-4f && std::fabs(p.axis[Y] - split[s].axis[Y]) < 1e-4f)
+                        ++s;
+                    last = p.axis;
+                }
+                REQUIRE(s == split.size());
+                // Each piece loses at most one segment to the rounding
+                REQUIRE(points.size() + split.size() >= std::hypot(to[X] - from[X], to[Y] - from[Y]) / 5);
+                require_same_point(points.back(), split.back());
+            }
+        }
+
+        WHEN("A move is shorter than a segment")
+        {
+            const float from[4] = {40, 40, 0.2f, 0}, to[4] = {42, 41, 0.2f, 0.1f};
+            const auto points = segment_iterative(grid, from, to, 5);
+
+            THEN("It is not split")
+            {
+                REQUIRE(points.size() == 1);
+                REQUIRE(points[0].offset == Approx(grid.offset(to)));
+            }
+        }
+
+        WHEN("A move is only in Z")
+        {
+            const float from[4] = {40, 40, 0.2f, 0}, to[4] = {40, 40, 10, 0};
+            const auto points = segment_iterative(grid, from, to, 5);
+
+            THEN("It is not split")
+            {
+                REQUIRE(points.size() == 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,269 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstring>
+#include <random>
+#include <vector>
+#include "catch.hpp"
+#include "CH376Async.h"
+
+namespace
+{
+    const uint8_t USB_INT_SUCCESS = 0x14, USB_INT_DISK_READ = 0x1D;
+    const uint8_t CMD_BYTE_READ = 0x3A, CMD_BYTE_RD_GO = 0x3B;
+    const uint8_t BLOCK = 16;
+
+    //! Fake CH376: each command raises INT# after a random latency
+    struct FakeChip
+    {
+        std::mt19937 random{42};
+        uint32_t min_latency = 1, max_latency = 20;
+        uint32_t now = 0;
+        uint32_t raise_at = 0;
+        bool pending = false, dead = false;
+        uint8_t status = 0;
+        uint8_t file[100];
+        uint32_t position = 0, remaining = 0;
+        unsigned commands = 0, status_reads = 0;
+
+        void reset()
+        {
+            *this = FakeChip{};
+            for(unsigned i = 0; i < sizeof(file); ++i)
+                file[i] = static_cast<uint8_t>(i * 7);
+        }
+
+        void raise(uint8_t s)
+        {
+            std::uniform_int_distribution<uint32_t> latency(min_latency, max_latency);
+            raise_at = now + latency(random);
+            status = s;
+            pending = !dead;
+        }
+
+        void command(uint8_t cmd, uint16_t count = 0)
+        {
+            ++commands;
+            if(cmd == CMD_BYTE_READ)
+                remaining = count;
+            // A request for data while there is some left, then SUCCESS
+            const uint32_t left = sizeof(file) - position;
+            raise(remaining && left ? USB_INT_DISK_READ : USB_INT_SUCCESS);
+        }
+
+        uint8_t read_block(uint8_t* buf)
+        {
+            uint32_t n = remaining < BLOCK ? remaining : BLOCK;
+            if(n > sizeof(file) - position)
+                n = sizeof(file) - position;
+            std::memcpy(buf, &file[position], n);
+            position += n;
+            remaining -= n;
+            return static_cast<uint8_t>(n);
+        }
+    };
+
+    FakeChip chip;
+
+    //! Set while the operation is allowed to talk to the chip
+    const CH376Async<struct FakeHAL>* engine = nullptr;
+    bool unowned_access = false;
+
+    struct FakeHAL
+    {
+        static bool interrupt() { return chip.pending && int32_t(chip.now - chip.raise_at) >= 0; }
+        static uint8_t status()
+        {
+            check_owner();
+            ++chip.status_reads;
+            chip.pending = false;
+            return chip.status;
+        }
+        static uint32_t millis() { return chip.now; }
+        static void check_owner() { if(engine && !engine->owns_chip()) unowned_access = true; }
+    };
+
+    typedef CH376Async<FakeHAL> Async;
+
+    //! Read of 'count' bytes, like USBFile::prefetchStep
+    struct Read
+    {
+        uint16_t count;
+        uint8_t data[100];
+        uint8_t length = 0;
+        std::vector<uint8_t> statuses;
+        bool done = false;
+
+        static bool step(void* context, uint8_t status)
+        {
+            FakeHAL::check_owner();
+            Read* read = static_cast<Read*>(context);
+            read->statuses.push_back(status);
+            if(status == CH376_ASYNC_START)
+            {
+                chip.command(CMD_BYTE_READ, read->count);
+                return false;
+            }
+            if(status == USB_INT_DISK_READ)
+            {
+                read->length += chip.read_block(&read->data[read->length]);
+                chip.command(CMD_BYTE_RD_GO);
+                return false;
+            }
+            read->done = status == USB_INT_SUCCESS;
+            return true;
+        }
+    };
+}
+
+SCENARIO("CH376 operations progress in the background", "[ch376]")
+{
+    GIVEN("A fake CH376 answering after 1 to 20 ms")
+    {
+        chip.reset();
+        Async async;
+        engine = &async;
+        unowned_access = false;
+
+        WHEN("A 40 bytes read is started")
+        {
+            Read read;
+            read.count = 40;
+            REQUIRE(async.start(Read::step, &read, 500));
+
+            THEN("It only writes the first command and does not wait")
+            {
+                REQUIRE(async.busy());
+                REQUIRE(chip.commands == 1);
+                REQUIRE(read.statuses.size() == 1);
+                REQUIRE(read.statuses[0] == CH376_ASYNC_START);
+            }
+
+            THEN("Polling before the chip answers does nothing")
+            {
+                REQUIRE_FALSE(async.poll());
+                REQUIRE(chip.status_reads == 0);
+                REQUIRE(read.statuses.size() == 1);
+            }
+
+            THEN("Polling every millisecond completes it with the right data")
+            {
+                unsigned polls = 0;
+                while(!async.poll())
+                {
+                    ++chip.now;
+                    ++polls;
+                }
+                REQUIRE(read.done);
+                REQUIRE(read.length == 40);
+                REQUIRE(std::memcmp(read.data, chip.file, 40) == 0);
+                // 3 blocks, each followed by RD_GO, then SUCCESS
+                REQUIRE(read.statuses.size() == 1 + 3 + 1);
+                REQUIRE(chip.status_reads == 4);
+                REQUIRE(polls >= 4);
+                REQUIRE_FALSE(async.busy());
+                REQUIRE_FALSE(unowned_access);
+            }
+
+            THEN("Another operation cannot start until it is over")
+            {
+                Read other;
+                other.count = 1;
+                REQUIRE_FALSE(async.start(Read::step, &other, 500));
+                REQUIRE(other.statuses.empty());
+
+                async.finish([]{ ++chip.now; });
+                REQUIRE(read.done);
+                REQUIRE(async.start(Read::step, &other, 500));
+            }
+        }
+
+        WHEN("A read goes past the end of the file")
+        {
+            chip.position = 90;
+            Read read;
+            read.count = 40;
+            async.start(Read::step, &read, 500);
+            async.finish([]{ ++chip.now; });
+
+            THEN("It ends with the bytes that were left")
+            {
+                REQUIRE(read.done);
+                REQUIRE(read.length == 10);
+                REQUIRE(std::memcmp(read.data, &chip.file[90], 10) == 0);
+            }
+        }
+
+        WHEN("The chip never answers")
+        {
+            chip.dead = true;
+            Read read;
+            read.count = 10;
+            async.start(Read::step, &read, 500);
+
+            THEN("The step gets a timeout once the delay is elapsed")
+            {
+                chip.now += 499;
+                REQUIRE_FALSE(async.poll());
+                chip.now += 1;
+                REQUIRE(async.poll());
+                REQUIRE(read.statuses.back() == CH376_ASYNC_TIMEOUT);
+                REQUIRE_FALSE(read.done);
+                REQUIRE_FALSE(async.busy());
+            }
+        }
+
+        engine = nullptr;
+    }
+
+    GIVEN("Random latencies, including answers within the same millisecond")
+    {
+        chip.reset();
+        chip.min_latency = 0;
+        chip.max_latency = 50;
+        Async async;
+        engine = &async;
+        unowned_access = false;
+
+        std::mt19937 random{1};
+        std::uniform_int_distribution<int> counts(1, 100), steps(0, 3);
+
+        bool all_good = true;
+        for(int i = 0; i < 500 && all_good; ++i)
+        {
+            chip.position = 0;
+            Read read;
+            read.count = static_cast<uint16_t>(counts(random));
+            all_good = async.start(Read::step, &read, 500);
+            // The idle loop does not run at a fixed period
+            async.finish([&]{ chip.now += steps(random); });
+            all_good = all_good && read.done && read.length == read.count &&
+                       std::memcmp(read.data, chip.file, read.count) == 0;
+        }
+
+        THEN("Every read completes with the right data")
+        {
+            REQUIRE(all_good);
+            REQUIRE_FALSE(unowned_access);
+        }
+
+        engine = nullptr;
+    }
+}
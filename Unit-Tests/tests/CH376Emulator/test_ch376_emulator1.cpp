@@ -0,0 +1,458 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "CH376Emulator.h"
+
+// What cardusbfile.cpp provides in the firmware
+
+UINT8 Wait376Interrupt()
+{
+    const uint32_t deadline = ch376.millis() + CH376_INT_TIMEOUT_MS;
+    while(!Query376Interrupt())
+        if(int32_t(ch376.millis() - deadline) >= 0)
+            return ERR_USB_UNKNOWN;
+    return CH376GetIntStatus();
+}
+
+void CH376BeforeCmd() {}
+
+namespace
+{
+    const std::string CUBE_LONG = "calibration cube.gcode";
+    const std::string BIG_LONG = "big fragmented print.gcode";
+    const std::string SPLIT_LONG = "long name across two sectors.gcode";
+
+    std::vector<uint8_t> make_data(uint32_t size, uint32_t seed)
+    {
+        std::vector<uint8_t> data(size);
+        std::mt19937 random{seed};
+        for(auto& d: data)
+            d = static_cast<uint8_t>(random());
+        return data;
+    }
+
+    const std::vector<uint8_t> cube = make_data(3000, 1);
+    const std::vector<uint8_t> big = make_data(300000, 2);
+
+    //! A stick like the ones of the users: a few files, some long names, a fragmented file
+    void make_stick(FatImage::Type type)
+    {
+        ch376.reset();
+        ch376.connect(true);
+        ch376.timing() = CH376Timing{};
+        FatImage& disk = ch376.disk();
+        const bool formatted = type == FatImage::Type::FAT16 ? disk.format(type, 32768, 4) : disk.format(type, 80000, 1);
+        REQUIRE(formatted);
+        REQUIRE(disk.add_file("/CUBE.GCO", cube, CUBE_LONG));
+        REQUIRE(disk.mkdir("/GCODES", "My prints"));
+        REQUIRE(disk.add_file("/README.TXT", make_data(100, 3)));
+        // Fill the first sector of the root so the next long name is on two sectors
+        for(char c = '1'; c <= '8'; ++c)
+            REQUIRE(disk.add_file(std::string("/F") + c + ".TXT", make_data(10, 4)));
+        REQUIRE(disk.add_file("/SPLIT.GCO", make_data(10, 5), SPLIT_LONG));
+        REQUIRE(disk.add_file("/GCODES/BIG.GCO", big, BIG_LONG, 2));
+        ch376.reset_counters();
+    }
+
+    void mount()
+    {
+        REQUIRE(CH376_init(EMST_USB_DISK) == USB_INT_SUCCESS);
+        REQUIRE(CH376DiskConnect() == USB_INT_SUCCESS);
+        REQUIRE(CH376DiskMount() == USB_INT_SUCCESS);
+    }
+
+    //! The CH376 functions take non-const strings
+    struct Path
+    {
+        explicit Path(const std::string& path): buffer(path.begin(), path.end()) { buffer.push_back(0); }
+        operator PUINT8() { return buffer.data(); }
+        std::vector<uint8_t> buffer;
+    };
+
+    std::vector<uint8_t> read(uint16_t count)
+    {
+        std::vector<uint8_t> data(count);
+        UINT16 length = 0;
+        REQUIRE(CH376ByteRead(data.data(), count, &length) == USB_INT_SUCCESS);
+        data.resize(length);
+        return data;
+    }
+
+    bool same(const std::vector<uint8_t>& data, const std::vector<uint8_t>& file, uint32_t offset)
+    {
+        return offset + data.size() <= file.size() && std::equal(data.begin(), data.end(), file.begin() + offset);
+    }
+
+    //! Enumerate the directory whose start cluster is 'cluster', like USBReader
+    std::vector<std::string> enumerate(uint32_t cluster)
+    {
+        std::vector<std::string> names;
+        CH376WriteVar32(VAR_START_CLUSTER, cluster);
+        CH376SetFileName(Path("*"));
+        UINT8 s = CH376SendCmdWaitInt(CMD0H_FILE_OPEN);
+        while(s == USB_INT_DISK_READ)
+        {
+            UINT8 buffer[64];
+            REQUIRE(CH376ReadBlock(buffer) == sizeof(FAT_DIR_INFO));
+            names.emplace_back(reinterpret_cast<char*>(buffer), 11);
+            s = CH376SendCmdWaitInt(CMD0H_FILE_ENUM_GO);
+        }
+        REQUIRE(s == ERR_MISS_FILE);
+        return names;
+    }
+
+    std::string long_name(const std::string& path)
+    {
+        UINT8 buffer[LONG_NAME_BUF_LEN + 2];
+        if(CH376GetLongName(Path(path), buffer) != USB_INT_SUCCESS)
+            return "";
+        std::string name;
+        for(int i = 0; buffer[i] || buffer[i + 1]; i += 2)
+            name += static_cast<char>(buffer[i]);
+        return name;
+    }
+}
+
+SCENARIO("The CH376 emulator mounts a USB stick", "[ch376]")
+{
+    GIVEN("A FAT16 stick")
+    {
+        make_stick(FatImage::Type::FAT16);
+
+        THEN("It is mounted like with the real chip")
+        {
+            mount();
+            REQUIRE(CH376GetDiskStatus() == DEF_DISK_READY);
+            REQUIRE(CH376ReadVar8(VAR_SEC_PER_CLUS) == 4);
+            UINT32 free = 0;
+            REQUIRE(CH376DiskQuery(&free) == USB_INT_SUCCESS);
+            REQUIRE(free == ch376.disk().free_clusters() * 4);
+        }
+
+        THEN("Without the stick, it is not connected")
+        {
+            ch376.connect(false);
+            REQUIRE(CH376_init(EMST_USB_DISK) == USB_INT_SUCCESS);
+            REQUIRE(CH376DiskConnect() == ERR_DISK_DISCON);
+            REQUIRE(CH376DiskMount() == ERR_DISK_DISCON);
+        }
+
+        THEN("It can be saved to an image file and loaded back")
+        {
+            const std::string path = "ch376_emulator_test.img";
+            REQUIRE(ch376.disk().save(path));
+            REQUIRE(ch376.disk().format(FatImage::Type::FAT16, 32768, 4));
+            REQUIRE(ch376.disk().load(path));
+            std::remove(path.c_str());
+            mount();
+            REQUIRE(CH376FileOpenPath(Path("/GCODES/BIG.GCO")) == USB_INT_SUCCESS);
+            REQUIRE(CH376GetFileSize() == big.size());
+        }
+    }
+
+    GIVEN("Something that is not FAT16 or FAT32")
+    {
+        make_stick(FatImage::Type::FAT16);
+        ch376.disk().sector(0)[12] = 0;   // 0 bytes per sector
+
+        THEN("It is not mounted")
+        {
+            REQUIRE(CH376DiskConnect() == USB_INT_SUCCESS);
+            REQUIRE(CH376DiskMount() == ERR_TYPE_ERROR);
+            REQUIRE(CH376FileOpenPath(Path("/CUBE.GCO")) == ERR_DISK_DISCON);
+        }
+    }
+}
+
+SCENARIO("The CH376 emulator opens and reads files", "[ch376]")
+{
+    for(auto type: {FatImage::Type::FAT16, FatImage::Type::FAT32})
+    {
+        const bool fat16 = type == FatImage::Type::FAT16;
+        const char* stick = fat16 ? "A FAT16 stick" : "A FAT32 stick";
+        GIVEN(stick)
+        {
+            make_stick(type);
+            mount();
+
+            THEN("Paths are opened level by level")
+            {
+                REQUIRE(CH376FileOpenPath(Path("/CUBE.GCO")) == USB_INT_SUCCESS);
+                REQUIRE(CH376GetFileSize() == cube.size());
+                REQUIRE(CH376FileOpenPath(Path("/gcodes/big.gco")) == USB_INT_SUCCESS);
+                REQUIRE(CH376FileOpenPath(Path("/GCODES")) == ERR_OPEN_DIR);
+                REQUIRE(CH376FileOpenPath(Path("/")) == ERR_OPEN_DIR);
+                REQUIRE(CH376FileOpenPath(Path("/MISSING.GCO")) == ERR_MISS_FILE);
+                REQUIRE(CH376FileOpenPath(Path("/MISSING/BIG.GCO")) == ERR_MISS_DIR);
+                REQUIRE(CH376FileOpenPath(Path("/CUBE.GCO/BIG.GCO")) == ERR_FOUND_NAME);
+            }
+
+            THEN("A name without separator is in the directory of VAR_START_CLUSTER")
+            {
+                REQUIRE(CH376FileOpen(Path("/GCODES")) == ERR_OPEN_DIR);
+                REQUIRE(CH376FileOpen(Path("BIG.GCO")) == USB_INT_SUCCESS);
+                REQUIRE(CH376FileOpen(Path("/BIG.GCO")) == ERR_MISS_FILE);
+            }
+
+            THEN("Files are read by bytes, up to their end")
+            {
+                REQUIRE(CH376FileOpenPath(Path("/CUBE.GCO")) == USB_INT_SUCCESS);
+                const auto start = read(1000);
+                REQUIRE(start.size() == 1000);
+                REQUIRE(same(start, cube, 0));
+                REQUIRE(CH376ByteLocate(2500) == USB_INT_SUCCESS);
+                const auto end = read(1000);
+                REQUIRE(end.size() == 500);
+                REQUIRE(same(end, cube, 2500));
+                REQUIRE(read(10).empty());
+                REQUIRE(CH376FileClose(FALSE) == USB_INT_SUCCESS);
+            }
+
+            THEN("A fragmented file is read whole, and at random places")
+            {
+                REQUIRE(CH376FileOpenPath(Path("/GCODES/BIG.GCO")) == USB_INT_SUCCESS);
+                std::vector<uint8_t> all;
+                for(auto block = read(1000); !block.empty(); block = read(1000))
+                    all.insert(all.end(), block.begin(), block.end());
+                REQUIRE(all == big);
+
+                std::mt19937 random{7};
+                std::uniform_int_distribution<uint32_t> offsets(0, static_cast<uint32_t>(big.size()) - 1);
+                bool all_good = true;
+                for(int i = 0; i < 200 && all_good; ++i)
+                {
+                    const uint32_t offset = offsets(random);
+                    all_good = CH376ByteLocate(offset) == USB_INT_SUCCESS &&
+                               CH376ReadVar32(VAR_CURRENT_OFFSET) == offset &&
+                               same(read(100), big, offset);
+                }
+                REQUIRE(all_good);
+            }
+
+            THEN("Files are read by sectors, a cluster at most at a time")
+            {
+                REQUIRE(CH376FileOpenPath(Path("/CUBE.GCO")) == USB_INT_SUCCESS);
+                std::vector<uint8_t> buffer(8 * DEF_SECTOR_SIZE);
+                UINT8 count = 0;
+                REQUIRE(CH376SecRead(buffer.data(), 8, &count) == USB_INT_SUCCESS);
+                REQUIRE(count == 6);
+                buffer.resize(cube.size());
+                REQUIRE(buffer == cube);
+                REQUIRE(ch376.counters().command[CMD1H_SEC_READ] == (fat16 ? 3u : 7u));
+            }
+
+            THEN("The directory information of a file is read")
+            {
+                REQUIRE(CH376FileOpenPath(Path("/CUBE.GCO")) == USB_INT_SUCCESS);
+                REQUIRE(CH376DirInfoRead() == USB_INT_SUCCESS);
+                FAT_DIR_INFO info;
+                REQUIRE(CH376ReadBlock(reinterpret_cast<PUINT8>(&info)) == sizeof(info));
+                CH376EndDirInfo();
+                REQUIRE(std::memcmp(info.DIR_Name, "CUBE    GCO", 11) == 0);
+                REQUIRE(info.DIR_FileSize == cube.size());
+                REQUIRE((info.DIR_Attr & ATTR_DIRECTORY) == 0);
+            }
+
+            THEN("Directories are enumerated, the root starting with the volume label")
+            {
+                const auto root = enumerate(0);
+                REQUIRE(root.size() == 13);
+                REQUIRE(root[0] == "3DLABS     ");
+                REQUIRE(root[1] == "CUBE    GCO");
+                REQUIRE(root[2] == "GCODES     ");
+                REQUIRE(root[12] == "SPLIT   GCO");
+
+                REQUIRE(CH376FileOpenPath(Path("/GCODES")) == ERR_OPEN_DIR);
+                const auto gcodes = enumerate(CH376ReadVar32(VAR_START_CLUSTER));
+                REQUIRE(gcodes == std::vector<std::string>({".          ", "..         ", "BIG     GCO"}));
+            }
+
+            THEN("Long names are found before the short names, even in the previous sector")
+            {
+                REQUIRE(long_name("/CUBE.GCO") == CUBE_LONG);
+                REQUIRE(long_name("/GCODES") == "My prints");
+                REQUIRE(long_name("/GCODES/BIG.GCO") == BIG_LONG);
+                REQUIRE(long_name("/SPLIT.GCO") == SPLIT_LONG);
+                REQUIRE(long_name("/README.TXT").empty());
+            }
+        }
+    }
+}
+
+SCENARIO("The CH376 emulator measures the transactions", "[ch376]")
+{
+    GIVEN("A mounted stick with a fragmented file")
+    {
+        make_stick(FatImage::Type::FAT16);
+        mount();
+        REQUIRE(CH376FileOpenPath(Path("/GCODES/BIG.GCO")) == USB_INT_SUCCESS);
+        ch376.reset_counters();
+
+        WHEN("1000 bytes are read")
+        {
+            const uint64_t start = ch376.now_ns();
+            read(1000);
+            const uint64_t elapsed = ch376.now_ns() - start;
+
+            THEN("They come in blocks of 64 bytes, from sectors read once")
+            {
+                REQUIRE(ch376.counters().command[CMD2H_BYTE_READ] == 1);
+                REQUIRE(ch376.counters().command[CMD0H_BYTE_RD_GO] == 16);
+                REQUIRE(ch376.counters().interrupts == 17);
+                REQUIRE(ch376.counters().sectors - ch376.counters().fat_sectors == 2);
+                REQUIRE(elapsed >= (17 * 20 + 2 * 400) * 1000ULL);
+            }
+
+            THEN("Slower sectors make it slower")
+            {
+                REQUIRE(CH376ByteLocate(0) == USB_INT_SUCCESS);
+                ch376.timing().sector_us = 2000;
+                const uint64_t restart = ch376.now_ns();
+                read(1000);
+                REQUIRE(ch376.now_ns() - restart > elapsed);
+            }
+        }
+
+        WHEN("The end of the file is located from its start or from a cluster close to it")
+        {
+            const uint32_t offset = static_cast<uint32_t>(big.size()) - 100;
+            REQUIRE(CH376ByteLocate(offset) == USB_INT_SUCCESS);
+            const uint32_t from_start = ch376.counters().fat_sectors;
+            const uint32_t cluster = CH376ReadVar32(VAR_CURRENT_CLUST);
+            const uint32_t base = offset - offset % 2048;
+
+            REQUIRE(CH376ByteLocate(0) == USB_INT_SUCCESS);
+            ch376.reset_counters();
+            CH376WriteVar32(VAR_START_CLUSTER, cluster);
+            CH376WriteVar32(VAR_FILE_SIZE, static_cast<uint32_t>(big.size()) - base);
+            REQUIRE(CH376ByteLocate(offset - base) == USB_INT_SUCCESS);
+
+            THEN("Walking fewer clusters reads fewer FAT sectors, for the same data")
+            {
+                REQUIRE(from_start >= 1);
+                REQUIRE(ch376.counters().fat_sectors < from_start);
+                REQUIRE(same(read(100), big, offset));
+            }
+        }
+
+        WHEN("The chip takes longer than the timeout to answer")
+        {
+            ch376.timing().command_us[CMD4H_BYTE_LOCATE] = (CH376_INT_TIMEOUT_MS + 100) * 1000;
+
+            THEN("The wait times out")
+            {
+                REQUIRE(CH376ByteLocate(0) == ERR_USB_UNKNOWN);
+                REQUIRE(ch376.counters().polls > 1000);
+            }
+        }
+
+        WHEN("The firmware tries to write sectors")
+        {
+            THEN("The write fails, it is not emulated")
+            {
+                UINT8 data[FatImage::SECTOR] = {};
+                REQUIRE(CH376SecWrite(data, 1, nullptr) == USB_INT_DISK_ERR);
+                REQUIRE(ch376.counters().unsupported == 1);
+            }
+        }
+    }
+}
+
+SCENARIO("The CH376 emulator writes files", "[ch376]")
+{
+    for(auto type: {FatImage::Type::FAT16, FatImage::Type::FAT32})
+    {
+        const bool fat16 = type == FatImage::Type::FAT16;
+        const char* stick = fat16 ? "A FAT16 stick" : "A FAT32 stick";
+        GIVEN(stick)
+        {
+            make_stick(type);
+            mount();
+            const uint32_t free_clusters = ch376.disk().free_clusters();
+
+            WHEN("A new file is written in pieces and closed")
+            {
+                const auto data = make_data(5000, 6);
+                REQUIRE(CH376FileCreatePath(Path("/GCODES/NEW.GCO")) == USB_INT_SUCCESS);
+                for(uint32_t offset = 0; offset < data.size(); offset += 100)
+                {
+                    UINT16 length = 0;
+                    REQUIRE(CH376ByteWrite(const_cast<PUINT8>(&data[offset]), 100, &length) == USB_INT_SUCCESS);
+                    REQUIRE(length == 100);
+                }
+                REQUIRE(CH376FileClose(TRUE) == USB_INT_SUCCESS);
+
+                THEN("The disk has the file, in new clusters")
+                {
+                    REQUIRE(ch376.disk().file("/GCODES/NEW.GCO") == data);
+                    const uint32_t cluster_bytes = ch376.disk().sectors_per_cluster() * FatImage::SECTOR;
+                    REQUIRE(free_clusters - ch376.disk().free_clusters() == (5000 + cluster_bytes - 1) / cluster_bytes);
+                    REQUIRE(ch376.disk().file("/GCODES/BIG.GCO") == big);
+                }
+
+                THEN("It can be read back")
+                {
+                    REQUIRE(CH376FileOpenPath(Path("/GCODES/NEW.GCO")) == USB_INT_SUCCESS);
+                    REQUIRE(CH376GetFileSize() == 5000);
+                    REQUIRE(CH376ByteLocate(4000) == USB_INT_SUCCESS);
+                    REQUIRE(same(read(1000), data, 4000));
+                }
+            }
+
+            WHEN("An existing file is created again")
+            {
+                UINT8 data[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+                REQUIRE(CH376FileCreatePath(Path("/CUBE.GCO")) == USB_INT_SUCCESS);
+                REQUIRE(CH376ByteWrite(data, sizeof(data), nullptr) == USB_INT_SUCCESS);
+                REQUIRE(CH376FileClose(TRUE) == USB_INT_SUCCESS);
+
+                THEN("Its old clusters are free and it only has the new bytes")
+                {
+                    REQUIRE(ch376.disk().file("/CUBE.GCO") == std::vector<uint8_t>(data, data + sizeof(data)));
+                    const uint32_t cluster_bytes = ch376.disk().sectors_per_cluster() * FatImage::SECTOR;
+                    REQUIRE(ch376.disk().free_clusters() - free_clusters == (3000 + cluster_bytes - 1) / cluster_bytes - 1);
+                }
+            }
+
+            WHEN("Bytes are written in the middle of a sector")
+            {
+                UINT8 data[3] = {'a', 'b', 'c'};
+                REQUIRE(CH376FileCreatePath(Path("/LOG.TXT")) == USB_INT_SUCCESS);
+                ch376.reset_counters();
+                REQUIRE(CH376ByteWrite(data, sizeof(data), nullptr) == USB_INT_SUCCESS);
+                const uint32_t first = ch376.counters().sectors_written;
+                REQUIRE(CH376ByteWrite(data, sizeof(data), nullptr) == USB_INT_SUCCESS);
+
+                THEN("The sector is written back at the end of each command")
+                {
+                    REQUIRE(first == 2);    // The FAT for the first cluster, then the data
+                    REQUIRE(ch376.counters().sectors_written == 3);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,154 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <random>
+#include <vector>
+#include "catch.hpp"
+#include "CH376SeekMap.h"
+
+namespace
+{
+    const uint32_t CLUSTER = 4096, BLOCK = 64;
+
+    //! A fragmented file: the clusters of its chain are not contiguous
+    std::vector<uint32_t> make_chain(uint32_t size)
+    {
+        std::vector<uint32_t> chain((size + CLUSTER - 1) / CLUSTER);
+        std::mt19937 random{3};
+        std::uniform_int_distribution<uint32_t> gap(1, 5);
+        uint32_t cluster = 2;
+        for(auto& c: chain)
+            c = cluster += gap(random);
+        return chain;
+    }
+
+    //! Cluster the CH376 reports with the file pointer at 'offset'. At a boundary it may be either.
+    uint32_t current_cluster(const std::vector<uint32_t>& chain, uint32_t offset)
+    {
+        return chain[offset / CLUSTER];
+    }
+
+    //! Read the file sequentially from 'from' to 'to', noting like USBFile does
+    template<typename MAP>
+    void read(MAP& map, const std::vector<uint32_t>& chain, uint32_t from, uint32_t to)
+    {
+        for(uint32_t offset = from + BLOCK; offset <= to; offset += BLOCK)
+            if(map.wanted(offset))
+                map.note(offset, current_cluster(chain, offset));
+    }
+}
+
+SCENARIO("Cluster checkpoints of a file read sequentially", "[seek]")
+{
+    GIVEN("An empty map")
+    {
+        ClusterCheckpoints<16> map;
+        map.reset(CLUSTER, 0x10000);
+        uint32_t start = 0, cluster = 0;
+
+        THEN("There is no checkpoint")
+        {
+            REQUIRE_FALSE(map.nearest(1000000, start, cluster));
+        }
+
+        THEN("Cluster boundaries are not wanted, even past the spacing")
+        {
+            REQUIRE_FALSE(map.wanted(0x10000));
+            REQUIRE(map.wanted(0x10000 + BLOCK));
+            REQUIRE_FALSE(map.wanted(0x10000 - BLOCK));
+        }
+    }
+
+    GIVEN("A map without cluster size")
+    {
+        ClusterCheckpoints<16> map;
+        map.reset(0, 0x10000);
+        map.note(0x20040, 12);
+
+        THEN("It notes nothing")
+        {
+            uint32_t start, cluster;
+            REQUIRE_FALSE(map.wanted(0x20040));
+            REQUIRE_FALSE(map.nearest(0x30000, start, cluster));
+        }
+    }
+
+    GIVEN("A 50 MB fragmented file read from start to end")
+    {
+        const uint32_t size = 50UL * 1024 * 1024;
+        const auto chain = make_chain(size);
+        ClusterCheckpoints<16> map;
+        map.reset(CLUSTER, 0x10000);
+        read(map, chain, 0, size);
+
+        THEN("The map is full and its spacing grew to cover the whole file")
+        {
+            REQUIRE(map.count() <= 16);
+            REQUIRE(map.count() >= 8);
+            REQUIRE(map.spacing() * 16 >= size);
+            REQUIRE(map.spacing() * 4 <= size);
+        }
+
+        THEN("Any offset has a checkpoint before it, on the right cluster, at most two spacings away")
+        {
+            std::mt19937 random{7};
+            std::uniform_int_distribution<uint32_t> offsets(2 * map.spacing(), size - 1);
+            bool all_good = true;
+            for(int i = 0; i < 10000 && all_good; ++i)
+            {
+                const uint32_t offset = offsets(random);
+                uint32_t start = 0, cluster = 0;
+                all_good = map.nearest(offset, start, cluster) &&
+                           start <= offset && start % CLUSTER == 0 &&
+                           offset - start < 2 * map.spacing() &&
+                           cluster == chain[start / CLUSTER];
+            }
+            REQUIRE(all_good);
+        }
+    }
+
+    GIVEN("A file read in the middle after a seek, then from the start again")
+    {
+        const uint32_t size = 1024UL * 1024;
+        const auto chain = make_chain(size);
+        ClusterCheckpoints<16> map;
+        map.reset(CLUSTER, 0x10000);
+        read(map, chain, 0x80000, 0xA0000);
+        const uint8_t count = map.count();
+        read(map, chain, 0, 0x40000);
+
+        THEN("Reading again before the last checkpoint adds nothing")
+        {
+            REQUIRE(count == 2);
+            REQUIRE(map.count() == count);
+        }
+
+        THEN("Offsets before the first checkpoint have none")
+        {
+            uint32_t start, cluster;
+            REQUIRE_FALSE(map.nearest(0x7FFFF, start, cluster));
+            REQUIRE(map.nearest(0x95000, start, cluster));
+            REQUIRE(start == 0x90000);
+            REQUIRE(cluster == chain[start / CLUSTER]);
+            REQUIRE(map.nearest(0x90000, start, cluster));
+            REQUIRE(start == 0x90000);
+        }
+    }
+}
@@ -0,0 +1,326 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "CH376Upload.h"
+
+// What cardusbfile.cpp provides in the firmware
+
+UINT8 Wait376Interrupt()
+{
+    const uint32_t deadline = ch376.millis() + CH376_INT_TIMEOUT_MS;
+    while(!Query376Interrupt())
+        if(int32_t(ch376.millis() - deadline) >= 0)
+            return ERR_USB_UNKNOWN;
+    return CH376GetIntStatus();
+}
+
+void CH376BeforeCmd() {}
+
+namespace
+{
+    //! Keeps what it is given, in pieces
+    struct MemorySink
+    {
+        static bool write(const uint8_t* data, uint16_t length)
+        {
+            if(fail)
+                return false;
+            pieces.emplace_back(data, data + length);
+            return true;
+        }
+
+        static std::vector<std::vector<uint8_t>> pieces;
+        static bool fail;
+    };
+
+    std::vector<std::vector<uint8_t>> MemorySink::pieces;
+    bool MemorySink::fail = false;
+
+    //! Writes to the emulated USB stick, like USBFile::write
+    struct CH376Sink
+    {
+        static bool write(const uint8_t* data, uint16_t length)
+        {
+            return CH376ByteWrite(const_cast<PUINT8>(data), length, nullptr) == USB_INT_SUCCESS;
+        }
+    };
+
+    //! An upload as sent by a host: G1 moves, about 30 bytes each
+    std::vector<std::string> make_gcode(int count)
+    {
+        std::vector<std::string> lines;
+        for(int i = 0; i < count; ++i)
+        {
+            char line[64];
+            std::snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.5f\r\n", 10 + (i % 200) * 0.731, 20 + (i % 170) * 0.913, i * 0.0213);
+            lines.emplace_back(line);
+        }
+        return lines;
+    }
+
+    std::vector<uint8_t> join(const std::vector<std::string>& lines)
+    {
+        std::vector<uint8_t> data;
+        for(const auto& line: lines)
+            data.insert(data.end(), line.begin(), line.end());
+        return data;
+    }
+
+    void make_stick()
+    {
+        ch376.reset();
+        ch376.connect(true);
+        ch376.timing() = CH376Timing{};
+        REQUIRE(ch376.disk().format(FatImage::Type::FAT16, 65536, 4));
+        REQUIRE(CH376_init(EMST_USB_DISK) == USB_INT_SUCCESS);
+        REQUIRE(CH376DiskConnect() == USB_INT_SUCCESS);
+        REQUIRE(CH376DiskMount() == USB_INT_SUCCESS);
+    }
+
+    //! Create 'path', write the lines with 'write' and close. Return the upload speed in KB/s.
+    template<typename WRITE>
+    double upload(const char* path, const std::vector<std::string>& lines, WRITE write)
+    {
+        std::vector<uint8_t> name(path, path + std::strlen(path) + 1);
+        REQUIRE(CH376FileCreatePath(name.data()) == USB_INT_SUCCESS);
+        ch376.reset_counters();
+        const uint64_t start = ch376.now_ns();
+        uint32_t bytes = 0;
+        for(const auto& line: lines)
+        {
+            REQUIRE(write(line));
+            bytes += static_cast<uint32_t>(line.size());
+        }
+        REQUIRE(write(std::string()));
+        REQUIRE(CH376FileClose(TRUE) == USB_INT_SUCCESS);
+        return bytes / 1024.0 / ((ch376.now_ns() - start) / 1e9);
+    }
+}
+
+SCENARIO("Bytes are gathered and written a buffer at a time", "[upload]")
+{
+    GIVEN("A buffer of 16 bytes")
+    {
+        uint8_t storage[16];
+        WriteBuffer<16, MemorySink> buffer;
+        buffer.reset(storage);
+        MemorySink::pieces.clear();
+        MemorySink::fail = false;
+
+        WHEN("Less than 16 bytes are written")
+        {
+            REQUIRE(buffer.write("G28\r\n", 5));
+            REQUIRE(buffer.write("G1 X1\r\n", 7));
+
+            THEN("Nothing is written until the buffer is flushed")
+            {
+                REQUIRE(MemorySink::pieces.empty());
+                REQUIRE(buffer.pending() == 12);
+                REQUIRE(buffer.flush());
+                REQUIRE(MemorySink::pieces.size() == 1);
+                REQUIRE(std::string(MemorySink::pieces[0].begin(), MemorySink::pieces[0].end()) == "G28\r\nG1 X1\r\n");
+                REQUIRE(buffer.pending() == 0);
+                REQUIRE(buffer.written() == 12);
+            }
+
+            THEN("Flushing an empty buffer writes nothing")
+            {
+                REQUIRE(buffer.flush());
+                REQUIRE(buffer.flush());
+                REQUIRE(MemorySink::pieces.size() == 1);
+            }
+        }
+
+        WHEN("40 bytes are written at once")
+        {
+            const std::string data = "0123456789abcdefghijklmnopqrstuvwxyzABCD";
+            REQUIRE(buffer.write(data.data(), 40));
+
+            THEN("They are written in pieces of 16 bytes, the rest stays in the buffer")
+            {
+                REQUIRE(MemorySink::pieces.size() == 2);
+                REQUIRE(MemorySink::pieces[0].size() == 16);
+                REQUIRE(MemorySink::pieces[1].size() == 16);
+                REQUIRE(std::string(MemorySink::pieces[1].begin(), MemorySink::pieces[1].end()) == data.substr(16, 16));
+                REQUIRE(buffer.pending() == 8);
+                REQUIRE(buffer.written() == 32);
+            }
+        }
+
+        WHEN("A write fails")
+        {
+            MemorySink::fail = true;
+            const bool first = buffer.write("0123456789abcdef", 16);
+            MemorySink::fail = false;
+
+            THEN("The error stays until the buffer is reset")
+            {
+                REQUIRE_FALSE(first);
+                REQUIRE(buffer.error());
+                REQUIRE_FALSE(buffer.write("G28\r\n", 5));
+                REQUIRE_FALSE(buffer.flush());
+                REQUIRE(MemorySink::pieces.empty());
+                buffer.reset(storage);
+                REQUIRE(buffer.write("G28\r\n", 5));
+                REQUIRE(buffer.flush());
+                REQUIRE(MemorySink::pieces.size() == 1);
+            }
+        }
+    }
+}
+
+SCENARIO("Bytes are written as they come without a buffer", "[upload]")
+{
+    GIVEN("A write buffer without RAM")
+    {
+        WriteBuffer<16, MemorySink> buffer;
+        buffer.reset(nullptr);
+        MemorySink::pieces.clear();
+        MemorySink::fail = false;
+
+        WHEN("Bytes are written")
+        {
+            REQUIRE(buffer.write("G28\r\n", 5));
+            REQUIRE(buffer.write("G1 X1\r\n", 7));
+
+            THEN("Each write goes straight to the sink")
+            {
+                REQUIRE(MemorySink::pieces.size() == 2);
+                REQUIRE(buffer.pending() == 0);
+                REQUIRE(buffer.written() == 12);
+                REQUIRE(buffer.flush());
+                REQUIRE(MemorySink::pieces.size() == 2);
+            }
+        }
+
+        WHEN("A write fails")
+        {
+            MemorySink::fail = true;
+            REQUIRE_FALSE(buffer.write("G28\r\n", 5));
+            MemorySink::fail = false;
+
+            THEN("The error stays")
+            {
+                REQUIRE_FALSE(buffer.write("G28\r\n", 5));
+                REQUIRE_FALSE(buffer.flush());
+            }
+        }
+    }
+}
+
+SCENARIO("A binary upload counts its bytes and their checksum", "[upload]")
+{
+    GIVEN("An upload of 8 bytes")
+    {
+        BinaryUpload upload;
+        REQUIRE_FALSE(upload.active());
+        upload.start(8);
+
+        THEN("It ends with the last byte and has the Fletcher-16 checksum of the bytes")
+        {
+            const std::string data = "abcdefgh";
+            for(size_t i = 0; i < data.size(); ++i)
+            {
+                REQUIRE(upload.active());
+                REQUIRE(upload.received() == i);
+                REQUIRE(upload.add(static_cast<uint8_t>(data[i])) == (i == data.size() - 1));
+            }
+            REQUIRE_FALSE(upload.active());
+            REQUIRE(upload.remaining() == 0);
+            REQUIRE(upload.checksum() == 0x0627);
+        }
+
+        THEN("Stopping it makes it inactive")
+        {
+            upload.add('a');
+            upload.stop();
+            REQUIRE_FALSE(upload.active());
+        }
+    }
+
+    GIVEN("Other known checksums")
+    {
+        BinaryUpload upload;
+        upload.start(6);
+        for(char c: std::string("abcde"))
+            upload.add(static_cast<uint8_t>(c));
+        REQUIRE(upload.checksum() == 0xC8F0);
+        upload.add('f');
+        REQUIRE(upload.checksum() == 0x2057);
+    }
+}
+
+SCENARIO("Uploads are faster when written a sector at a time", "[upload]")
+{
+    GIVEN("A USB stick and an upload of 2000 lines")
+    {
+        make_stick();
+        const auto lines = make_gcode(2000);
+        const auto data = join(lines);
+
+        WHEN("It is written line by line, then through a buffer of 512 bytes")
+        {
+            // One CH376ByteWrite per line, like USBReader::write_command used to do
+            const double by_line = upload("/LINES.GCO", lines, [](const std::string& line)
+            {
+                return line.empty() || CH376ByteWrite(reinterpret_cast<PUINT8>(const_cast<char*>(line.data())),
+                                                      static_cast<UINT16>(line.size()), nullptr) == USB_INT_SUCCESS;
+            });
+            const CH376Counters line_counters = ch376.counters();
+
+            uint8_t sector[512];
+            WriteBuffer<512, CH376Sink> buffer;
+            buffer.reset(sector);
+            const double by_sector = upload("/SECTORS.GCO", lines, [&buffer](const std::string& line)
+            {
+                return line.empty() ? buffer.flush() : buffer.write(line.data(), static_cast<uint16_t>(line.size()));
+            });
+            const CH376Counters sector_counters = ch376.counters();
+
+            THEN("Both files have the upload")
+            {
+                REQUIRE(ch376.disk().file("/LINES.GCO") == data);
+                REQUIRE(ch376.disk().file("/SECTORS.GCO") == data);
+            }
+
+            THEN("The buffer writes each data sector once, with far fewer commands")
+            {
+                const uint32_t sectors = static_cast<uint32_t>((data.size() + 511) / 512);
+                const uint32_t clusters = (sectors + 3) / 4;
+                REQUIRE(line_counters.command[CMD2H_BYTE_WRITE] == lines.size());
+                REQUIRE(line_counters.sectors_written >= lines.size());
+                REQUIRE(sector_counters.command[CMD2H_BYTE_WRITE] == sectors);
+                // Data sectors, a FAT sector per cluster and the directory entry at the end
+                REQUIRE(sector_counters.sectors_written == sectors + clusters + 1);
+            }
+
+            THEN("The upload is more than 4 times faster")
+            {
+                INFO("Line by line: " << by_line << " KB/s, by sector: " << by_sector << " KB/s");
+                REQUIRE(by_sector > 4 * by_line);
+            }
+        }
+    }
+}
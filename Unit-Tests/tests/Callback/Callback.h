@@ -0,0 +1,42 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef UNIT_TESTS_CALLBACK_H
+#define UNIT_TESTS_CALLBACK_H
+
+#include <new>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+// ADVstd.h defines a placement new, already in <new> on the host: use the standard library
+#define ADVSTD_H
+namespace adv
+{
+    using std::size_t;
+    using std::nullptr_t;
+    using std::forward;
+    using std::is_void;
+    using std::copy;
+}
+
+#include "../../../Marlin/ADVcallback.h"
+
+#endif //UNIT_TESTS_CALLBACK_H
@@ -0,0 +1,364 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <type_traits>
+#include "catch.hpp"
+#include "Callback.h"
+
+using adv::Callback;
+
+//! The previous implementation, with a virtual Callable placed in a buffer, to compare with
+namespace previous
+{
+    using namespace adv;
+
+    namespace internal {
+        template<typename I>
+        void copy_data(const I& i, void* o)
+        {
+            auto p = reinterpret_cast<const char*>(&i);
+            copy(p, p + sizeof(I), reinterpret_cast<char*>(o));
+        }
+    }
+
+    template<typename R, typename...A>
+    struct Callable
+    {
+        virtual void clone(void* dest) const = 0;
+        virtual R operator()(A&&...args) const = 0;
+        virtual ~Callable() = default;
+    };
+
+    template<typename R, typename...A>
+    struct CallableFunction: public Callable<R, A...>
+    {
+        using FP = R(*)(A...);
+        using Super = Callable<R, A...>;
+        using Self = CallableFunction<R, A...>;
+
+        explicit CallableFunction(FP f): function_{f} {}
+        void clone(void* dest) const override { internal::copy_data(function_, dest); }
+
+        R operator()(A&&...args) const override { if(is_void<R>::value) function_(forward<A>(args)...);
+            else return function_(forward<A>(args)...); }
+
+    private:
+        FP function_;
+    };
+
+    template<typename O, typename R, typename...A>
+    struct CallableMethod: public Callable<R, A...>
+    {
+        using MP = R(O::*)(A...); // Pointer to member function type
+        using Super = Callable<R, A...>;
+        using Self = CallableMethod<O, R, A...>;
+
+        CallableMethod(O& o, MP m): f_{o, m} {}
+        void clone(void* dest) const override { internal::copy_data(f_, dest); }
+
+        R operator()(A&&...args) const override { if(is_void<R>::value) (f_.object_.*f_.method_)(forward<A>(args)...);
+            else return (f_.object_.*f_.method_)(forward<A>(args)...); }
+
+    private:
+        struct fields { O& object_; MP method_; } f_{};
+    };
+
+    template<typename O, typename R, typename...A>
+    struct CallableConstMethod: public Callable<R, A...>
+    {
+        using MP = R(O::*)(A...) const; // Pointer to member function type
+        using Super = Callable<R, A...>;
+        using Self = CallableMethod<O, R, A...>;
+
+        CallableConstMethod(const O& o, MP m): f_{o, m} {}
+        void clone(void* dest) const override { internal::copy_data(f_, dest); }
+
+        R operator()(A&&...args) const override { if(is_void<R>::value) (f_.object_.*f_.method_)(forward<A>(args)...);
+            else return (f_.object_.*f_.method_)(forward<A>(args)...); }
+
+    private:
+        struct fields { const O& object_; MP method_; } f_{};
+    };
+
+    template<typename>
+    struct Callback;
+
+    template <typename R, typename... A>
+    struct Callback<R(*)(A...)>
+    {
+        using FP = R(*)(A...);
+        using Self = Callback<R(*)(A...)>;
+
+        // Empty callback
+        Callback() noexcept = default;
+        explicit Callback(nullptr_t) noexcept {}
+
+        // From a function
+        explicit Callback(FP f): isNull_{false} { place<CallableFunction<R, A...>>(f); }
+
+        // From a member function and object reference
+        template <typename O>
+        Callback(O& o, R(O::*m)(A...)): isNull_{false}  { place<CallableMethod<O, R, A...>>(o, m); }
+
+        // From a member function and object pointer
+        template <typename O>
+        Callback(O* o, R(O::*m)(A...)): isNull_{false}  { place<CallableMethod<O, R, A...>>(*o, m); }
+
+        // From a const member function and object reference
+        template <typename O>
+        Callback(const O& o, R(O::*m)(A...)): isNull_{false}  { place<CallableConstMethod<O, R, A...>>(o, m); }
+
+        // From a const member function and object pointer
+        template <typename O>
+        Callback(const O* o, R(O::*m)(A...)): isNull_{false}  { place<CallableConstMethod<O, R, A...>>(*o, m); }
+
+        // Captured lambda specialization
+        template<typename L>
+        explicit Callback(const L& l): isNull_{false}  { place<CallableFunction<R, A...>>(l); }
+
+        // From another Callback
+        Callback(const Self& cb): isNull_{cb.isNull_}  { copy_buffer(cb.buffer_); }
+
+        // Assignment
+        Callback& operator=(const Self& cb) { if(&cb != this) { isNull_ = cb.isNull_;  copy_buffer(cb.buffer_); } return *this; };
+        Callback& operator=(nullptr_t) { isNull_ = true; return *this; }
+
+        // Call
+        R operator()(A&&... args)
+            { if(is_void<R>::value) { if(!isNull_) (*callable())(forward<A>(args)...); }
+              else { return !isNull_ ? (*callable())(forward<A>(args)...) : R(); } }
+
+        // Boolean
+        explicit operator bool() const noexcept { return !isNull_; }
+
+    private:
+        void copy_buffer(const char* from) { copy(from, from + BUFFER_SIZE, buffer_); }
+        Callable<R, A...>* callable() { return reinterpret_cast<Callable<R, A...>*>(buffer_); }
+
+        template<typename T, typename... Args> void place(Args&&... args)
+        { static_assert(sizeof(T) <= BUFFER_SIZE, "Buffer is too small"); new(buffer_) T(forward<Args>(args)...); }
+
+    private:
+        static const size_t BUFFER_SIZE = 4 * sizeof(void*); // 8 on the ATmega
+        char buffer_[BUFFER_SIZE] = {};
+        bool isNull_ = true;
+    };
+
+}
+
+namespace
+{
+    struct Counter
+    {
+        int count = 0;
+        void increment() { ++count; }
+        bool check() { ++count; return count > 1; }
+        int add(int a, int b) { count += a + b; return count; }
+        int get() const { return count; }
+    };
+
+    int function_calls = 0;
+    void function() { ++function_calls; }
+
+    using Clock = std::chrono::steady_clock;
+
+    //! Time of an operation in ns, repeated n times
+    template<typename F>
+    double measure(unsigned n, F f)
+    {
+        auto start = Clock::now();
+        for(unsigned i = 0; i < n; ++i)
+            f(i);
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n;
+    }
+}
+
+SCENARIO("A Callback calls a member function")
+{
+    GIVEN("An object")
+    {
+        Counter counter;
+
+        WHEN("A callback is made with a pointer to the object")
+        {
+            Callback<void(*)()> callback{&counter, &Counter::increment};
+            callback();
+            callback();
+            THEN("The member function is called on the object")
+            {
+                CHECK(static_cast<bool>(callback));
+                CHECK(counter.count == 2);
+            }
+        }
+
+        WHEN("A callback is made with a reference to the object")
+        {
+            Callback<bool(*)()> callback{counter, &Counter::check};
+            THEN("The result is returned")
+            {
+                CHECK_FALSE(callback());
+                CHECK(callback());
+            }
+        }
+
+        WHEN("The member function takes parameters")
+        {
+            Callback<int(*)(int, int)> callback{&counter, &Counter::add};
+            THEN("They are passed")
+            {
+                CHECK(callback(2, 3) == 5);
+                CHECK(callback(10, 0) == 15);
+            }
+        }
+
+        WHEN("The member function is const")
+        {
+            const Counter& object = counter;
+            counter.count = 42;
+            Callback<int(*)()> callback{&object, &Counter::get};
+            THEN("It is called")
+            {
+                CHECK(callback() == 42);
+            }
+        }
+    }
+}
+
+SCENARIO("A Callback calls a function")
+{
+    GIVEN("A function and a lambda without capture")
+    {
+        function_calls = 0;
+        Callback<void(*)()> callback{&function};
+        Callback<int(*)(int)> lambda{[](int i) { return i * 2; }};
+
+        WHEN("They are called")
+        {
+            callback();
+            THEN("They are executed")
+            {
+                CHECK(function_calls == 1);
+                CHECK(lambda(21) == 42);
+            }
+        }
+    }
+}
+
+SCENARIO("An empty Callback does nothing")
+{
+    GIVEN("Empty callbacks")
+    {
+        Callback<void(*)()> empty;
+        Callback<bool(*)()> null{nullptr};
+
+        THEN("They are false and return a default value")
+        {
+            CHECK_FALSE(static_cast<bool>(empty));
+            CHECK_FALSE(static_cast<bool>(null));
+            empty();
+            CHECK_FALSE(null());
+        }
+
+        WHEN("A callback is reset")
+        {
+            Counter counter;
+            Callback<bool(*)()> callback{&counter, &Counter::check};
+            callback = nullptr;
+            THEN("It is empty")
+            {
+                CHECK_FALSE(static_cast<bool>(callback));
+                CHECK_FALSE(callback());
+                CHECK(counter.count == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("A Callback is copied like a value")
+{
+    GIVEN("A callback")
+    {
+        Counter a, b;
+        Callback<void(*)()> callback{&a, &Counter::increment};
+
+        THEN("It is trivially copyable and as small as its fields")
+        {
+            CHECK(std::is_trivially_copyable<Callback<void(*)()>>::value);
+            CHECK(sizeof(callback) == 4 * sizeof(void*));
+            CHECK(std::has_virtual_destructor<Callback<void(*)()>>::value == false);
+        }
+
+        WHEN("It is copied and the original is changed")
+        {
+            Callback<void(*)()> copy{callback};
+            callback = Callback<void(*)()>{&b, &Counter::increment};
+            copy();
+            callback();
+            callback();
+            THEN("Each calls its own object")
+            {
+                CHECK(a.count == 1);
+                CHECK(b.count == 2);
+            }
+        }
+    }
+}
+
+SCENARIO("Cost of a Callback compared to the previous implementation")
+{
+    GIVEN("Callbacks to different objects, as the wait page and background tasks")
+    {
+        const unsigned n = 10000000;
+        Counter counters[4];
+        Callback<void(*)()> callbacks[4];
+        previous::Callback<void(*)()> previous_callbacks[4];
+        for(unsigned i = 0; i < 4; ++i)
+        {
+            callbacks[i] = Callback<void(*)()>{&counters[i], &Counter::increment};
+            previous_callbacks[i] = previous::Callback<void(*)()>{&counters[i], &Counter::increment};
+        }
+        volatile unsigned mask = 3;
+
+        WHEN("They are called")
+        {
+            double now = measure(n, [&](unsigned i) { callbacks[i & mask](); });
+            double before = measure(n, [&](unsigned i) { previous_callbacks[i & mask](); });
+            THEN("Each call is counted")
+            {
+                INFO("Call: " << now << " ns, previously " << before << " ns");
+                CHECK(counters[0].count + counters[1].count + counters[2].count + counters[3].count == 2 * n);
+            }
+        }
+
+        WHEN("They are assigned")
+        {
+            Callback<void(*)()> callback;
+            previous::Callback<void(*)()> previous_callback;
+            double now = measure(n, [&](unsigned i) { callback = callbacks[i & mask]; callback(); });
+            double before = measure(n, [&](unsigned i) { previous_callback = previous_callbacks[i & mask]; previous_callback(); });
+            THEN("The last one assigned is called")
+            {
+                INFO("Assign and call: " << now << " ns, previously " << before << " ns");
+                CHECK(counters[3].count == n / 2);
+            }
+        }
+    }
+}
@@ -0,0 +1,335 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "CommandBuffer.h"
+
+namespace
+{
+    const uint8_t MAX_CMD_SIZE = 96;
+
+    //! The queue of Marlin_main.cpp: slots indexed like cmd_queue_index_r / _w and commands_in_queue
+    template<uint16_t SIZE, uint8_t SLOTS>
+    struct Queue
+    {
+        CommandBuffer<SIZE, SLOTS, MAX_CMD_SIZE> buffer;
+        uint8_t r = 0, w = 0, count = 0;
+
+        char* space() { return buffer.space(r, count); }
+
+        void commit(uint8_t length)
+        {
+            buffer.commit(w, length);
+            if(++w >= SLOTS) w = 0;
+            ++count;
+        }
+
+        bool enqueue(const char* command)
+        {
+            char* p = space();
+            if(!p)
+                return false;
+            std::strcpy(p, command);
+            commit(static_cast<uint8_t>(std::strlen(command)));
+            return true;
+        }
+
+        const char* front() { return buffer.command(r); }
+
+        void pop()
+        {
+            --count;
+            if(++r >= SLOTS) r = 0;
+        }
+    };
+
+    //! The former queue: BUFSIZE slots of MAX_CMD_SIZE bytes
+    template<uint8_t BUFSIZE>
+    struct SlotQueue
+    {
+        char slots[BUFSIZE][MAX_CMD_SIZE];
+        uint8_t r = 0, w = 0, count = 0;
+
+        char* space() { return count < BUFSIZE ? slots[w] : nullptr; }
+        void commit(uint8_t) { if(++w >= BUFSIZE) w = 0; ++count; }
+        const char* front() { return slots[r]; }
+        void pop() { --count; if(++r >= BUFSIZE) r = 0; }
+    };
+
+    //! What a slicer produces for a print: perimeters and infill with extrusion, travels, retractions, comments
+    std::vector<std::string> production_gcode(int layers)
+    {
+        std::vector<std::string> lines{"; generated by a slicer", "M140 S60", "M104 S200", "M190 S60", "M109 S200",
+                                       "G28 ; home all axes", "G92 E0", "G1 Z0.2 F3000"};
+        char line[MAX_CMD_SIZE];
+        double e = 0;
+        for(int layer = 0; layer < layers; ++layer)
+        {
+            lines.emplace_back(";LAYER:" + std::to_string(layer));
+            std::snprintf(line, sizeof(line), "G0 F9000 X%.3f Y%.3f Z%.2f", 50.0 + layer % 7, 50.0 + layer % 5, 0.2 + layer * 0.2);
+            lines.emplace_back(line);
+            lines.emplace_back("G1 F2700 E0");
+            for(int i = 0; i < 120; ++i)
+            {
+                e += 0.04123 + (i % 9) * 0.0031;
+                // Like most slicers, the feedrate only when it changes
+                std::snprintf(line, sizeof(line), i % 40 ? "G1 X%.3f Y%.3f E%.5f" : "G1 F1800 X%.3f Y%.3f E%.5f",
+                              50 + (i * 37 % 100) * 0.917, 50 + (i * 53 % 100) * 0.883, e);
+                lines.emplace_back(line);
+                if(i % 40 == 39)
+                {
+                    lines.emplace_back("G1 F2700 E" + std::to_string(e - 6.5).substr(0, 9));
+                    std::snprintf(line, sizeof(line), "G0 F9000 X%.3f Y%.3f", 60.0 + i % 13, 70.0 + i % 11);
+                    lines.emplace_back(line);
+                    lines.emplace_back(";TYPE:FILL");
+                }
+            }
+        }
+        lines.emplace_back("M104 S0");
+        lines.emplace_back("M140 S0");
+        lines.emplace_back("M84");
+        return lines;
+    }
+
+    //! What the parser does with a command: walk its parameters
+    unsigned parse(const char* p)
+    {
+        unsigned parameters = 0;
+        for(; *p; ++p)
+            if(*p >= 'A' && *p <= 'Z')
+                ++parameters;
+        return parameters;
+    }
+
+    struct Replay
+    {
+        double average_depth = 0;       //!< Commands waiting in the queue when one is taken
+        double lines_per_second = 0;
+        unsigned parameters = 0;
+    };
+
+    /**
+     * Read the lines of the file into the queue like get_sdcard_commands (comments removed), and
+     * take one command each time the queue is full, like the main loop when the planner is busy.
+     * With 'copy', lines are read into a line buffer then copied to the queue, like the serial path did.
+     */
+    template<typename QUEUE>
+    Replay replay(const std::vector<std::string>& file, bool copy, int repeat)
+    {
+        using Clock = std::chrono::steady_clock;
+        Replay result;
+        QUEUE queue;
+        char line_buffer[MAX_CMD_SIZE];
+        unsigned long depth = 0, taken = 0;
+        const auto start = Clock::now();
+        for(int n = 0; n < repeat; ++n)
+        {
+            for(const auto& line: file)
+            {
+                char* command;
+                while((command = queue.space()) == nullptr)
+                {
+                    depth += queue.count;
+                    ++taken;
+                    result.parameters += parse(queue.front());
+                    queue.pop();
+                }
+                char* dst = copy ? line_buffer : command;
+                uint8_t length = 0;
+                for(const char* p = line.c_str(); *p && *p != ';' && length < MAX_CMD_SIZE - 1; ++p)
+                    dst[length++] = *p;
+                if(!length)
+                    continue;
+                dst[length] = '\0';
+                if(copy)
+                    std::strcpy(command, line_buffer);
+                queue.commit(length);
+            }
+        }
+        while(queue.count)
+        {
+            result.parameters += parse(queue.front());
+            queue.pop();
+        }
+        const std::chrono::duration<double> elapsed = Clock::now() - start;
+        result.average_depth = double(depth) / taken;
+        result.lines_per_second = file.size() * repeat / elapsed.count();
+        return result;
+    }
+}
+
+SCENARIO("Commands are packed in the command buffer", "[queue]")
+{
+    GIVEN("A buffer of 288 bytes for 16 commands")
+    {
+        Queue<288, 16> queue;
+
+        WHEN("Short commands are queued")
+        {
+            int count = 0;
+            while(queue.enqueue("G1 X10.5 Y20.25 E0.12345"))
+                ++count;
+
+            THEN("It takes them as long as a command of MAX_CMD_SIZE bytes still fits")
+            {
+                // 25 characters and their NUL: 8 x 26 = 208, 96 more bytes don't fit in 288
+                REQUIRE(count == 8);
+                REQUIRE(queue.count == 8);
+                REQUIRE(queue.space() == nullptr);
+            }
+            THEN("They come out in order, as they were queued")
+            {
+                for(int i = 0; i < 8; ++i)
+                {
+                    REQUIRE(std::string(queue.front()) == "G1 X10.5 Y20.25 E0.12345");
+                    queue.pop();
+                }
+                REQUIRE(queue.count == 0);
+            }
+        }
+
+        WHEN("Very short commands are queued")
+        {
+            int count = 0;
+            while(queue.enqueue("M105"))
+                ++count;
+
+            THEN("It takes as many as there are slots")
+            {
+                REQUIRE(count == 16);
+            }
+        }
+
+        WHEN("Long commands are queued")
+        {
+            const std::string command(MAX_CMD_SIZE - 1, 'x');
+            int count = 0;
+            while(queue.enqueue(command.c_str()))
+                ++count;
+
+            THEN("It takes as many as it can hold")
+            {
+                REQUIRE(count == 3);
+            }
+        }
+
+        WHEN("Commands are queued and taken, around the ring")
+        {
+            std::vector<std::string> queued;
+            size_t taken = 0;
+            bool ok = true;
+            for(int i = 0; i < 2000 && ok; ++i)
+            {
+                const std::string command = "G1 X" + std::string(static_cast<size_t>(i * 7 % 90), '1') + " N" + std::to_string(i);
+                while(!queue.enqueue(command.c_str()))
+                {
+                    ok = ok && queued[taken] == queue.front();
+                    ++taken;
+                    queue.pop();
+                }
+                queued.push_back(command);
+                // Each command is in one piece in the buffer
+                const char* front = queue.front();
+                ok = ok && front + std::strlen(front) < queue.buffer.end();
+            }
+
+            THEN("Each comes out as it was queued")
+            {
+                REQUIRE(ok);
+                REQUIRE(taken + queue.count == queued.size());
+            }
+        }
+
+        WHEN("The queue is empty")
+        {
+            queue.enqueue("G28");
+            queue.enqueue("G29");
+            queue.pop();
+            queue.pop();
+
+            THEN("The next command goes at the start of the buffer")
+            {
+                REQUIRE(queue.space() == queue.buffer.begin());
+            }
+        }
+
+        WHEN("There is room for a command only at the start of the buffer")
+        {
+            const std::string command(MAX_CMD_SIZE - 1, 'x');
+            REQUIRE(queue.enqueue("M105"));
+            REQUIRE(queue.enqueue(command.c_str()));
+            REQUIRE(queue.enqueue(command.c_str()));
+            queue.pop();
+            queue.pop();
+
+            THEN("The end of the buffer is left unused")
+            {
+                REQUIRE(queue.space() == queue.buffer.begin());
+                REQUIRE(queue.enqueue("M105"));
+                REQUIRE(std::string(queue.front()) == command);
+                queue.pop();
+                REQUIRE(std::string(queue.front()) == "M105");
+            }
+        }
+
+        WHEN("A space is not committed")
+        {
+            queue.enqueue("G28");
+            char* space = queue.space();
+            std::strcpy(space, "N12 G1 X1*99");
+
+            THEN("It is given again")
+            {
+                REQUIRE(queue.space() == space);
+                REQUIRE(queue.count == 1);
+            }
+        }
+    }
+}
+
+SCENARIO("A host replay of a print fills a deeper queue", "[queue]")
+{
+    GIVEN("The G-code of a print")
+    {
+        const auto file = production_gcode(40);
+
+        WHEN("It is replayed with the former queue (5 x 96 bytes) and with the packed one (444 bytes, 12 slots)")
+        {
+            const auto slots = replay<SlotQueue<5>>(file, true, 20);
+            const auto packed = replay<Queue<444, 12>>(file, false, 20);
+
+            THEN("The same commands are parsed and more of them wait in the same RAM")
+            {
+                INFO("Former queue: " << slots.average_depth << " commands, " << static_cast<long>(slots.lines_per_second) << " lines/s");
+                INFO("Packed queue: " << packed.average_depth << " commands, " << static_cast<long>(packed.lines_per_second) << " lines/s");
+                REQUIRE(slots.parameters == packed.parameters);
+                REQUIRE(sizeof(SlotQueue<5>::slots) == 480);
+                REQUIRE(444 + 12 * sizeof(uint16_t) + 12 /* send_ok */ == 480);
+                CHECK(slots.average_depth == Approx(5));
+                CHECK(packed.average_depth > 9);
+            }
+        }
+    }
+}
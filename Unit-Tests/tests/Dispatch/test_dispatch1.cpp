@@ -0,0 +1,207 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "Dispatch.h"
+
+using advi3pp::Action;
+using advi3pp::KeyValue;
+
+namespace
+{
+    std::vector<std::string> calls;
+    std::vector<uint16_t> values;
+
+    #define MOCK(method) void method() { record(#method, 0); }
+
+    //! A handler: records the member functions called
+    struct Mock
+    {
+        const char* name;
+
+        void record(const char* method, uint16_t value)
+        {
+            calls.push_back(std::string(name) + "." + method);
+            values.push_back(value);
+        }
+
+        void handle(KeyValue value) { record("handle", static_cast<uint16_t>(value)); }
+        void change_brightness(uint16_t brightness) { record("change_brightness", brightness); }
+
+        MOCK(x_minus_command) MOCK(x_plus_command) MOCK(y_minus_command) MOCK(y_plus_command)
+        MOCK(z_minus_command) MOCK(z_plus_command) MOCK(e_minus_command) MOCK(e_plus_command)
+        MOCK(minus_command) MOCK(plus_command) MOCK(minus) MOCK(plus)
+        MOCK(feedrate_minus_command) MOCK(feedrate_plus_command)
+        MOCK(fan1_minus_command) MOCK(fan1_plus_command) MOCK(fan2_minus_command) MOCK(fan2_plus_command)
+        MOCK(hotend1_minus_command) MOCK(hotend1_plus_command) MOCK(hotend2_minus_command) MOCK(hotend2_plus_command)
+        MOCK(bed_minus_command) MOCK(bed_plus_command) MOCK(enclosure_minus_command) MOCK(enclosure_plus_command)
+    };
+
+    #undef MOCK
+
+    Mock screens{"screens"}, print{"print"}, wait{"wait"}, load_unload{"load_unload"}, preheat{"preheat"},
+         move{"move"}, sd_card{"sd_card"}, factory_reset{"factory_reset"}, manual_leveling{"manual_leveling"},
+         extruder_tuning{"extruder_tuning"}, pid_tuning{"pid_tuning"}, sensor_settings{"sensor_settings"},
+         babysteps_settings{"babysteps_settings"}, lcd_settings{"lcd_settings"}, statistics{"statistics"},
+         versions{"versions"}, print_settings{"print_settings"}, pid_settings{"pid_settings"},
+         steps_settings{"steps_settings"}, feedrates_settings{"feedrates_settings"},
+         accelerations_settings{"accelerations_settings"}, jerks_settings{"jerks_settings"},
+         copyrights{"copyrights"}, sensor_tuning{"sensor_tuning"}, automatic_leveling{"automatic_leveling"},
+         leveling_grid{"leveling_grid"}, sensor_z_height{"sensor_z_height"}, change_filament{"change_filament"},
+         eeprom_mismatch{"eeprom_mismatch"}, linear_advance_tuning{"linear_advance_tuning"},
+         linear_advance_settings{"linear_advance_settings"}, temperatures{"temperatures"};
+
+    // As in ADVi3pp_::read_lcd_serial
+    using Actions = adv::Dispatch<Action, KeyValue>;
+    constexpr Actions::Entry actions[] = ADVi3PP_DISPATCH_TABLE(ADVi3PP_ACTIONS);
+    constexpr Actions::Entry increments[] = ADVi3PP_DISPATCH_TABLE(ADVi3PP_INCREMENTS);
+    const uint16_t first_action = 0x0400, first_increment = 0x0500;
+    const size_t nb_actions = sizeof(actions) / sizeof(actions[0]), nb_increments = sizeof(increments) / sizeof(increments[0]);
+
+    static_assert(Actions::is_indexed(actions, nb_actions, first_action), "Actions not in order");
+    static_assert(Actions::is_indexed(increments, nb_increments, first_increment), "Increments not in order");
+
+    struct Ram
+    {
+        static Actions::Thunk read(const Actions::Thunk* thunk) { return *thunk; }
+    };
+
+    Actions::Thunk find_action(Action action)
+    {
+        return static_cast<uint16_t>(action) < first_increment
+            ? Actions::find<Ram>(actions, nb_actions, first_action, action)
+            : Actions::find<Ram>(increments, nb_increments, first_increment, action);
+    }
+
+    struct Route { Action action; const char* call; };
+
+    //! The switch of ADVi3pp_::read_lcd_serial before the table
+    const Route routes[] =
+    {
+        {Action::Screen, "screens.handle"},
+        {Action::PrintCommand, "print.handle"},
+        {Action::Wait, "wait.handle"},
+        {Action::LoadUnload, "load_unload.handle"},
+        {Action::Preheat, "preheat.handle"},
+        {Action::Move, "move.handle"},
+        {Action::SdCard, "sd_card.handle"},
+        {Action::FactoryReset, "factory_reset.handle"},
+        {Action::ManualLeveling, "manual_leveling.handle"},
+        {Action::ExtruderTuning, "extruder_tuning.handle"},
+        {Action::PidTuning, "pid_tuning.handle"},
+        {Action::SensorSettings, "sensor_settings.handle"},
+        {Action::Babysteps, "babysteps_settings.handle"},
+        {Action::LCD, "lcd_settings.handle"},
+        {Action::Statistics, "statistics.handle"},
+        {Action::Versions, "versions.handle"},
+        {Action::PrintSettings, "print_settings.handle"},
+        {Action::PIDSettings, "pid_settings.handle"},
+        {Action::StepsSettings, "steps_settings.handle"},
+        {Action::FeedrateSettings, "feedrates_settings.handle"},
+        {Action::AccelerationSettings, "accelerations_settings.handle"},
+        {Action::JerkSettings, "jerks_settings.handle"},
+        {Action::Copyrights, "copyrights.handle"},
+        {Action::SensorTuning, "sensor_tuning.handle"},
+        {Action::AutomaticLeveling, "automatic_leveling.handle"},
+        {Action::SensorGrid, "leveling_grid.handle"},
+        {Action::SensorZHeight, "sensor_z_height.handle"},
+        {Action::ChangeFilament, "change_filament.handle"},
+        {Action::EEPROMMismatch, "eeprom_mismatch.handle"},
+        {Action::LinearAdvanceTuning, "linear_advance_tuning.handle"},
+        {Action::LinearAdvanceSettings, "linear_advance_settings.handle"},
+        {Action::Temperatures, "temperatures.handle"},
+        {Action::MoveXPlus, "move.x_plus_command"},
+        {Action::MoveXMinus, "move.x_minus_command"},
+        {Action::MoveYPlus, "move.y_plus_command"},
+        {Action::MoveYMinus, "move.y_minus_command"},
+        {Action::MoveZPlus, "move.z_plus_command"},
+        {Action::MoveZMinus, "move.z_minus_command"},
+        {Action::MoveEPlus, "move.e_plus_command"},
+        {Action::MoveEMinus, "move.e_minus_command"},
+        {Action::BabyMinus, "babysteps_settings.minus_command"},
+        {Action::BabyPlus, "babysteps_settings.plus_command"},
+        {Action::ZHeightMinus, "sensor_z_height.minus"},
+        {Action::ZHeightPlus, "sensor_z_height.plus"},
+        {Action::FeedrateMinus, "print_settings.feedrate_minus_command"},
+        {Action::FeedratePlus, "print_settings.feedrate_plus_command"},
+        {Action::FanMinus, "print_settings.fan1_minus_command"},
+        {Action::FanPlus, "print_settings.fan1_plus_command"},
+        {Action::Hotend1Minus, "print_settings.hotend1_minus_command"},
+        {Action::Hotend1Plus, "print_settings.hotend1_plus_command"},
+        {Action::Hotend2Minus, "print_settings.hotend2_minus_command"},
+        {Action::Hotend2Plus, "print_settings.hotend2_plus_command"},
+        {Action::BedMinus, "print_settings.bed_minus_command"},
+        {Action::BedPlus, "print_settings.bed_plus_command"},
+        {Action::EnclosureMinus, "print_settings.enclosure_minus_command"},
+        {Action::EnclosurePlus, "print_settings.enclosure_plus_command"},
+        {Action::LCDBrightness, "lcd_settings.change_brightness"},
+        {Action::Fan2Minus, "print_settings.fan2_minus_command"},
+        {Action::Fan2Plus, "print_settings.fan2_plus_command"},
+    };
+}
+
+SCENARIO("Every action is dispatched to the same handler as before")
+{
+    GIVEN("The routes of the actions")
+    {
+        THEN("Each action calls the same member function with the key value")
+        {
+            for(auto& route: routes)
+            {
+                calls.clear();
+                values.clear();
+                INFO("Action 0x" << std::hex << static_cast<uint16_t>(route.action) << ": " << route.call);
+                auto thunk = find_action(route.action);
+                REQUIRE(thunk != nullptr);
+                thunk(static_cast<KeyValue>(0x1234));
+                REQUIRE(calls.size() == 1);
+                CHECK(calls[0] == route.call);
+                if(calls[0].find(".handle") != std::string::npos || route.action == Action::LCDBrightness)
+                    CHECK(values[0] == 0x1234);
+            }
+        }
+
+        THEN("There is no other action")
+        {
+            unsigned handled = 0;
+            for(uint16_t action = 0x0300; action < 0x0700; ++action)
+                if(find_action(static_cast<Action>(action)))
+                    ++handled;
+            CHECK(handled == sizeof(routes) / sizeof(routes[0]));
+        }
+    }
+}
+
+SCENARIO("Unknown actions are reported")
+{
+    GIVEN("Values without action")
+    {
+        THEN("No handler is found")
+        {
+            for(uint16_t action: {0x03FF, 0x040E, 0x041E, 0x0421, 0x0423, 0x04FF, 0x051B, 0x0600, 0xFFFF})
+            {
+                INFO("Action 0x" << std::hex << action);
+                CHECK(find_action(static_cast<Action>(action)) == nullptr);
+            }
+        }
+    }
+}
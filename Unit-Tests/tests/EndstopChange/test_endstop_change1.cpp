@@ -0,0 +1,242 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <vector>
+#include "catch.hpp"
+#include "EndstopChange.h"
+
+namespace
+{
+    const uint8_t SAMPLES = 3;      //!< ENDSTOP_CHANGE_SAMPLES
+    const uint8_t X_MIN = 0, Y_MIN = 2, Z_MIN = 4;
+    const uint8_t MASK = (1 << X_MIN) | (1 << Y_MIN) | (1 << Z_MIN);
+
+    //! Port C of the 3DLabs Stealth: X_MIN (37), Y_MIN (35), Z_MIN / BLTouch (33)
+    struct PinBank
+    {
+        uint8_t port = 0;
+        unsigned pin_reads = 0, port_reads = 0;
+
+        bool read(uint8_t bit) { ++pin_reads; return (port >> bit) & 1; }
+        uint8_t read_port() { ++port_reads; return port & MASK; }
+        void set(uint8_t bit, bool on) { port = on ? port | (1 << bit) : port & ~(1 << bit); }
+    };
+
+    //! Endstops::update(): each pin is read and tested
+    struct Endstops
+    {
+        explicit Endstops(PinBank& pins): pins_{pins} {}
+
+        void update()
+        {
+            ++updates;
+            live_state = 0;
+            for(auto bit: {X_MIN, Y_MIN, Z_MIN})
+                if(pins_.read(bit))
+                    live_state |= 1 << bit;
+            if(abort_enabled && (live_state & (1 << Z_MIN)) && !triggered)
+                triggered = true;
+        }
+
+        bool abort_enabled = false, triggered = false;
+        uint8_t live_state = 0;
+        unsigned updates = 0;
+
+    private:
+        PinBank& pins_;
+    };
+
+    //! Endstops::poll() every millisecond (temperature ISR) and Endstops::update() at each block
+    //! start (stepper ISR). Pins change at given milliseconds.
+    struct Printer
+    {
+        enum class Mode { Polling, ChangeDetection };
+
+        struct Change { uint32_t ms; uint8_t bit; bool on; };
+
+        Printer(Mode mode, bool homing): endstops{pins}, mode_{mode} { endstops.abort_enabled = homing; change_.reset(pins.read_port()); pins.port_reads = 0; }
+
+        //! Run for a time, with a number of blocks per second
+        void run(uint32_t ms, uint32_t blocks_per_s, const std::vector<Change>& changes)
+        {
+            uint32_t block_ticks = 0;
+            for(uint32_t now = 0; now < ms; ++now)
+            {
+                for(auto& change: changes)
+                    if(change.ms == now)
+                        pins.set(change.bit, change.on);
+
+                // Stepper ISR: blocks starting during this millisecond
+                block_ticks += blocks_per_s;
+                for(; block_ticks >= 1000; block_ticks -= 1000)
+                    if(mode_ == Mode::Polling || endstops.abort_enabled)
+                        block_update();
+
+                poll();
+                states.push_back(endstops.live_state);
+            }
+        }
+
+        PinBank pins;
+        Endstops endstops;
+        std::vector<uint8_t> states;    //!< live_state after each poll
+
+    private:
+        void block_update()
+        {
+            // Without change detection, update() returns at once if no switch can abort the move
+            if(mode_ == Mode::Polling && !endstops.abort_enabled)
+                return;
+            endstops.update();
+        }
+
+        void poll()
+        {
+            if(mode_ == Mode::Polling)
+                endstops.update();  // As with ENDSTOP_NOISE_FILTER, to follow the pins when not homing
+            else if(change_.sample(pins.read_port()) || endstops.abort_enabled)
+                endstops.update();
+        }
+
+        Mode mode_;
+        EndstopChange<uint8_t, SAMPLES> change_;
+    };
+
+    //! Polls until live_state has a bit
+    uint32_t latency(const std::vector<uint8_t>& states, uint32_t from, uint8_t bit)
+    {
+        for(uint32_t ms = from; ms < states.size(); ++ms)
+            if(states[ms] & (1 << bit))
+                return ms - from;
+        return UINT32_MAX;
+    }
+}
+
+SCENARIO("Debounce of the endstop pins", "[endstop_change]")
+{
+    EndstopChange<uint8_t, SAMPLES> change;
+    change.reset(0);
+
+    GIVEN("A pin changing")
+    {
+        WHEN("It stays")
+        {
+            REQUIRE_FALSE(change.sample(1));
+            REQUIRE(change.pending());
+            REQUIRE_FALSE(change.sample(1));
+            REQUIRE_FALSE(change.sample(1));
+            THEN("It is settled after the samples")
+            {
+                REQUIRE(change.sample(1));
+                REQUIRE(change.state() == 1);
+                REQUIRE_FALSE(change.pending());
+                REQUIRE_FALSE(change.sample(1));
+            }
+        }
+
+        WHEN("It bounces")
+        {
+            change.sample(1);
+            change.sample(0);
+            change.sample(1);
+            change.sample(1);
+            change.sample(1);
+            THEN("The debounce restarts at each change")
+            {
+                REQUIRE(change.sample(1));
+                REQUIRE(change.state() == 1);
+            }
+        }
+
+        WHEN("It is a glitch")
+        {
+            change.sample(1);
+            for(int i = 0; i < SAMPLES; ++i)
+                REQUIRE_FALSE(change.sample(0));
+            THEN("Nothing changes")
+            {
+                REQUIRE_FALSE(change.sample(0));
+                REQUIRE(change.state() == 0);
+                REQUIRE_FALSE(change.pending());
+            }
+        }
+    }
+}
+
+SCENARIO("Endstops polling and change detection while printing", "[endstop_change]")
+{
+    GIVEN("A 10 minutes print with 150 blocks/s, a glitch on X and the BLTouch stowed and deployed")
+    {
+        const uint32_t duration = 10 * 60 * 1000;
+        const std::vector<Printer::Change> changes{
+            {60000, X_MIN, true}, {60001, X_MIN, false},   // 1ms of noise
+            {300000, Z_MIN, true}, {400000, Z_MIN, false}
+        };
+
+        Printer polling{Printer::Mode::Polling, false};
+        polling.run(duration, 150, changes);
+        Printer detection{Printer::Mode::ChangeDetection, false};
+        detection.run(duration, 150, changes);
+
+        const double polling_reads = (polling.pins.pin_reads + polling.pins.port_reads) * 1000.0 / duration;
+        const double detection_reads = (detection.pins.pin_reads + detection.pins.port_reads) * 1000.0 / duration;
+
+        INFO("Polling: " << polling.endstops.updates << " updates, " << polling_reads << " reads/s");
+        INFO("Change detection: " << detection.endstops.updates << " updates, " << detection_reads << " reads/s");
+
+        THEN("The endstops are updated only when the pins have changed")
+        {
+            REQUIRE(polling.endstops.updates == duration);
+            REQUIRE(detection.endstops.updates == 2);
+            REQUIRE(detection_reads * 2.5 < polling_reads);
+        }
+        THEN("The state follows the pins after the debounce")
+        {
+            REQUIRE(latency(detection.states, 300000, Z_MIN) == SAMPLES);
+            REQUIRE(detection.states[400000 + SAMPLES] == 0);
+        }
+        THEN("The glitch is ignored")
+        {
+            REQUIRE(latency(polling.states, 60000, X_MIN) == 0);
+            REQUIRE(latency(detection.states, 60000, X_MIN) == UINT32_MAX);
+        }
+    }
+}
+
+SCENARIO("Endstops while probing", "[endstop_change]")
+{
+    GIVEN("A probing move where the BLTouch triggers")
+    {
+        const std::vector<Printer::Change> changes{{500, Z_MIN, true}};
+
+        Printer polling{Printer::Mode::Polling, true};
+        polling.run(1000, 10, changes);
+        Printer detection{Printer::Mode::ChangeDetection, true};
+        detection.run(1000, 10, changes);
+
+        THEN("The trigger is seen at the same poll, without debounce")
+        {
+            REQUIRE(latency(polling.states, 500, Z_MIN) == 0);
+            REQUIRE(latency(detection.states, 500, Z_MIN) == 0);
+            REQUIRE(detection.endstops.triggered);
+            REQUIRE(detection.endstops.updates == polling.endstops.updates);
+        }
+    }
+}
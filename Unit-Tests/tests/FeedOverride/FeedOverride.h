@@ -0,0 +1,31 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef UNIT_TESTS_FEED_OVERRIDE_H
+#define UNIT_TESTS_FEED_OVERRIDE_H
+
+#include <stdint.h>
+#include "../../../Marlin/macros.h"
+
+#define REALTIME_OVERRIDES
+#include "../../../Marlin/emergency_parser.h"
+#include "../../../Marlin/feed_override.h"
+
+#endif //UNIT_TESTS_FEED_OVERRIDE_H
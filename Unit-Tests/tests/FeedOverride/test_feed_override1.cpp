@@ -0,0 +1,513 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "FeedOverride.h"
+
+namespace
+{
+    const uint32_t TIMER_RATE = 2000000;    //!< STEPPER_TIMER_RATE (F_CPU / 8)
+    const uint32_t MIN_STEP_RATE = 32;      //!< F_CPU / 500000, the lowest rate of calc_timer_interval
+
+    using Override = FeedOverride<TIMER_RATE / 1000, 2, 10, 150>;
+    Override feed_override;
+    unsigned quickstops = 0;
+
+    //! Bytes from the host through the RX ISR: return those stored in the RX buffer
+    std::string receive(const std::string& bytes)
+    {
+        std::string stored;
+        for(auto c: bytes)
+            if(emergency_parser.update(static_cast<uint8_t>(c)))
+                stored += c;
+        return stored;
+    }
+
+    void reset()
+    {
+        feed_override = Override{};
+        EmergencyParser::enable();
+        quickstops = 0;
+    }
+
+    //! A trapezoid block, as the planner gives it to the stepper
+    struct Block
+    {
+        uint32_t steps, accelerate_until, decelerate_after;
+        uint32_t initial_rate, nominal_rate, final_rate, acceleration_rate;
+        bool travel;
+        uint8_t planned_percent;    //!< Feed override the block is planned for
+    };
+
+    //! stepper_block_phase_isr (without S-curve) with a step per ISR. The serial RX ISR
+    //! runs between two stepper ISRs: bytes are received at the first ISR after their time.
+    struct Stepper
+    {
+        struct Isr { uint64_t time; uint32_t rate; bool step; };
+
+        explicit Stepper(const Block& block): block_{block}
+        {
+            feed_override.block(block.travel, Override::ramp_ticks(block.nominal_rate, block.acceleration_rate),
+                                Override::limit(block.planned_percent));
+        }
+
+        //! Bytes to send at a time (in timer ticks)
+        void send(uint64_t time, const std::string& bytes) { sends_.push_back({time, bytes}); }
+
+        //! Run until the block is done or until a time
+        void run(uint64_t until = UINT64_MAX)
+        {
+            while(completed_ < block_.steps && now_ < until)
+            {
+                for(auto& send: sends_)
+                    if(!send.bytes.empty() && send.time <= now_)
+                    {
+                        receive(send.bytes);
+                        send.bytes.clear();
+                    }
+                const bool step = !feed_override.held();    // stepper_pulse_phase_isr
+                if(step)
+                    ++completed_;
+                const uint32_t interval = block_phase(step);
+                isrs.push_back({now_, step ? TIMER_RATE / interval : 0, step});
+                now_ += interval;
+            }
+        }
+
+        //! First ISR at or after a time
+        size_t at(uint64_t time) const
+        {
+            size_t i = 0;
+            while(i < isrs.size() && isrs[i].time < time)
+                ++i;
+            return i;
+        }
+
+        std::vector<Isr> isrs;
+
+    private:
+        uint32_t timer_interval(uint32_t rate) const
+        {
+            rate = feed_override.apply(rate);
+            if(rate < MIN_STEP_RATE)
+                rate = MIN_STEP_RATE;
+            return TIMER_RATE / rate;
+        }
+
+        uint32_t block_phase(bool stepped)
+        {
+            uint32_t interval = TIMER_RATE / 1000;
+            if(!stepped)
+            {
+                feed_override.elapsed(interval);
+                return interval;
+            }
+
+            if(completed_ <= block_.accelerate_until)
+            {
+                acc_step_rate_ = block_.initial_rate + static_cast<uint32_t>(uint64_t(acceleration_time_) * block_.acceleration_rate / TIMER_RATE);
+                if(acc_step_rate_ > block_.nominal_rate)
+                    acc_step_rate_ = block_.nominal_rate;
+                interval = timer_interval(acc_step_rate_);
+                acceleration_time_ += feed_override.apply(interval);
+            }
+            else if(completed_ > block_.decelerate_after)
+            {
+                const uint32_t delta = static_cast<uint32_t>(uint64_t(deceleration_time_) * block_.acceleration_rate / TIMER_RATE);
+                uint32_t step_rate = acc_step_rate_ > delta ? acc_step_rate_ - delta : block_.final_rate;
+                if(step_rate < block_.final_rate)
+                    step_rate = block_.final_rate;
+                interval = timer_interval(step_rate);
+                deceleration_time_ += feed_override.apply(interval);
+            }
+            else
+            {
+                if(ticks_nominal_ < 0)
+                    ticks_nominal_ = timer_interval(block_.nominal_rate);
+                interval = static_cast<uint32_t>(ticks_nominal_);
+            }
+
+            if(feed_override.elapsed(interval))
+                ticks_nominal_ = -1;
+            return interval;
+        }
+
+        struct Send { uint64_t time; std::string bytes; };
+
+        Block block_;
+        std::vector<Send> sends_;
+        uint64_t now_ = 0;
+        uint32_t completed_ = 0;
+        uint32_t acc_step_rate_ = 0, acceleration_time_ = 0, deceleration_time_ = 0;
+        int32_t ticks_nominal_ = -1;
+    };
+
+    double ms(uint64_t ticks) { return ticks * 1000.0 / TIMER_RATE; }
+
+    //! A long cruise at 8000 steps/s (100mm/s at 80 steps/mm)
+    const Block cruise{400000, 100, 399900, 1000, 8000, 1000, 80000, false, 100};
+}
+
+// External references of emergency_parser.h
+volatile bool wait_for_user = false, wait_for_heatup = false;
+void quickstop_stepper() { ++quickstops; }
+bool realtime_override(const uint8_t c) { return feed_override.command(c); }
+
+bool EmergencyParser::killed_by_M112 = false;
+EmergencyParser::State EmergencyParser::state = EmergencyParser::EP_RESET;
+bool EmergencyParser::enabled = true;
+EmergencyParser emergency_parser;
+
+SCENARIO("Real-time commands are taken between lines", "[feed_override]")
+{
+    reset();
+
+    GIVEN("Real-time bytes between G-code lines and inside a comment")
+    {
+        // 0x91 is also the second byte of a UTF-8 character (Ñ)
+        const std::string lines = "G1 X10\n\x91G1 X20 ; \xC3\x91 \x81\n\x91\x91\x96M410\n\x81";
+
+        WHEN("They are received")
+        {
+            const std::string stored = receive(lines);
+
+            THEN("Only those between lines are taken and not stored")
+            {
+                REQUIRE(stored == "G1 X10\nG1 X20 ; \xC3\x91 \x81\nM410\n");
+                REQUIRE(feed_override.feed_percent() == 130);
+                REQUIRE(feed_override.rapid_percent() == 50);
+                REQUIRE(feed_override.hold_requested());
+            }
+            THEN("The emergency commands still work")
+            {
+                REQUIRE(quickstops == 1);
+            }
+        }
+    }
+
+    GIVEN("A binary upload")
+    {
+        EmergencyParser::disable();
+
+        WHEN("Bytes are received")
+        {
+            const std::string bytes = "\x81\x91\x92\nM410\n";
+            const std::string stored = receive(bytes);
+
+            THEN("They are all stored")
+            {
+                REQUIRE(stored == bytes);
+                REQUIRE_FALSE(feed_override.hold_requested());
+                REQUIRE(feed_override.feed_percent() == 100);
+                REQUIRE(quickstops == 0);
+            }
+        }
+
+        WHEN("The upload ends")
+        {
+            receive("\x12\x34");
+            EmergencyParser::enable();
+
+            THEN("Real-time commands are taken again")
+            {
+                REQUIRE(receive("\x92").empty());
+                REQUIRE(feed_override.feed_percent() == 90);
+            }
+        }
+    }
+}
+
+SCENARIO("Feed override limits", "[feed_override]")
+{
+    reset();
+
+    WHEN("The feed is increased many times")
+    {
+        receive(std::string(20, '\x91'));
+        THEN("It stops at the maximum")
+        {
+            REQUIRE(feed_override.feed_percent() == 150);
+        }
+    }
+
+    WHEN("The feed is decreased many times")
+    {
+        receive(std::string(20, '\x92'));
+        THEN("It stops at the minimum")
+        {
+            REQUIRE(feed_override.feed_percent() == 10);
+        }
+        AND_WHEN("It is reset")
+        {
+            receive("\x90");
+            THEN("It is at 100%")
+            {
+                REQUIRE(feed_override.feed_percent() == 100);
+            }
+        }
+    }
+
+    WHEN("The rapid override is set")
+    {
+        THEN("It takes the three values")
+        {
+            receive("\x97");
+            REQUIRE(feed_override.rapid_percent() == 25);
+            receive("\x96");
+            REQUIRE(feed_override.rapid_percent() == 50);
+            receive("\x95");
+            REQUIRE(feed_override.rapid_percent() == 100);
+        }
+    }
+}
+
+SCENARIO("Latency from the byte received to the speed change", "[feed_override]")
+{
+    reset();
+
+    GIVEN("A long cruise")
+    {
+        Stepper stepper{cruise};
+        const uint64_t sent = TIMER_RATE / 10;   // 100ms
+        const uint32_t ramp_ms = 256 / 2;       // From 0 to 100%
+
+        WHEN("The feed is decreased by 10%")
+        {
+            stepper.send(sent, "\x92");
+            stepper.run(sent + TIMER_RATE / 10);
+
+            const size_t first = stepper.at(sent);
+            size_t changed = first, reached = first;
+            while(changed < stepper.isrs.size() && stepper.isrs[changed].rate == 8000)
+                ++changed;
+            while(reached < stepper.isrs.size() && stepper.isrs[reached].rate > 7200)
+                ++reached;
+
+            INFO("Speed change after " << ms(stepper.isrs[changed].time - sent) << "ms, "
+                 << "90% reached after " << ms(stepper.isrs[reached].time - sent) << "ms");
+
+            THEN("The speed changes within 1ms and reaches 90% within the ramp")
+            {
+                REQUIRE(changed < stepper.isrs.size());
+                REQUIRE(stepper.isrs[changed].time - sent <= TIMER_RATE / 1000 + TIMER_RATE / 8000);
+                REQUIRE(reached < stepper.isrs.size());
+                REQUIRE(stepper.isrs[reached].time - sent <= (ramp_ms / 10 + 2) * (TIMER_RATE / 1000));
+                REQUIRE(stepper.isrs.back().rate == Approx(7200).epsilon(0.01));
+            }
+        }
+
+        WHEN("A feed hold is sent, then a resume")
+        {
+            const uint64_t resumed = sent + TIMER_RATE / 2;
+            stepper.send(sent, "\x81");
+            stepper.send(resumed, "\x82");
+            stepper.run(resumed + TIMER_RATE / 2);
+
+            size_t stopped = stepper.at(sent);
+            while(stopped < stepper.isrs.size() && stepper.isrs[stopped].step)
+                ++stopped;
+            size_t back = stepper.at(resumed);
+            while(back < stepper.isrs.size() && stepper.isrs[back].rate < 8000)
+                ++back;
+
+            uint32_t steps_held = 0;
+            for(size_t i = stopped; i < stepper.at(resumed); ++i)
+                steps_held += stepper.isrs[i].step;
+
+            INFO("Stopped after " << ms(stepper.isrs[stopped].time - sent) << "ms, "
+                 << "back to full speed after " << ms(stepper.isrs[back].time - resumed) << "ms");
+
+            THEN("The stepper decelerates to a stop, waits, and accelerates back")
+            {
+                // The last steps are at the lowest rate of the timer (an ISR every 31ms)
+                REQUIRE(stopped < stepper.isrs.size());
+                REQUIRE(stepper.isrs[stopped].time - sent <= ramp_ms * (TIMER_RATE / 1000) + 2 * TIMER_RATE / MIN_STEP_RATE);
+                REQUIRE(steps_held == 0);
+                REQUIRE(back < stepper.isrs.size());
+                REQUIRE(stepper.isrs[back].time - resumed <= (ramp_ms + 2) * (TIMER_RATE / 1000));
+            }
+        }
+    }
+
+    GIVEN("A travel move and the rapid override at 25%")
+    {
+        Block travel = cruise;
+        travel.travel = true;
+        receive("\x97");
+
+        WHEN("Running the travel move")
+        {
+            Stepper stepper{travel};
+            stepper.run(TIMER_RATE);
+
+            THEN("It runs at 25%")
+            {
+                REQUIRE(stepper.isrs.back().rate == 2000);
+            }
+        }
+
+        WHEN("Running an extrusion")
+        {
+            Stepper stepper{cruise};
+            stepper.run(TIMER_RATE);
+
+            THEN("It is not changed")
+            {
+                REQUIRE(stepper.isrs.back().rate == 8000);
+            }
+        }
+
+        WHEN("Running the travel move with the feed override at 50%")
+        {
+            feed_override.set_feed(50);
+            Stepper stepper{travel};
+            stepper.run(TIMER_RATE);
+
+            THEN("Both apply: it runs at 12.5%")
+            {
+                REQUIRE(stepper.isrs.back().rate == 1000);
+            }
+        }
+    }
+}
+
+SCENARIO("A block planned for a feed override above 100%", "[feed_override]")
+{
+    reset();
+
+    GIVEN("A block planned with the limits of the planner at 150%")
+    {
+        // At 100%: 4000 steps/s at the junctions, 80000 steps/s^2. Planner::update_feed_override
+        // plans them 1.5 and 1.5^2 lower.
+        const double f = 1.5, junction = 4000, acceleration = 80000;
+        const uint32_t entry = static_cast<uint32_t>(junction / f), accel = static_cast<uint32_t>(acceleration / (f * f));
+        const uint32_t ramp_steps = static_cast<uint32_t>((8000.0 * 8000 - double(entry) * entry) / (2 * accel));
+        const Block block{20000, ramp_steps, 20000 - ramp_steps, entry, 8000, entry, accel, false, 150};
+
+        feed_override.set_feed(150);
+        feed_override.block(false, Override::ramp_ticks(block.nominal_rate, block.acceleration_rate), Override::limit(150));
+        while(feed_override.scale() != 384)
+            feed_override.elapsed(TIMER_RATE / 1000);
+
+        WHEN("The stepper runs it at 150%")
+        {
+            Stepper stepper{block};
+            stepper.run();
+
+            const auto& isrs = stepper.isrs;
+            const double accel_time = double(isrs[ramp_steps].time - isrs[0].time) / TIMER_RATE;
+            const double executed = (isrs[ramp_steps].rate - isrs[0].rate) / accel_time;
+            uint32_t jump = 0;
+            for(size_t i = 1; i < isrs.size(); ++i)
+                jump = std::max(jump, isrs[i].rate > isrs[i - 1].rate ? isrs[i].rate - isrs[i - 1].rate : isrs[i - 1].rate - isrs[i].rate);
+
+            INFO("Entry " << isrs[0].rate << " steps/s, acceleration " << executed << " steps/s^2, "
+                 << "cruise " << isrs[isrs.size() / 2].rate << " steps/s, largest change " << jump << " steps/s");
+
+            THEN("The junction speeds and the acceleration are within the limits at 100%")
+            {
+                REQUIRE(isrs.front().rate <= junction * 1.01);
+                REQUIRE(isrs.back().rate <= junction * 1.01);
+                REQUIRE(executed <= acceleration * 1.01);
+            }
+            THEN("The acceleration ends at the cruise speed, without a jump")
+            {
+                REQUIRE(isrs[isrs.size() / 2].rate == Approx(12000).epsilon(0.01));
+                REQUIRE(jump < 150);
+            }
+        }
+    }
+}
+
+SCENARIO("A feed hold decelerates at the acceleration of the move", "[feed_override]")
+{
+    reset();
+
+    GIVEN("A fast travel move: 300mm/s and 2000mm/s^2 at 80 steps/mm")
+    {
+        const uint32_t rate = 24000, acceleration = 160000;
+        const Block travel{2000000, 100, 1999900, 1000, rate, 1000, acceleration, true, 100};
+        Stepper stepper{travel};
+        const uint64_t sent = TIMER_RATE / 10;   // 100ms
+
+        WHEN("A feed hold is sent")
+        {
+            stepper.send(sent, "\x81");
+            stepper.run(sent + TIMER_RATE / 2);
+
+            const size_t first = stepper.at(sent);
+            size_t stopped = first, half = first;
+            while(stopped < stepper.isrs.size() && stepper.isrs[stopped].step)
+                ++stopped;
+            while(half < stepper.isrs.size() && stepper.isrs[half].rate > rate / 2)
+                ++half;
+
+            const double deceleration = (rate / 2) / (double(stepper.isrs[half].time - sent) / TIMER_RATE);
+            INFO("Stopped after " << ms(stepper.isrs[stopped].time - sent) << "ms, deceleration " << deceleration << " steps/s^2");
+
+            THEN("It is not faster than the acceleration, and not much slower")
+            {
+                REQUIRE(stopped < stepper.isrs.size());
+                REQUIRE(half < stopped);
+                REQUIRE(deceleration <= acceleration * 1.01);
+                REQUIRE(deceleration >= acceleration * 0.95);
+                REQUIRE(stepper.isrs[stopped].time - sent >= TIMER_RATE * rate / acceleration);
+            }
+        }
+    }
+}
+
+SCENARIO("A feed override above 100% waits for the blocks planned for it", "[feed_override]")
+{
+    reset();
+
+    GIVEN("A block planned for 100% and the feed override set to 150%")
+    {
+        const Block next = [] { Block block = cruise; block.planned_percent = 150; return block; }();
+        feed_override.set_feed(150);
+
+        WHEN("The stepper runs the block")
+        {
+            Stepper stepper{cruise};
+            stepper.run(TIMER_RATE / 2);
+
+            THEN("It is not faster than planned")
+            {
+                REQUIRE(feed_override.scale() == 256);
+                REQUIRE(stepper.isrs.back().rate == 8000);
+            }
+
+            AND_WHEN("The next block, planned for 150%, runs")
+            {
+                Stepper next_stepper{next};
+                next_stepper.run(TIMER_RATE / 2);
+
+                THEN("It runs at 150%")
+                {
+                    REQUIRE(feed_override.scale() == 384);
+                    REQUIRE(next_stepper.isrs.back().rate == Approx(12000).epsilon(0.01));
+                }
+            }
+        }
+    }
+}
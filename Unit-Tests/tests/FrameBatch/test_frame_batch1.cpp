@@ -0,0 +1,320 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <vector>
+#include <string>
+#include "catch.hpp"
+#include "FrameBatch.h"
+
+namespace
+{
+    using Bytes = std::vector<uint8_t>;
+
+    //! Serial port of the LCD panel: records the bytes and the writes
+    struct Serial
+    {
+        static Bytes bytes;
+        static unsigned writes;
+
+        static bool write(const uint8_t* data, size_t size)
+        {
+            bytes.insert(bytes.end(), data, data + size);
+            ++writes;
+            return true;
+        }
+
+        static void reset() { bytes.clear(); writes = 0; }
+    };
+
+    Bytes Serial::bytes;
+    unsigned Serial::writes = 0;
+
+    using Batch = adv::FrameBatch<192, Serial>;
+
+    //! Write of 16-bit values to RAM, starting at a VP
+    Bytes write_ram(uint16_t vp, std::initializer_list<uint16_t> values)
+    {
+        Bytes frame{0x5A, 0xA5, 3, 0x82, static_cast<uint8_t>(vp >> 8), static_cast<uint8_t>(vp & 0xFF)};
+        for(auto value: values)
+        {
+            frame.push_back(static_cast<uint8_t>(value >> 8));
+            frame.push_back(static_cast<uint8_t>(value & 0xFF));
+            frame[2] += 2;
+        }
+        return frame;
+    }
+
+    //! Write of a string to RAM
+    Bytes write_text(uint16_t vp, const std::string& text)
+    {
+        Bytes frame{0x5A, 0xA5, 3, 0x82, static_cast<uint8_t>(vp >> 8), static_cast<uint8_t>(vp & 0xFF)};
+        for(auto c: text)
+            frame.push_back(static_cast<uint8_t>(c));
+        frame[2] += static_cast<uint8_t>(text.size());
+        return frame;
+    }
+
+    Bytes show_page(uint8_t page) { return Bytes{0x5A, 0xA5, 4, 0x80, 0x03, 0x00, page}; }
+    Bytes read_ram(uint16_t vp) { return Bytes{0x5A, 0xA5, 4, 0x83, static_cast<uint8_t>(vp >> 8), static_cast<uint8_t>(vp & 0xFF), 1}; }
+
+    //! Frame::send: gathered by the batch or written directly
+    template<typename B>
+    void send(B& batch, const Bytes& frame)
+    {
+        if(!batch.add(frame.data(), static_cast<uint16_t>(frame.size())))
+            Serial::write(frame.data(), frame.size());
+    }
+
+    Bytes concat(std::initializer_list<Bytes> frames)
+    {
+        Bytes bytes;
+        for(auto& frame: frames)
+            bytes.insert(bytes.end(), frame.begin(), frame.end());
+        return bytes;
+    }
+}
+
+SCENARIO("Frames are written directly when no batch is started")
+{
+    GIVEN("A batch not started")
+    {
+        Serial::reset();
+        Batch batch;
+
+        WHEN("Frames are sent")
+        {
+            send(batch, write_ram(0x100, {1}));
+            send(batch, show_page(7));
+            THEN("Each is written as is")
+            {
+                CHECK(Serial::writes == 2);
+                CHECK(Serial::bytes == concat({write_ram(0x100, {1}), show_page(7)}));
+            }
+        }
+    }
+}
+
+SCENARIO("Writes to contiguous VPs are merged")
+{
+    GIVEN("A started batch")
+    {
+        Serial::reset();
+        Batch batch;
+        batch.begin();
+
+        WHEN("Two writes follow each other in RAM")
+        {
+            send(batch, write_ram(0x100, {1, 2}));
+            send(batch, write_ram(0x102, {3}));
+            send(batch, write_ram(0x103, {4}));
+            THEN("Nothing is written before the end")
+            {
+                CHECK(Serial::writes == 0);
+            }
+            batch.end();
+            THEN("They are written as one frame")
+            {
+                CHECK(Serial::writes == 1);
+                CHECK(Serial::bytes == write_ram(0x100, {1, 2, 3, 4}));
+            }
+        }
+
+        WHEN("A string with an odd length is followed by the next VP")
+        {
+            send(batch, write_text(0x200, "abc"));
+            send(batch, write_ram(0x202, {5}));
+            batch.end();
+            THEN("They are not merged, but written in one burst")
+            {
+                CHECK(Serial::writes == 1);
+                CHECK(Serial::bytes == concat({write_text(0x200, "abc"), write_ram(0x202, {5})}));
+            }
+        }
+
+        WHEN("The merged frame would be longer than its length byte allows")
+        {
+            std::string text(250, 'x');
+            send(batch, write_text(0x300, text));
+            send(batch, write_ram(0x300 + 125, {6}));
+            batch.end();
+            THEN("The second write is a frame of its own")
+            {
+                CHECK(Serial::bytes == concat({write_text(0x300, text), write_ram(0x300 + 125, {6})}));
+            }
+        }
+    }
+}
+
+SCENARIO("The page switch is written last")
+{
+    GIVEN("A started batch")
+    {
+        Serial::reset();
+        Batch batch;
+        batch.begin();
+
+        WHEN("The page is shown before the data is sent")
+        {
+            send(batch, write_ram(0x100, {1}));
+            send(batch, show_page(3));
+            send(batch, write_ram(0x200, {2}));
+            batch.end();
+            THEN("Everything is written in one burst, the page switch at the end")
+            {
+                CHECK(Serial::writes == 1);
+                CHECK(Serial::bytes == concat({write_ram(0x100, {1}), write_ram(0x200, {2}), show_page(3)}));
+            }
+        }
+
+        WHEN("Two pages are shown")
+        {
+            send(batch, show_page(3));
+            send(batch, show_page(4));
+            batch.end();
+            THEN("Only the last one is written")
+            {
+                CHECK(Serial::bytes == show_page(4));
+            }
+        }
+
+        WHEN("A read is sent in the middle")
+        {
+            send(batch, write_ram(0x100, {1}));
+            send(batch, show_page(3));
+            send(batch, read_ram(0x400));
+            send(batch, write_ram(0x200, {2}));
+            batch.end();
+            THEN("The writes before are written first, the page switch is still last")
+            {
+                CHECK(Serial::writes == 3);
+                CHECK(Serial::bytes == concat({write_ram(0x100, {1}), read_ram(0x400), write_ram(0x200, {2}), show_page(3)}));
+            }
+        }
+    }
+}
+
+SCENARIO("Batches are nested and limited by the buffer")
+{
+    GIVEN("A started batch")
+    {
+        Serial::reset();
+        Batch batch;
+        batch.begin();
+
+        WHEN("Another batch is started and ended inside")
+        {
+            batch.begin();
+            send(batch, write_ram(0x100, {1}));
+            CHECK(batch.end());
+            THEN("Nothing is written before the end of the outermost")
+            {
+                CHECK(Serial::writes == 0);
+                CHECK(batch.active());
+                batch.end();
+                CHECK(Serial::writes == 1);
+                CHECK_FALSE(batch.active());
+            }
+        }
+
+        WHEN("The frames do not fit in the buffer")
+        {
+            Bytes expected;
+            for(uint16_t i = 0; i < 30; ++i)
+            {
+                auto frame = write_ram(static_cast<uint16_t>(0x100 + 0x10 * i), {i, i});
+                send(batch, frame);
+                expected.insert(expected.end(), frame.begin(), frame.end());
+            }
+            auto big = write_text(0x1000, std::string(200, 'y'));
+            send(batch, big);
+            send(batch, show_page(9));
+            batch.end();
+            expected.insert(expected.end(), big.begin(), big.end());
+            auto page = show_page(9);
+            expected.insert(expected.end(), page.begin(), page.end());
+
+            THEN("They are written in order when the buffer is full, the page switch still last")
+            {
+                CHECK(Serial::bytes == expected);
+                INFO(Serial::writes << " writes for 32 frames");
+                CHECK(Serial::writes == 4);
+            }
+        }
+    }
+}
+
+SCENARIO("Pages of the LCD panel")
+{
+    // Frames (advi3pp_dgus.h): the largest page made of small frames is Sensor Settings
+    using PanelBatch = adv::FrameBatch<64, Serial>;
+
+    GIVEN("The frames of the Sensor Settings page")
+    {
+        // SensorSettings::send_data (three values and a title of 32 characters) and Pages::show_page
+        const Bytes frames[] = {write_ram(0x0000, {100, 200, 150}), write_text(0x0200, std::string(32, 's')), show_page(31)};
+
+        WHEN("They are sent without batch")
+        {
+            Serial::reset();
+            PanelBatch batch;
+            for(auto& frame: frames)
+                send(batch, frame);
+            const unsigned writes = Serial::writes;
+
+            AND_WHEN("They are sent with a batch")
+            {
+                Serial::reset();
+                batch.begin();
+                for(auto& frame: frames)
+                    send(batch, frame);
+                batch.end();
+
+                THEN("The same bytes are written in one burst")
+                {
+                    INFO("Writes: " << writes << " before, " << Serial::writes << " now");
+                    CHECK(Serial::bytes == concat({frames[0], frames[1], frames[2]}));
+                    CHECK(Serial::writes == 1);
+                }
+            }
+        }
+    }
+
+    GIVEN("The frames of the SD card page")
+    {
+        // Card::show_current_page (five names of 48 characters, then the page number) and Pages::show_page
+        const Bytes frames[] = {write_text(0x0100, std::string(240, 'f')), write_ram(0x0000, {1}), show_page(3)};
+
+        WHEN("They are sent with a batch")
+        {
+            Serial::reset();
+            PanelBatch batch;
+            batch.begin();
+            for(auto& frame: frames)
+                send(batch, frame);
+            batch.end();
+
+            THEN("The names are written alone, the page switch still last")
+            {
+                CHECK(Serial::bytes == concat({frames[0], frames[1], frames[2]}));
+                CHECK(Serial::writes == 2);
+            }
+        }
+    }
+}
@@ -0,0 +1,270 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string>
+#include "catch.hpp"
+#include "GCodeMetadata.h"
+
+namespace
+{
+    //! Moves of a layer, to fill the middle of a file
+    std::string layers(size_t size)
+    {
+        std::string moves;
+        for(int i = 0; moves.size() < size; ++i)
+            moves += "G1 X" + std::to_string(100 + i % 50) + ".123 Y" + std::to_string(80 + i % 30) + ".456 E0.04321\n";
+        return moves;
+    }
+
+    const std::string cura_head =
+        ";FLAVOR:Marlin\n"
+        ";TIME:6500\n"
+        ";Filament used: 12.3456m\n"
+        ";Layer height: 0.2\n"
+        ";LAYER_COUNT:120\n"
+        "M140 S60\n"
+        "M105\n"
+        "M190 S60\n"
+        "M104 S210\n"
+        "M109 S210\n";
+
+    const std::string prusa_head =
+        "; generated by PrusaSlicer 2.1.0\n"
+        "M107\n"
+        "M190 S65 ; set bed temperature and wait for it to be reached\n"
+        "M104 S215 ; set temperature\n";
+
+    const std::string prusa_tail =
+        "M84 ; disable motors\n"
+        "; filament used [mm] = 4567.8\n"
+        "; filament used [g] = 13.6\n"
+        "; estimated printing time (normal mode) = 1d 2h 48m 20s\n"
+        "; estimated printing time (silent mode) = 1d 3h 10m 5s\n"
+        "; first_layer_bed_temperature = 65\n"
+        "; first_layer_temperature = 215,220\n";
+
+    const std::string s3d_head =
+        "; G-Code generated by Simplify3D(R) Version 4.1.2\n"
+        ";   Build time: 2 hours 5 minutes\n"
+        ";   Filament length: 9876.5 mm (9.88 m)\n"
+        ";   Plastic weight: 29.45 g (0.06 lb)\n"
+        "M140 S55\n"
+        "M104 S205 T0\n";
+
+    //! Scan a file in memory like USBReader, chunk by chunk, seeking only when a chunk is not the next one
+    GCodeMetadata scan(const std::string& file, uint32_t* read = nullptr, uint32_t* chunks = nullptr, uint32_t* seeks = nullptr)
+    {
+        GCodeMetadataScan scanner;
+        scanner.start(file.size());
+        uint32_t total = 0, count = 0, located = 0, current = 0;
+        bool active = scanner.active();
+        while(active)
+        {
+            uint32_t position = 0;
+            const uint8_t length = scanner.next(position);
+            REQUIRE(position + length <= file.size());
+            if(position != current)
+                ++located;
+            active = scanner.feed(reinterpret_cast<const uint8_t*>(file.data()) + position, length);
+            current = position + length;
+            total += length;
+            ++count;
+        }
+        CHECK(!scanner.active());
+        if(read)
+            *read = total;
+        if(chunks)
+            *chunks = count;
+        if(seeks)
+            *seeks = located;
+        return scanner.metadata();
+    }
+}
+
+SCENARIO("Metadata written by slicers", "[gcode_metadata]")
+{
+    GIVEN("A file from Cura")
+    {
+        const auto metadata = scan(cura_head + layers(100000) + "M84\n");
+
+        THEN("The values are found")
+        {
+            CHECK(metadata.time == 6500);
+            CHECK(metadata.filament == 12345);
+            CHECK(metadata.layers == 120);
+            CHECK(metadata.hotend == 210);
+            CHECK(metadata.bed == 60);
+        }
+    }
+
+    GIVEN("A file from PrusaSlicer, with the values at the end")
+    {
+        const auto metadata = scan(prusa_head + layers(100000) + prusa_tail);
+
+        THEN("The values are found, the first ones are kept")
+        {
+            CHECK(metadata.time == 86400 + 2 * 3600 + 48 * 60 + 20);
+            CHECK(metadata.filament == 4567);
+            CHECK(metadata.layers == 0);
+            CHECK(metadata.hotend == 215);
+            CHECK(metadata.bed == 65);
+        }
+    }
+
+    GIVEN("A file from Simplify3D")
+    {
+        const auto metadata = scan(s3d_head + layers(20000));
+
+        THEN("The values are found")
+        {
+            CHECK(metadata.time == 2 * 3600 + 5 * 60);
+            CHECK(metadata.filament == 9876);
+            CHECK(metadata.hotend == 205);
+            CHECK(metadata.bed == 55);
+        }
+    }
+
+    GIVEN("A file without metadata")
+    {
+        const auto metadata = scan("G28\nG1 X10 Y10\nM104 S0");
+
+        THEN("Nothing is found")
+        {
+            CHECK(metadata.time == 0);
+            CHECK(metadata.filament == 0);
+            CHECK(metadata.layers == 0);
+            CHECK(metadata.hotend == 0);
+            CHECK(metadata.bed == 0);
+        }
+    }
+
+    GIVEN("An empty file")
+    {
+        GCodeMetadataScan scanner;
+        scanner.start(0);
+        uint32_t position = 0;
+
+        THEN("There is nothing to read")
+        {
+            CHECK(scanner.next(position) == 0);
+            CHECK(!scanner.feed(nullptr, 0));
+        }
+    }
+}
+
+SCENARIO("Parts of the file read", "[gcode_metadata]")
+{
+    GIVEN("A large file")
+    {
+        const std::string file = cura_head + layers(2000000) + prusa_tail;
+        uint32_t read = 0, chunks = 0, seeks = 0;
+        const auto metadata = scan(file, &read, &chunks, &seeks);
+
+        THEN("Only the head and the tail are read, with a single seek to the tail")
+        {
+            CHECK(seeks == 1);
+            INFO("File: " << file.size() << " bytes, read: " << read << " bytes in " << chunks << " chunks");
+            CHECK(read == GCodeMetadataScan::HEAD_SIZE + GCodeMetadataScan::TAIL_SIZE);
+            CHECK(metadata.time == 6500);
+            CHECK(metadata.filament == 12345);
+        }
+    }
+
+    GIVEN("A file smaller than the head and the tail")
+    {
+        const std::string file = cura_head + layers(5000) + prusa_tail;
+        uint32_t read = 0;
+        const auto metadata = scan(file, &read);
+
+        THEN("It is read once")
+        {
+            CHECK(read == file.size());
+            CHECK(metadata.layers == 120);
+        }
+    }
+
+    GIVEN("A tail starting in the middle of a key")
+    {
+        const std::string tail = ";TIME:1234\n";
+        std::string file = layers(10000) + tail;
+        // Once inserted, the tail starts at the ';' of this line
+        const std::string truncated = "X;TIME:9999\n";
+        file.insert(file.size() + truncated.size() - GCodeMetadataScan::TAIL_SIZE - 1, truncated);
+        REQUIRE(file[file.size() - GCodeMetadataScan::TAIL_SIZE] == ';');
+
+        THEN("The truncated line is ignored")
+        {
+            CHECK(scan(file).time == 1234);
+        }
+    }
+}
+
+SCENARIO("Durations", "[gcode_metadata]")
+{
+    CHECK(GCodeMetadataParser::parse_duration("1d 2h 3m 4s") == 93784);
+    CHECK(GCodeMetadataParser::parse_duration(" 48m 20s") == 2900);
+    CHECK(GCodeMetadataParser::parse_duration("1 hours 48 minutes") == 6480);
+    CHECK(GCodeMetadataParser::parse_duration("6500") == 6500);
+    CHECK(GCodeMetadataParser::parse_duration("") == 0);
+}
+
+SCENARIO("Cache of the metadata", "[gcode_metadata]")
+{
+    GIVEN("A cache of 3 files")
+    {
+        GCodeMetadataCache<3> cache;
+        cache.store("A.GCO", 100, {1, 0, 0, 0, 0});
+        cache.store("B.GCO", 200, {2, 0, 0, 0, 0});
+        cache.store("C.GCO", 300, {3, 0, 0, 0, 0});
+
+        THEN("They are found by name and size")
+        {
+            REQUIRE(cache.find("B.GCO", 200) != nullptr);
+            CHECK(cache.find("B.GCO", 200)->time == 2);
+            CHECK(cache.find("B.GCO", 201) == nullptr);
+            CHECK(cache.find("D.GCO", 200) == nullptr);
+        }
+
+        WHEN("A file is found then another one is stored")
+        {
+            REQUIRE(cache.find("A.GCO", 100) != nullptr);
+            cache.store("D.GCO", 400, {4, 0, 0, 0, 0});
+
+            THEN("The least recently used one is replaced")
+            {
+                CHECK(cache.find("B.GCO", 200) == nullptr);
+                CHECK(cache.find("A.GCO", 100) != nullptr);
+                CHECK(cache.find("C.GCO", 300) != nullptr);
+                CHECK(cache.find("D.GCO", 400)->time == 4);
+            }
+        }
+
+        WHEN("Nothing is stored")
+        {
+            GCodeMetadataCache<2> empty;
+
+            THEN("Nothing is found, even a file without name")
+            {
+                CHECK(empty.find("", 0) == nullptr);
+                CHECK(empty.find("A.GCO", 100) == nullptr);
+            }
+        }
+    }
+}
@@ -0,0 +1,311 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "JobStart.h"
+
+namespace
+{
+    //! A heater and what it heats: first order model, heating at full power until the target
+    struct Heater
+    {
+        double power;           //!< Heating power (°C/s at ambient temperature)
+        double loss;            //!< Losses (1/s)
+        double temperature = 25;
+        double target = 0;
+
+        void step(double dt)
+        {
+            const double heat = temperature < target ? power : 0;
+            temperature += (heat - loss * (temperature - 25)) * dt;
+        }
+        bool reached() const { return temperature >= target - 1; }
+    };
+
+    //! A printer executing commands, with the duration of the moves
+    struct Printer
+    {
+        Heater bed{0.45, 0.0030};       //!< About 3 minutes to 60°C
+        Heater hotend{4.0, 0.0100};     //!< About 1 minute to 210°C
+        double time = 0;
+        double first_extrusion = -1;    //!< Time of the first extruding move
+        double bed_at_extrusion = 0, hotend_at_extrusion = 0;
+        double bed_at_probing = 0;      //!< Bed temperature when G29 starts
+        std::vector<std::string> executed;
+
+        void wait(double duration)
+        {
+            for(double t = 0; t < duration; t += 0.1)
+                step();
+        }
+
+        void step()
+        {
+            bed.step(0.1);
+            hotend.step(0.1);
+            time += 0.1;
+        }
+
+        void execute(const std::string& command)
+        {
+            executed.push_back(command);
+            const auto s = command.find('S');
+            const double value = s == std::string::npos ? 0 : std::atof(command.c_str() + s + 1);
+            const std::string code = command.substr(0, 4);
+
+            if(code == "M140") bed.target = value;
+            else if(code == "M104") hotend.target = value;
+            else if(code == "M190") { bed.target = value; while(!bed.reached()) step(); }
+            else if(code == "M109") { hotend.target = value; while(!hotend.reached()) step(); }
+            else if(code == "G28 ") wait(25);
+            else if(code == "G29 ") { bed_at_probing = bed.temperature; wait(120); }
+            else if(JobStart::is_extruding(command.c_str()))
+            {
+                if(first_extrusion < 0)
+                {
+                    first_extrusion = time;
+                    bed_at_extrusion = bed.temperature;
+                    hotend_at_extrusion = hotend.temperature;
+                }
+                wait(1);
+            }
+            else wait(0.1);
+        }
+    };
+
+    //! Print the start of a file, as it is: one command after the other
+    Printer print_serial(const std::vector<std::string>& file)
+    {
+        Printer printer;
+        for(auto& line: file)
+            printer.execute(line);
+        return printer;
+    }
+
+    //! Print the start of a file with JobStart: the lines are filtered when read, the waits done before probing and extruding
+    Printer print_overlapped(const std::vector<std::string>& file, JobStart& job_start)
+    {
+        Printer printer;
+        job_start.start();
+        std::vector<std::string> queue;
+        for(auto& line: file)
+        {
+            char buffer[96];
+            std::strcpy(buffer, line.c_str());
+            job_start.filter(buffer);
+            queue.push_back(buffer);
+        }
+
+        for(auto& command: queue)
+        {
+            while(const char* wait = job_start.next_wait(command.c_str()))
+                printer.execute(wait);
+            printer.execute(command);
+        }
+        return printer;
+    }
+
+    const std::vector<std::string> cura_start =
+    {
+        "M140 S60", "M105", "M190 S60", "M104 S210", "M105", "M109 S210", "M82",
+        "G28 ", "G29 ", "G92 E0", "G1 Z2.0 F3000", "G1 X0.1 Y20 Z0.3 F5000.0",
+        "G1 X0.1 Y200.0 Z0.3 F1500.0 E15", "G1 X0.4 Y200.0 Z0.3 F5000.0", "G92 E0", "G1 X10 Y10 E0.5"
+    };
+}
+
+SCENARIO("Start of a print with the heating overlapped", "[job_start]")
+{
+    GIVEN("The start G-code of Cura: heat and wait, then home and probe")
+    {
+        JobStart job_start;
+        const Printer serial = print_serial(cura_start);
+        const Printer overlapped = print_overlapped(cura_start, job_start);
+
+        THEN("It extrudes sooner, at the right temperatures")
+        {
+            INFO("First extrusion: " << serial.first_extrusion << " s as it is, " << overlapped.first_extrusion << " s overlapped");
+            CHECK(overlapped.first_extrusion < serial.first_extrusion - 60);
+            CHECK(overlapped.bed_at_probing >= 59);
+            CHECK(overlapped.bed_at_extrusion >= 59);
+            CHECK(overlapped.hotend_at_extrusion >= 209);
+            CHECK(!job_start.waiting());
+            CHECK(!job_start.filtering());
+        }
+
+        THEN("The waits are made non-blocking, the bed done before probing and the hotend before the first extrusion")
+        {
+            const std::vector<std::string> expected =
+            {
+                "M140 S60", "M105", "M140 S60", "M104 S210", "M105", "M104 S210", "M82",
+                "G28 ", "M190 S60", "G29 ", "G92 E0", "G1 Z2.0 F3000", "G1 X0.1 Y20 Z0.3 F5000.0",
+                "M109 S210", "G1 X0.1 Y200.0 Z0.3 F1500.0 E15"
+            };
+            REQUIRE(overlapped.executed.size() >= expected.size());
+            CHECK(std::vector<std::string>(overlapped.executed.begin(), overlapped.executed.begin() + expected.size()) == expected);
+        }
+    }
+
+    GIVEN("A start G-code probing at a lower temperature")
+    {
+        JobStart job_start;
+        const std::vector<std::string> file =
+        {
+            "M104 S150", "M190 S60", "M109 S150", "G28 ", "G29 ", "M104 S215", "G1 Z0.3", "G1 X10 E5"
+        };
+        const Printer overlapped = print_overlapped(file, job_start);
+
+        THEN("The wait is for the last target")
+        {
+            CHECK(std::find(overlapped.executed.begin(), overlapped.executed.end(), "M109 S215") != overlapped.executed.end());
+            CHECK(std::find(overlapped.executed.begin(), overlapped.executed.end(), "M109 S150") == overlapped.executed.end());
+            CHECK(overlapped.hotend_at_extrusion >= 214);
+        }
+    }
+}
+
+SCENARIO("Lines left as they are", "[job_start]")
+{
+    GIVEN("A print started")
+    {
+        JobStart job_start;
+        job_start.start();
+
+        WHEN("The hotend waits for cooling or has no temperature")
+        {
+            char cooling[] = "M109 R180", previous[] = "M109";
+            job_start.filter(cooling);
+            job_start.filter(previous);
+
+            THEN("They are not changed")
+            {
+                CHECK(std::string(cooling) == "M109 R180");
+                CHECK(std::string(previous) == "M109");
+                CHECK(!job_start.waiting());
+            }
+        }
+
+        WHEN("Two hotends wait")
+        {
+            char first[] = "M109 S200 T0", second[] = "M109 S210 T1", move[] = "G1 E2";
+            job_start.filter(first);
+            job_start.filter(second);
+            job_start.filter(move);
+
+            THEN("Both are kept")
+            {
+                CHECK(std::string(first) == "M104 S200 T0");
+                CHECK(std::string(second) == "M104 S210 T1");
+                CHECK(job_start.next_wait("G1 X10") == nullptr);
+                CHECK(job_start.next_wait("G29") == nullptr);
+                CHECK(std::string(job_start.next_wait("G1 E2")) == "M109 S200 T0");
+                CHECK(std::string(job_start.next_wait("G1 E2")) == "M109 S210 T1");
+                CHECK(job_start.next_wait("G1 E2") == nullptr);
+            }
+        }
+
+        WHEN("The bed gets a new target after probing")
+        {
+            char bed[] = "M190 S60", probe[] = "G29", again[] = "M140 S70", move[] = "G1 E2";
+            job_start.filter(bed);
+            job_start.filter(probe);
+            const std::string before_probing = job_start.next_wait(probe);
+            const char* after_probing = job_start.next_wait(probe);
+            job_start.filter(again);
+            job_start.filter(move);
+
+            THEN("The bed is waited for before probing, then again before the first extrusion")
+            {
+                CHECK(before_probing == "M190 S60");
+                CHECK(after_probing == nullptr);
+                CHECK(std::string(job_start.next_wait(move)) == "M190 S70");
+                CHECK(!job_start.waiting());
+            }
+        }
+
+        WHEN("The first extrusion is read")
+        {
+            char move[] = "G1 X10 E1", wait[] = "M109 S200";
+            job_start.filter(move);
+            job_start.filter(wait);
+
+            THEN("The next waits are left as they are")
+            {
+                CHECK(std::string(wait) == "M109 S200");
+                CHECK(!job_start.filtering());
+            }
+        }
+
+        WHEN("The wait is after the first lines")
+        {
+            for(int i = 0; i < JobStart::MAX_LINES; ++i)
+            {
+                char line[] = "M105";
+                job_start.filter(line);
+            }
+            char wait[] = "M190 S60";
+            job_start.filter(wait);
+
+            THEN("It is left as it is")
+            {
+                CHECK(std::string(wait) == "M190 S60");
+            }
+        }
+
+        WHEN("The print is stopped")
+        {
+            char wait[] = "M190 S60";
+            job_start.filter(wait);
+            job_start.stop();
+
+            THEN("The waits are forgotten")
+            {
+                CHECK(!job_start.waiting());
+                CHECK(job_start.next_wait("G1 E2") == nullptr);
+            }
+        }
+    }
+}
+
+SCENARIO("Extruding moves", "[job_start]")
+{
+    CHECK(JobStart::is_extruding("G1 X10 E2"));
+    CHECK(JobStart::is_extruding("G0 E-1"));
+    CHECK(JobStart::is_extruding("G1X10E2"));
+    CHECK(!JobStart::is_extruding("G1 X10 Y10"));
+    CHECK(!JobStart::is_extruding("G92 E0"));
+    CHECK(!JobStart::is_extruding("G10"));
+    CHECK(!JobStart::is_extruding("M82"));
+}
+
+SCENARIO("Probing commands", "[job_start]")
+{
+    CHECK(JobStart::is_probing("G29"));
+    CHECK(JobStart::is_probing("G29 P1"));
+    CHECK(JobStart::is_probing("G30 X10 Y10"));
+    CHECK(!JobStart::is_probing("G28"));
+    CHECK(!JobStart::is_probing("G2 X10 Y10 I5"));
+    CHECK(!JobStart::is_probing("G290"));
+    CHECK(!JobStart::is_probing("M29"));
+}
@@ -0,0 +1,190 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cmath>
+#include "catch.hpp"
+#include "MeshStatistics.h"
+
+namespace
+{
+    template<int NX, int NY>
+    struct Mesh
+    {
+        float z_[NX][NY];
+        float saved_[NX][NY];
+
+        Mesh(float a, float b, float d)
+        {
+            for(int i = 0; i < NX; ++i)
+                for(int j = 0; j < NY; ++j)
+                    z_[i][j] = saved_[i][j] = a * x(i) + b * y(j) + d;
+        }
+
+        uint8_t points_x() const { return NX; }
+        uint8_t points_y() const { return NY; }
+        float x(uint8_t i) const { return 30 + 70 * i; }
+        float y(uint8_t j) const { return 20 + 80 * j; }
+        float z(uint8_t i, uint8_t j) const { return z_[i][j]; }
+        float saved(uint8_t i, uint8_t j) const { return saved_[i][j]; }
+    };
+
+    // Same computations as incremental_LSF and finish_incremental_LSF (least_squares_fit)
+    struct Fit
+    {
+        float xbar, ybar, zbar, x2bar, y2bar, xybar, xzbar, yzbar, N;
+
+        void reset() { xbar = ybar = zbar = x2bar = y2bar = xybar = xzbar = yzbar = N = 0; }
+
+        void add(float x, float y, float z)
+        {
+            xbar += x; ybar += y; zbar += z;
+            x2bar += x * x; y2bar += y * y;
+            xybar += x * y; xzbar += x * z; yzbar += y * z;
+            N += 1;
+        }
+
+        bool finish(float& a, float& b, float& d)
+        {
+            xbar /= N; ybar /= N; zbar /= N;
+            x2bar = x2bar / N - xbar * xbar;
+            y2bar = y2bar / N - ybar * ybar;
+            xybar = xybar / N - xbar * ybar;
+            yzbar = yzbar / N - ybar * zbar;
+            xzbar = xzbar / N - xbar * zbar;
+            const float DD = x2bar * y2bar - xybar * xybar;
+            if(std::fabs(DD) <= 1e-10 * (xbar + ybar)) return false;
+            const float A = (yzbar * xybar - xzbar * y2bar) / DD,
+                        B = (xzbar * xybar - yzbar * x2bar) / DD,
+                        D = -(zbar + A * xbar + B * ybar);
+            a = -A; b = -B; d = -D;
+            return true;
+        }
+    };
+}
+
+SCENARIO("Statistics of a flat tilted bed", "[mesh_statistics]")
+{
+    GIVEN("A 3x3 mesh on a plane")
+    {
+        Mesh<3, 3> mesh{0.002f, -0.001f, 0.15f};
+        Fit fit;
+        mesh_statistics_t stats;
+
+        WHEN("Statistics are computed")
+        {
+            REQUIRE(mesh_statistics(mesh, fit, stats));
+
+            THEN("The plane is found and nothing is left")
+            {
+                CHECK(stats.points == 9);
+                CHECK(stats.slope_x == Approx(0.002f).margin(1e-5));
+                CHECK(stats.slope_y == Approx(-0.001f).margin(1e-5));
+                CHECK(stats.offset == Approx(0.15f).margin(1e-3));
+                CHECK(stats.rms == Approx(0).margin(1e-4));
+                CHECK(stats.max_deviation == Approx(0).margin(1e-4));
+            }
+            THEN("The mesh did not change since saved")
+            {
+                CHECK(stats.max_change == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Statistics of a warped bed", "[mesh_statistics]")
+{
+    GIVEN("A 3x3 mesh on a plane with a bump in the middle")
+    {
+        const float bump = 0.09f;
+        Mesh<3, 3> mesh{0.001f, 0.001f, 0};
+        mesh.z_[1][1] += bump;
+        Fit fit;
+        mesh_statistics_t stats;
+
+        WHEN("Statistics are computed")
+        {
+            REQUIRE(mesh_statistics(mesh, fit, stats));
+
+            THEN("The bump raises the plane by 1/9 and is the largest deviation")
+            {
+                CHECK(stats.slope_x == Approx(0.001f).margin(1e-5));
+                CHECK(stats.slope_y == Approx(0.001f).margin(1e-5));
+                CHECK(stats.offset == Approx(bump / 9).margin(1e-4));
+                CHECK(stats.max_deviation == Approx(bump * 8 / 9).margin(1e-4));
+                CHECK(stats.rms == Approx(bump * std::sqrt(8.0f) / 9).margin(1e-4));
+            }
+            THEN("The change is the bump")
+            {
+                CHECK(stats.max_change == Approx(bump).margin(1e-5));
+            }
+        }
+    }
+}
+
+SCENARIO("Incomplete meshes", "[mesh_statistics]")
+{
+    GIVEN("A 4x4 mesh with a point not probed")
+    {
+        Mesh<4, 4> mesh{-0.0005f, 0.0015f, -0.2f};
+        mesh.z_[3][0] = NAN;
+        Fit fit;
+        mesh_statistics_t stats;
+
+        THEN("The point is ignored")
+        {
+            REQUIRE(mesh_statistics(mesh, fit, stats));
+            CHECK(stats.points == 15);
+            CHECK(stats.slope_x == Approx(-0.0005f).margin(1e-5));
+            CHECK(stats.rms == Approx(0).margin(1e-4));
+            CHECK_FALSE(std::isnan(stats.max_change));
+        }
+    }
+
+    GIVEN("A mesh without a saved copy")
+    {
+        Mesh<3, 3> mesh{0, 0, 0};
+        mesh.saved_[2][2] = NAN;
+        Fit fit;
+        mesh_statistics_t stats;
+
+        THEN("The change is unknown")
+        {
+            REQUIRE(mesh_statistics(mesh, fit, stats));
+            CHECK(std::isnan(stats.max_change));
+        }
+    }
+
+    GIVEN("A mesh with only two points")
+    {
+        Mesh<3, 3> mesh{0, 0, 0};
+        for(auto& column: mesh.z_)
+            for(auto& v: column)
+                v = NAN;
+        mesh.z_[0][0] = mesh.z_[2][2] = 0.1f;
+        Fit fit;
+        mesh_statistics_t stats;
+
+        THEN("There are no statistics")
+        {
+            CHECK_FALSE(mesh_statistics(mesh, fit, stats));
+            CHECK(stats.points == 2);
+        }
+    }
+}
@@ -0,0 +1,207 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "PowerLossRecovery.h"
+
+namespace
+{
+    const uint8_t BLOCK_BUFFER_SIZE = 16;
+    using Lines = JobRecoveryLineIndex<BLOCK_BUFFER_SIZE, 4>;
+
+    struct Position
+    {
+        float axis[4];
+        bool operator==(const Position& other) const { return std::memcmp(axis, other.axis, sizeof(axis)) == 0; }
+    };
+
+    struct Block
+    {
+        uint8_t tag;
+        Position target;
+        float feedrate;
+    };
+
+    // A G-code file with absolute moves, some split into several blocks, and a few non-move commands
+    std::string make_file(unsigned lines)
+    {
+        std::string file;
+        char line[64];
+        for(unsigned i = 1; i <= lines; ++i)
+        {
+            if(i % 7 == 0)
+                std::snprintf(line, sizeof(line), "M106 S%u\n", i % 256);
+            else if(i % 5 == 0)
+                std::snprintf(line, sizeof(line), "G1 X%u Y%u Z%u E%u F%u\n", i % 200, (i * 3) % 200, i / 10, i, 1000 + i);
+            else
+                std::snprintf(line, sizeof(line), "G1 X%u Y%u E%u\n", i % 200, (i * 3) % 200, i);
+            file += line;
+        }
+        return file;
+    }
+
+    // Just enough of the planner, the stepper and the G-code parser
+    struct Machine
+    {
+        const std::string& file;
+        Lines lines;
+        Position position{};
+        float feedrate = 50;
+        std::deque<Block> planner;
+        std::vector<Block> toolpath; // Completed blocks
+        size_t kill_after = SIZE_MAX;
+        uint32_t next_line = 0;
+
+        explicit Machine(const std::string& f): file(f) { lines.reset(); }
+
+        bool killed() const { return toolpath.size() >= kill_after; }
+
+        void complete_block()
+        {
+            toolpath.push_back(planner.front());
+            planner.pop_front();
+        }
+
+        void queue_block(const Position& target)
+        {
+            if(planner.size() >= BLOCK_BUFFER_SIZE - 1U)
+                complete_block();
+            if(killed())
+                return;
+            planner.push_back(Block{lines.tag(), target, feedrate});
+        }
+
+        void execute(uint32_t offset, const std::string& line)
+        {
+            lines.begin(offset, position.axis, feedrate);
+            if(line[0] != 'G')
+                return;
+
+            Position target = position;
+            for(size_t i = 0; i < line.size(); ++i)
+            {
+                const char* const axes = "XYZE";
+                if(const char* a = std::strchr(axes, line[i]))
+                    target.axis[a - axes] = std::strtof(line.c_str() + i + 1, nullptr);
+                else if(line[i] == 'F')
+                    feedrate = std::strtof(line.c_str() + i + 1, nullptr) / 60;
+            }
+
+            // Some lines are split like a leveled or an arc move
+            const unsigned segments = 1 + static_cast<unsigned>(target.axis[0]) % 3;
+            const Position start = position;
+            for(unsigned s = 1; s <= segments && !killed(); ++s)
+            {
+                Position segment;
+                for(int a = 0; a < 4; ++a)
+                    segment.axis[a] = s == segments ? target.axis[a] : start.axis[a] + (target.axis[a] - start.axis[a]) * s / segments;
+                queue_block(segment);
+            }
+            position = target;
+        }
+
+        void run(uint32_t offset)
+        {
+            while(offset < file.size() && !killed())
+            {
+                const size_t eol = file.find('\n', offset);
+                next_line = static_cast<uint32_t>(eol + 1);
+                execute(offset, file.substr(offset, eol - offset));
+                offset = next_line;
+            }
+            while(!planner.empty() && !killed())
+                complete_block();
+        }
+
+        // What save_job_recovery_info records
+        uint32_t resume(Position& start, float& start_feedrate) const
+        {
+            if(!planner.empty())
+            {
+                const uint8_t tag = planner.front().tag;
+                std::memcpy(start.axis, lines.position(tag), sizeof(start.axis));
+                start_feedrate = lines.feedrate(tag);
+                return lines.sdpos(tag);
+            }
+            start = position;
+            start_feedrate = feedrate;
+            return next_line;
+        }
+    };
+}
+
+SCENARIO("A job killed at any block is replayed exactly from the line index", "[recovery]")
+{
+    GIVEN("A G-code file and its complete toolpath")
+    {
+        const std::string file = make_file(300);
+        Machine reference{file};
+        reference.run(0);
+        const std::vector<Block>& expected = reference.toolpath;
+        REQUIRE(expected.size() > 3 * BLOCK_BUFFER_SIZE);
+
+        WHEN("The power is cut after random numbers of completed blocks")
+        {
+            std::mt19937 random{2018};
+            std::uniform_int_distribution<size_t> blocks{1, expected.size() - 1};
+
+            for(int run = 0; run < 200; ++run)
+            {
+                Machine job{file};
+                job.kill_after = blocks(random);
+                job.run(0);
+                REQUIRE(job.killed());
+
+                Position start;
+                float feedrate;
+                const uint32_t sdpos = job.resume(start, feedrate);
+
+                // Recovery restores the position and feedrate, then resumes the file
+                Machine recovered{file};
+                recovered.position = start;
+                recovered.feedrate = feedrate;
+                recovered.run(sdpos);
+
+                THEN("The replay redoes at most the blocks of unfinished lines and skips nothing")
+                {
+                    const std::vector<Block>& replayed = recovered.toolpath;
+                    REQUIRE(replayed.size() <= expected.size());
+                    const size_t first = expected.size() - replayed.size();
+                    REQUIRE(first <= job.kill_after);
+                    REQUIRE(job.kill_after - first < BLOCK_BUFFER_SIZE + 3);
+
+                    for(size_t i = 0; i < replayed.size(); ++i)
+                    {
+                        REQUIRE(replayed[i].target == expected[first + i].target);
+                        REQUIRE(replayed[i].feedrate == expected[first + i].feedrate);
+                    }
+                    REQUIRE(recovered.position == reference.position);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,345 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstddef>
+#include <cstring>
+#include "catch.hpp"
+#include "PowerLossRecovery.h"
+
+namespace
+{
+    // Same shape as job_recovery_hot_t for a single hotend, heated bed and one fan
+    struct Hot
+    {
+        uint32_t sequence;
+        uint16_t crc;
+        float current_position[4], feedrate;
+        int16_t target_temperature[1];
+        int16_t target_temperature_bed;
+        int16_t fanSpeeds[1];
+        uint32_t sdpos;
+        uint32_t print_job_elapsed;
+    };
+
+    struct Cold
+    {
+        uint32_t sequence;
+        uint16_t crc;
+        bool leveling;
+        float fade;
+        char sd_filename[26];
+    };
+
+    // The recovery file, as written on the USB drive
+    struct File
+    {
+        uint8_t bytes[JOB_RECOVERY_FILE_SIZE] = {};
+
+        // Write the record, but only 'written' bytes of it reach the media before the power is cut
+        template<typename T>
+        void write(uint32_t offset, const T& rec, size_t written = sizeof(T))
+        {
+            std::memcpy(bytes + offset, &rec, written);
+        }
+
+        template<typename T>
+        T read(uint32_t offset) const
+        {
+            T rec;
+            std::memcpy(&rec, bytes + offset, sizeof(T));
+            return rec;
+        }
+
+        int8_t latest() const
+        {
+            Hot slots[JOB_RECOVERY_SLOTS];
+            for(uint8_t i = 0; i < JOB_RECOVERY_SLOTS; ++i)
+                slots[i] = read<Hot>(JOB_RECOVERY_SLOT_OFFSET(i));
+            return job_recovery_latest(slots, JOB_RECOVERY_SLOTS);
+        }
+
+        int8_t latest_cold() const
+        {
+            Cold slots[JOB_RECOVERY_COLD_SLOTS];
+            for(uint8_t i = 0; i < JOB_RECOVERY_COLD_SLOTS; ++i)
+                slots[i] = read<Cold>(JOB_RECOVERY_COLD_OFFSET(i));
+            return job_recovery_latest(slots, JOB_RECOVERY_COLD_SLOTS);
+        }
+
+        Hot latest_hot() const
+        {
+            auto index = latest();
+            REQUIRE(index >= 0);
+            return read<Hot>(JOB_RECOVERY_SLOT_OFFSET(index));
+        }
+    };
+
+    Hot make_hot(uint32_t n)
+    {
+        Hot hot;
+        std::memset(&hot, 0, sizeof(hot));
+        hot.current_position[2] = 0.2f * n;
+        hot.feedrate = 50;
+        hot.target_temperature[0] = 200;
+        hot.target_temperature_bed = 60;
+        hot.fanSpeeds[0] = 255;
+        hot.sdpos = 1000 * n;
+        hot.print_job_elapsed = 10 * n;
+        return hot;
+    }
+
+    // One save as done by save_job_recovery_info, possibly interrupted
+    void save(File& file, Hot& hot, uint32_t n, size_t written = sizeof(Hot))
+    {
+        Hot next = make_hot(n);
+        job_recovery_seal(next, hot.sequence + 1);
+        file.write(JOB_RECOVERY_SLOT_OFFSET(job_recovery_slot(next.sequence)), next, written);
+        if(written == sizeof(Hot))
+            hot = next;
+    }
+}
+
+SCENARIO("Power-loss recovery records are sealed and checked", "[recovery]")
+{
+    GIVEN("A sealed record")
+    {
+        Hot hot = make_hot(3);
+        job_recovery_seal(hot, 42);
+
+        THEN("It is valid")
+        {
+            REQUIRE(hot.sequence == 42);
+            REQUIRE(job_recovery_valid(hot));
+        }
+
+        WHEN("Any byte is corrupted")
+        {
+            THEN("It is no longer valid")
+            {
+                for(size_t i = 0; i < sizeof(Hot); ++i)
+                {
+                    Hot copy = hot;
+                    reinterpret_cast<uint8_t*>(&copy)[i] ^= 0x10;
+                    // Padding bytes on the host are covered by the CRC too
+                    REQUIRE_FALSE(job_recovery_valid(copy));
+                }
+            }
+        }
+    }
+
+    GIVEN("A zero-filled record, as in a freshly prepared file")
+    {
+        Hot hot;
+        std::memset(&hot, 0, sizeof(hot));
+
+        THEN("It is not valid even if its CRC matches")
+        {
+            REQUIRE(job_recovery_record_crc(hot) == 0);
+            REQUIRE_FALSE(job_recovery_valid(hot));
+        }
+    }
+}
+
+SCENARIO("The most recent slot of the ring is recovered", "[recovery]")
+{
+    GIVEN("A freshly prepared file")
+    {
+        File file;
+        Hot hot;
+        std::memset(&hot, 0, sizeof(hot));
+
+        THEN("Nothing can be recovered")
+        {
+            REQUIRE(file.latest() == -1);
+        }
+
+        WHEN("More saves than slots are done")
+        {
+            for(uint32_t n = 1; n <= 3 * JOB_RECOVERY_SLOTS + 1; ++n)
+                save(file, hot, n);
+
+            THEN("The last save is recovered")
+            {
+                Hot recovered = file.latest_hot();
+                REQUIRE(recovered.sequence == 3 * JOB_RECOVERY_SLOTS + 1);
+                REQUIRE(recovered.sdpos == 1000 * (3 * JOB_RECOVERY_SLOTS + 1));
+            }
+        }
+    }
+}
+
+SCENARIO("A power cut during a save falls back to the previous slot", "[recovery]")
+{
+    GIVEN("A file with several complete saves")
+    {
+        for(uint32_t saves = 1; saves <= 2 * JOB_RECOVERY_SLOTS; ++saves)
+        {
+            for(size_t written = 0; written < sizeof(Hot); ++written)
+            {
+                File file;
+                Hot hot;
+                std::memset(&hot, 0, sizeof(hot));
+                for(uint32_t n = 1; n <= saves; ++n)
+                    save(file, hot, n);
+
+                // The power is cut after 'written' bytes of the next save
+                save(file, hot, saves + 1, written);
+
+                Hot recovered = file.latest_hot();
+                if(recovered.sequence == saves + 1)
+                {
+                    // The bytes not written already had their new value: the record is complete
+                    Hot intended = make_hot(saves + 1);
+                    job_recovery_seal(intended, saves + 1);
+                    REQUIRE(std::memcmp(&recovered, &intended, sizeof(Hot)) == 0);
+                }
+                else
+                {
+                    REQUIRE(recovered.sequence == saves);
+                    REQUIRE(recovered.sdpos == 1000 * saves);
+                    REQUIRE(recovered.current_position[2] == Approx(0.2f * saves));
+                }
+            }
+        }
+    }
+
+    GIVEN("A power cut during the very first save")
+    {
+        File file;
+        Hot hot;
+        std::memset(&hot, 0, sizeof(hot));
+        save(file, hot, 1, sizeof(Hot) / 2);
+
+        THEN("Nothing can be recovered")
+        {
+            REQUIRE(file.latest() == -1);
+        }
+    }
+}
+
+SCENARIO("The cold record is only valid when complete", "[recovery]")
+{
+    GIVEN("A cold record")
+    {
+        File file;
+        Cold cold;
+        std::memset(&cold, 0, sizeof(cold));
+        cold.leveling = true;
+        cold.fade = 10;
+        std::strcpy(cold.sd_filename, "/PARTS/BRACKET.GCO");
+
+        WHEN("It is written completely")
+        {
+            job_recovery_seal(cold, 1);
+            file.write(JOB_RECOVERY_COLD_OFFSET(0), cold);
+
+            THEN("It is valid")
+            {
+                REQUIRE(job_recovery_valid(file.read<Cold>(JOB_RECOVERY_COLD_OFFSET(0))));
+            }
+
+            AND_WHEN("It is rewritten unchanged")
+            {
+                THEN("Its CRC still matches so there is no need to write it again")
+                {
+                    REQUIRE(job_recovery_valid(cold));
+                }
+            }
+
+            AND_WHEN("A field changes")
+            {
+                cold.leveling = false;
+
+                THEN("Its CRC no longer matches and it has to be written again")
+                {
+                    REQUIRE_FALSE(job_recovery_valid(cold));
+                }
+            }
+        }
+
+        WHEN("The power is cut while it is written")
+        {
+            job_recovery_seal(cold, 1);
+            file.write(JOB_RECOVERY_COLD_OFFSET(0), cold, offsetof(Cold, sd_filename) + 4);
+
+            THEN("It is not valid")
+            {
+                REQUIRE_FALSE(job_recovery_valid(file.read<Cold>(JOB_RECOVERY_COLD_OFFSET(0))));
+            }
+        }
+    }
+}
+
+SCENARIO("A power cut while the cold record changes keeps the previous one", "[recovery]")
+{
+    GIVEN("A cold record saved with the first hot record, then changed")
+    {
+        File file;
+        Hot hot;
+        std::memset(&hot, 0, sizeof(hot));
+        Cold cold;
+        std::memset(&cold, 0, sizeof(cold));
+        std::strcpy(cold.sd_filename, "/PARTS/BRACKET.GCO");
+        uint8_t cold_slot = 0;
+
+        // As save_job_recovery_info: the new cold record goes to the other slot, before the hot record of the same save
+        auto save_cold = [&](size_t written)
+        {
+            cold_slot ^= 1;
+            job_recovery_seal(cold, hot.sequence + 1);
+            file.write(JOB_RECOVERY_COLD_OFFSET(cold_slot), cold, written);
+        };
+
+        save_cold(sizeof(Cold));
+        save(file, hot, 1);
+        for(uint32_t n = 2; n <= JOB_RECOVERY_SLOTS; ++n)
+            save(file, hot, n);
+        cold.leveling = true;
+        cold.fade = 10;
+
+        WHEN("The power is cut while it is written")
+        {
+            save_cold(offsetof(Cold, sd_filename) + 4);
+
+            THEN("The previous cold record is recovered with the last hot record")
+            {
+                const auto latest = file.latest_cold();
+                REQUIRE(latest >= 0);
+                const Cold recovered = file.read<Cold>(JOB_RECOVERY_COLD_OFFSET(latest));
+                REQUIRE_FALSE(recovered.leveling);
+                REQUIRE(std::strcmp(recovered.sd_filename, "/PARTS/BRACKET.GCO") == 0);
+                REQUIRE(file.latest_hot().sequence == JOB_RECOVERY_SLOTS);
+            }
+        }
+
+        WHEN("It is written completely")
+        {
+            save_cold(sizeof(Cold));
+            save(file, hot, JOB_RECOVERY_SLOTS + 1);
+
+            THEN("The new cold record is recovered")
+            {
+                const auto latest = file.latest_cold();
+                REQUIRE(latest == cold_slot);
+                REQUIRE(file.read<Cold>(JOB_RECOVERY_COLD_OFFSET(latest)).leveling);
+            }
+        }
+    }
+}
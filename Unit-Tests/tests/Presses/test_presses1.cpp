@@ -0,0 +1,243 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <vector>
+#include "catch.hpp"
+#include "Presses.h"
+
+using namespace adv;
+
+namespace
+{
+    using Jogs = Presses<3, 100, 300>;
+
+    //! A button pressed or held: presses every period ms, from start to start + duration
+    struct Button
+    {
+        uint8_t control;
+        int16_t delta;
+        uint32_t start;
+        uint32_t duration;
+        uint32_t period;
+    };
+
+    //! Outcome of a simulation
+    struct Outcome
+    {
+        std::vector<int16_t> applied;   //!< Changes applied, in order
+        int32_t total = 0;              //!< Sum of the changes applied
+        uint32_t presses = 0;           //!< Number of presses
+        uint32_t last_change = 0;       //!< Time of the last change applied
+    };
+
+    //! Simulate the LCD panel and idle(): the buttons are read and the changes applied every step ms
+    Outcome simulate(const std::vector<Button>& buttons, uint32_t duration, uint32_t start = 0, uint32_t step = 2)
+    {
+        Jogs jogs;
+        Outcome outcome;
+        for(uint32_t now = start; now - start < duration; now += step)
+        {
+            for(auto& button: buttons)
+            {
+                const uint32_t elapsed = now - start - button.start;
+                if(now - start >= button.start && elapsed <= button.duration && elapsed % button.period == 0)
+                {
+                    jogs.add(button.control, button.delta, now);
+                    ++outcome.presses;
+                }
+            }
+
+            for(uint8_t control = 0; control < 3; ++control)
+            {
+                const int16_t delta = jogs.take(control, now);
+                if(delta)
+                {
+                    outcome.applied.push_back(delta);
+                    outcome.total += delta;
+                    outcome.last_change = now - start;
+                }
+            }
+        }
+        return outcome;
+    }
+}
+
+SCENARIO("Presses in the same direction are merged", "[presses]")
+{
+    GIVEN("Some presses")
+    {
+        Jogs jogs;
+
+        WHEN("Presses are close to each other")
+        {
+            jogs.add(0, 400, 1000);
+            jogs.add(0, 400, 1050);
+            jogs.add(0, 400, 1090);
+
+            THEN("Nothing is applied during the window")
+            {
+                CHECK(jogs.pending(0));
+                CHECK(jogs.take(0, 1100) == 0);
+                CHECK(jogs.take(0, 1189) == 0);
+            }
+            THEN("They are applied at once after the window")
+            {
+                CHECK(jogs.take(0, 1190) == 1200);
+                CHECK(jogs.take(0, 1191) == 0);
+                CHECK(!jogs.pending(0));
+            }
+            THEN("Other controls are not changed")
+            {
+                CHECK(!jogs.pending(1));
+                CHECK(jogs.take(1, 2000) == 0);
+                CHECK(jogs.take(2, 2000) == 0);
+            }
+        }
+
+        WHEN("The button is held")
+        {
+            for(uint32_t now = 0; now < 300; now += 50)
+            {
+                jogs.add(1, 50, now);
+                CHECK(jogs.take(1, now) == 0);
+            }
+
+            THEN("The latency is bounded")
+            {
+                CHECK(jogs.take(1, 299) == 0);
+                CHECK(jogs.take(1, 300) == 50 * 6);
+            }
+        }
+
+        WHEN("The direction changes")
+        {
+            jogs.add(2, 50, 0);
+            jogs.add(2, 50, 10);
+            jogs.add(2, -50, 20);
+
+            THEN("The sum before the change is ready at once")
+            {
+                CHECK(jogs.take(2, 20) == 100);
+                CHECK(jogs.take(2, 21) == 0);
+                CHECK(jogs.take(2, 120) == -50);
+            }
+        }
+
+        WHEN("The direction changes twice before being taken")
+        {
+            jogs.add(2, 50, 0);
+            jogs.add(2, -50, 10);
+            jogs.add(2, -50, 20);
+            jogs.add(2, 50, 30);
+
+            THEN("Nothing is lost")
+            {
+                int32_t total = 0;
+                for(uint32_t now = 30; now < 500; ++now)
+                    total += jogs.take(2, now);
+                CHECK(total == 0);
+                CHECK(!jogs.pending(2));
+            }
+        }
+
+        WHEN("The sum overflows")
+        {
+            for(int i = 0; i < 100; ++i)
+                jogs.add(0, 1000, 0);
+            jogs.add(1, -30000, 0);
+            jogs.add(1, -30000, 0);
+
+            THEN("It is saturated")
+            {
+                CHECK(jogs.take(0, 100) == INT16_MAX);
+                CHECK(jogs.take(1, 100) == INT16_MIN);
+            }
+        }
+
+        WHEN("Presses are cleared")
+        {
+            jogs.add(0, 400, 0);
+            jogs.clear();
+
+            THEN("Nothing is applied")
+            {
+                CHECK(!jogs.pending(0));
+                CHECK(jogs.take(0, 1000) == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Presses around the wrap around of millis()", "[presses]")
+{
+    GIVEN("Presses just before millis() wraps around")
+    {
+        Jogs jogs;
+        jogs.add(0, 400, 0xFFFFFFC0);
+        jogs.add(0, 400, 0xFFFFFFF0);
+
+        THEN("They are applied after the window")
+        {
+            CHECK(jogs.take(0, 0x00000010) == 0);
+            CHECK(jogs.take(0, 0x00000060) == 800);
+        }
+    }
+
+    GIVEN("Presses when the low 16 bits of millis() wrap around")
+    {
+        const Outcome outcome = simulate({{0, 400, 0, 1000, 50}}, 2000, 0x0001FE00);
+
+        THEN("Nothing is lost and the latency is bounded")
+        {
+            CHECK(outcome.total == 400 * 21);
+            CHECK(outcome.last_change <= 1000 + 100 + 2);
+        }
+    }
+}
+
+SCENARIO("Commands generated by a burst of presses", "[presses]")
+{
+    GIVEN("A button pressed 20 times in a second and another one tapped once")
+    {
+        const Outcome outcome = simulate({{0, 400, 0, 950, 50}, {2, -50, 400, 0, 1}}, 3000);
+
+        THEN("Few changes are applied and nothing is lost")
+        {
+            INFO("Presses: " << outcome.presses << ", changes applied: " << outcome.applied.size());
+            CHECK(outcome.presses == 21);
+            CHECK(outcome.total == 400 * 20 - 50);
+            CHECK(outcome.applied.size() <= 6);
+            CHECK(outcome.last_change <= 950 + 100 + 2);
+        }
+    }
+
+    GIVEN("A button held with the auto-repeat of the LCD panel (every 20 ms)")
+    {
+        const Outcome outcome = simulate({{1, 4, 0, 2000, 20}}, 3000);
+
+        THEN("Changes are applied at least every latency")
+        {
+            INFO("Presses: " << outcome.presses << ", changes applied: " << outcome.applied.size());
+            CHECK(outcome.total == 4 * 101);
+            CHECK(outcome.applied.size() >= 2000 / 300);
+            CHECK(outcome.applied.size() <= 2000 / 300 + 2);
+        }
+    }
+}
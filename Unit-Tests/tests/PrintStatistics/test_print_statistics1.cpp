@@ -0,0 +1,248 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "catch.hpp"
+#include "PrintStatistics.h"
+
+namespace
+{
+    using Stats = printStatisticsExtended<2, 3>;
+
+    //! EEPROM written like eeprom_update_block: only the bytes that are different
+    struct Eeprom
+    {
+        uint8_t bytes[sizeof(Stats)] = {};
+        uint32_t writes[sizeof(Stats)] = {};
+
+        void update(const Stats& stats)
+        {
+            const auto* data = reinterpret_cast<const uint8_t*>(&stats);
+            for(size_t i = 0; i < sizeof(Stats); ++i)
+                if(bytes[i] != data[i])
+                {
+                    bytes[i] = data[i];
+                    ++writes[i];
+                }
+        }
+
+        uint32_t max_writes() const { return *std::max_element(writes, writes + sizeof(Stats)); }
+    };
+
+    //! A day of use: the printer is on 10 hours and prints 8 of them, in 2 jobs.
+    //! Every second: moves, filament and heater time. The journal decides when to save.
+    //! @param save_each_change Save at each change instead (what not to do)
+    //! @return The EEPROM after the given number of days
+    Eeprom simulate(unsigned days, bool save_each_change, unsigned& saves)
+    {
+        Stats stats{};
+        StatisticsJournal journal;
+        Eeprom eeprom;
+        saves = 0;
+
+        uint32_t now = 0;
+        for(unsigned day = 0; day < days; ++day)
+        {
+            for(unsigned second = 0; second < 10 * 3600; ++second, ++now)
+            {
+                const bool printing = (second >= 600 && second < 600 + 4 * 3600) ||
+                                      (second >= 5 * 3600 && second < 9 * 3600);
+                if(printing)
+                {
+                    stats.moves += 20;
+                    stats.filamentUsed[0] += 0.8f;
+                    stats.heaterTime[0] += 1;
+                    stats.heaterTime[2] += 1;
+                    journal.changed();
+                }
+                // End of a job
+                if(second == 600 + 4 * 3600 || second == 9 * 3600)
+                    journal.changed(true);
+
+                if(save_each_change ? journal.dirty() : journal.due(now, 3600))
+                {
+                    eeprom.update(stats);
+                    journal.saved(now);
+                    ++saves;
+                }
+            }
+            now += 14 * 3600; // Off
+        }
+
+        // Nothing is lost when the printer is turned off after a print
+        INFO("Saved statistics are the last ones");
+        CHECK(std::memcmp(eeprom.bytes, &stats, sizeof(Stats)) == 0);
+        return eeprom;
+    }
+}
+
+SCENARIO("Statistics are saved in batches", "[PrintStatistics]")
+{
+    GIVEN("A journal with nothing changed")
+    {
+        StatisticsJournal journal;
+        journal.reset(0);
+
+        THEN("Nothing has to be saved")
+        {
+            CHECK_FALSE(journal.dirty());
+            CHECK_FALSE(journal.due(100000, 3600));
+        }
+
+        WHEN("A counter changes")
+        {
+            journal.changed();
+
+            THEN("It is saved only after the interval")
+            {
+                CHECK(journal.dirty());
+                CHECK_FALSE(journal.due(3599, 3600));
+                CHECK(journal.due(3600, 3600));
+            }
+
+            AND_WHEN("It is saved")
+            {
+                journal.saved(3600);
+                THEN("The interval starts again")
+                {
+                    CHECK_FALSE(journal.dirty());
+                    journal.changed();
+                    CHECK_FALSE(journal.due(7199, 3600));
+                    CHECK(journal.due(7200, 3600));
+                }
+            }
+        }
+
+        WHEN("An urgent change happens")
+        {
+            journal.changed();
+            journal.changed(true);
+            journal.changed();
+
+            THEN("It is saved at once and the urgency does not last")
+            {
+                CHECK(journal.due(1, 3600));
+                journal.saved(1);
+                journal.changed();
+                CHECK_FALSE(journal.due(2, 3600));
+            }
+        }
+
+        WHEN("millis() wraps around")
+        {
+            journal.reset(0xFFFFF000);
+            journal.changed();
+            THEN("The interval is still respected")
+            {
+                CHECK_FALSE(journal.due(0x00000100, 0x2000));
+                CHECK(journal.due(0x00001000, 0x2000));
+            }
+        }
+    }
+}
+
+SCENARIO("Statistics are sent only when they change", "[PrintStatistics]")
+{
+    GIVEN("A journal and a reader that has seen nothing")
+    {
+        StatisticsJournal journal;
+        uint16_t seen = 0;
+
+        THEN("The first time, they are sent")
+        {
+            CHECK(journal.changedSince(seen));
+            CHECK_FALSE(journal.changedSince(seen));
+        }
+
+        WHEN("They change, several times")
+        {
+            journal.changedSince(seen);
+            journal.changed();
+            journal.changed();
+            THEN("They are sent once")
+            {
+                CHECK(journal.changedSince(seen));
+                CHECK_FALSE(journal.changedSince(seen));
+            }
+        }
+
+        WHEN("Saving them")
+        {
+            journal.changedSince(seen);
+            journal.changed();
+            journal.changedSince(seen);
+            journal.saved(10);
+            THEN("They are not sent again")
+            {
+                CHECK_FALSE(journal.changedSince(seen));
+            }
+        }
+
+        WHEN("The version wraps around")
+        {
+            bool zero = false;
+            for(unsigned i = 0; i < 0x10000; ++i)
+            {
+                journal.changed();
+                zero = zero || journal.version() == 0;
+            }
+            CHECK_FALSE(zero);
+            THEN("A reader that has seen nothing still gets them")
+            {
+                uint16_t none = 0;
+                CHECK(journal.changedSince(none));
+            }
+        }
+    }
+}
+
+SCENARIO("The EEPROM lasts with statistics saved in batches", "[PrintStatistics]")
+{
+    GIVEN("30 days of prints, 8 hours a day")
+    {
+        WHEN("Saving at each change")
+        {
+            unsigned saves = 0;
+            const Eeprom eeprom = simulate(30, true, saves);
+            const uint32_t max_writes = eeprom.max_writes();
+            INFO("Saves: " << saves << ", writes of the most written byte: " << max_writes);
+            THEN("The most written byte is near its endurance (100 000 writes) in a month")
+            {
+                CHECK(max_writes > 100000 / 2);
+            }
+        }
+
+        WHEN("Saving with the journal")
+        {
+            unsigned saves = 0;
+            const Eeprom eeprom = simulate(30, false, saves);
+            const uint32_t max_writes = eeprom.max_writes();
+            INFO("Saves: " << saves << ", writes of the most written byte: " << max_writes);
+            THEN("It is saved at most once an hour plus at the end of the jobs")
+            {
+                CHECK(saves <= 30 * (10 + 2));
+                // 100 000 writes last more than 20 years at this rate
+                CHECK(max_writes * 12 * 20 < 100000);
+            }
+        }
+    }
+}
@@ -0,0 +1,268 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cmath>
+#include <vector>
+#include "catch.hpp"
+#include "PrintTimeEstimator.h"
+
+namespace
+{
+    //! A part of a G-code file
+    struct Section
+    {
+        uint32_t bytes;     //!< Size of the part
+        double planned;     //!< Duration of its moves, as planned (s)
+        double actual;      //!< Actual time to print it (s), heating and accelerations included
+    };
+
+    //! Estimate at some point of a print
+    struct Estimate
+    {
+        double progress;    //!< Part of the actual time elapsed
+        double actual;      //!< Actual time remaining (s)
+        double estimated;   //!< Time remaining given by the estimator (s)
+        double linear;      //!< Time remaining from the percentage of the file read (s)
+    };
+
+    //! Simulate a print: bytes are read and moves planned as the time passes, the estimator is
+    //! updated every 500 ms like the status of the LCD panel.
+    std::vector<Estimate> simulate(PrintTimeEstimator& estimator, const std::vector<Section>& sections,
+                                   const std::vector<double>& checkpoints)
+    {
+        uint32_t size = 0;
+        double total = 0;
+        for(auto& section: sections)
+        {
+            size += section.bytes;
+            total += section.actual;
+        }
+
+        std::vector<Estimate> estimates;
+        size_t checkpoint = 0;
+        double position = 0, time = 0;
+        for(auto& section: sections)
+        {
+            const double step = 0.5, bytes_per_step = section.bytes * step / section.actual;
+            for(double t = 0; t < section.actual; t += step)
+            {
+                position += bytes_per_step;
+                estimator.add_move(section.planned * bytes_per_step / section.bytes);
+                time += step;
+
+                const auto elapsed = static_cast<uint32_t>(time);
+                const auto read = static_cast<uint32_t>(position);
+                estimator.update(read, size, elapsed);
+
+                if(checkpoint < checkpoints.size() && time >= checkpoints[checkpoint] * total)
+                {
+                    const double percent = std::floor(100.0 * read / size);
+                    const int32_t remaining = estimator.remaining(read);
+                    estimates.push_back({checkpoints[checkpoint], total - time, static_cast<double>(remaining),
+                                         percent > 0 ? elapsed * (100 - percent) / percent : -1});
+                    ++checkpoint;
+                }
+            }
+        }
+        return estimates;
+    }
+
+    double error(double estimated, double actual) { return std::fabs(estimated - actual) / actual; }
+
+    //! A typical print: start G-code with heating, a slow first layer, infill and small perimeters at the end
+    const std::vector<Section> print =
+    {
+        {1500,    20, 240},     // Start G-code: heating, homing, leveling
+        {60000,  700, 900},     // First layer, slow
+        {800000, 3000, 3300},   // Infill
+        {400000, 1000, 1600},   // Top layers, short segments
+    };
+
+    const std::vector<double> checkpoints = {0.10, 0.25, 0.50, 0.75, 0.90};
+}
+
+SCENARIO("Time remaining of a simulated print", "[print_time]")
+{
+    GIVEN("A print with a heating preamble and sections of different speeds")
+    {
+        PrintTimeEstimator estimator;
+        const auto estimates = simulate(estimator, print, checkpoints);
+        REQUIRE(estimates.size() == checkpoints.size());
+
+        THEN("The estimate is closer than the linear one")
+        {
+            for(auto& estimate: estimates)
+            {
+                INFO("At " << estimate.progress * 100 << "% of the time: actual " << estimate.actual
+                     << " s, estimated " << estimate.estimated << " s (" << error(estimate.estimated, estimate.actual) * 100
+                     << "%), linear " << estimate.linear << " s (" << error(estimate.linear, estimate.actual) * 100 << "%)");
+                CHECK(estimate.estimated >= 0);
+                CHECK(error(estimate.estimated, estimate.actual) < error(estimate.linear, estimate.actual));
+                // During the first layer, its speed is extrapolated to the whole file
+                if(estimate.progress >= 0.25)
+                    CHECK(error(estimate.estimated, estimate.actual) < 0.10);
+            }
+            CHECK(estimator.samples() > 100);
+        }
+    }
+
+    GIVEN("The same print with the time given by the slicer")
+    {
+        PrintTimeEstimator estimator;
+        estimator.set_slicer_time(4720, 1261500); // The moves, without heating and accelerations
+        const auto estimates = simulate(estimator, print, checkpoints);
+        REQUIRE(estimates.size() == checkpoints.size());
+
+        THEN("The estimate is close from the start")
+        {
+            for(auto& estimate: estimates)
+            {
+                INFO("At " << estimate.progress * 100 << "% of the time: actual " << estimate.actual
+                     << " s, estimated " << estimate.estimated << " s (" << error(estimate.estimated, estimate.actual) * 100
+                     << "%), linear " << estimate.linear << " s");
+                CHECK(error(estimate.estimated, estimate.actual) < 0.20);
+            }
+        }
+    }
+
+    GIVEN("A print at a constant speed")
+    {
+        PrintTimeEstimator estimator;
+        const auto estimates = simulate(estimator, {{1000000, 3600, 3960}}, checkpoints);
+
+        THEN("The ratio between the actual and the planned time is learnt")
+        {
+            CHECK(estimator.ratio() == Approx(1.1).epsilon(0.02));
+            CHECK(estimator.seconds_per_byte() == Approx(0.0036).epsilon(0.02));
+            for(auto& estimate: estimates)
+                CHECK(error(estimate.estimated, estimate.actual) < 0.03);
+        }
+    }
+}
+
+SCENARIO("Start of a print", "[print_time]")
+{
+    GIVEN("An estimator")
+    {
+        PrintTimeEstimator estimator;
+
+        WHEN("Nothing has been learnt")
+        {
+            estimator.update(0, 100000, 0);
+            estimator.update(1000, 100000, 60);
+
+            THEN("There is no estimate")
+            {
+                CHECK(estimator.remaining(1000) == -1);
+            }
+        }
+
+        WHEN("The slicer gives the time of the print")
+        {
+            estimator.set_slicer_time(3600, 100000);
+            estimator.update(0, 100000, 0);
+            estimator.update(500, 100000, 120);  // Heating: no move
+
+            THEN("The heating is not counted")
+            {
+                CHECK(estimator.remaining(500) == 3600);
+            }
+
+            estimator.add_move(1);
+            estimator.update(600, 100000, 121);  // First move
+            estimator.add_move(100);
+
+            THEN("What is not planned yet is remaining")
+            {
+                CHECK(estimator.remaining(600) == 3500);
+            }
+
+            estimator.add_move(5000);
+
+            THEN("The estimate from the file is used past the time of the slicer")
+            {
+                CHECK(estimator.remaining(600) == -1);
+            }
+        }
+
+        WHEN("Moves are planned before the print")
+        {
+            estimator.add_move(100);
+            estimator.update(0, 100000, 0);
+            estimator.add_move(1);
+            estimator.update(100, 100000, 1);
+            for(uint32_t t = 2; t <= 12; ++t)
+            {
+                estimator.add_move(0.1f);
+                estimator.update(t * 100, 100000, t);
+            }
+
+            THEN("They are forgotten")
+            {
+                REQUIRE(estimator.samples() == 1);
+                CHECK(estimator.seconds_per_byte() == Approx(0.001));
+            }
+        }
+    }
+}
+
+SCENARIO("A new print", "[print_time]")
+{
+    GIVEN("An estimator which has learnt a print")
+    {
+        PrintTimeEstimator estimator;
+        simulate(estimator, {{100000, 600, 1200}}, {});
+        REQUIRE(estimator.samples() > 0);
+
+        WHEN("Another file is printed")
+        {
+            estimator.update(0, 50000, 0);
+
+            THEN("It starts again")
+            {
+                CHECK(estimator.samples() == 0);
+                CHECK(estimator.remaining(0) == -1);
+            }
+        }
+
+        WHEN("Another file is printed after a file with a time given by the slicer")
+        {
+            estimator.set_slicer_time(3600, 100000);
+            estimator.update(0, 100000, 0);
+            REQUIRE(estimator.remaining(0) == 3600);
+            estimator.update(0, 50000, 0);
+
+            THEN("The time of the slicer is forgotten")
+            {
+                CHECK(estimator.remaining(0) == -1);
+            }
+        }
+
+        WHEN("The same file is printed again")
+        {
+            estimator.update(10, 100000, 0);
+
+            THEN("It starts again")
+            {
+                CHECK(estimator.samples() == 0);
+            }
+        }
+    }
+}
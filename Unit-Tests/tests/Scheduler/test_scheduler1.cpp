@@ -0,0 +1,351 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <vector>
+#include "catch.hpp"
+#include "Scheduler.h"
+
+using namespace adv;
+
+namespace
+{
+    //! Virtual millis() and the log of the tasks executed
+    struct Clock
+    {
+        uint32_t now = 0;
+        std::vector<int> log;
+    };
+
+    Clock clock_;
+
+    //! A task: an identifier, with a possible action when executed
+    struct Task
+    {
+        int id = 0;
+        void (*action)(int) = nullptr;
+
+        void operator()() const
+        {
+            clock_.log.push_back(id);
+            if(action)
+                action(id);
+        }
+    };
+
+    using Tasks = Scheduler<Task, 8>;
+
+    //! Advance the virtual time, calling execute() every step ms like idle()
+    void run(Tasks& tasks, uint32_t duration, uint32_t step = 1)
+    {
+        for(uint32_t elapsed = 0; elapsed < duration; elapsed += step)
+        {
+            clock_.now += step;
+            tasks.execute(clock_.now);
+        }
+    }
+
+    unsigned count(int id)
+    {
+        unsigned n = 0;
+        for(auto i: clock_.log)
+            if(i == id)
+                ++n;
+        return n;
+    }
+
+    Tasks* current_ = nullptr;
+    TaskHandle self_ = no_task;
+}
+
+SCENARIO("Tasks are executed in deadline order")
+{
+    GIVEN("Three tasks with different periods")
+    {
+        clock_ = Clock{};
+        Tasks tasks;
+        tasks.add(Task{3}, 300, clock_.now);
+        tasks.add(Task{1}, 100, clock_.now);
+        tasks.add(Task{2}, 200, clock_.now);
+        REQUIRE(tasks.count() == 3);
+
+        uint32_t deadline = 0;
+        REQUIRE(tasks.next_deadline(deadline));
+        CHECK(deadline == 100);
+
+        WHEN("Nothing is due")
+        {
+            clock_.now = 99;
+            THEN("Nothing is executed")
+            {
+                CHECK(tasks.execute(clock_.now) == 0);
+                CHECK(clock_.log.empty());
+            }
+        }
+
+        WHEN("All are due at the same time")
+        {
+            clock_.now = 1000;
+            THEN("Each is executed once, earliest deadline first")
+            {
+                CHECK(tasks.execute(clock_.now) == 3);
+                CHECK(clock_.log == (std::vector<int>{1, 2, 3}));
+            }
+        }
+
+        WHEN("600 ms elapse")
+        {
+            run(tasks, 600);
+            THEN("Each follows its own period")
+            {
+                CHECK(count(1) == 6);
+                CHECK(count(2) == 3);
+                CHECK(count(3) == 2);
+            }
+        }
+    }
+}
+
+SCENARIO("Tasks are cancelled by handle")
+{
+    GIVEN("Two tasks")
+    {
+        clock_ = Clock{};
+        Tasks tasks;
+        TaskHandle a = tasks.add(Task{1}, 100, clock_.now);
+        TaskHandle b = tasks.add(Task{2}, 100, clock_.now);
+        REQUIRE(a != no_task);
+        REQUIRE(b != no_task);
+        REQUIRE(a != b);
+
+        WHEN("One is cancelled")
+        {
+            CHECK(tasks.cancel(a));
+            THEN("Only the other is executed and the handle is reset")
+            {
+                CHECK(a == no_task);
+                CHECK_FALSE(tasks.has(a));
+                CHECK(tasks.has(b));
+                run(tasks, 500);
+                CHECK(count(1) == 0);
+                CHECK(count(2) == 5);
+            }
+        }
+
+        WHEN("A task is cancelled and its slot reused")
+        {
+            TaskHandle stale = a;
+            tasks.cancel(a);
+            TaskHandle c = tasks.add(Task{3}, 100, clock_.now);
+            THEN("The old handle does not match the new task")
+            {
+                CHECK(c != stale);
+                CHECK_FALSE(tasks.has(stale));
+                CHECK_FALSE(tasks.cancel(stale));
+                CHECK(tasks.has(c));
+                CHECK(tasks.count() == 2);
+            }
+        }
+
+        WHEN("A task cancels itself when executed")
+        {
+            current_ = &tasks;
+            self_ = tasks.add(Task{4, [](int) { current_->cancel(self_); }}, 50, clock_.now);
+            run(tasks, 500);
+            THEN("It is executed once")
+            {
+                CHECK(count(4) == 1);
+                CHECK(count(1) == 5);
+                CHECK(tasks.count() == 2);
+            }
+        }
+
+        WHEN("A task replaces itself by another one")
+        {
+            current_ = &tasks;
+            self_ = tasks.add(Task{5, [](int)
+            {
+                current_->cancel(self_);
+                self_ = current_->add(Task{6}, 100, clock_.now);
+            }}, 50, clock_.now);
+            run(tasks, 500);
+            THEN("The new task takes over from the next period")
+            {
+                CHECK(count(5) == 1);
+                CHECK(count(6) == 4);
+            }
+        }
+    }
+}
+
+SCENARIO("The capacity of the scheduler is fixed")
+{
+    GIVEN("A full scheduler")
+    {
+        clock_ = Clock{};
+        Tasks tasks;
+        std::vector<TaskHandle> handles;
+        for(int i = 0; i < 8; ++i)
+            handles.push_back(tasks.add(Task{i}, static_cast<uint16_t>(10 * (8 - i)), clock_.now));
+
+        THEN("No more task can be added")
+        {
+            CHECK(tasks.add(Task{9}, 100, clock_.now) == no_task);
+        }
+
+        WHEN("Tasks are cancelled in any order")
+        {
+            tasks.cancel(handles[3]);
+            tasks.cancel(handles[0]);
+            tasks.cancel(handles[6]);
+            THEN("The others are still executed in deadline order")
+            {
+                clock_.now = 1000;
+                tasks.execute(clock_.now);
+                CHECK(clock_.log == (std::vector<int>{7, 5, 4, 2, 1}));
+                CHECK(tasks.add(Task{9}, 100, clock_.now) != no_task);
+            }
+        }
+    }
+}
+
+SCENARIO("Overruns are counted")
+{
+    GIVEN("A task of 100 ms")
+    {
+        clock_ = Clock{};
+        Tasks tasks;
+        TaskHandle handle = tasks.add(Task{1}, 100, clock_.now);
+
+        WHEN("idle() is called late once, and on time otherwise")
+        {
+            run(tasks, 200, 10);
+            clock_.now += 250;  // Something blocked the main loop
+            tasks.execute(clock_.now);
+            run(tasks, 300, 10);
+
+            THEN("The overrun and the longest delay are reported")
+            {
+                TaskStats stats;
+                REQUIRE(tasks.stats(handle, stats));
+                CHECK(stats.period == 100);
+                CHECK(stats.runs == 6);
+                CHECK(stats.overruns == 1);
+                CHECK(stats.max_late == 150);
+            }
+
+            THEN("It is not executed several times to catch up")
+            {
+                CHECK(count(1) == 6);
+            }
+        }
+
+        WHEN("Its period is changed")
+        {
+            tasks.set_period(handle, 200);
+            run(tasks, 1000);
+            THEN("It takes effect after the next execution")
+            {
+                CHECK(count(1) == 5);
+                TaskStats stats;
+                REQUIRE(tasks.stats(handle, stats));
+                CHECK(stats.period == 200);
+                CHECK(stats.overruns == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("millis() wraps around")
+{
+    GIVEN("Tasks added just before the wrap")
+    {
+        clock_ = Clock{};
+        clock_.now = 0xFFFFFFFF - 150;
+        Tasks tasks;
+        tasks.add(Task{1}, 100, clock_.now);
+        tasks.add(Task{2}, 300, clock_.now);
+
+        WHEN("Time passes over the wrap")
+        {
+            run(tasks, 600);
+            THEN("The periods and the order are kept")
+            {
+                CHECK(count(1) == 6);
+                CHECK(count(2) == 2);
+                CHECK(clock_.log == (std::vector<int>{1, 1, 1, 2, 1, 1, 1, 2}));
+            }
+        }
+    }
+}
+
+SCENARIO("The heating check is more responsive with its own period")
+{
+    GIVEN("The status update (500 ms) and the heating check")
+    {
+        // The old single slot checked the heating at the status period
+        for(uint16_t period: {uint16_t{500}, uint16_t{200}})
+        {
+            clock_ = Clock{};
+            Tasks tasks;
+            tasks.add(Task{1}, 500, clock_.now);
+            tasks.add(Task{2, [](int) { clock_.log.push_back(-static_cast<int>(clock_.now)); }}, period, clock_.now);
+
+            // The hotend reaches its temperature at 1234 ms
+            const uint32_t reached = 1234;
+            run(tasks, 3000);
+            uint32_t detected = 0;
+            for(auto i: clock_.log)
+                if(i < 0 && static_cast<uint32_t>(-i) >= reached)
+                {
+                    detected = static_cast<uint32_t>(-i);
+                    break;
+                }
+
+            INFO("Heating check period " << period << " ms: detected after " << detected - reached << " ms");
+            CHECK(detected - reached < period);
+        }
+    }
+}
+
+SCENARIO("idle() costs one comparison when nothing is due")
+{
+    GIVEN("Eight tasks")
+    {
+        clock_ = Clock{};
+        Tasks tasks;
+        for(int i = 0; i < 8; ++i)
+            tasks.add(Task{i}, 500, clock_.now);
+
+        WHEN("idle() is called every ms")
+        {
+            unsigned executions = 0, calls = 0;
+            for(int i = 0; i < 5000; ++i)
+            {
+                ++calls;
+                executions += tasks.execute(++clock_.now);
+            }
+            THEN("Tasks are only executed at their deadlines")
+            {
+                INFO(calls << " calls, " << executions << " executions");
+                CHECK(executions == 80);
+            }
+        }
+    }
+}
@@ -0,0 +1,586 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "SerialLines.h"
+
+namespace
+{
+    const uint8_t MAX_CMD_SIZE = 96;
+
+    //! The RX side of MarlinSerial: what store_rxd_char, read, read_line and flush do with the ring buffer
+    template<uint16_t SIZE, typename POS>
+    struct Uart
+    {
+        uint8_t buffer[SIZE] = {};
+        volatile POS head = 0, tail = 0;
+        SerialLineEnds<8, POS> lines;
+        uint32_t tail_moves = 0;    //!< Times the main loop set the tail (atomic_set_rx_tail)
+
+        //! The RX interrupt. Return false if the buffer is full (the byte is dropped).
+        bool isr(uint8_t c)
+        {
+            const POS h = head, i = (POS)(h + 1) & (POS)(SIZE - 1);
+            if(i == tail)
+                return false;
+            buffer[h] = c;
+            lines.stored(c, i);
+            head = i;
+            return true;
+        }
+
+        int read()
+        {
+            const POS h = head;
+            POS t = tail;
+            if(h == t)
+                return -1;
+            const int v = buffer[t];
+            t = (POS)(t + 1) & (POS)(SIZE - 1);
+            tail = t;
+            ++tail_moves;
+            lines.reached(t);
+            return v;
+        }
+
+        bool read_line(char* line, uint8_t size, uint8_t& length)
+        {
+            const bool ends = !lines.empty();
+            const POS h = head, t = tail;
+            const bool full = ((POS)(h - t) & (POS)(SIZE - 1)) == SIZE - 1;
+            if(!ends && !full)
+                return false;
+            POS next = t;
+            const bool complete = copy_serial_line<SIZE>(buffer, next, h, line, size, length, full);
+            if(next == t)
+            {
+                if(ends)
+                    lines.pop();
+                return false;
+            }
+            tail = next;
+            ++tail_moves;
+            lines.reached(next);
+            return complete;
+        }
+
+        void flush()
+        {
+            lines.clear();
+            tail = head;
+        }
+    };
+
+    //! get_serial_commands character by character, as it was
+    template<typename UART>
+    struct CharReader
+    {
+        char buffer[MAX_CMD_SIZE];
+        int count = 0;
+        bool comment = false;
+
+        void get(UART& uart, std::vector<std::string>& out)
+        {
+            int c;
+            while((c = uart.read()) >= 0)
+            {
+                char serial_char = c;
+                if(serial_char == '\n' || serial_char == '\r')
+                {
+                    comment = false;
+                    if(!count)
+                        continue;
+                    buffer[count] = 0;
+                    count = 0;
+                    out.emplace_back(buffer);
+                }
+                else if(count >= MAX_CMD_SIZE - 1) {}
+                else if(serial_char == '\\')
+                {
+                    if((c = uart.read()) >= 0 && !comment)
+                        buffer[count++] = (char)c;
+                }
+                else
+                {
+                    if(serial_char == ';')
+                        comment = true;
+                    if(!comment)
+                        buffer[count++] = serial_char;
+                }
+            }
+        }
+    };
+
+    //! strip_serial_line of Marlin_main.cpp
+    uint8_t strip_serial_line(char* line)
+    {
+        char *dst = line;
+        for(const char *src = line; *src && *src != ';'; src++)
+        {
+            if(*src == '\\' && !*++src)
+                break;
+            *dst++ = *src;
+        }
+        *dst = '\0';
+        return static_cast<uint8_t>(dst - line);
+    }
+
+    //! get_serial_commands a line at a time
+    template<typename UART>
+    struct LineReader
+    {
+        char buffer[MAX_CMD_SIZE];
+        uint8_t count = 0;
+
+        void get(UART& uart, std::vector<std::string>& out)
+        {
+            while(uart.read_line(buffer, MAX_CMD_SIZE, count))
+            {
+                count = 0;
+                if(strip_serial_line(buffer))
+                    out.emplace_back(buffer);
+            }
+        }
+    };
+
+    //! What a host sends to print: numbered lines with their checksum, temperature requests, comments
+    std::string record_host_stream(int count, bool crlf = false)
+    {
+        std::string stream;
+        auto send = [&](const std::string& command, int n)
+        {
+            char line[128];
+            std::snprintf(line, sizeof(line), "N%d %s", n, command.c_str());
+            uint8_t checksum = 0;
+            for(const char* p = line; *p; ++p)
+                checksum ^= static_cast<uint8_t>(*p);
+            stream += line;
+            stream += "*" + std::to_string(checksum) + (crlf ? "\r\n" : "\n");
+        };
+
+        send("M110 N0", 0);
+        for(int i = 1; i <= count; ++i)
+        {
+            char command[96];
+            if(i % 50 == 0)
+                std::snprintf(command, sizeof(command), "M105");
+            else if(i % 97 == 0)
+                std::snprintf(command, sizeof(command), "M117 Layer %d\\; \\\\ done", i / 97);
+            else
+                std::snprintf(command, sizeof(command), "G1 X%.3f Y%.3f E%.5f", 10 + (i % 200) * 0.731, 20 + (i % 170) * 0.913, i * 0.0213);
+            send(command, i);
+            if(i % 31 == 0)
+                stream += "; layer change\n";
+            if(i % 43 == 0)
+                stream += "\n";
+        }
+        return stream;
+    }
+
+    //! The lines of a stream, as get_serial_commands gets them when the whole stream is there
+    std::vector<std::string> reference_lines(const std::string& stream)
+    {
+        Uart<4096, uint16_t> uart;
+        CharReader<Uart<4096, uint16_t>> reader;
+        std::vector<std::string> lines;
+        size_t i = 0;
+        while(i < stream.size())
+        {
+            while(i < stream.size() && uart.isr(static_cast<uint8_t>(stream[i])))
+                ++i;
+            reader.get(uart, lines);
+        }
+        return lines;
+    }
+
+    //! Send the stream in chunks of random sizes, the main loop reading between them
+    template<typename UART, typename READER>
+    std::vector<std::string> receive(const std::string& stream, unsigned seed, size_t max_chunk)
+    {
+        UART uart;
+        READER reader;
+        std::vector<std::string> lines;
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<size_t> chunk(1, max_chunk);
+        size_t i = 0;
+        while(i < stream.size())
+        {
+            // The host waits if the buffer is full, like with flow control
+            for(size_t n = chunk(random); n > 0 && i < stream.size() && uart.isr(static_cast<uint8_t>(stream[i])); --n)
+                ++i;
+            reader.get(uart, lines);
+        }
+        reader.get(uart, lines);
+        return lines;
+    }
+
+    struct Speed
+    {
+        size_t lines = 0;
+        double lines_per_second = 0;
+        double tail_moves_per_line = 0;
+    };
+
+    //! Get all the lines of a stream already received, repeatedly
+    template<typename READER>
+    Speed measure(const std::string& stream)
+    {
+        using Clock = std::chrono::steady_clock;
+        using SerialUart = Uart<1024, uint16_t>;
+        SerialUart uart;
+        READER reader;
+        std::vector<std::string> lines;
+        lines.reserve(stream.size() / 10);
+        Speed speed;
+        Clock::duration elapsed{};
+        for(int repeat = 0; repeat < 20; ++repeat)
+        {
+            size_t i = 0;
+            while(i < stream.size())
+            {
+                while(i < stream.size() && uart.isr(static_cast<uint8_t>(stream[i])))
+                    ++i;
+                lines.clear();
+                const auto start = Clock::now();
+                reader.get(uart, lines);
+                elapsed += Clock::now() - start;
+                speed.lines += lines.size();
+            }
+        }
+        speed.lines_per_second = speed.lines / std::chrono::duration<double>(elapsed).count();
+        speed.tail_moves_per_line = double(uart.tail_moves) / speed.lines;
+        return speed;
+    }
+}
+
+SCENARIO("The RX interrupt notes where the lines end", "[serial]")
+{
+    GIVEN("Line ends for a 128-byte buffer")
+    {
+        SerialLineEnds<4, uint8_t> ends;
+        REQUIRE(ends.empty());
+
+        WHEN("Lines end with LF, CR or CRLF")
+        {
+            const char* stream = "G28\nM105\rG1\r\n";
+            uint8_t i = 0;
+            for(const char* p = stream; *p; ++p)
+                ends.stored(static_cast<uint8_t>(*p), ++i);
+
+            THEN("Each end of line is noted, until the ring is full")
+            {
+                REQUIRE(ends.front() == 4);
+                ends.reached(4);
+                REQUIRE(ends.front() == 9);
+                ends.reached(9);
+                // The LF after CR moved the last end: the ring holds 3 of them
+                REQUIRE(ends.front() == 13);
+                ends.reached(13);
+                REQUIRE(ends.empty());
+            }
+        }
+
+        WHEN("An end of line is escaped")
+        {
+            const char* stream = "M117 A\\\nB\\\\\n";
+            uint8_t i = 0;
+            for(const char* p = stream; *p; ++p)
+                ends.stored(static_cast<uint8_t>(*p), ++i);
+
+            THEN("Only the last one ends a line")
+            {
+                REQUIRE(ends.front() == 12);
+                ends.reached(12);
+                REQUIRE(ends.empty());
+            }
+        }
+
+        WHEN("The tail is somewhere else")
+        {
+            ends.stored('\n', 10);
+            ends.reached(9);
+            ends.reached(11);
+
+            THEN("The end is kept")
+            {
+                REQUIRE(!ends.empty());
+                REQUIRE(ends.front() == 10);
+            }
+            THEN("pop and clear drop ends")
+            {
+                ends.stored('\n', 20);
+                ends.pop();
+                REQUIRE(ends.front() == 20);
+                ends.clear();
+                REQUIRE(ends.empty());
+            }
+        }
+    }
+}
+
+SCENARIO("Lines are copied from the ring buffer as a whole", "[serial]")
+{
+    GIVEN("A ring buffer of 16 bytes with a line across its end")
+    {
+        uint8_t ring[16];
+        const char* text = "G1 X1\nM1";
+        for(int i = 0; i < 8; ++i)
+            ring[(12 + i) % 16] = static_cast<uint8_t>(text[i]);
+        char line[8];
+
+        WHEN("The whole line is copied")
+        {
+            uint8_t tail = 12, length = 0;
+            const bool complete = copy_serial_line<16>(ring, tail, uint8_t(4), line, 8, length, false);
+
+            THEN("The line is there without its end of line, and the tail follows it")
+            {
+                REQUIRE(complete);
+                REQUIRE(std::string(line) == "G1 X1");
+                REQUIRE(length == 5);
+                REQUIRE(tail == 2);
+            }
+        }
+
+        WHEN("The end of the next line is not there yet")
+        {
+            uint8_t tail = 2, length = 0;
+            const bool complete = copy_serial_line<16>(ring, tail, uint8_t(4), line, 8, length, false);
+
+            THEN("Nothing is taken")
+            {
+                REQUIRE(!complete);
+                REQUIRE(tail == 2);
+                REQUIRE(length == 0);
+            }
+        }
+
+        WHEN("It is not there but the buffer is full")
+        {
+            uint8_t tail = 2, length = 0;
+            const bool complete = copy_serial_line<16>(ring, tail, uint8_t(4), line, 8, length, true);
+
+            THEN("The start of the line is taken")
+            {
+                REQUIRE(!complete);
+                REQUIRE(tail == 4);
+                REQUIRE(std::string(line) == "M1");
+                REQUIRE(length == 2);
+            }
+        }
+
+        WHEN("The line is longer than the command buffer")
+        {
+            uint8_t tail = 12, length = 0;
+            char small[4];
+            const bool complete = copy_serial_line<16>(ring, tail, uint8_t(4), small, 4, length, false);
+
+            THEN("The characters that don't fit are skipped")
+            {
+                REQUIRE(complete);
+                REQUIRE(std::string(small) == "G1 ");
+                REQUIRE(tail == 2);
+            }
+        }
+    }
+}
+
+SCENARIO("Recorded host streams give the same lines", "[serial]")
+{
+    for(auto crlf: {false, true})
+    {
+        GIVEN(std::string("A print streamed by a host") + (crlf ? " with CRLF" : ""))
+        {
+            const std::string stream = record_host_stream(2000, crlf);
+            const auto expected = reference_lines(stream);
+            REQUIRE(expected.size() == 2001);
+            REQUIRE(expected[97].compare(0, 25, "N97 M117 Layer 1; \\ done*") == 0);
+
+            WHEN("It arrives in pieces and the lines are read as a whole")
+            {
+                for(unsigned seed = 1; seed <= 5; ++seed)
+                {
+                    INFO("Seed " << seed);
+                    CHECK(receive<Uart<128, uint8_t>, LineReader<Uart<128, uint8_t>>>(stream, seed, 40) == expected);
+                    CHECK(receive<Uart<1024, uint16_t>, LineReader<Uart<1024, uint16_t>>>(stream, seed, 300) == expected);
+                    // Lines longer than the buffer: they are taken in pieces
+                    CHECK(receive<Uart<32, uint8_t>, LineReader<Uart<32, uint8_t>>>(stream, seed, 8) == expected);
+                }
+            }
+
+            WHEN("It is read character by character")
+            {
+                using SerialUart = Uart<128, uint8_t>;
+                SerialUart uart;
+                CharReader<SerialUart> reader;
+                std::vector<std::string> lines;
+                size_t i = 0;
+                while(i < stream.size())
+                {
+                    while(i < stream.size() && uart.isr(static_cast<uint8_t>(stream[i])))
+                        ++i;
+                    reader.get(uart, lines);
+                }
+
+                THEN("read() drops the line ends on its way")
+                {
+                    CHECK(lines.size() == expected.size());
+                    CHECK(uart.lines.empty());
+                }
+            }
+        }
+    }
+
+    GIVEN("A line longer than the command buffer and the RX buffer")
+    {
+        std::string stream = "M117 " + std::string(200, 'x') + "\nN1 M105*39\n";
+        const auto expected = reference_lines(stream);
+        REQUIRE(expected.size() == 2);
+        REQUIRE(expected[0].size() == MAX_CMD_SIZE - 1);
+
+        THEN("It is truncated the same way")
+        {
+            CHECK(receive<Uart<128, uint8_t>, LineReader<Uart<128, uint8_t>>>(stream, 7, 50) == expected);
+        }
+    }
+}
+
+SCENARIO("An escape arrives without the character it escapes", "[serial]")
+{
+    GIVEN("A line received in two pieces, split after an escape")
+    {
+        using SerialUart = Uart<128, uint8_t>;
+        const std::string first = "M117 A\\", second = ";B\n";
+
+        WHEN("It is read character by character")
+        {
+            SerialUart uart;
+            CharReader<SerialUart> reader;
+            std::vector<std::string> lines;
+            for(char c: first)
+                uart.isr(static_cast<uint8_t>(c));
+            reader.get(uart, lines);
+            for(char c: second)
+                uart.isr(static_cast<uint8_t>(c));
+            reader.get(uart, lines);
+
+            THEN("The escape is lost")
+            {
+                REQUIRE(lines == std::vector<std::string>{"M117 A"});
+            }
+        }
+
+        WHEN("It is read as a whole")
+        {
+            SerialUart uart;
+            LineReader<SerialUart> reader;
+            std::vector<std::string> lines;
+            for(char c: first)
+                uart.isr(static_cast<uint8_t>(c));
+            reader.get(uart, lines);
+            for(char c: second)
+                uart.isr(static_cast<uint8_t>(c));
+            reader.get(uart, lines);
+
+            THEN("The escaped character is kept")
+            {
+                REQUIRE(lines == std::vector<std::string>{"M117 A;B"});
+            }
+        }
+    }
+}
+
+SCENARIO("Lines arrive after a flush", "[serial]")
+{
+    GIVEN("A buffer with lines and the start of another one")
+    {
+        using SerialUart = Uart<128, uint8_t>;
+        SerialUart uart;
+        LineReader<SerialUart> reader;
+        std::vector<std::string> lines;
+        for(char c: std::string("N1 G28\nN2 G1 X1\nN3 G1"))
+            REQUIRE(uart.isr(static_cast<uint8_t>(c)));
+
+        WHEN("It is flushed after an end was noted, and lines come again")
+        {
+            uart.flush();
+            for(char c: std::string("N3 G1 Y1\n"))
+                REQUIRE(uart.isr(static_cast<uint8_t>(c)));
+            reader.get(uart, lines);
+
+            THEN("They are read")
+            {
+                REQUIRE(lines == std::vector<std::string>{"N3 G1 Y1"});
+            }
+        }
+
+        WHEN("The end of a line dropped by the flush remains")
+        {
+            // The RX interrupt noted it between the clear of the ends and the move of the tail
+            uart.lines.clear();
+            uart.isr('\n');
+            uart.tail = uart.head;
+            for(char c: std::string("N3 G1"))
+                REQUIRE(uart.isr(static_cast<uint8_t>(c)));
+            reader.get(uart, lines);
+            for(char c: std::string(" Y1\n"))
+                REQUIRE(uart.isr(static_cast<uint8_t>(c)));
+            reader.get(uart, lines);
+
+            THEN("It is dropped and the next lines are read")
+            {
+                REQUIRE(lines == std::vector<std::string>{"N3 G1 Y1"});
+                REQUIRE(uart.lines.empty());
+            }
+        }
+    }
+}
+
+SCENARIO("Lines are read with one move of the tail", "[serial]")
+{
+    GIVEN("A print streamed by a host")
+    {
+        const std::string stream = record_host_stream(5000);
+
+        WHEN("The lines are read character by character and as a whole")
+        {
+            const auto by_char = measure<CharReader<Uart<1024, uint16_t>>>(stream);
+            const auto by_line = measure<LineReader<Uart<1024, uint16_t>>>(stream);
+
+            THEN("The tail of the RX buffer is set once per line")
+            {
+                // On the host, the time is spent making strings as much as reading; on the
+                // printer, each read() is a call with volatile 16-bit indexes to read and set
+                INFO("Character by character: " << static_cast<long>(by_char.lines_per_second) << " lines/s, "
+                     << by_char.tail_moves_per_line << " tail moves per line");
+                INFO("As a whole: " << static_cast<long>(by_line.lines_per_second) << " lines/s, "
+                     << by_line.tail_moves_per_line << " tail moves per line");
+                REQUIRE(by_char.lines == by_line.lines);
+                CHECK(by_line.tail_moves_per_line < 1.1);
+                CHECK(by_char.tail_moves_per_line > 30);
+            }
+        }
+    }
+}
@@ -0,0 +1,208 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cmath>
+#include <random>
+#include "catch.hpp"
+#include "UBLFixedMesh.h"
+
+namespace
+{
+    const int NX = 10, NY = 10;
+    const float MIN_X = 1, MIN_Y = 1, DIST_X = 198.0f / (NX - 1), DIST_Y = 198.0f / (NY - 1);
+    const float TOLERANCE = 0.002f; // 2 microns
+
+    // The float implementation of unified_bed_leveling (ubl.h and ubl_motion.cpp)
+    struct FloatMesh
+    {
+        float z_values[NX][NY];
+
+        static float xpos(int i) { return MIN_X + i * DIST_X; }
+        static float ypos(int i) { return MIN_Y + i * DIST_Y; }
+
+        float on_x_line(float rx0, int x1_i, int yi) const
+        {
+            const float xratio = (rx0 - xpos(x1_i)) * (1.0 / DIST_X), z1 = z_values[x1_i][yi];
+            return z1 + xratio * (z_values[std::min(x1_i, NX - 2) + 1][yi] - z1);
+        }
+
+        float on_y_line(float ry0, int xi, int y1_i) const
+        {
+            const float yratio = (ry0 - ypos(y1_i)) * (1.0 / DIST_Y), z1 = z_values[xi][y1_i];
+            return z1 + yratio * (z_values[xi][std::min(y1_i, NY - 2) + 1] - z1);
+        }
+
+        // FINAL_MOVE of line_to_destination_cartesian
+        float in_cell(float x, float y, int xi, int yi) const
+        {
+            if(xi >= NX - 1 || yi >= NY - 1) return 0;
+            const float xratio = (x - xpos(xi)) * (1.0f / DIST_X);
+            const float z1 = z_values[xi][yi] + xratio * (z_values[xi + 1][yi] - z_values[xi][yi]),
+                        z2 = z_values[xi][yi + 1] + xratio * (z_values[xi + 1][yi + 1] - z_values[xi][yi + 1]);
+            const float yratio = (y - ypos(yi)) * (1.0f / DIST_Y);
+            return z1 + (z2 - z1) * yratio;
+        }
+    };
+
+    struct Meshes
+    {
+        FloatMesh reference;
+        UBLFixedMesh<NX, NY> fixed;
+
+        explicit Meshes(unsigned seed, float amplitude = 1.5f)
+        {
+            std::mt19937 random{seed};
+            std::uniform_real_distribution<float> z{-amplitude, amplitude};
+            for(auto& column: reference.z_values)
+                for(auto& v: column)
+                    v = z(random);
+            load();
+        }
+
+        void load()
+        {
+            fixed.load(reference.z_values, MIN_X, MIN_Y, DIST_X, DIST_Y);
+        }
+    };
+
+    bool same(float a, float b)
+    {
+        if(std::isnan(a) || std::isnan(b)) return std::isnan(a) && std::isnan(b);
+        return std::fabs(a - b) <= TOLERANCE;
+    }
+
+    // Position inside a segment, a little beyond its ends as when the float code extrapolates
+    float along(std::mt19937& random, float start, float dist)
+    {
+        std::uniform_real_distribution<float> f{-0.05f, 1.05f};
+        return start + f(random) * dist;
+    }
+}
+
+SCENARIO("Fixed-point mesh matches the float mesh on mesh lines", "[ubl_fixed_mesh]")
+{
+    GIVEN("Random 10x10 meshes")
+    {
+        std::mt19937 random{42};
+        for(unsigned seed = 1; seed <= 20; ++seed)
+        {
+            Meshes meshes{seed};
+            for(int xi = 0; xi < NX; ++xi)
+                for(int yi = 0; yi < NY; ++yi)
+                    for(int n = 0; n < 20; ++n)
+                    {
+                        const float rx = along(random, FloatMesh::xpos(xi), DIST_X),
+                                    ry = along(random, FloatMesh::ypos(yi), DIST_Y);
+                        INFO("seed " << seed << " cell " << xi << "," << yi << " at " << rx << "," << ry);
+                        CHECK(same(meshes.fixed.on_x_line(rx, xi, yi), meshes.reference.on_x_line(rx, xi, yi)));
+                        CHECK(same(meshes.fixed.on_y_line(ry, xi, yi), meshes.reference.on_y_line(ry, xi, yi)));
+                    }
+        }
+    }
+}
+
+SCENARIO("Fixed-point mesh matches the float mesh inside cells", "[ubl_fixed_mesh]")
+{
+    GIVEN("Random 10x10 meshes")
+    {
+        std::mt19937 random{7};
+        for(unsigned seed = 1; seed <= 20; ++seed)
+        {
+            Meshes meshes{seed};
+            for(int xi = 0; xi < NX; ++xi)
+                for(int yi = 0; yi < NY; ++yi)
+                    for(int n = 0; n < 20; ++n)
+                    {
+                        const float x = along(random, FloatMesh::xpos(xi), DIST_X),
+                                    y = along(random, FloatMesh::ypos(yi), DIST_Y);
+                        INFO("seed " << seed << " cell " << xi << "," << yi << " at " << x << "," << y);
+                        CHECK(same(meshes.fixed.in_cell(x, y, xi, yi), meshes.reference.in_cell(x, y, xi, yi)));
+                    }
+        }
+    }
+
+    GIVEN("A mesh with the corners of a cell")
+    {
+        Meshes meshes{3};
+        WHEN("Evaluated exactly on the corners")
+        {
+            THEN("The probed values are returned")
+            {
+                for(int xi = 0; xi < NX - 1; ++xi)
+                    for(int yi = 0; yi < NY - 1; ++yi)
+                    {
+                        const float x = FloatMesh::xpos(xi), y = FloatMesh::ypos(yi);
+                        CHECK(same(meshes.fixed.in_cell(x, y, xi, yi), meshes.reference.z_values[xi][yi]));
+                        CHECK(same(meshes.fixed.in_cell(x + DIST_X, y, xi, yi), meshes.reference.z_values[xi + 1][yi]));
+                        CHECK(same(meshes.fixed.in_cell(x, y + DIST_Y, xi, yi), meshes.reference.z_values[xi][yi + 1]));
+                        CHECK(same(meshes.fixed.in_cell(x + DIST_X, y + DIST_Y, xi, yi), meshes.reference.z_values[xi + 1][yi + 1]));
+                    }
+            }
+        }
+    }
+}
+
+SCENARIO("Undefined mesh points", "[ubl_fixed_mesh]")
+{
+    GIVEN("A mesh with an undefined point")
+    {
+        Meshes meshes{5};
+        meshes.reference.z_values[4][6] = NAN;
+        meshes.load();
+
+        WHEN("Lines and cells are evaluated")
+        {
+            THEN("Those using the point give NAN, like the float mesh, the others are unchanged")
+            {
+                std::mt19937 random{11};
+                for(int xi = 0; xi < NX; ++xi)
+                    for(int yi = 0; yi < NY; ++yi)
+                    {
+                        const float x = along(random, FloatMesh::xpos(xi), DIST_X),
+                                    y = along(random, FloatMesh::ypos(yi), DIST_Y);
+                        INFO("cell " << xi << "," << yi);
+                        CHECK(same(meshes.fixed.on_x_line(x, xi, yi), meshes.reference.on_x_line(x, xi, yi)));
+                        CHECK(same(meshes.fixed.on_y_line(y, xi, yi), meshes.reference.on_y_line(y, xi, yi)));
+                        CHECK(same(meshes.fixed.in_cell(x, y, xi, yi), meshes.reference.in_cell(x, y, xi, yi)));
+                    }
+                CHECK(std::isnan(meshes.fixed.in_cell(FloatMesh::xpos(3) + 1, FloatMesh::ypos(5) + 1, 3, 5)));
+                CHECK(meshes.fixed.z_microns(4, 6) == UBL_FIXED_INVALID);
+            }
+        }
+    }
+}
+
+SCENARIO("Out of range mesh values", "[ubl_fixed_mesh]")
+{
+    GIVEN("A mesh with a point far beyond the microns range")
+    {
+        Meshes meshes{9};
+        meshes.reference.z_values[2][2] = 40.0f;
+        meshes.reference.z_values[3][3] = -40.0f;
+        meshes.load();
+
+        THEN("The values are clamped")
+        {
+            CHECK(meshes.fixed.z_microns(2, 2) == UBL_FIXED_LIMIT);
+            CHECK(meshes.fixed.z_microns(3, 3) == -UBL_FIXED_LIMIT);
+            CHECK(meshes.fixed.z_microns(2, 3) != UBL_FIXED_INVALID);
+        }
+    }
+}
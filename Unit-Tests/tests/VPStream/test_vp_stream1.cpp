@@ -0,0 +1,259 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cmath>
+#include <vector>
+#include <map>
+#include "catch.hpp"
+#include "VPStream.h"
+
+namespace
+{
+    //! RAM of the panel: the words written, by VP, and the frames received
+    struct Panel
+    {
+        static std::map<uint16_t, uint16_t> ram;
+        static std::vector<uint8_t> frame_sizes;
+        static bool fail;
+
+        static bool write(uint16_t vp, const uint8_t* data, uint8_t size)
+        {
+            frame_sizes.push_back(size);
+            for(uint8_t i = 0; i < size; i += 2)
+                ram[static_cast<uint16_t>(vp + i / 2)] = static_cast<uint16_t>(data[i] << 8 | data[i + 1]);
+            return !fail;
+        }
+
+        static void reset() { ram.clear(); frame_sizes.clear(); fail = false; }
+    };
+
+    std::map<uint16_t, uint16_t> Panel::ram;
+    std::vector<uint8_t> Panel::frame_sizes;
+    bool Panel::fail = false;
+
+    using Stream = adv::VPStream<Panel, 8>; // 4 words per frame
+    using LcdStream = adv::VPStream<Panel>; // As in the firmware
+
+    //! Frame::operator<<(Uint16): the words that do not fit in the 255 bytes are dropped
+    unsigned words_in_one_frame(unsigned words)
+    {
+        const unsigned FRAME_BUFFER_SIZE = 255, DATA = 6; // Header, length, command and VP
+        unsigned position = DATA, written = 0;
+        for(unsigned i = 0; i < words; ++i)
+            if(position < FRAME_BUFFER_SIZE - 1)
+            {
+                position += 2;
+                ++written;
+            }
+        return written;
+    }
+}
+
+SCENARIO("Words are written in chunks to contiguous VPs")
+{
+    GIVEN("A stream of 4 words per frame")
+    {
+        Panel::reset();
+
+        WHEN("Exactly one chunk is written")
+        {
+            {
+                Stream stream{0x300};
+                for(uint16_t i = 0; i < 4; ++i)
+                    stream.write(i);
+                THEN("It is written as soon as it is full")
+                {
+                    CHECK(Panel::frame_sizes.size() == 1);
+                    CHECK(stream.vp() == 0x304);
+                }
+            }
+            THEN("Nothing more is written at the end")
+            {
+                CHECK(Panel::frame_sizes == (std::vector<uint8_t>{8}));
+            }
+        }
+
+        WHEN("One word more than a chunk is written")
+        {
+            {
+                Stream stream{0x300};
+                for(uint16_t i = 0; i < 5; ++i)
+                    stream.write(static_cast<uint16_t>(0x1000 + i));
+                CHECK(Panel::frame_sizes.size() == 1);
+            }
+            THEN("The last word is in a frame of its own, at the next VP")
+            {
+                CHECK(Panel::frame_sizes == (std::vector<uint8_t>{8, 2}));
+                CHECK(Panel::ram.size() == 5);
+                CHECK(Panel::ram[0x304] == 0x1004);
+            }
+        }
+
+        WHEN("The stream continues at another VP")
+        {
+            {
+                Stream stream{0x300};
+                for(uint16_t i = 0; i < 2; ++i)
+                    stream.write(static_cast<uint16_t>(0x1000 + i));
+                stream.seek(0x400);
+                for(uint16_t i = 0; i < 5; ++i)
+                    stream.write(static_cast<uint16_t>(0x2000 + i));
+            }
+            THEN("The words before are written at their VP, the others from the new one")
+            {
+                CHECK(Panel::frame_sizes == (std::vector<uint8_t>{4, 8, 2}));
+                CHECK(Panel::ram[0x301] == 0x1001);
+                CHECK(Panel::ram[0x400] == 0x2000);
+                CHECK(Panel::ram[0x404] == 0x2004);
+                CHECK(Panel::ram.size() == 7);
+            }
+        }
+
+        WHEN("Nothing is written")
+        {
+            {
+                Stream stream{0x300};
+                CHECK(stream.flush());
+            }
+            THEN("No frame is sent")
+            {
+                CHECK(Panel::frame_sizes.empty());
+            }
+        }
+
+        WHEN("A write fails")
+        {
+            Stream stream{0x300};
+            Panel::fail = true;
+            for(uint16_t i = 0; i < 4; ++i)
+                stream.write(i);
+            Panel::fail = false;
+            stream.write(4);
+            THEN("The error is kept")
+            {
+                CHECK_FALSE(stream.flush());
+            }
+        }
+    }
+}
+
+SCENARIO("A large grid is not truncated")
+{
+    GIVEN("A 15x15 grid and its statistics, as LevelingGrid")
+    {
+        Panel::reset();
+        const unsigned words = 15 * 15 + 5;
+
+        WHEN("It is streamed")
+        {
+            uint8_t frames = 0;
+            {
+                LcdStream stream{0x300};
+                for(unsigned i = 0; i < words; ++i)
+                    stream.write(static_cast<uint16_t>(i * 7));
+                stream.flush();
+                frames = stream.frames();
+            }
+
+            THEN("All the words are written")
+            {
+                INFO(words << " words in " << static_cast<int>(frames) << " frames, a single frame keeps "
+                     << words_in_one_frame(words));
+                CHECK(words_in_one_frame(words) < words);
+                REQUIRE(Panel::ram.size() == words);
+                for(unsigned i = 0; i < words; ++i)
+                    CHECK(Panel::ram[static_cast<uint16_t>(0x300 + i)] == i * 7);
+                CHECK(frames == 4);
+                for(auto size: Panel::frame_sizes)
+                    CHECK(size <= 252);
+            }
+        }
+    }
+
+    GIVEN("The 3x3 grid of the printer")
+    {
+        Panel::reset();
+        THEN("It is still sent in one frame")
+        {
+            LcdStream stream{0x300};
+            for(unsigned i = 0; i < 3 * 3 + 5; ++i)
+                stream.write(static_cast<uint16_t>(i));
+            stream.flush();
+            CHECK(stream.frames() == 1);
+            CHECK(words_in_one_frame(3 * 3 + 5) == 3 * 3 + 5);
+        }
+    }
+}
+
+SCENARIO("Heatmap of a mesh")
+{
+    GIVEN("The bands of a mesh")
+    {
+        MeshBands<8> bands;
+        bands.reset();
+
+        WHEN("The points go from -0.2 to 0.2 mm")
+        {
+            const float z[] = {-0.2f, -0.1f, 0.0f, 0.05f, 0.1f, 0.2f, NAN};
+            for(auto v: z)
+                bands.add(v);
+            bands.finish();
+
+            THEN("The lowest is in the first band, the highest in the last")
+            {
+                CHECK(bands.low() == Approx(-0.2f));
+                CHECK(bands.high() == Approx(0.2f));
+                CHECK(bands.band(-0.2f) == 0);
+                CHECK(bands.band(-0.1f) == 2);
+                CHECK(bands.band(0.0f) == 4);
+                CHECK(bands.band(0.05f) == 5);
+                CHECK(bands.band(0.2f) == 7);
+            }
+
+            THEN("Points not probed have their own band")
+            {
+                CHECK(bands.band(NAN) == 8);
+                CHECK(static_cast<int>(MeshBands<8>::NOT_PROBED) == 8);
+            }
+        }
+
+        WHEN("The mesh is flat")
+        {
+            bands.add(0.1f);
+            bands.add(0.1f);
+            bands.finish();
+            THEN("All the points are in the middle band")
+            {
+                CHECK(bands.band(0.1f) == 4);
+            }
+        }
+
+        WHEN("No point is probed")
+        {
+            bands.add(NAN);
+            bands.finish();
+            THEN("There is no height")
+            {
+                CHECK(std::isnan(bands.low()));
+                CHECK(bands.band(NAN) == 8);
+            }
+        }
+    }
+}
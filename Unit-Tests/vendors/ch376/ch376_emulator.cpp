@@ -0,0 +1,760 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include "ch376_emulator.h"
+
+CH376Emulator ch376;
+
+namespace
+{
+    const uint8_t IC_VERSION = 0x43;
+    const uint8_t ATTR_LONG = 0x0F;
+    const uint32_t NO_SECTOR = 0xFFFFFFFF;
+
+    //! Number of parameters of a command, -1 for a name ending with 0
+    int parameters(uint8_t cmd)
+    {
+        switch(cmd)
+        {
+            case CMD11_CHECK_EXIST:
+            case CMD11_SET_USB_MODE:
+            case CMD11_READ_VAR8:
+            case CMD14_READ_VAR32:
+            case CMD1H_FILE_CLOSE:
+            case CMD1H_DIR_INFO_READ:
+            case CMD1H_SEC_READ:
+            case CMD1H_SEC_WRITE:       return 1;
+            case CMD20_WRITE_VAR8:
+            case CMD2H_BYTE_READ:
+            case CMD2H_BYTE_WRITE:      return 2;
+            case CMD4H_BYTE_LOCATE:
+            case CMD4H_SEC_LOCATE:      return 4;
+            case CMD50_WRITE_VAR32:
+            case CMD5H_DISK_READ:
+            case CMD5H_DISK_WRITE:      return 5;
+            case CMD10_SET_FILE_NAME:   return -1;
+            default:                    return 0;
+        }
+    }
+
+    void put32(std::vector<uint8_t>& v, uint32_t value)
+    {
+        for(int i = 0; i < 4; ++i)
+            v.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    //! Name of a directory entry as the firmware writes it, such as "PART.GCO"
+    std::string display_name(const uint8_t* entry)
+    {
+        std::string name(reinterpret_cast<const char*>(entry), 8), ext(reinterpret_cast<const char*>(entry + 8), 3);
+        name.erase(name.find_last_not_of(' ') + 1);
+        ext.erase(ext.find_last_not_of(' ') + 1);
+        return ext.empty() ? name : name + "." + ext;
+    }
+}
+
+CH376Timing::CH376Timing()
+{
+    std::fill(std::begin(command_us), std::end(command_us), 20);
+}
+
+void CH376Emulator::reset()
+{
+    std::memset(vars_, 0, sizeof(vars_));
+    vars_[VAR_DISK_STATUS] = DEF_DISK_UNKNOWN;
+    pending_ = false;
+    status_ = 0;
+    params_.clear();
+    out_.clear();
+    buffer_.clear();
+    name_.clear();
+    operation_ = Operation::None;
+    open_ = directory_ = modified_ = position_valid_ = false;
+    requested_ = 0;
+    write_error_ = dirty_ = false;
+    data_lba_ = fat_lba_ = NO_SECTOR;
+}
+
+uint32_t CH376Emulator::var32(uint8_t var) const
+{
+    return vars_[var] | vars_[var + 1] << 8 | vars_[var + 2] << 16 | static_cast<uint32_t>(vars_[var + 3]) << 24;
+}
+
+void CH376Emulator::set_var32(uint8_t var, uint32_t value)
+{
+    for(int i = 0; i < 4; ++i)
+        vars_[var + i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint32_t CH376Emulator::param32(size_t index) const
+{
+    return params_[index] | params_[index + 1] << 8 | params_[index + 2] << 16 |
+           static_cast<uint32_t>(params_[index + 3]) << 24;
+}
+
+void CH376Emulator::command(uint8_t cmd)
+{
+    now_ns_ += timing_.byte_ns;
+    ++counters_.commands;
+    ++counters_.command[cmd];
+    cmd_ = cmd;
+    params_.clear();
+    out_.clear();
+    out_position_ = 0;
+    if(cmd == CMD10_SET_FILE_NAME)
+        name_.clear();
+    if(parameters(cmd) == 0)
+        execute();
+}
+
+void CH376Emulator::write(uint8_t data)
+{
+    now_ns_ += timing_.byte_ns;
+    ++counters_.data_written;
+    if(cmd_ == CMD10_SET_FILE_NAME)
+    {
+        if(data)
+            name_ += static_cast<char>(std::toupper(data));
+        return;
+    }
+    if(cmd_ == CMD01_WR_REQ_DATA)
+    {
+        if(requested_)
+        {
+            --requested_;
+            --remaining_;
+            if(!write_error_ && !put_byte(data))
+                write_error_ = true;
+        }
+        return;
+    }
+    params_.push_back(data);
+    if(static_cast<int>(params_.size()) == parameters(cmd_))
+        execute();
+}
+
+uint8_t CH376Emulator::read()
+{
+    now_ns_ += timing_.byte_ns;
+    ++counters_.data_read;
+    return out_position_ < out_.size() ? out_[out_position_++] : 0xFF;
+}
+
+bool CH376Emulator::interrupt()
+{
+    ++counters_.polls;
+    if(pending_ && now_ns_ >= interrupt_ns_)
+        return true;
+    now_ns_ += timing_.poll_ns;
+    return false;
+}
+
+void CH376Emulator::raise(uint8_t status)
+{
+    ++counters_.interrupts;
+    status_ = status;
+    pending_ = true;
+    interrupt_ns_ = now_ns_ + timing_.command_us[cmd_] * 1000ULL + work_ns_;
+    work_ns_ = 0;
+}
+
+const uint8_t* CH376Emulator::read_sector(uint32_t lba, bool fat)
+{
+    uint32_t& cached = fat ? fat_lba_ : data_lba_;
+    if(lba != cached)
+    {
+        if(!fat)
+            flush_sector();
+        cached = lba;
+        ++counters_.sectors;
+        if(fat)
+            ++counters_.fat_sectors;
+        work_ns_ += timing_.sector_us * 1000ULL;
+    }
+    return disk_.sector(lba);
+}
+
+uint8_t* CH376Emulator::write_sector(uint32_t lba)
+{
+    read_sector(lba);
+    dirty_ = true;
+    return disk_.sector(lba);
+}
+
+void CH376Emulator::flush_sector()
+{
+    if(!dirty_)
+        return;
+    dirty_ = false;
+    ++counters_.sectors_written;
+    work_ns_ += timing_.sector_us * 1000ULL;
+}
+
+uint32_t CH376Emulator::next_cluster(uint32_t cluster)
+{
+    read_sector(disk_.fat_lba(cluster), true);
+    return disk_.next(cluster);
+}
+
+uint32_t CH376Emulator::append_cluster(uint32_t last)
+{
+    const uint32_t cluster = disk_.append_cluster(last);
+    if(!cluster)
+        return 0;
+    // The FAT sector is written at once
+    read_sector(disk_.fat_lba(cluster), true);
+    ++counters_.sectors_written;
+    work_ns_ += timing_.sector_us * 1000ULL;
+    return cluster;
+}
+
+void CH376Emulator::execute()
+{
+    switch(cmd_)
+    {
+        case CMD01_GET_IC_VER:      out_.push_back(IC_VERSION); break;
+        case CMD11_CHECK_EXIST:     out_.push_back(static_cast<uint8_t>(~params_[0])); break;
+        case CMD11_SET_USB_MODE:    out_.push_back(CMD_RET_SUCCESS); break;
+        case CMD01_GET_STATUS:      pending_ = false; out_.push_back(status_); break;
+        case CMD11_READ_VAR8:       out_.push_back(vars_[params_[0]]); break;
+        case CMD14_READ_VAR32:      put32(out_, var32(params_[0])); break;
+        case CMD20_WRITE_VAR8:      vars_[params_[0]] = params_[1]; break;
+
+        case CMD50_WRITE_VAR32:
+            set_var32(params_[0], param32(1));
+            // The firmware moved the file pointer itself (such as USBFile::rebaseChip)
+            if(params_[0] == VAR_START_CLUSTER || params_[0] == VAR_CURRENT_CLUST || params_[0] == VAR_CURRENT_OFFSET)
+                position_valid_ = false;
+            break;
+
+        case CMD01_RD_USB_DATA0:
+            out_.push_back(static_cast<uint8_t>(buffer_.size()));
+            out_.insert(out_.end(), buffer_.begin(), buffer_.end());
+            break;
+
+        case CMD0H_DISK_CONNECT:    raise(connected_ ? USB_INT_SUCCESS : ERR_DISK_DISCON); break;
+        case CMD0H_DISK_MOUNT:      mount(); break;
+        case CMD0H_DISK_R_SENSE:    raise(USB_INT_SUCCESS); break;
+
+        case CMD0H_DISK_CAPACITY:
+            buffer_.clear();
+            put32(buffer_, disk_.disk_sectors());
+            raise(USB_INT_SUCCESS);
+            break;
+
+        case CMD0H_DISK_QUERY:
+            buffer_.clear();
+            put32(buffer_, disk_.clusters() * disk_.sectors_per_cluster());
+            put32(buffer_, disk_.free_clusters() * disk_.sectors_per_cluster());
+            buffer_.push_back(disk_.type() == FatImage::Type::FAT32 ? 3 : 2);
+            raise(USB_INT_SUCCESS);
+            break;
+
+        case CMD0H_FILE_OPEN:       open(); break;
+        case CMD0H_FILE_ENUM_GO:    enumerate(); break;
+
+        case CMD0H_FILE_CREATE:     create(); break;
+        case CMD1H_FILE_CLOSE:      close(params_[0] != 0); break;
+
+        case CMD1H_DIR_INFO_READ:   dir_info(params_[0]); break;
+
+        case CMD4H_BYTE_LOCATE:
+        case CMD4H_SEC_LOCATE:
+        {
+            const uint32_t offset = param32(0);
+            const uint32_t lba = locate(cmd_ == CMD4H_SEC_LOCATE ? offset * FatImage::SECTOR : offset);
+            buffer_.clear();
+            put32(buffer_, lba);
+            raise(USB_INT_SUCCESS);
+            break;
+        }
+
+        case CMD2H_BYTE_READ:
+            operation_ = Operation::ByteRead;
+            if(!position_valid_)
+                seek(var32(VAR_CURRENT_OFFSET));
+            remaining_ = std::min<uint32_t>(params_[0] | params_[1] << 8, limit() - var32(VAR_CURRENT_OFFSET));
+            byte_read();
+            break;
+
+        case CMD0H_BYTE_RD_GO:      byte_read(); break;
+
+        case CMD2H_BYTE_WRITE:
+            if(!open_ || directory_)
+                return raise(ERR_FILE_CLOSE);
+            operation_ = Operation::ByteWrite;
+            if(!position_valid_)
+                seek(var32(VAR_CURRENT_OFFSET));
+            remaining_ = params_[0] | params_[1] << 8;
+            write_error_ = false;
+            byte_write();
+            break;
+
+        case CMD01_WR_REQ_DATA:
+            requested_ = operation_ == Operation::ByteWrite ?
+                         static_cast<uint8_t>(std::min<uint32_t>(remaining_, CH376_DAT_BLOCK_LEN)) : 0;
+            out_.push_back(requested_);
+            break;
+
+        case CMD0H_BYTE_WR_GO:      byte_write(); break;
+        case CMD1H_SEC_READ:        sector_read(params_[0]); break;
+
+        case CMD5H_DISK_READ:
+            operation_ = Operation::DiskRead;
+            disk_lba_ = param32(0);
+            remaining_ = params_[4] * (FatImage::SECTOR / CH376_DAT_BLOCK_LEN);
+            disk_read();
+            break;
+
+        case CMD0H_DISK_RD_GO:      disk_read(); break;
+
+        default:
+            ++counters_.unsupported;
+            raise(USB_INT_DISK_ERR);
+            break;
+    }
+}
+
+void CH376Emulator::mount()
+{
+    if(!connected_)
+        return raise(ERR_DISK_DISCON);
+    if(!disk_.mount())
+        return raise(ERR_TYPE_ERROR);
+
+    vars_[VAR_DISK_STATUS] = DEF_DISK_READY;
+    vars_[VAR_SEC_PER_CLUS] = disk_.sectors_per_cluster();
+    set_var32(VAR_DSK_TOTAL_CLUS, disk_.clusters());
+    set_var32(VAR_DSK_START_LBA, disk_.start_lba());
+    set_var32(VAR_DSK_DAT_START, disk_.data_lba());
+    data_lba_ = fat_lba_ = NO_SECTOR;
+
+    // INQUIRY data of the disk
+    const char inquiry[] = "\x00\x80\x02\x02\x1F\x00\x00\x00" "3DLABS  " "CH376 EMULATOR  " "1.00";
+    buffer_.assign(inquiry, inquiry + sizeof(inquiry) - 1);
+    raise(USB_INT_SUCCESS);
+}
+
+// A name starting with a separator is in the root, otherwise in the directory of VAR_START_CLUSTER
+uint32_t CH376Emulator::directory(std::string& name) const
+{
+    uint32_t cluster = var32(VAR_START_CLUSTER);
+    if(!name.empty() && (name[0] == DEF_SEPAR_CHAR1 || name[0] == DEF_SEPAR_CHAR2))
+    {
+        name.erase(0, 1);
+        cluster = 0;
+    }
+    return cluster == disk_.root_cluster() ? 0 : cluster;
+}
+
+void CH376Emulator::open()
+{
+    if(vars_[VAR_DISK_STATUS] < DEF_DISK_READY)
+        return raise(ERR_DISK_DISCON);
+
+    std::string name = name_;
+    const uint32_t directory = this->directory(name);
+    modified_ = false;
+    operation_ = Operation::None;
+    open_ = false;
+    directory_sectors_ = disk_.directory_sectors(directory);
+    entry_ = 0;
+
+    if(name.empty())
+    {
+        // The root directory itself
+        open_ = directory_ = true;
+        position_valid_ = false;
+        set_var32(VAR_START_CLUSTER, disk_.root_cluster());
+        set_var32(VAR_CURRENT_CLUST, disk_.root_cluster());
+        set_var32(VAR_FILE_SIZE, 0);
+        set_var32(VAR_CURRENT_OFFSET, 0);
+        vars_[VAR_DISK_STATUS] = DEF_DISK_OPEN_ROOT;
+        return raise(ERR_OPEN_DIR);
+    }
+
+    const auto wildcard = name.find(DEF_WILDCARD_CHAR);
+    if(wildcard != std::string::npos)
+    {
+        operation_ = Operation::Enumerate;
+        pattern_ = name.substr(0, wildcard);
+        return enumerate();
+    }
+
+    const std::string short_name = fat_short_name(name);
+    for(size_t i = 0; i < directory_sectors_.size() * 16; ++i)
+    {
+        const uint32_t lba = directory_sectors_[i / 16];
+        const uint8_t* e = read_sector(lba) + (i % 16) * FatImage::ENTRY;
+        if(e[0] == 0)
+            break;
+        if(e[0] == 0xE5 || (e[11] & ATTR_LONG) == ATTR_LONG || (e[11] & ATTR_VOLUME_ID))
+            continue;
+        if(std::memcmp(e, short_name.data(), 11) != 0)
+            continue;
+
+        const uint32_t cluster = (e[20] | e[21] << 8) << 16 | (e[26] | e[27] << 8);
+        open_ = true;
+        directory_ = (e[11] & ATTR_DIRECTORY) != 0;
+        position_valid_ = false;
+        set_var32(VAR_FAT_DIR_LBA, lba);
+        vars_[VAR_FILE_DIR_INDEX] = static_cast<uint8_t>(i % 16);
+        set_var32(VAR_START_CLUSTER, cluster);
+        set_var32(VAR_CURRENT_CLUST, cluster);
+        set_var32(VAR_CURRENT_OFFSET, 0);
+        set_var32(VAR_FILE_SIZE, e[28] | e[29] << 8 | e[30] << 16 | static_cast<uint32_t>(e[31]) << 24);
+        if(directory_)
+            directory_sectors_ = disk_.directory_sectors(cluster);
+        vars_[VAR_DISK_STATUS] = directory_ ? DEF_DISK_OPEN_DIR : DEF_DISK_OPEN_FILE;
+        return raise(directory_ ? ERR_OPEN_DIR : USB_INT_SUCCESS);
+    }
+    raise(ERR_MISS_FILE);
+}
+
+void CH376Emulator::create()
+{
+    if(vars_[VAR_DISK_STATUS] < DEF_DISK_READY)
+        return raise(ERR_DISK_DISCON);
+
+    std::string name = name_;
+    const uint32_t directory = this->directory(name);
+    operation_ = Operation::None;
+    open_ = false;
+    if(name.empty() || name.find(DEF_WILDCARD_CHAR) != std::string::npos)
+        return raise(ERR_MISS_FILE);
+
+    // Looking for the name (or a free entry) reads the directory, the entry is then written
+    for(uint32_t lba: disk_.directory_sectors(directory))
+        read_sector(lba);
+    uint32_t lba;
+    uint8_t index;
+    if(!disk_.create(directory, name, lba, index))
+        return raise(ERR_FDT_OVER);
+    write_sector(lba);
+    flush_sector();
+
+    open_ = modified_ = true;
+    directory_ = position_valid_ = false;
+    set_var32(VAR_FAT_DIR_LBA, lba);
+    vars_[VAR_FILE_DIR_INDEX] = index;
+    set_var32(VAR_START_CLUSTER, 0);
+    set_var32(VAR_CURRENT_CLUST, 0);
+    set_var32(VAR_CURRENT_OFFSET, 0);
+    set_var32(VAR_FILE_SIZE, 0);
+    vars_[VAR_DISK_STATUS] = DEF_DISK_OPEN_FILE;
+    raise(USB_INT_SUCCESS);
+}
+
+void CH376Emulator::close(bool update)
+{
+    // The directory entry of a written file gets its first cluster and length
+    if(open_ && modified_ && update)
+    {
+        uint8_t* e = write_sector(var32(VAR_FAT_DIR_LBA)) + vars_[VAR_FILE_DIR_INDEX] * FatImage::ENTRY;
+        const uint32_t cluster = var32(VAR_START_CLUSTER), size = var32(VAR_FILE_SIZE);
+        e[20] = static_cast<uint8_t>(cluster >> 16);
+        e[21] = static_cast<uint8_t>(cluster >> 24);
+        e[26] = static_cast<uint8_t>(cluster);
+        e[27] = static_cast<uint8_t>(cluster >> 8);
+        for(int i = 0; i < 4; ++i)
+            e[28 + i] = static_cast<uint8_t>(size >> (8 * i));
+    }
+    flush_sector();
+    open_ = modified_ = false;
+    operation_ = Operation::None;
+    vars_[VAR_DISK_STATUS] = DEF_DISK_READY;
+    raise(USB_INT_SUCCESS);
+}
+
+void CH376Emulator::enumerate()
+{
+    if(operation_ != Operation::Enumerate)
+        return raise(ERR_MISS_FILE);
+
+    for(; entry_ < directory_sectors_.size() * 16; ++entry_)
+    {
+        const uint32_t lba = directory_sectors_[entry_ / 16];
+        const uint8_t* e = read_sector(lba) + (entry_ % 16) * FatImage::ENTRY;
+        if(e[0] == 0)
+            break;
+        if(e[0] == 0xE5 || (e[11] & ATTR_LONG) == ATTR_LONG)
+            continue;
+        if(display_name(e).compare(0, pattern_.size(), pattern_) != 0)
+            continue;
+
+        set_var32(VAR_FAT_DIR_LBA, lba);
+        vars_[VAR_FILE_DIR_INDEX] = static_cast<uint8_t>(entry_ % 16);
+        buffer_.assign(e, e + FatImage::ENTRY);
+        ++entry_;
+        return raise(USB_INT_DISK_READ);
+    }
+    operation_ = Operation::None;
+    raise(ERR_MISS_FILE);
+}
+
+void CH376Emulator::dir_info(uint8_t index)
+{
+    if(index == 0xFF)
+    {
+        if(!open_)
+            return raise(ERR_FILE_CLOSE);
+        index = vars_[VAR_FILE_DIR_INDEX];
+    }
+    const uint8_t* sector = index < 16 ? read_sector(var32(VAR_FAT_DIR_LBA)) : nullptr;
+    if(!sector)
+        return raise(USB_INT_DISK_ERR);
+    buffer_.assign(sector + index * FatImage::ENTRY, sector + (index + 1) * FatImage::ENTRY);
+    raise(USB_INT_SUCCESS);
+}
+
+uint32_t CH376Emulator::limit() const
+{
+    return directory_ ? static_cast<uint32_t>(directory_sectors_.size() * FatImage::SECTOR) : var32(VAR_FILE_SIZE);
+}
+
+void CH376Emulator::seek(uint32_t offset)
+{
+    offset = std::min(offset, limit());
+    set_var32(VAR_CURRENT_OFFSET, offset);
+    position_valid_ = true;
+    if(directory_)
+        return;
+
+    // Walk the chain to the cluster holding the offset, or the last one at the end of the file
+    const uint32_t cluster_bytes = disk_.sectors_per_cluster() * FatImage::SECTOR;
+    uint32_t index = offset / cluster_bytes;
+    if(index && offset == limit() && offset % cluster_bytes == 0)
+        --index;
+    uint32_t cluster = var32(VAR_START_CLUSTER);
+    for(uint32_t i = 0; i < index && cluster != FatImage::END_OF_CHAIN; ++i)
+        cluster = next_cluster(cluster);
+    set_var32(VAR_CURRENT_CLUST, cluster);
+    cluster_offset_ = index * cluster_bytes;
+}
+
+uint32_t CH376Emulator::locate(uint32_t offset)
+{
+    operation_ = Operation::None;
+    if(!open_)
+        return NO_SECTOR;
+    seek(offset);
+
+    const uint32_t position = var32(VAR_CURRENT_OFFSET);
+    if(position >= limit())
+        return NO_SECTOR;
+    if(directory_)
+        return directory_sectors_[position / FatImage::SECTOR];
+    return disk_.cluster_lba(var32(VAR_CURRENT_CLUST)) + (position - cluster_offset_) / FatImage::SECTOR;
+}
+
+uint8_t CH376Emulator::next_byte()
+{
+    const uint32_t offset = var32(VAR_CURRENT_OFFSET);
+    uint32_t lba;
+    if(directory_)
+        lba = directory_sectors_[offset / FatImage::SECTOR];
+    else
+    {
+        // The chip moves to the next cluster only when it needs a byte from it
+        const uint32_t cluster_bytes = disk_.sectors_per_cluster() * FatImage::SECTOR;
+        uint32_t cluster = var32(VAR_CURRENT_CLUST);
+        if(offset - cluster_offset_ >= cluster_bytes)
+        {
+            cluster = next_cluster(cluster);
+            set_var32(VAR_CURRENT_CLUST, cluster);
+            cluster_offset_ += cluster_bytes;
+        }
+        lba = disk_.cluster_lba(cluster) + (offset - cluster_offset_) / FatImage::SECTOR;
+    }
+    const uint8_t* sector = read_sector(lba);
+    set_var32(VAR_CURRENT_OFFSET, offset + 1);
+    return sector ? sector[offset % FatImage::SECTOR] : 0;
+}
+
+void CH376Emulator::byte_read()
+{
+    if(operation_ != Operation::ByteRead || remaining_ == 0)
+    {
+        operation_ = Operation::None;
+        return raise(USB_INT_SUCCESS);
+    }
+    const uint32_t length = std::min<uint32_t>(remaining_, CH376_DAT_BLOCK_LEN);
+    buffer_.clear();
+    for(uint32_t i = 0; i < length; ++i)
+        buffer_.push_back(next_byte());
+    remaining_ -= length;
+    raise(USB_INT_DISK_READ);
+}
+
+void CH376Emulator::byte_write()
+{
+    if(write_error_)
+    {
+        operation_ = Operation::None;
+        flush_sector();
+        return raise(ERR_DISK_FULL);
+    }
+    if(operation_ != Operation::ByteWrite || remaining_ == 0)
+    {
+        // Like the chip, the sector is written back at the end of the command
+        operation_ = Operation::None;
+        flush_sector();
+        return raise(USB_INT_SUCCESS);
+    }
+    raise(USB_INT_DISK_WRITE);
+}
+
+bool CH376Emulator::put_byte(uint8_t data)
+{
+    const uint32_t offset = var32(VAR_CURRENT_OFFSET);
+    const uint32_t cluster_bytes = disk_.sectors_per_cluster() * FatImage::SECTOR;
+    uint32_t cluster = var32(VAR_CURRENT_CLUST);
+    if(cluster == 0)
+    {
+        // First byte of an empty file
+        cluster = append_cluster(0);
+        if(!cluster)
+            return false;
+        set_var32(VAR_START_CLUSTER, cluster);
+        set_var32(VAR_CURRENT_CLUST, cluster);
+        cluster_offset_ = 0;
+    }
+    else if(offset - cluster_offset_ >= cluster_bytes)
+    {
+        uint32_t next = next_cluster(cluster);
+        if(next == FatImage::END_OF_CHAIN && !(next = append_cluster(cluster)))
+            return false;
+        cluster = next;
+        set_var32(VAR_CURRENT_CLUST, cluster);
+        cluster_offset_ += cluster_bytes;
+    }
+
+    uint8_t* sector = write_sector(disk_.cluster_lba(cluster) + (offset - cluster_offset_) / FatImage::SECTOR);
+    sector[offset % FatImage::SECTOR] = data;
+    set_var32(VAR_CURRENT_OFFSET, offset + 1);
+    if(offset + 1 > var32(VAR_FILE_SIZE))
+        set_var32(VAR_FILE_SIZE, offset + 1);
+    modified_ = true;
+    return true;
+}
+
+void CH376Emulator::sector_read(uint8_t count)
+{
+    operation_ = Operation::None;
+    if(!open_ || directory_)
+        return raise(ERR_FILE_CLOSE);
+    if(!position_valid_)
+        seek(var32(VAR_CURRENT_OFFSET));
+
+    // Contiguous sectors: up to the end of the file or of the current cluster
+    const uint32_t cluster_bytes = disk_.sectors_per_cluster() * FatImage::SECTOR;
+    const uint32_t position = var32(VAR_CURRENT_OFFSET), offset = position / FatImage::SECTOR * FatImage::SECTOR;
+    uint32_t cluster = var32(VAR_CURRENT_CLUST), lba = 0, sectors = 0;
+    if(position < limit())
+    {
+        if(offset - cluster_offset_ >= cluster_bytes)
+        {
+            cluster = next_cluster(cluster);
+            set_var32(VAR_CURRENT_CLUST, cluster);
+            cluster_offset_ += cluster_bytes;
+        }
+        const uint32_t in_cluster = (offset - cluster_offset_) / FatImage::SECTOR;
+        const uint32_t in_file = (limit() - offset + FatImage::SECTOR - 1) / FatImage::SECTOR;
+        sectors = std::min<uint32_t>({count, in_file, disk_.sectors_per_cluster() - in_cluster});
+        lba = disk_.cluster_lba(cluster) + in_cluster;
+        set_var32(VAR_CURRENT_OFFSET, std::min(offset + sectors * FatImage::SECTOR, limit()));
+    }
+    buffer_.assign({static_cast<uint8_t>(sectors), 0, 0, 0});
+    put32(buffer_, lba);
+    raise(USB_INT_SUCCESS);
+}
+
+void CH376Emulator::disk_read()
+{
+    if(operation_ != Operation::DiskRead || remaining_ == 0)
+    {
+        operation_ = Operation::None;
+        return raise(USB_INT_SUCCESS);
+    }
+    const uint8_t* sector = read_sector(disk_lba_);
+    if(!sector)
+    {
+        operation_ = Operation::None;
+        return raise(USB_INT_DISK_ERR);
+    }
+    const uint32_t blocks = FatImage::SECTOR / CH376_DAT_BLOCK_LEN;
+    const uint32_t block = blocks - 1 - (remaining_ - 1) % blocks;
+    buffer_.assign(sector + block * CH376_DAT_BLOCK_LEN, sector + (block + 1) * CH376_DAT_BLOCK_LEN);
+    if(--remaining_ % blocks == 0)
+        ++disk_lba_;
+    raise(USB_INT_DISK_READ);
+}
+
+// CH376_hal.h on the emulator, instead of CH376_com_arduino_spi_hw.cpp and CH376_hal_base_arduino.cpp
+
+void CH376Delayus(UINT8 us) { ch376.advance(us * 1000ULL); }
+void CH376Delayms(UINT8 ms) { ch376.advance(ms * 1000000ULL); }
+void CH376_PORT_INIT() {}
+void xEndCH376Cmd() {}
+
+void xWriteCH376Cmd(UINT8 mCmd)
+{
+    CH376BeforeCmd();
+    ch376.command(mCmd);
+}
+
+void xWriteCH376Data(UINT8 mData) { ch376.write(mData); }
+UINT8 xReadCH376Data() { return ch376.read(); }
+
+void xReadCH376Block(PUINT8 buf, UINT8 len)
+{
+    while(len--)
+        *buf++ = ch376.read();
+}
+
+void xWriteCH376Block(PUINT8 buf, UINT8 len)
+{
+    while(len--)
+        ch376.write(*buf++);
+}
+
+UINT8 Query376Interrupt() { return ch376.interrupt() ? TRUE : FALSE; }
+
+UINT8 CH376_init(EM_STORAGE_TYPE storage_type)
+{
+    xWriteCH376Cmd(CMD11_CHECK_EXIST);
+    xWriteCH376Data(0x65);
+    if(xReadCH376Data() != 0x9A)
+        return ERR_USB_UNKNOWN;
+    xWriteCH376Cmd(CMD11_SET_USB_MODE);
+    xWriteCH376Data(storage_type == EMST_USB_DISK ? 0x06 : 0x03);
+    return xReadCH376Data() == CMD_RET_SUCCESS ? USB_INT_SUCCESS : ERR_USB_UNKNOWN;
+}
+
+// CH376_debug.h
+
+void mStopIfError(UINT8) {}
+void mInitSTDIO() {}
+void CH376DebugOut(const char*) {}
+void CH376DebugOutErr(UINT16) {}
+void CH376DebugOutPair(const char*, UINT16) {}
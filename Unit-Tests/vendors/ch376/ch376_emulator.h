@@ -0,0 +1,162 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef UNIT_TESTS_CH376_EMULATOR_H
+#define UNIT_TESTS_CH376_EMULATOR_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// CH376_include.h types 32-bit values as unsigned long, 64 bits on the host
+#define UINT32 uint32_t
+#define PUINT32 uint32_t*
+// CH376_debug.h and CH376_hal.h include MarlinConfig.h and fastio.h (AVR registers)
+#define MARLIN_CONFIG_H
+#define _FASTIO_ARDUINO_H_
+
+#include "../../../Marlin/mass_storage/CH376_debug.h"
+#include "fat_image.h"
+
+//! Latency knobs. Time is simulated: it only moves when the firmware talks to the chip or waits.
+struct CH376Timing
+{
+    CH376Timing();
+
+    uint32_t command_us[256];   //!< From the end of a command to INT#, by command code
+    uint32_t sector_us = 400;   //!< Added to the latency for each sector read from or written to the disk
+    uint32_t byte_ns = 1000;    //!< Each byte over the interface, command codes included
+    uint32_t poll_ns = 1000;    //!< Each Query376Interrupt() that finds INT# high
+};
+
+//! Transaction counters
+struct CH376Counters
+{
+    uint32_t commands = 0;          //!< Commands written
+    uint32_t command[256] = {};     //!< Commands written, by command code
+    uint32_t data_written = 0;      //!< Data bytes written, command codes not included
+    uint32_t data_read = 0;         //!< Data bytes read
+    uint32_t interrupts = 0;        //!< Interrupts raised
+    uint32_t polls = 0;             //!< Query376Interrupt() calls
+    uint32_t sectors = 0;           //!< Sectors read from the disk, FAT sectors included
+    uint32_t fat_sectors = 0;       //!< FAT sectors read from the disk
+    uint32_t sectors_written = 0;   //!< Sectors written to the disk, FAT and directory sectors included
+    uint32_t unsupported = 0;       //!< Commands not emulated
+};
+
+//! The CH376 in USB host file mode, behind the functions of CH376_hal.h.
+//! It emulates the command set used by CH376_file_sys.cpp, USBFile and USBReader: disk
+//! connect / mount / query, file open and enumeration, byte and sector locate and read,
+//! directory information, raw sector read, file create, byte write and close. The other
+//! commands writing to the disk (sector writes, erase, directory create) raise
+//! USB_INT_DISK_ERR.
+//!
+//! Like the chip, it keeps one sector of file data and one sector of FAT in its buffers:
+//! only the other sectors are read from the disk and add to the latency. A sector changed
+//! by BYTE_WRITE is written back at the end of the command. BYTE_LOCATE walks the FAT
+//! chain from VAR_START_CLUSTER. Directories are opened with a length of 0 and their
+//! pointer moves over all the sectors of their chain.
+class CH376Emulator
+{
+public:
+    CH376Emulator() { reset(); }
+
+    FatImage& disk() { return disk_; }
+    CH376Timing& timing() { return timing_; }
+    const CH376Counters& counters() const { return counters_; }
+    void reset_counters() { counters_ = CH376Counters{}; }
+
+    //! Power on: variables and buffers are cleared. The disk, knobs and counters are kept.
+    void reset();
+    //! Plug or unplug the USB stick
+    void connect(bool connected) { connected_ = connected; }
+
+    uint64_t now_ns() const { return now_ns_; }
+    uint32_t millis() const { return static_cast<uint32_t>(now_ns_ / 1000000); }
+    void advance(uint64_t ns) { now_ns_ += ns; }
+
+    uint32_t var32(uint8_t var) const;
+
+    // CH376_hal.h
+    void command(uint8_t cmd);
+    void write(uint8_t data);
+    uint8_t read();
+    bool interrupt();
+
+private:
+    enum class Operation { None, Enumerate, ByteRead, ByteWrite, DiskRead };
+
+    void execute();
+    void raise(uint8_t status);
+    void set_var32(uint8_t var, uint32_t value);
+    uint32_t param32(size_t index) const;
+    const uint8_t* read_sector(uint32_t lba, bool fat = false);
+    uint8_t* write_sector(uint32_t lba);
+    void flush_sector();
+    uint32_t next_cluster(uint32_t cluster);
+    uint32_t append_cluster(uint32_t last);
+
+    void mount();
+    uint32_t directory(std::string& name) const;
+    void open();
+    void create();
+    void close(bool update);
+    void enumerate();
+    void dir_info(uint8_t index);
+    uint32_t limit() const;
+    void seek(uint32_t offset);
+    uint32_t locate(uint32_t offset);
+    uint8_t next_byte();
+    void byte_read();
+    void byte_write();
+    bool put_byte(uint8_t data);
+    void sector_read(uint8_t count);
+    void disk_read();
+
+    FatImage disk_;
+    CH376Timing timing_;
+    CH376Counters counters_;
+    uint64_t now_ns_ = 0, interrupt_ns_ = 0, work_ns_ = 0;
+    bool connected_ = true, pending_ = false;
+
+    uint8_t vars_[256];
+    uint8_t cmd_ = 0, status_ = 0;
+    std::vector<uint8_t> params_, out_, buffer_;
+    size_t out_position_ = 0;
+    std::string name_;
+
+    Operation operation_ = Operation::None;
+    bool open_ = false, directory_ = false, modified_ = false;
+    std::vector<uint32_t> directory_sectors_;
+    size_t entry_ = 0;                          //!< Next entry to enumerate
+    std::string pattern_;
+    uint32_t remaining_ = 0;                    //!< Bytes or blocks left to read or write
+    uint8_t requested_ = 0;                     //!< Bytes left to write after WR_REQ_DATA
+    bool write_error_ = false;
+    uint32_t disk_lba_ = 0;
+    bool position_valid_ = false;
+    uint32_t cluster_offset_ = 0;               //!< Where VAR_CURRENT_CLUST starts in the file
+    uint32_t data_lba_ = 0xFFFFFFFF, fat_lba_ = 0xFFFFFFFF;
+    bool dirty_ = false;                        //!< The data sector has to be written back
+};
+
+extern CH376Emulator ch376;
+
+#endif //UNIT_TESTS_CH376_EMULATOR_H
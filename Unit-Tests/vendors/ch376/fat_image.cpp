@@ -0,0 +1,573 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "fat_image.h"
+
+namespace
+{
+    const uint8_t ATTR_VOLUME = 0x08, ATTR_DIR = 0x10, ATTR_FILE = 0x20, ATTR_LONG = 0x0F;
+    const uint8_t FREE = 0x00, DELETED = 0xE5;
+    const uint16_t DATE = ((2019 - 1980) << 9) + (1 << 5) + 1, TIME = 12 << 11;
+    //! Offsets of the 13 UCS-2 characters in a long name entry
+    const uint8_t LONG_NAME_CHARS[13] = {1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30};
+
+    void put16(uint8_t* p, uint16_t v) { p[0] = uint8_t(v); p[1] = uint8_t(v >> 8); }
+    void put32(uint8_t* p, uint32_t v) { put16(p, uint16_t(v)); put16(p + 2, uint16_t(v >> 16)); }
+
+    std::vector<std::string> split(const std::string& path)
+    {
+        std::vector<std::string> names;
+        std::string name;
+        for(char c: path)
+        {
+            if(c == '/' || c == '\\')
+            {
+                if(!name.empty())
+                    names.push_back(name);
+                name.clear();
+            }
+            else
+                name += c;
+        }
+        if(!name.empty())
+            names.push_back(name);
+        return names;
+    }
+}
+
+std::string fat_short_name(const std::string& name)
+{
+    std::string result(11, ' ');
+    if(name == "." || name == "..")
+        return result.replace(0, name.size(), name);
+    const auto dot = name.rfind('.');
+    const std::string base = name.substr(0, dot), ext = dot == std::string::npos ? "" : name.substr(dot + 1);
+    for(size_t i = 0; i < base.size() && i < 8; ++i)
+        result[i] = static_cast<char>(std::toupper(base[i]));
+    for(size_t i = 0; i < ext.size() && i < 3; ++i)
+        result[8 + i] = static_cast<char>(std::toupper(ext[i]));
+    return result;
+}
+
+uint8_t fat_name_checksum(const uint8_t* short_name)
+{
+    uint8_t sum = 0;
+    for(int i = 0; i < 11; ++i)
+        sum = static_cast<uint8_t>(((sum & 1) ? 0x80 : 0) + (sum >> 1) + short_name[i]);
+    return sum;
+}
+
+bool FatImage::format(Type type, uint32_t sectors, uint8_t sectors_per_cluster)
+{
+    const bool fat32 = type == Type::FAT32;
+    const uint32_t reserved = fat32 ? 32 : 1, root_entries = fat32 ? 0 : 512;
+    const uint32_t root_sectors = root_entries * ENTRY / SECTOR, entry_size = fat32 ? 4 : 2;
+    const uint32_t estimate = (sectors - reserved - root_sectors) / sectors_per_cluster;
+    const uint32_t fat_sectors = ((estimate + 2) * entry_size + SECTOR - 1) / SECTOR;
+    const uint32_t clusters = (sectors - reserved - 2 * fat_sectors - root_sectors) / sectors_per_cluster;
+    if(type == Type::None || clusters < 4085 || (fat32 ? clusters < 65525 : clusters >= 65525))
+        return false;
+
+    disk_.assign(static_cast<size_t>(sectors) * SECTOR, 0);
+    uint8_t* boot = sector(0);
+    const uint8_t jump[] = {0xEB, uint8_t(fat32 ? 0x58 : 0x3C), 0x90};
+    std::memcpy(boot, jump, sizeof(jump));
+    std::memcpy(boot + 3, "MSWIN4.1", 8);
+    put16(boot + 11, SECTOR);
+    boot[13] = sectors_per_cluster;
+    put16(boot + 14, uint16_t(reserved));
+    boot[16] = 2;
+    put16(boot + 17, uint16_t(root_entries));
+    boot[21] = 0xF8;
+    put16(boot + 24, 63);
+    put16(boot + 26, 255);
+    put32(boot + 32, sectors);
+    uint8_t* ext = boot + 36;
+    if(fat32)
+    {
+        put32(boot + 36, fat_sectors);
+        put32(boot + 44, 2);        // Root directory
+        put16(boot + 48, 1);        // FSInfo
+        put16(boot + 50, 6);        // Backup boot sector
+        ext = boot + 64;
+    }
+    else
+        put16(boot + 22, uint16_t(fat_sectors));
+    ext[0] = 0x80;
+    ext[2] = 0x29;
+    put32(ext + 3, 0x20190101);
+    std::memcpy(ext + 7, "3DLABS     ", 11);
+    std::memcpy(ext + 18, fat32 ? "FAT32   " : "FAT16   ", 8);
+    put16(boot + 510, 0xAA55);
+    if(fat32)
+    {
+        uint8_t* info = sector(1);
+        put32(info, 0x41615252);
+        put32(info + 484, 0x61417272);
+        put32(info + 488, 0xFFFFFFFF);
+        put32(info + 492, 0xFFFFFFFF);
+        put32(info + 508, 0xAA550000);
+    }
+
+    mount();
+    set_fat(0, 0x0FFFFFF8);
+    set_fat(1, END_OF_CHAIN);
+    if(fat32)
+        set_fat(root_cluster_, END_OF_CHAIN);
+
+    // Like most sticks, the root starts with the volume label
+    std::vector<Entry> label;
+    free_entries(root_cluster(), 1, label);
+    uint8_t* e = entry(label[0]);
+    std::memcpy(e, "3DLABS     ", 11);
+    e[11] = ATTR_VOLUME;
+    return true;
+}
+
+bool FatImage::load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+        return false;
+    disk_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return mount();
+}
+
+bool FatImage::save(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(disk_.data()), static_cast<std::streamsize>(disk_.size()));
+    return static_cast<bool>(file);
+}
+
+bool FatImage::mount()
+{
+    type_ = Type::None;
+    if(disk_.size() < SECTOR || le16(510) != 0xAA55)
+        return false;
+
+    // A disk with a MBR: the volume is the first partition
+    start_lba_ = disk_[0] == 0xEB || disk_[0] == 0xE9 ? 0 : le32(0x1C6);
+    const uint32_t boot = start_lba_ * SECTOR;
+    if(boot + SECTOR > disk_.size() || le16(boot + 11) != SECTOR || !disk_[boot + 13] || !disk_[boot + 16])
+        return false;
+
+    sectors_per_cluster_ = disk_[boot + 13];
+    fats_ = disk_[boot + 16];
+    const uint32_t reserved = le16(boot + 14), root_entries = le16(boot + 17);
+    const uint32_t total = le16(boot + 19) ? le16(boot + 19) : le32(boot + 32);
+    fat_sectors_ = le16(boot + 22) ? le16(boot + 22) : le32(boot + 36);
+    root_sectors_ = (root_entries * ENTRY + SECTOR - 1) / SECTOR;
+    fat_lba_ = start_lba_ + reserved;
+    root_lba_ = fat_lba_ + fats_ * fat_sectors_;
+    data_lba_ = root_lba_ + root_sectors_;
+    if(total <= data_lba_ - start_lba_)
+        return false;
+    clusters_ = (total - (data_lba_ - start_lba_)) / sectors_per_cluster_;
+    if(clusters_ < 4085)
+        return false;   // FAT12 is not supported by the CH376 firmware either
+    type_ = clusters_ < 65525 ? Type::FAT16 : Type::FAT32;
+    root_cluster_ = type_ == Type::FAT32 ? le32(boot + 44) : 0;
+    return true;
+}
+
+uint32_t FatImage::le32(uint32_t offset) const
+{
+    return le16(offset) | static_cast<uint32_t>(le16(offset + 2)) << 16;
+}
+
+uint16_t FatImage::le16(uint32_t offset) const
+{
+    return static_cast<uint16_t>(disk_[offset] | disk_[offset + 1] << 8);
+}
+
+const uint8_t* FatImage::sector(uint32_t lba) const
+{
+    return lba < disk_sectors() ? &disk_[static_cast<size_t>(lba) * SECTOR] : nullptr;
+}
+
+uint8_t* FatImage::sector(uint32_t lba)
+{
+    return lba < disk_sectors() ? &disk_[static_cast<size_t>(lba) * SECTOR] : nullptr;
+}
+
+uint32_t FatImage::fat_lba(uint32_t cluster) const
+{
+    return fat_lba_ + cluster * (type_ == Type::FAT32 ? 4 : 2) / SECTOR;
+}
+
+uint32_t FatImage::next(uint32_t cluster) const
+{
+    if(cluster < 2 || cluster >= clusters_ + 2)
+        return END_OF_CHAIN;
+    const uint32_t offset = fat_lba_ * SECTOR;
+    uint32_t value;
+    if(type_ == Type::FAT32)
+    {
+        value = le32(offset + cluster * 4) & 0x0FFFFFFF;
+        if(value >= 0x0FFFFFF8)
+            return END_OF_CHAIN;
+    }
+    else
+    {
+        value = le16(offset + cluster * 2);
+        if(value >= 0xFFF8)
+            return END_OF_CHAIN;
+    }
+    return value < 2 ? END_OF_CHAIN : value;
+}
+
+void FatImage::set_fat(uint32_t cluster, uint32_t value)
+{
+    for(uint32_t fat = 0; fat < fats_; ++fat)
+    {
+        uint8_t* p = &disk_[static_cast<size_t>(fat_lba_ + fat * fat_sectors_) * SECTOR];
+        if(type_ == Type::FAT32)
+            put32(p + cluster * 4, (p[cluster * 4 + 3] & 0xF0u) << 24 | (value & 0x0FFFFFFF));
+        else
+            put16(p + cluster * 2, value >= END_OF_CHAIN ? 0xFFFF : uint16_t(value));
+    }
+}
+
+uint32_t FatImage::free_clusters() const
+{
+    const uint32_t offset = fat_lba_ * SECTOR;
+    uint32_t count = 0;
+    for(uint32_t cluster = 2; cluster < clusters_ + 2; ++cluster)
+        if((type_ == Type::FAT32 ? le32(offset + cluster * 4) & 0x0FFFFFFF : le16(offset + cluster * 2)) == 0)
+            ++count;
+    return count;
+}
+
+uint32_t FatImage::allocate(uint32_t from)
+{
+    const uint32_t offset = fat_lba_ * SECTOR, end = clusters_ + 2;
+    for(uint32_t i = 0; i < clusters_; ++i)
+    {
+        uint32_t cluster = std::max<uint32_t>(from, 2) + i;
+        if(cluster >= end)
+            cluster -= clusters_;
+        if((type_ == Type::FAT32 ? le32(offset + cluster * 4) & 0x0FFFFFFF : le16(offset + cluster * 2)) == 0)
+        {
+            set_fat(cluster, END_OF_CHAIN);
+            return cluster;
+        }
+    }
+    return 0;
+}
+
+uint32_t FatImage::allocate_chain(uint32_t bytes, uint32_t gap)
+{
+    const uint32_t cluster_bytes = sectors_per_cluster_ * SECTOR;
+    uint32_t first = 0, previous = 0, from = 2;
+    for(uint32_t n = (bytes + cluster_bytes - 1) / cluster_bytes; n > 0; --n)
+    {
+        const uint32_t cluster = allocate(from);
+        if(!cluster)
+            return 0;
+        if(previous)
+            set_fat(previous, cluster);
+        else
+            first = cluster;
+        previous = cluster;
+        from = cluster + 1 + gap;
+    }
+    return first;
+}
+
+std::vector<uint32_t> FatImage::directory_sectors(uint32_t cluster) const
+{
+    std::vector<uint32_t> sectors;
+    if(cluster == 0 && type_ == Type::FAT16)
+    {
+        for(uint32_t i = 0; i < root_sectors_; ++i)
+            sectors.push_back(root_lba_ + i);
+        return sectors;
+    }
+    if(cluster == 0)
+        cluster = root_cluster_;
+    for(uint32_t n = 0; cluster != END_OF_CHAIN && n < clusters_; cluster = next(cluster), ++n)
+        for(uint32_t i = 0; i < sectors_per_cluster_; ++i)
+            sectors.push_back(cluster_lba(cluster) + i);
+    return sectors;
+}
+
+bool FatImage::find(const std::string& path, uint32_t& cluster, bool& directory) const
+{
+    cluster = root_cluster();
+    directory = true;
+    for(const auto& name: split(path))
+    {
+        if(!directory)
+            return false;
+        const std::string short_name = fat_short_name(name);
+        bool found = false, end = false;
+        for(uint32_t lba: directory_sectors(cluster))
+        {
+            const uint8_t* e = sector(lba);
+            for(uint32_t i = 0; i < SECTOR / ENTRY && !found && !end; ++i, e += ENTRY)
+            {
+                end = e[0] == FREE;
+                if(end || e[0] == DELETED || (e[11] & ATTR_LONG) == ATTR_LONG || (e[11] & ATTR_VOLUME))
+                    continue;
+                if(std::memcmp(e, short_name.data(), 11) == 0)
+                {
+                    found = true;
+                    directory = (e[11] & ATTR_DIR) != 0;
+                    cluster = (e[20] | e[21] << 8) << 16 | (e[26] | e[27] << 8);
+                }
+            }
+            if(found || end)
+                break;
+        }
+        if(!found)
+            return false;
+    }
+    return true;
+}
+
+bool FatImage::parent(const std::string& path, uint32_t& cluster, std::string& name) const
+{
+    const auto names = split(path);
+    if(names.empty())
+        return false;
+    name = names.back();
+    bool directory;
+    return find(path.substr(0, path.rfind(name)), cluster, directory) && directory;
+}
+
+bool FatImage::free_entries(uint32_t directory, uint8_t count, std::vector<Entry>& entries)
+{
+    for(;;)
+    {
+        entries.clear();
+        for(uint32_t lba: directory_sectors(directory))
+        {
+            const uint8_t* e = sector(lba);
+            for(uint8_t i = 0; i < SECTOR / ENTRY; ++i, e += ENTRY)
+            {
+                if(e[0] != FREE && e[0] != DELETED)
+                {
+                    entries.clear();
+                    continue;
+                }
+                entries.push_back(Entry{lba, i});
+                if(entries.size() == count)
+                    return true;
+            }
+        }
+        if(directory == 0 && type_ == Type::FAT16)
+            return false;   // Fixed size
+
+        // Add a cluster to the directory
+        uint32_t last = directory ? directory : root_cluster_;
+        while(next(last) != END_OF_CHAIN)
+            last = next(last);
+        const uint32_t cluster = allocate(last + 1);
+        if(!cluster)
+            return false;
+        set_fat(last, cluster);
+        std::memset(sector(cluster_lba(cluster)), 0, sectors_per_cluster_ * SECTOR);
+    }
+}
+
+bool FatImage::add_entry(const std::string& path, uint8_t attr, uint32_t cluster, uint32_t size,
+                         const std::string& long_name, uint32_t& parent_cluster)
+{
+    std::string name;
+    uint32_t existing;
+    bool directory;
+    if(!parent(path, parent_cluster, name) || find(path, existing, directory))
+        return false;
+
+    const std::string short_name = fat_short_name(name);
+    const uint8_t checksum = fat_name_checksum(reinterpret_cast<const uint8_t*>(short_name.data()));
+    const uint8_t long_entries = static_cast<uint8_t>((long_name.size() + 12) / 13);
+    std::vector<Entry> entries;
+    if(!free_entries(parent_cluster, long_entries + 1, entries))
+        return false;
+
+    // Long name entries come first, the last part of the name first
+    for(uint8_t n = 0; n < long_entries; ++n)
+    {
+        const uint8_t order = long_entries - n;
+        uint8_t* e = entry(entries[n]);
+        std::memset(e, 0, ENTRY);
+        e[0] = static_cast<uint8_t>(order | (n == 0 ? 0x40 : 0));
+        e[11] = ATTR_LONG;
+        e[13] = checksum;
+        for(uint8_t i = 0; i < 13; ++i)
+        {
+            const size_t c = (order - 1) * 13u + i;
+            put16(e + LONG_NAME_CHARS[i], c < long_name.size() ? uint8_t(long_name[c]) :
+                                          c == long_name.size() ? 0x0000 : 0xFFFF);
+        }
+    }
+
+    set_entry(entry(entries[long_entries]), short_name, attr, cluster, size);
+    return true;
+}
+
+void FatImage::set_entry(uint8_t* e, const std::string& short_name, uint8_t attr, uint32_t cluster, uint32_t size)
+{
+    std::memset(e, 0, ENTRY);
+    std::memcpy(e, short_name.data(), 11);
+    e[11] = attr;
+    put16(e + 14, TIME);
+    put16(e + 16, DATE);
+    put16(e + 18, DATE);
+    put16(e + 20, uint16_t(cluster >> 16));
+    put16(e + 22, TIME);
+    put16(e + 24, DATE);
+    put16(e + 26, uint16_t(cluster));
+    put32(e + 28, size);
+}
+
+bool FatImage::create(uint32_t directory, const std::string& name, uint32_t& lba, uint8_t& index)
+{
+    const std::string short_name = fat_short_name(name);
+    for(uint32_t sector_lba: directory_sectors(directory))
+    {
+        uint8_t* e = sector(sector_lba);
+        for(uint8_t i = 0; i < SECTOR / ENTRY; ++i, e += ENTRY)
+        {
+            if(e[0] == FREE)
+                break;
+            if(e[0] == DELETED || (e[11] & ATTR_LONG) == ATTR_LONG || (e[11] & ATTR_VOLUME) ||
+               std::memcmp(e, short_name.data(), 11) != 0)
+                continue;
+            if(e[11] & ATTR_DIR)
+                return false;
+            free_chain((e[20] | e[21] << 8) << 16 | (e[26] | e[27] << 8));
+            set_entry(e, short_name, ATTR_FILE, 0, 0);
+            lba = sector_lba;
+            index = i;
+            return true;
+        }
+    }
+
+    std::vector<Entry> entries;
+    if(!free_entries(directory, 1, entries))
+        return false;
+    set_entry(entry(entries[0]), short_name, ATTR_FILE, 0, 0);
+    lba = entries[0].lba;
+    index = entries[0].index;
+    return true;
+}
+
+uint32_t FatImage::append_cluster(uint32_t last)
+{
+    const uint32_t cluster = allocate(last ? last + 1 : 2);
+    if(cluster && last)
+        set_fat(last, cluster);
+    return cluster;
+}
+
+void FatImage::free_chain(uint32_t first)
+{
+    for(uint32_t cluster = first, n = 0; cluster >= 2 && cluster < clusters_ + 2 && n < clusters_; ++n)
+    {
+        const uint32_t following = next(cluster);
+        set_fat(cluster, 0);
+        cluster = following;
+    }
+}
+
+bool FatImage::mkdir(const std::string& path, const std::string& long_name)
+{
+    const uint32_t cluster = allocate(2);
+    if(!cluster)
+        return false;
+    uint8_t* data = sector(cluster_lba(cluster));
+    std::memset(data, 0, sectors_per_cluster_ * SECTOR);
+
+    uint32_t parent_cluster;
+    if(!add_entry(path, ATTR_DIR, cluster, 0, long_name, parent_cluster))
+    {
+        set_fat(cluster, 0);
+        return false;
+    }
+
+    // . and .. (the root is cluster 0 even on FAT32)
+    const uint32_t dots[2] = {cluster, parent_cluster == root_cluster() ? 0 : parent_cluster};
+    for(int i = 0; i < 2; ++i)
+    {
+        uint8_t* e = data + i * ENTRY;
+        std::memcpy(e, fat_short_name(i ? ".." : ".").data(), 11);
+        e[11] = ATTR_DIR;
+        put16(e + 20, uint16_t(dots[i] >> 16));
+        put16(e + 24, DATE);
+        put16(e + 26, uint16_t(dots[i]));
+    }
+    return true;
+}
+
+bool FatImage::add_file(const std::string& path, const std::vector<uint8_t>& data,
+                        const std::string& long_name, uint32_t gap)
+{
+    const uint32_t size = static_cast<uint32_t>(data.size()), cluster_bytes = sectors_per_cluster_ * SECTOR;
+    const uint32_t first = allocate_chain(size, gap);
+    if(size && !first)
+        return false;
+
+    uint32_t cluster = first;
+    for(uint32_t offset = 0; offset < size; offset += cluster_bytes, cluster = next(cluster))
+        std::memcpy(sector(cluster_lba(cluster)), &data[offset], std::min(cluster_bytes, size - offset));
+
+    uint32_t parent_cluster;
+    return add_entry(path, ATTR_FILE, first, size, long_name, parent_cluster);
+}
+
+std::vector<uint8_t> FatImage::file(const std::string& path) const
+{
+    std::string name;
+    uint32_t directory;
+    std::vector<uint8_t> data;
+    if(!parent(path, directory, name))
+        return data;
+
+    const std::string short_name = fat_short_name(name);
+    for(uint32_t lba: directory_sectors(directory))
+    {
+        const uint8_t* e = sector(lba);
+        for(uint32_t i = 0; i < SECTOR / ENTRY; ++i, e += ENTRY)
+        {
+            if(e[0] == FREE)
+                return data;
+            if(e[0] == DELETED || (e[11] & (ATTR_VOLUME | ATTR_DIR)) || std::memcmp(e, short_name.data(), 11) != 0)
+                continue;
+            const uint32_t size = e[28] | e[29] << 8 | e[30] << 16 | static_cast<uint32_t>(e[31]) << 24;
+            const uint32_t cluster_bytes = sectors_per_cluster_ * SECTOR;
+            uint32_t cluster = (e[20] | e[21] << 8) << 16 | (e[26] | e[27] << 8);
+            for(uint32_t offset = 0; offset < size && cluster != END_OF_CHAIN; offset += cluster_bytes, cluster = next(cluster))
+            {
+                const uint8_t* p = sector(cluster_lba(cluster));
+                data.insert(data.end(), p, p + std::min(cluster_bytes, size - offset));
+            }
+            return data;
+        }
+    }
+    return data;
+}
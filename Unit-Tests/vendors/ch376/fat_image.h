@@ -0,0 +1,114 @@
+/**
+ * ADVi3++ Unit Tests
+ *
+ * Copyright (C) 2018 Sebastien Andrivet [https://github.com/andrivet/]
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef UNIT_TESTS_FAT_IMAGE_H
+#define UNIT_TESTS_FAT_IMAGE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//! A FAT16 or FAT32 disk held in memory: the USB stick behind the CH376 emulator.
+//! It is either loaded from an image file (a raw volume or a disk with a MBR) or
+//! formatted and filled by the tests. Names are given as 8.3 short names.
+class FatImage
+{
+public:
+    static const uint32_t SECTOR = 512;
+    static const uint32_t END_OF_CHAIN = 0x0FFFFFFF;
+    static const uint8_t ENTRY = 32;
+
+    enum class Type { None, FAT16, FAT32 };
+
+    //! Create an empty volume. Return false if the number of clusters does not fit the type.
+    bool format(Type type, uint32_t sectors, uint8_t sectors_per_cluster);
+    //! Load a disk image (such as a file mounted with mount -o loop) and mount it
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    //! Create a directory, and its long name if any. Return false if the parent does not exist.
+    bool mkdir(const std::string& path, const std::string& long_name = "");
+    //! Create a file. With a 'gap', that many free clusters are left between its clusters.
+    bool add_file(const std::string& path, const std::vector<uint8_t>& data,
+                  const std::string& long_name = "", uint32_t gap = 0);
+    //! Read a file, empty if it does not exist
+    std::vector<uint8_t> file(const std::string& path) const;
+
+    //! Analyse the boot sector. Return false if it is not a FAT16 or FAT32 volume.
+    bool mount();
+    Type type() const { return type_; }
+
+    uint32_t disk_sectors() const { return static_cast<uint32_t>(disk_.size() / SECTOR); }
+    uint32_t start_lba() const { return start_lba_; }
+    uint32_t data_lba() const { return data_lba_; }
+    uint8_t sectors_per_cluster() const { return sectors_per_cluster_; }
+    uint32_t clusters() const { return clusters_; }
+    uint32_t free_clusters() const;
+    //! First cluster of the root directory, 0 for the fixed root directory of FAT16
+    uint32_t root_cluster() const { return type_ == Type::FAT32 ? root_cluster_ : 0; }
+
+    //! Sector at an absolute LBA, nullptr past the end of the disk
+    const uint8_t* sector(uint32_t lba) const;
+    uint8_t* sector(uint32_t lba);
+    //! LBA of the sector of the FAT holding the entry of 'cluster'
+    uint32_t fat_lba(uint32_t cluster) const;
+    //! Next cluster in the chain, END_OF_CHAIN (or above) if it is the last one
+    uint32_t next(uint32_t cluster) const;
+    uint32_t cluster_lba(uint32_t cluster) const { return data_lba_ + (cluster - 2) * sectors_per_cluster_; }
+    //! Sectors of a directory: its chain, or the fixed root of FAT16 (cluster 0)
+    std::vector<uint32_t> directory_sectors(uint32_t cluster) const;
+
+    //! Create an empty file in a directory (0 for the root), or empty the file if it exists.
+    //! Give the sector and index of its entry. Return false if it is a directory or if there is no room.
+    bool create(uint32_t directory, const std::string& name, uint32_t& lba, uint8_t& index);
+    //! Add a free cluster at the end of a chain, or start a chain if 'last' is 0. Return 0 if the disk is full.
+    uint32_t append_cluster(uint32_t last);
+    //! Make the clusters of a chain free
+    void free_chain(uint32_t first);
+
+private:
+    struct Entry { uint32_t lba; uint8_t index; };
+
+    uint32_t le32(uint32_t offset) const;
+    uint16_t le16(uint32_t offset) const;
+    void set_fat(uint32_t cluster, uint32_t value);
+    uint32_t allocate(uint32_t from);
+    uint32_t allocate_chain(uint32_t bytes, uint32_t gap);
+    bool find(const std::string& path, uint32_t& cluster, bool& directory) const;
+    bool parent(const std::string& path, uint32_t& cluster, std::string& name) const;
+    bool free_entries(uint32_t directory, uint8_t count, std::vector<Entry>& entries);
+    bool add_entry(const std::string& path, uint8_t attr, uint32_t cluster, uint32_t size,
+                   const std::string& long_name, uint32_t& parent_cluster);
+    void set_entry(uint8_t* e, const std::string& short_name, uint8_t attr, uint32_t cluster, uint32_t size);
+    uint8_t* entry(const Entry& e) { return sector(e.lba) + e.index * ENTRY; }
+
+    std::vector<uint8_t> disk_;
+    Type type_ = Type::None;
+    uint32_t start_lba_ = 0, fat_lba_ = 0, fat_sectors_ = 0, root_lba_ = 0, root_sectors_ = 0;
+    uint32_t data_lba_ = 0, clusters_ = 0, root_cluster_ = 0;
+    uint8_t sectors_per_cluster_ = 0, fats_ = 0;
+};
+
+//! Short name in the 11 bytes form of the directory entries, such as "PART    GCO"
+std::string fat_short_name(const std::string& name);
+//! Checksum of a short name, stored in its long name entries
+uint8_t fat_name_checksum(const uint8_t* short_name);
+
+#endif //UNIT_TESTS_FAT_IMAGE_H